@@ -57,4 +57,133 @@ int run_server(struct core_object *co);
  */
 int close_server(struct core_object *co);
 
+/*
+ * Request handlers are loaded from their own shared library, like the engines, so that any engine can run any
+ * work on the messages it receives. An engine starts each message with on_message_begin, which gives the message
+ * a state of its own, since an engine such as poll-server receives many messages at once, interleaved. It then
+ * passes the message to on_message in chunks, in order, as they are received; the chunks are only valid for the
+ * duration of the call. A last call with a NULL chunk marks the end of the message, and is where the handler
+ * fills in the response. on_message_end frees the state of the message, whether it ended or was cut short by the
+ * client going away. The handler state is shared by every message in the process.
+ */
+
+/**
+ * handler_initialize
+ * <p>
+ * Set up the state of a request handler.
+ * </p>
+ * @param state where to store the state, passed to every other call
+ * @return 0 on success, -1 and set errno on failure
+ */
+int handler_initialize(void **state);
+
+/**
+ * on_message_begin
+ * <p>
+ * Set up the state of a message, before its first chunk.
+ * </p>
+ * @param state the handler state
+ * @param length the length of the whole payload
+ * @param message where to store the state of the message, which must not be NULL on success
+ * @return 0 on success, -1 and set errno on failure
+ */
+int on_message_begin(void *state, uint64_t length, void **message);
+
+/**
+ * on_message
+ * <p>
+ * Handle the next chunk of a message, or finish the message.
+ * </p>
+ * @param state the handler state
+ * @param message the state of the message
+ * @param chunk the next bytes of the payload, NULL at the end of the message
+ * @param chunk_len the number of bytes in chunk
+ * @param length the length of the whole payload
+ * @param response the response to the message, filled in at the end of the message
+ * @return 0 on success, -1 and set errno on failure
+ */
+int on_message(void *state, void *message, const uint8_t *chunk, size_t chunk_len, uint64_t length,
+               struct handler_response *response);
+
+/**
+ * on_message_end
+ * <p>
+ * Free the state of a message, once it has ended or been given up on.
+ * </p>
+ * @param state the handler state
+ * @param message the state of the message
+ */
+void on_message_end(void *state, void *message);
+
+/**
+ * handler_close
+ * <p>
+ * Report on and free the state of a request handler. Called in every process which handled messages.
+ * </p>
+ * @param state the handler state
+ */
+void handler_close(void *state);
+
+/**
+ * handle_begin
+ * <p>
+ * Start a message in the loaded request handler. Without one, the message has no state.
+ * </p>
+ * @param co the core object
+ * @param length the length of the whole payload
+ * @param message where to store the state of the message, NULL without a handler
+ * @return 0 on success, -1 and set errno on failure
+ */
+static inline int handle_begin(const struct core_object *co, uint64_t length, void **message)
+{
+    *message = NULL;
+    if (!co->handler.on_message)
+    {
+        return 0;
+    }
+    
+    return co->handler.begin(co->handler.state, length, message);
+}
+
+/**
+ * handle_chunk
+ * <p>
+ * Pass the next chunk of a message, or its end, to the loaded request handler. Does nothing without one.
+ * </p>
+ * @param co the core object
+ * @param message the state of the message, from handle_begin
+ * @param chunk the next bytes of the payload, NULL at the end of the message
+ * @param chunk_len the number of bytes in chunk
+ * @param length the length of the whole payload
+ * @param response the response to the message
+ * @return 0 on success, -1 and set errno on failure
+ */
+static inline int handle_chunk(const struct core_object *co, void *message, const void *chunk, size_t chunk_len,
+                               uint64_t length, struct handler_response *response)
+{
+    if (!co->handler.on_message)
+    {
+        return 0;
+    }
+    
+    return co->handler.on_message(co->handler.state, message, (const uint8_t *) chunk, chunk_len, length, response);
+}
+
+/**
+ * handle_end
+ * <p>
+ * Free the state of a message in the loaded request handler. Does nothing if the message has no state.
+ * </p>
+ * @param co the core object
+ * @param message the state of the message, set to NULL
+ */
+static inline void handle_end(const struct core_object *co, void **message)
+{
+    if (*message)
+    {
+        co->handler.end(co->handler.state, *message);
+        *message = NULL;
+    }
+}
+
 #endif //SCALABLE_SERVER_API_FUNCTIONS_H
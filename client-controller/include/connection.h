@@ -40,4 +40,60 @@ int send_stop(struct state * s, struct dc_error * err, struct dc_env * env);
  */
 int send_data(struct state * s, struct dc_error * err, struct dc_env * env);
 
+/**
+ * send_scenario
+ * <p>
+ * send the scenario command to all connected clients, then the data as send_data does, then to each client its index
+ * and the scenario, prefixed with its size. clients run the phases of the scenario meant for their index from then on,
+ * in place of the start command. Commands are sent to all connections regardless of any errors.
+ * </p>
+ * @param s pointer to the state structure.
+ * @param err pointer to the dc_error structure.
+ * @param env pointer to the dc_env structure.
+ * @return 0 on success. On failure -1 and set errno.
+ */
+int send_scenario(struct state * s, struct dc_error * err, struct dc_env * env);
+
+/**
+ * send_search
+ * <p>
+ * send the search command to all connected clients, then the data as send_data does. clients then run the steps of
+ * the search as send_step sends them, until the stop command. Commands are sent to all connections regardless of any
+ * errors.
+ * </p>
+ * @param s pointer to the state structure.
+ * @param err pointer to the dc_error structure.
+ * @param env pointer to the dc_env structure.
+ * @return 0 on success. On failure -1 and set errno.
+ */
+int send_search(struct state * s, struct dc_error * err, struct dc_env * env);
+
+/**
+ * send_step
+ * <p>
+ * send a step of the search to all connected clients: its rate, shared evenly among them, in thousandths of a request
+ * per second, then the seconds it is measured and the seconds of warm-up before. Commands are sent to all connections
+ * regardless of any errors.
+ * </p>
+ * @param s pointer to the state structure.
+ * @param rate the requests per second of the step, across the clients.
+ * @param err pointer to the dc_error structure.
+ * @param env pointer to the dc_env structure.
+ * @return 0 on success. On failure -1 and set errno.
+ */
+int send_step(struct state * s, double rate, struct dc_error * err, struct dc_env * env);
+
+/**
+ * read_results
+ * <p>
+ * read what every client measured in a step, once it is over, and merge them into one result.
+ * </p>
+ * @param s pointer to the state structure.
+ * @param dst where to store the result.
+ * @param err pointer to the dc_error structure.
+ * @param env pointer to the dc_env structure.
+ * @return 0 on success. On failure -1 and set errno.
+ */
+int read_results(struct state * s, struct search_result * dst, struct dc_error * err, struct dc_env * env);
+
 #endif //CLIENT_CONTROLLER_CONNECTION_H
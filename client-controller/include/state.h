@@ -1,6 +1,8 @@
 #ifndef SCALABLE_CLIENT_STATE_H
 #define SCALABLE_CLIENT_STATE_H
 
+#include "../../core/include/search.h"
+
 #include <netinet/in.h>
 #include <dc_env/env.h>
 #include <dc_error/error.h>
@@ -19,6 +21,10 @@ struct init_state_params {
     const char *server_port;
     const char *data_file_name;
     int wait_period_sec;
+    const char *scenario_file_name;
+    const char *slo;
+    const char *rate;
+    uint16_t warmup_sec;
 };
 
 /**
@@ -39,6 +45,11 @@ struct state {
     off_t data_size;
     bool started;
     int wait_period_sec;
+    char * scenario; // The scenario file, sent to every client in place of the start command; NULL if not passed.
+    bool search; // Search for the highest rate that holds to slo, in steps of the wait period, in place of a test.
+    struct search_slo slo;
+    double rate; // Requests per second of the first step, shared among the clients.
+    uint16_t warmup_sec; // Seconds of load before each step is measured.
 };
 
 /**
@@ -17,6 +17,18 @@
  */
 int write_fully(int fd, void * data, size_t size);
 
+/**
+ * read_fully
+ * <p>
+ * reads data fully from a file descriptor. the other end closing before all of it has come is a failure.
+ * </p>
+ * @param fd file descriptor to read from.
+ * @param data where to write read data.
+ * @param size size of data to read.
+ * @return 0 on success. On failure -1 and set errno.
+ */
+int read_fully(int fd, void * data, size_t size);
+
 /**
  * TCP_socket
  * <p>
@@ -1,4 +1,5 @@
 #include "connection.h"
+#include "../../protocol.h"
 
 #include <util.h>
 
@@ -7,6 +8,9 @@
 
 static uint16_t start = 1;
 static uint16_t stop = 2;
+static uint16_t scenario = 3;
+static uint16_t search = 4;
+static uint16_t step = 5;
 
 int send_start(struct state * s, struct dc_error * err, struct dc_env * env) {
     DC_TRACE(env);
@@ -63,3 +67,106 @@ int send_data(struct state * s, struct dc_error * err, struct dc_env * env) {
 
     return result;
 }
+
+int send_scenario(struct state * s, struct dc_error * err, struct dc_env * env) {
+    DC_TRACE(env);
+
+    int result = 0;
+    uint32_t size = (uint32_t) strlen(s->scenario);
+    uint32_t net_size = htonl(size);
+    for (int i = 0; i < s->num_conns; i++)
+    {
+        uint16_t net_scenario = htons(scenario);
+        if (write_fully(s->accepted_fds[i], &net_scenario, sizeof(net_scenario)) == -1) {
+            result = -1;
+        }
+    }
+    s->started = true;
+
+    if (send_data(s, err, env) == -1) {
+        result = -1;
+    }
+
+    for (int i = 0; i < s->num_conns; i++)
+    {
+        uint16_t net_client = htons((uint16_t) i); // the index client settings in the scenario refer to.
+        if (write_fully(s->accepted_fds[i], &net_client, sizeof(net_client)) == -1) {
+            result = -1;
+        }
+        if (write_fully(s->accepted_fds[i], &net_size, sizeof(net_size)) == -1) {
+            result = -1;
+        }
+        if (write_fully(s->accepted_fds[i], s->scenario, size) == -1) {
+            result = -1;
+        }
+    }
+
+    return result;
+}
+
+int send_search(struct state * s, struct dc_error * err, struct dc_env * env) {
+    DC_TRACE(env);
+
+    int result = 0;
+    for (int i = 0; i < s->num_conns; i++)
+    {
+        uint16_t net_search = htons(search);
+        if (write_fully(s->accepted_fds[i], &net_search, sizeof(net_search)) == -1) {
+            result = -1;
+        }
+    }
+    s->started = true;
+
+    if (send_data(s, err, env) == -1) {
+        result = -1;
+    }
+
+    return result;
+}
+
+int send_step(struct state * s, double rate, struct dc_error * err, struct dc_env * env) {
+    DC_TRACE(env);
+
+    int result = 0;
+    uint8_t net_rate[sizeof(uint64_t)];
+    uint16_t net_step = htons(step);
+    uint16_t net_duration = htons((uint16_t) s->wait_period_sec);
+    uint16_t net_warmup = htons(s->warmup_sec);
+    protocol_put_u64(net_rate, (uint64_t) (rate * 1000 / s->num_conns)); // thousandths of a request per second.
+    for (int i = 0; i < s->num_conns; i++)
+    {
+        if (write_fully(s->accepted_fds[i], &net_step, sizeof(net_step)) == -1) {
+            result = -1;
+        }
+        if (write_fully(s->accepted_fds[i], net_rate, sizeof(net_rate)) == -1) {
+            result = -1;
+        }
+        if (write_fully(s->accepted_fds[i], &net_duration, sizeof(net_duration)) == -1) {
+            result = -1;
+        }
+        if (write_fully(s->accepted_fds[i], &net_warmup, sizeof(net_warmup)) == -1) {
+            result = -1;
+        }
+    }
+
+    return result;
+}
+
+int read_results(struct state * s, struct search_result * dst, struct dc_error * err, struct dc_env * env) {
+    DC_TRACE(env);
+
+    uint8_t buf[SEARCH_RESULT_SIZE];
+    struct search_result result;
+
+    memset(dst, 0, sizeof(struct search_result));
+    for (int i = 0; i < s->num_conns; i++)
+    {
+        if (read_fully(s->accepted_fds[i], buf, sizeof(buf)) == -1) {
+            return -1;
+        }
+        search_result_decode(&result, buf);
+        search_result_merge(dst, &result);
+    }
+
+    return 0;
+}
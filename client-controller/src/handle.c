@@ -1,6 +1,7 @@
 #include "handle.h"
 
 #include <connection.h>
+#include <util.h>
 
 #include <poll.h>
 #include <stdio.h>
@@ -11,6 +12,8 @@
 #include <arpa/inet.h>
 
 #define START_COMMAND "start"
+#define SEARCH_FILE_NAME "saturation.csv" // truncated; one search's steps.
+#define NS_PER_US ((double) 1000)
 
 /**
  * handle_accept
@@ -29,7 +32,8 @@ static int handle_accept(struct pollfd *pfd, struct state * s, struct dc_error *
  * handle_stdin
  * <p>
  * check if a user input equals the start command. If so, send the start command to clients and then send server port,
- * server ip, and data.
+ * server ip, and data; or, with a scenario, send the scenario command, the same data and the scenario; or, with a
+ * latency objective, run a saturation search.
  * </p>
  * @param pfd poll file descriptor to reset revents on.
  * @param s the program state struct.
@@ -39,6 +43,20 @@ static int handle_accept(struct pollfd *pfd, struct state * s, struct dc_error *
  */
 static int handle_stdin(struct pollfd *pfd, struct state * s, struct dc_error * err, struct dc_env * env);
 
+/**
+ * run_search
+ * <p>
+ * search for the highest rate the clients together sustain within the latency objective, one step of the wait period
+ * at a time, judging each step by what all the clients measured. every step is written to the saturation file as a
+ * point of the latency against throughput curve, and the highest throughput sustained is printed at the end.
+ * </p>
+ * @param s the program state struct.
+ * @param err pointer to a dc_err struct.
+ * @param env pointer to a dc_env struct.
+ * @return 0 on success. On failure, -1 and set errno.
+ */
+static int run_search(struct state * s, struct dc_error * err, struct dc_env * env);
+
 /**
  * wait_duration
  * <p>
@@ -163,6 +181,22 @@ static int handle_stdin(struct pollfd *pfd, struct state * s, struct dc_error *
 
     buff[strcspn(buff, "\n\r")] = 0; // trim trailing \n or \r from input
 
+    if (strcmp(buff, START_COMMAND) == 0 && s->search)
+    {
+        if (s->num_conns == 0) {
+            (void) fprintf(stdout, "No clients to search with yet\n");
+            return SUCCESS;
+        }
+        return (run_search(s, err, env) == -1) ? ERROR : STARTED;
+    }
+    if (strcmp(buff, START_COMMAND) == 0 && s->scenario != NULL)
+    {
+        if (send_scenario(s, err, env) == -1) {
+            return ERROR;
+        }
+        wait_duration(s, err, env);
+        return STARTED;
+    }
     if (strcmp(buff, START_COMMAND) == 0)
     {
         if (send_start(s, err, env) == -1) {
@@ -178,6 +212,46 @@ static int handle_stdin(struct pollfd *pfd, struct state * s, struct dc_error *
     return SUCCESS;
 }
 
+static int run_search(struct state * s, struct dc_error * err, struct dc_env * env) {
+    struct search search;
+    struct search_step step;
+    struct search_result result;
+    FILE *csv;
+    bool more;
+    int ret;
+
+    if (open_file(&csv, SEARCH_FILE_NAME, "w") == -1) return -1;
+    search_init(&search, &s->slo, s->rate);
+    (void) fprintf(stdout, "Starting saturation search for %s with %d clients, in %d second steps\n", s->slo.spec,
+                   s->num_conns, s->wait_period_sec);
+
+    ret = send_search(s, err, env);
+    more = true;
+    while (ret == 0 && more && !sig_quit) {
+        (void) fprintf(stdout, "Step %u, %.1f requests/s...", search.steps + 1, search.rate);
+        fflush(stdout);
+        if (send_step(s, search.rate, err, env) == -1 || read_results(s, &result, err, env) == -1) {
+            ret = -1;
+        } else {
+            search_judge(&search, &result, &step);
+            search_write_step(&search, &step, csv);
+            (void) fprintf(stdout, "%.1f requests/s, p%g %.1fus, %s\n", step.throughput, s->slo.percentile,
+                           (double) step.latency_ns / NS_PER_US, (step.sustained) ? "sustained" : "missed");
+            more = search_next(&search, &step);
+        }
+    }
+    if (search.steps > 0) {
+        search_print(&search, stdout);
+    }
+
+    if (fclose(csv) == EOF) {
+        perror("closing saturation file");
+        ret = -1;
+    }
+
+    return ret;
+}
+
 static void wait_duration(struct state * s, struct dc_error * err, struct dc_env * env) {
     (void) fprintf(stdout, "Starting %d second load test with %d clients", s->wait_period_sec, s->num_conns);
     for (int i = 0; i < s->wait_period_sec && !sig_quit; i++) {
@@ -14,8 +14,10 @@
 
 #define DEFAULT_LISTEN_PORT "5000" // port read as a string
 #define DEFAULT_SERVER_PORT "5000"
+#define DEFAULT_RATE "1000" // requests per second of the first step of a search, across the clients.
 
 static const int default_duration = 15; // not #defined so pointer can be used
+static const int default_warmup = 0;
 
 /**
  * application_settings
@@ -31,6 +33,10 @@ struct application_settings
     struct dc_setting_string *server_port;
     struct dc_setting_string *data_file_name;
     struct dc_setting_uint16 *duration_sec;
+    struct dc_setting_string *scenario_file_name;
+    struct dc_setting_string *slo;
+    struct dc_setting_string *rate;
+    struct dc_setting_uint16 *warmup_sec;
 };
 
 /**
@@ -121,6 +127,10 @@ static struct dc_application_settings *create_settings(const struct dc_env *env,
     settings->server_ip               = dc_setting_string_create(env, err);
     settings->data_file_name          = dc_setting_string_create(env, err);
     settings->duration_sec            = dc_setting_uint16_create(env, err);
+    settings->scenario_file_name      = dc_setting_string_create(env, err);
+    settings->slo                     = dc_setting_string_create(env, err);
+    settings->rate                    = dc_setting_string_create(env, err);
+    settings->warmup_sec              = dc_setting_uint16_create(env, err);
 
     struct options opts[] = {
             {(struct dc_setting *) settings->opts.parent.config_path,
@@ -183,13 +193,53 @@ static struct dc_application_settings *create_settings(const struct dc_env *env,
                     "duration",
                     dc_uint16_from_config,
                     &default_duration},
+            {(struct dc_setting *) settings->scenario_file_name,
+                    dc_options_set_string,
+                    "scenario",
+                    required_argument,
+                    'S',
+                    "SCENARIO",
+                    dc_string_from_string,
+                    "scenario",
+                    dc_string_from_config,
+                    NULL},
+            {(struct dc_setting *) settings->slo,
+                    dc_options_set_string,
+                    "slo",
+                    required_argument,
+                    'L',
+                    "SLO",
+                    dc_string_from_string,
+                    "slo",
+                    dc_string_from_config,
+                    NULL},
+            {(struct dc_setting *) settings->rate,
+                    dc_options_set_string,
+                    "rate",
+                    required_argument,
+                    'R',
+                    "RATE",
+                    dc_string_from_string,
+                    "rate",
+                    dc_string_from_config,
+                    DEFAULT_RATE},
+            {(struct dc_setting *) settings->warmup_sec,
+                    dc_options_set_uint16,
+                    "warmup",
+                    required_argument,
+                    'W',
+                    "WARMUP",
+                    dc_uint16_from_string,
+                    "warmup",
+                    dc_uint16_from_config,
+                    &default_warmup},
     };
 
     settings->opts.opts_count = (sizeof(opts) / sizeof(struct options)) + 1;
     settings->opts.opts_size  = sizeof(struct options);
     settings->opts.opts       = dc_calloc(env, err, settings->opts.opts_count, settings->opts.opts_size);
     dc_memcpy(env, settings->opts.opts, opts, sizeof(opts));
-    settings->opts.flags      = "c:p:s:P:d:t:";
+    settings->opts.flags      = "c:p:s:P:d:t:S:L:R:W:";
     settings->opts.env_prefix = "CLIENT_CONTROLLER";
 
     return (struct dc_application_settings *) settings;
@@ -212,6 +262,10 @@ static int run(const struct dc_env *env, struct dc_error *err, struct dc_applica
     params.server_port = dc_setting_string_get(env, app_settings->server_port);
     params.data_file_name = dc_setting_string_get(env, app_settings->data_file_name);
     params.wait_period_sec = dc_setting_uint16_get(env, app_settings->duration_sec);
+    params.scenario_file_name = dc_setting_string_get(env, app_settings->scenario_file_name);
+    params.slo = dc_setting_string_get(env, app_settings->slo);
+    params.rate = dc_setting_string_get(env, app_settings->rate);
+    params.warmup_sec = dc_setting_uint16_get(env, app_settings->warmup_sec);
 
     init_result = init_state(&params, &s, err, env);
     if (init_result != -1)
@@ -1,4 +1,5 @@
 #include "../include/state.h"
+#include "../../core/include/scenario.h"
 #include "connection.h"
 
 #include <util.h>
@@ -9,8 +10,10 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <stdlib.h>
+#include <errno.h>
 
 #define BACKLOG 10
+#define SCENARIO_GRACE_SEC 2 // clients restart their threads between phases, so a scenario runs a little long.
 
 /**
  * start_listen
@@ -49,6 +52,28 @@ static int load_data(char **dst, off_t * size_dst, const char *file_name, const
  */
 static int validate_params(struct init_state_params * params, struct dc_env * env);
 
+/**
+ * load_scenario
+ * <p>
+ * reads a scenario file and checks that it parses, so that no client gets a scenario it cannot run.
+ * </p>
+ * @param s the program state, whose wait period becomes the length of the scenario.
+ * @param file_name name of the file to read.
+ * @return 0 on success. -1 on failure, described on stderr.
+ */
+static int load_scenario(struct state * s, const char * file_name);
+
+/**
+ * load_search
+ * <p>
+ * parses the latency objective and the first rate of a saturation search.
+ * </p>
+ * @param s the program state.
+ * @param params pointer to the init_state_params structure.
+ * @return 0 on success. -1 on failure, described on stderr.
+ */
+static int load_search(struct state * s, const struct init_state_params * params);
+
 int init_state(struct init_state_params * params, struct state * s, struct dc_error * err, struct dc_env * env) {
     DC_TRACE(env);
     struct sockaddr_in server_addr; // only used to validate server ip and port, never accessed
@@ -66,6 +91,8 @@ int init_state(struct init_state_params * params, struct state * s, struct dc_er
     if (init_addr(&server_addr, s->server_ip, s->server_port) == -1) return -1; // only used for validation
 
     if (load_data(&s->data, &s->data_size, params->data_file_name, "r", env) == -1) return -1;
+    if (params->scenario_file_name != NULL && load_scenario(s, params->scenario_file_name) == -1) return -1;
+    if (params->slo != NULL && load_search(s, params) == -1) return -1;
 
     return start_listen(s, err, env);
 }
@@ -81,6 +108,13 @@ static int validate_params(struct init_state_params * params, struct dc_env * en
         (void) fprintf(stderr, "Data file required, pass with -d\n");
         return -1;
     }
+    if (params->scenario_file_name != NULL && params->slo != NULL) {
+        (void) fprintf(stderr, "A scenario sets its own load, do not pass both -S and -L\n");
+        return -1;
+    }
+    if (params->slo == NULL && params->warmup_sec > 0) {
+        (void) fprintf(stdout, "WARNING: Warm-up only used by a search, pass with -L\n");
+    }
     return 0;
 }
 
@@ -125,6 +159,42 @@ static int load_data(char **dst, off_t * size_dst, const char *file_name, const
     return result;
 }
 
+static int load_scenario(struct state * s, const char * file_name) {
+    struct scenario scenario;
+
+    if (scenario_read(&s->scenario, file_name) == -1) return -1;
+    // client overrides are checked whichever client they are for, so one parse checks them all.
+    if (scenario_parse(&scenario, s->scenario, 0) == -1) return -1;
+    s->wait_period_sec = (int) scenario_duration(&scenario) + SCENARIO_GRACE_SEC;
+    scenario_free(&scenario);
+
+    return 0;
+}
+
+static int load_search(struct state * s, const struct init_state_params * params) {
+    char *end;
+
+    if (search_slo_parse(&s->slo, params->slo) == -1) {
+        (void) fprintf(stderr, "Latency objective must be pPERCENTILE:TIME[:ERRORS%%], TIME with a unit of ns, us, ms"
+                               " or s, pass with -L\n");
+        return -1;
+    }
+    errno = 0;
+    s->rate = strtod(params->rate, &end);
+    if (end == params->rate || *end != '\0' || errno != 0 || !(s->rate >= 1) || s->rate > UINT32_MAX) {
+        (void) fprintf(stderr, "First rate of the search must be at least 1 request per second, pass with -R\n");
+        return -1;
+    }
+    if (s->wait_period_sec == 0) {
+        (void) fprintf(stderr, "Each step of the search needs a duration, pass with -t\n");
+        return -1;
+    }
+    s->warmup_sec = params->warmup_sec;
+    s->search = true;
+
+    return 0;
+}
+
 static int start_listen(struct state * s, struct dc_error * err, struct dc_env * env) {
     DC_TRACE(env);
     int option;
@@ -178,6 +248,7 @@ int destroy_state(struct state * s, struct dc_error * err, struct dc_env * env)
     if (s->data) {
         free(s->data);
     }
+    free(s->scenario);
 
     return error;
 }
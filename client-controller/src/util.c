@@ -24,6 +24,24 @@ int write_fully(int fd, void * data, size_t size) {
     return 0;
 }
 
+int read_fully(int fd, void * data, size_t size) {
+    ssize_t result;
+    ssize_t nread = 0;
+
+    while (nread < (ssize_t)size) {
+        result = read(fd, ((char*)data)+nread, size-nread);
+        if (result == 0) {
+            errno = ECONNRESET;
+        }
+        if (result <= 0) {
+            perror("reading fully");
+            return -1;
+        }
+        nread += result;
+    }
+    return 0;
+}
+
 int TCP_socket(int *dst) {
     int sock;
 
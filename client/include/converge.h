@@ -0,0 +1,83 @@
+#ifndef CLIENT_CONVERGE_H
+#define CLIENT_CONVERGE_H
+
+#include "../../core/include/search.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * converge
+ * <p>
+ * whether the results of a run have settled, by batch means. the measured intervals are gathered into batches of
+ * equal length, and the throughput and p99 latency of each batch are taken as samples of the run's; the run has
+ * converged once the 95% confidence interval of the mean of each is narrow enough, as a share of the mean. batches
+ * rather than single intervals, so that the samples are close to independent of each other.
+ * </p>
+ */
+struct converge {
+    double precision; // the widest half of a confidence interval, as a share of its mean.
+    uint16_t batch_sec; // measured intervals in a batch.
+    uint16_t intervals; // measured intervals of the batch being gathered.
+    struct search_result start; // the results of the run when the batch being gathered started.
+    double *throughput; // by batch, requests per second.
+    double *p99; // by batch, in nanoseconds.
+    size_t count; // batches gathered.
+    size_t size; // batches there is room for.
+};
+
+/**
+ * converge_init
+ * <p>
+ * start estimating the results of a run. the run must not have measured anything yet.
+ * </p>
+ * @param c the estimate.
+ * @param precision the widest half of a confidence interval, as a share of its mean, above 0.
+ * @param batch_sec measured intervals in a batch, at least 1.
+ */
+void converge_init(struct converge *c, double precision, uint16_t batch_sec);
+
+/**
+ * converge_add
+ * <p>
+ * take a measured interval into the estimate, closing a batch if it is the last of one.
+ * </p>
+ * @param c the estimate.
+ * @param run the results of the run so far, as log_result takes them.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int converge_add(struct converge *c, const struct search_result *run);
+
+/**
+ * converge_done
+ * <p>
+ * check whether the run has converged: it has gathered at least five batches, and both confidence intervals are
+ * within the precision.
+ * </p>
+ * @param c the estimate.
+ * @return whether the run has converged.
+ */
+bool converge_done(const struct converge *c);
+
+/**
+ * converge_print
+ * <p>
+ * print the throughput and p99 latency of the run with their confidence intervals, and whether they converged.
+ * </p>
+ * @param c the estimate.
+ * @param out the file to print to.
+ */
+void converge_print(const struct converge *c, FILE *out);
+
+/**
+ * converge_free
+ * <p>
+ * free the batches of an estimate.
+ * </p>
+ * @param c the estimate.
+ */
+void converge_free(struct converge *c);
+
+#endif //CLIENT_CONVERGE_H
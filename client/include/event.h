@@ -0,0 +1,21 @@
+#ifndef CLIENT_EVENT_H
+#define CLIENT_EVENT_H
+
+#include <handle.h>
+
+/**
+ * handle_events
+ * <p>
+ * the event engine: drive h_args->connections connections to the server from one thread. every connection is
+ * non-blocking and runs its own state machine, connecting, sending requests and reading acks as epoll reports it
+ * ready, so one thread keeps as many requests in flight as it has connections (times the pipeline depth, for
+ * protocol 2). connections stay open for the whole run, unless conn_messages is set, in which case a connection is
+ * replaced once it has carried that many requests. each request goes out in one sendmsg, as far as the socket takes
+ * it. with a think time, a slot whose request completed waits that long before it sends the next one, as a user
+ * would. echo mode and checksums work as in the blocking engine. returns only on failure; requires epoll.
+ * </p>
+ * @param h_args the handle arguments.
+ */
+void handle_events(struct handle_args *h_args);
+
+#endif //CLIENT_EVENT_H
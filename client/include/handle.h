@@ -1,13 +1,67 @@
 #ifndef CLIENT_HANDLE_H
 #define CLIENT_HANDLE_H
 
+#include "schedule.h"
+#include "sizes.h"
+#include "transmit.h"
+
 #include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * connection_pool
+ * <p>
+ * connections to the server opened before the load starts and reused for many messages each, so that requests do
+ * not pay for a handshake. a connection is replaced once it has carried its share of messages.
+ * </p>
+ */
+struct connection_pool {
+    int *fds;
+    uint16_t *messages; // messages sent on each connection since it was opened.
+    uint16_t size;
+};
+
+/**
+ * in_flight
+ * <p>
+ * a request that has been sent and not yet acked. a free slot is zeroed.
+ * </p>
+ */
+struct in_flight {
+    uint64_t request_id;
+    time_t start_time;
+    clock_t start_time_granular;
+    uint64_t start_ns;
+    uint64_t sent_ns; // when the last byte of the request was sent; 0 until then.
+    uint64_t acked_ns; // when the ack was read, if the request completes later, with its echo; 0 otherwise.
+    const struct size_class *payload; // the size of the payload sent, drawn when the request started.
+};
 
 struct handle_args {
     struct sockaddr_in server_addr;
-    char * data;
-    off_t data_size;
+    char * data; // the payload, shared by every thread; read only, and mapped from the data file in standalone mode.
+    off_t data_size; // the largest size class; every request sends a prefix of data.
+    int data_fd; // the data file, for sendfile; -1 in the other transmit modes.
+    enum transmit_mode transmit; // how the payload is sent.
     int thread_id;
+    uint16_t protocol_version;
+    uint16_t pipeline_depth;
+    bool send_writev;
+    bool tcp_nodelay;
+    bool tcp_quickack;
+    bool echo;
+    bool checksum;
+    const struct size_dist *sizes; // the distribution payload sizes are drawn from, shared by every thread.
+    uint64_t rng; // the random number generator this thread draws sizes and think times with.
+    uint64_t schedule_seed; // what the open loop schedule of this thread is seeded with.
+    struct connection_pool pool; // empty unless keep-alive is on; protocol 1 only.
+    uint16_t conn_messages; // messages per pooled or event engine connection before it is replaced; 0 for no limit.
+    uint16_t connections; // connections the event engine drives on this thread; 0 for the blocking engine.
+    double rate; // requests per second this thread sends on a schedule, open loop; 0 for closed loop.
+    bool poisson; // whether open loop requests arrive as a poisson process, rather than evenly spaced.
+    struct think think; // how long a closed loop slot of the event engine waits before its next request.
 };
 
 /**
@@ -23,4 +77,61 @@ struct handle_args {
  */
 void * handle(void *handle_args);
 
+/**
+ * open_pool
+ * <p>
+ * open the keep-alive connections of a thread, pool.size of them, and apply the TCP options. waits for the server to
+ * accept, like every connection the client makes. the time each connection took is logged as connection setup.
+ * </p>
+ * @param h_args the handle arguments of the thread, with pool.size set.
+ * @return 0 on success. -1 and set errno on failure, with nothing left open.
+ */
+int open_pool(struct handle_args *h_args);
+
+/**
+ * close_pool
+ * <p>
+ * close the keep-alive connections of a thread and free the pool. does nothing to an empty pool.
+ * </p>
+ * @param pool the pool.
+ */
+void close_pool(struct connection_pool *pool);
+
+/**
+ * start_request
+ * <p>
+ * draw the payload size of one request, encode its header, in the protocol version of the handle arguments, and
+ * record the request as in flight.
+ * </p>
+ * @param h_args the handle arguments.
+ * @param slot where to record the request.
+ * @param request_id the ID of the request; not sent with protocol 1.
+ * @param header_buf where to encode the header, at least PROTOCOL_MAX_HEADER_SIZE bytes.
+ * @return the size of the header.
+ */
+size_t start_request(struct handle_args *h_args, struct in_flight *slot, uint64_t request_id, uint8_t *header_buf);
+
+/**
+ * log_request
+ * <p>
+ * log a completed request.
+ * </p>
+ * @param h_args the handle arguments.
+ * @param slot the request.
+ * @param server_resp the length the server acked.
+ * @return 0 on success. -1 on failure.
+ */
+int log_request(const struct handle_args *h_args, const struct in_flight *slot, uint64_t server_resp);
+
+/**
+ * set_tcp_options
+ * <p>
+ * apply the TCP options of the handle arguments to a new connection, and prepare it for the transmit mode.
+ * </p>
+ * @param server_sock the connection to the server.
+ * @param h_args the handle arguments.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int set_tcp_options(int server_sock, const struct handle_args *h_args);
+
 #endif //CLIENT_HANDLE_H
@@ -0,0 +1,59 @@
+#ifndef CLIENT_HDR_LOG_H
+#define CLIENT_HDR_LOG_H
+
+#include "../../core/include/histogram.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * hdr_log
+ * <p>
+ * an interval log in the HdrHistogram log format, version 1.3: one line per histogram per interval, tagged with what
+ * it measured, holding the histogram in the compressed V2 encoding. HdrHistogram's HistogramLogReader and the tools
+ * built on it, such as HistogramLogAnalyzer, read it. values are nanoseconds; maxima are written in milliseconds.
+ * </p>
+ */
+struct hdr_log {
+    FILE *file;
+    uint64_t start_ns; // the monotonic time of the log's start time; interval times are relative to it.
+};
+
+/**
+ * hdr_log_open
+ * <p>
+ * create an interval log, truncating any file of the same name, and write its header. the log starts now.
+ * </p>
+ * @param log the log.
+ * @param file_name the name of the file.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int hdr_log_open(struct hdr_log *log, const char *file_name);
+
+/**
+ * hdr_log_write
+ * <p>
+ * write the histogram of one interval. each bucket is written at its upper bound, in a histogram with finer buckets
+ * than the client's, so nothing is lost; values above an hour, the most the log's histograms hold, count as an hour.
+ * </p>
+ * @param log the log.
+ * @param tag what the histogram measured; letters only.
+ * @param h the histogram of the interval.
+ * @param start_ns when the interval started, from now_ns.
+ * @param end_ns when the interval ended, from now_ns.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int hdr_log_write(struct hdr_log *log, const char *tag, const struct histogram *h, uint64_t start_ns,
+                  uint64_t end_ns);
+
+/**
+ * hdr_log_close
+ * <p>
+ * close an interval log. does nothing to a log that is not open.
+ * </p>
+ * @param log the log.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int hdr_log_close(struct hdr_log *log);
+
+#endif //CLIENT_HDR_LOG_H
@@ -2,6 +2,10 @@
 #define CLIENT_LOG_H
 
 #include <state.h>
+#include "../../core/include/search.h"
+
+#include <stdbool.h>
+#include <stdint.h>
 
 /**
  * logger
@@ -13,6 +17,8 @@ struct logger {
     time_t start_time;
     time_t end_time;
     double elapsed_time_granular;
+    uint64_t latency_ns; // wall clock time from sending the request to reading its ack.
+    uint64_t ack_ns; // wall clock time from the last byte of the request being sent to reading its ack; 0 if unknown.
     uint32_t server_resp;
     uint32_t data_size;
     int thread_id;
@@ -21,29 +27,115 @@ struct logger {
 /**
  * init_logger
  * <p>
- * opens the logging file and initializes the logging mutex.
+ * opens the logging file and the interval log and initializes the logging mutex. the send path and TCP options in
+ * the state label the latency summary, so that runs in different modes can be compared.
  * </p>
+ * @param s pointer to the state object.
  * @return 0 on success. -1 and set errno on failure.
  */
-int init_logger(void);
+int init_logger(const struct state * s);
 
 /**
  * destroy_logger
  * <p>
- * destroys the logger mutex and closes the log file.
+ * destroys the logger mutex and closes the log files. prints the latency summary and percentiles of the measured
+ * intervals to stdout and appends the summary to the latency file, one row per run. if no interval was taken, as in
+ * controller mode, the whole run is taken as one first. the client threads must have stopped.
  * </p>
  * @return 0 on success. -1 and set errno on failure.
  */
 int destroy_logger(void);
 
+/**
+ * log_phase
+ * <p>
+ * start the results of a scenario phase: report the phase before, as destroy_logger reports a run, and label what
+ * follows with the phase and the settings it runs with. the client threads must have stopped.
+ * </p>
+ * @param s pointer to the state object, with the phase applied.
+ * @param name the name of the phase, or NULL to label what follows as the run.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int log_phase(const struct state * s, const char * name);
+
+/**
+ * log_result
+ * <p>
+ * take what the run, or the phase, has measured so far, as a step of a saturation search is judged by, and as early
+ * stopping follows the run. called by the main thread only.
+ * </p>
+ * @param dst where to store the result.
+ */
+void log_result(struct search_result * dst);
+
+/**
+ * open_thread_logs
+ * <p>
+ * give each of n client threads its own histograms, counters and CSV buffer, so that threads never wait on each
+ * other to log, and start the first interval.
+ * </p>
+ * @param n number of client threads; their thread IDs run from 0 to n - 1.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int open_thread_logs(int n);
+
+/**
+ * log_interval
+ * <p>
+ * end the interval being recorded and start the next: take what every thread has recorded since the last interval
+ * and, if the interval is measured, add it to the run and write its histograms to the interval log. intervals not
+ * measured, such as the warm-up, are dropped. called by the main thread only.
+ * </p>
+ * @param measured whether the interval counts towards the run.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int log_interval(bool measured);
+
 /**
  * do_log
  * <>
- * log information about the server connection.
+ * log information about the server connection, to the logging thread's own log.
  * </p>
  * @param l pointer to the state object.
  * @return 0 on success. -1 and set errno on failure.
  */
 int do_log(struct logger * l);
 
+/**
+ * log_connect
+ * <p>
+ * record how long opening a connection to the server took, apart from the latency of requests, so that the
+ * cost of connection setup can be told from the time the server takes to serve a request.
+ * </p>
+ * @param thread_id the ID of the client thread which opened the connection.
+ * @param connect_ns wall clock time from creating the socket to the connection being established.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int log_connect(int thread_id, uint64_t connect_ns);
+
+/**
+ * log_zerocopy
+ * <p>
+ * record zerocopy sends the kernel has reported complete, and how many of them it copied after all, so that a run
+ * can tell whether its payloads really went out without a copy.
+ * </p>
+ * @param thread_id the ID of the client thread which sent them.
+ * @param completed the sends completed.
+ * @param copied the sends among them the kernel copied.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int log_zerocopy(int thread_id, uint64_t completed, uint64_t copied);
+
+/**
+ * log_errors
+ * <p>
+ * record requests lost when the server dropped the connection they were in flight on, which count against the
+ * error rate of a saturation search.
+ * </p>
+ * @param thread_id the ID of the client thread which lost them.
+ * @param lost the requests lost.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int log_errors(int thread_id, uint64_t lost);
+
 #endif //CLIENT_LOG_H
@@ -0,0 +1,117 @@
+#ifndef CLIENT_SCHEDULE_H
+#define CLIENT_SCHEDULE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * schedule
+ * <p>
+ * when the requests of an open loop thread are due. requests arrive at a fixed rate, evenly spaced or as a poisson
+ * process, whether or not the server has kept up with the ones before them. the schedule holds the time the oldest
+ * request not yet sent was due; a request sent late keeps that time as its start, so the wait for a free connection
+ * counts as latency rather than hiding it.
+ * </p>
+ */
+struct schedule {
+    uint64_t start_ns; // when the first request was due; 0 until the schedule starts.
+    double elapsed_ns; // from start_ns to when the next request is due, kept apart so fractions add up.
+    uint64_t next_ns; // when the next request is due; 0 until the schedule starts.
+    double interval_ns; // mean time between requests.
+    bool poisson; // whether the time between requests is exponential, rather than fixed.
+    uint64_t rng; // xorshift state.
+};
+
+/**
+ * think_kind
+ * <p>
+ * how think times are drawn.
+ * </p>
+ */
+enum think_kind {
+    THINK_NONE, // requests are sent as soon as a slot frees.
+    THINK_FIXED,
+    THINK_UNIFORM,
+    THINK_EXP, // exponential, as the gaps between the requests of a poisson process.
+};
+
+/**
+ * think
+ * <p>
+ * how long a closed loop slot waits, once its request completes, before it sends the next one, as a user reading a
+ * reply would. a think time is drawn afresh for every request.
+ * </p>
+ */
+struct think {
+    enum think_kind kind;
+    double min_ns; // the fixed time, the least uniform time or the mean exponential time.
+    double max_ns; // the most uniform time.
+};
+
+/**
+ * schedule_init
+ * <p>
+ * set up a schedule, not yet started.
+ * </p>
+ * @param sched the schedule.
+ * @param rate requests per second, more than 0.
+ * @param poisson whether requests arrive as a poisson process, rather than evenly spaced.
+ * @param seed seeds the random times; threads with different seeds are not in step.
+ */
+void schedule_init(struct schedule *sched, double rate, bool poisson, uint64_t seed);
+
+/**
+ * schedule_start
+ * <p>
+ * start a schedule. the first request is due within one interval, at a random point so that threads started together
+ * do not send together.
+ * </p>
+ * @param sched the schedule.
+ * @param now the time, from now_ns.
+ */
+void schedule_start(struct schedule *sched, uint64_t now);
+
+/**
+ * schedule_due
+ * <p>
+ * check whether a request is due.
+ * </p>
+ * @param sched the schedule.
+ * @param now the time, from now_ns.
+ * @return whether the schedule has started and the next request is due by now.
+ */
+bool schedule_due(const struct schedule *sched, uint64_t now);
+
+/**
+ * schedule_take
+ * <p>
+ * take the request that is due next, moving the schedule on to the one after it.
+ * </p>
+ * @param sched the schedule, started.
+ * @return when the request taken was due, to use as its start.
+ */
+uint64_t schedule_take(struct schedule *sched);
+
+/**
+ * think_parse
+ * <p>
+ * parse think times: none, fixed:TIME, uniform:MIN:MAX or exp:MEAN, each time a number with a unit of ns, us, ms or s.
+ * </p>
+ * @param dst where to store the think times.
+ * @param spec the string to parse.
+ * @return 0 on success. -1 if the string is not such a spec.
+ */
+int think_parse(struct think *dst, const char *spec);
+
+/**
+ * think_draw
+ * <p>
+ * draw one think time.
+ * </p>
+ * @param think the think times, not none.
+ * @param rng the generator to draw with.
+ * @return the time in nanoseconds.
+ */
+uint64_t think_draw(const struct think *think, uint64_t *rng);
+
+#endif //CLIENT_SCHEDULE_H
@@ -0,0 +1,109 @@
+#ifndef CLIENT_SIZES_H
+#define CLIENT_SIZES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * size_class
+ * <p>
+ * one payload size requests are sent with. every class is a prefix of the one payload, so sending a request of a
+ * class is as cheap as sending the whole payload; its checksum is computed before the run.
+ * </p>
+ */
+struct size_class {
+    uint64_t size; // bytes of the payload sent.
+    uint32_t crc; // CRC32C of those bytes; only set with checksums on.
+};
+
+/**
+ * size_dist
+ * <p>
+ * the distribution payload sizes are drawn from, cut into size classes, with an alias table so that drawing a class
+ * takes one random number and one comparison however many classes there are. built before the run and read only
+ * during it; each thread draws with its own random number generator.
+ * </p>
+ */
+struct size_dist {
+    struct size_class *classes; // ascending by size.
+    double *keep; // by class: the chance of keeping the class drawn, rather than taking its alias.
+    uint32_t *alias; // by class: the class taken when the class drawn is not kept.
+    uint32_t count;
+    bool whole; // whether every request carries the whole payload, the one class sized when prepared.
+    char *payload; // the payload, extended to the largest class, when the data is shorter; NULL otherwise.
+};
+
+/**
+ * size_dist_parse
+ * <p>
+ * parse a size distribution, as passed with -D. sizes are bytes, optionally suffixed with K, M or G for powers of
+ * 1024. the distributions are:
+ * </p>
+ * <p>
+ * fixed: the whole payload, as without -D. fixed:SIZE: every request SIZE bytes.
+ * uniform:MIN:MAX: sizes from MIN to MAX, each as likely.
+ * lognormal:MEDIAN:SIGMA: sizes whose logarithm is normal around the logarithm of MEDIAN with standard deviation
+ * SIGMA, covering four standard deviations either side.
+ * zipf:MIN:MAX:S: sizes from MIN to MAX, a size k as likely as 1 / k^S, so that small sizes dominate.
+ * file:PATH: an empirical histogram, one "SIZE WEIGHT" line per size, blank lines and lines starting with # ignored.
+ * </p>
+ * <p>
+ * continuous distributions are cut into up to 128 classes, spaced evenly for uniform and geometrically otherwise;
+ * each class sends its middle size and carries the weight of every size it covers.
+ * </p>
+ * @param dist where to store the distribution.
+ * @param spec the distribution.
+ * @return 0 on success. -1 if the distribution is not one of these, with nothing left allocated; what is wrong with
+ * a histogram file is described on stderr.
+ */
+int size_dist_parse(struct size_dist *dist, const char *spec);
+
+/**
+ * size_dist_prepare
+ * <p>
+ * make a distribution ready to draw from, once the payload is known: a fixed distribution of the whole payload gets
+ * its one class, a payload shorter than the largest class is extended by repeating it, and with checksums on the
+ * CRC32C of every class is computed, in one pass over the largest. a distribution may be prepared again for a new
+ * payload, as controller mode sends one with every start.
+ * </p>
+ * @param dist the distribution, parsed.
+ * @param data the payload.
+ * @param data_size the size of the payload.
+ * @param checksum whether to compute the checksums of the classes.
+ * @return 0 on success. -1 and set errno on failure, to EFBIG if the payload of a fixed distribution is larger
+ * than a server takes.
+ */
+int size_dist_prepare(struct size_dist *dist, const char *data, off_t data_size, bool checksum);
+
+/**
+ * size_dist_draw
+ * <p>
+ * draw the size class of a request.
+ * </p>
+ * @param dist the distribution, prepared.
+ * @param rng the thread's random number generator, from seed_random.
+ * @return the class.
+ */
+const struct size_class *size_dist_draw(const struct size_dist *dist, uint64_t *rng);
+
+/**
+ * size_dist_max
+ * <p>
+ * get the largest size of a distribution.
+ * </p>
+ * @param dist the distribution, prepared.
+ * @return the largest size.
+ */
+uint64_t size_dist_max(const struct size_dist *dist);
+
+/**
+ * size_dist_free
+ * <p>
+ * free a distribution. does nothing to one already freed, or zeroed.
+ * </p>
+ * @param dist the distribution.
+ */
+void size_dist_free(struct size_dist *dist);
+
+#endif //CLIENT_SIZES_H
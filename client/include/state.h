@@ -1,6 +1,12 @@
 #ifndef SCALABLE_CLIENT_STATE_H
 #define SCALABLE_CLIENT_STATE_H
 
+#include "../../core/include/scenario.h"
+#include "../../core/include/search.h"
+#include "schedule.h"
+#include "sizes.h"
+#include "transmit.h"
+
 #include <dc_env/env.h>
 #include <dc_error/error.h>
 #include <netinet/in.h>
@@ -13,6 +19,27 @@ struct init_state_params {
     const char *controller_port;
     const char *data_file_name;
     uint16_t wait_period_sec;
+    uint16_t warmup_sec;
+    uint16_t protocol_version;
+    uint16_t pipeline_depth;
+    bool send_writev;
+    bool tcp_nodelay;
+    bool tcp_quickack;
+    bool echo;
+    bool checksum;
+    uint16_t pool_size;
+    uint16_t conn_messages;
+    uint16_t thread_count;
+    uint16_t connections;
+    const char *rate;
+    const char *arrival;
+    const char *transmit;
+    const char *sizes;
+    const char *think;
+    const char *scenario_file_name;
+    const char *slo;
+    const char *precision;
+    uint16_t max_duration_sec;
 };
 
 /**
@@ -28,10 +55,38 @@ struct state {
     int controller_fd;
     in_port_t server_port;
     char* server_ip;
-    char *data;
+    char *data; // The payload; a read-only mapping of the data file in standalone mode, shared by every thread.
     off_t data_size;
+    bool data_mapped; // Whether data is mapped, to be unmapped rather than freed.
+    int data_fd; // The data file, kept open for sendfile; -1 in the other transmit modes.
     uint16_t wait_period_sec;
+    uint16_t warmup_sec; // Seconds of load before the measured duration, left out of the results; standalone only.
+    double precision; // Run past the duration until the results are known to this share; 0 to stop at the duration.
+    uint16_t max_duration_sec; // The longest a run measures for, converged or not; with precision only.
     bool standalone;
+    uint16_t protocol_version; // Wire protocol version, 1 or 2. See protocol.h.
+    uint16_t pipeline_depth; // Requests in flight per connection; v2 only.
+    bool send_writev; // Send each header and payload with one writev instead of two writes.
+    bool tcp_nodelay; // Disable Nagle's algorithm on server connections.
+    bool tcp_quickack; // Keep server connections in quick ACK mode.
+    bool echo; // Have the server send each payload back, and verify it; v2 only.
+    bool checksum; // Follow each payload with its CRC32C for the server to verify; v2 only.
+    uint16_t pool_size; // Keep-alive connections per thread, opened before the load starts; 0 for one per message.
+    uint16_t conn_messages; // Messages per keep-alive or event engine connection before it is replaced; 0 for no limit.
+    uint16_t thread_count; // Client threads; 0 for one per processor.
+    uint16_t connections; // Connections per thread, driven by the event engine; 0 for the blocking engine.
+    double rate; // Requests per second across all threads, sent on a schedule; 0 for closed loop.
+    bool poisson; // Open loop requests arrive as a poisson process, rather than evenly spaced.
+    enum transmit_mode transmit; // How the payload is sent: copied, with sendfile, or with MSG_ZEROCOPY.
+    struct size_dist sizes; // The distribution payload sizes are drawn from; each request sends a prefix of data.
+    const char *sizes_spec; // The distribution as passed with -D, for the run label.
+    struct think think; // How long a closed loop slot waits before its next request; event engine only.
+    const char *think_spec; // The think times as passed with -I, for the run label.
+    struct init_state_params params; // The options, which every phase of a scenario starts from.
+    struct scenario scenario; // The phases to run, one after another; empty to run the options for the duration.
+    bool search; // Search for the highest rate that holds to slo, a step of the duration at a time; standalone only.
+    struct search_slo slo; // The latency objective of the search, passed with -L.
+    uint64_t seed; // What the random number generators of the threads are seeded from, different for every client.
 };
 
 /**
@@ -47,6 +102,31 @@ struct state {
  */
 int init_state(struct init_state_params * params, struct state * s, struct dc_error * err, struct dc_env * env);
 
+/**
+ * init_scenario
+ * <p>
+ * parse a scenario for this client and check that every phase of it can run, so that a mistake in a late phase does
+ * not end the run after the early ones.
+ * </p>
+ * @param s pointer to the state object.
+ * @param text the scenario, as scenario_parse takes it.
+ * @param client the index of this client among the controller's; 0 in standalone mode.
+ * @return 0 on success. -1 on failure, described on stderr.
+ */
+int init_scenario(struct state * s, const char * text, uint16_t client);
+
+/**
+ * apply_phase
+ * <p>
+ * take the load settings of a scenario phase: the options, with what the phase sets in their place. the threads must
+ * have stopped, and start again with the new settings.
+ * </p>
+ * @param s pointer to the state object.
+ * @param phase the phase.
+ * @return 0 on success. -1 on failure, described on stderr.
+ */
+int apply_phase(struct state * s, const struct scenario_phase * phase);
+
 /**
  * destroy_state.
  * <p>
@@ -6,7 +6,8 @@
 /**
  * start_threads
  * <p>
- * starts a group of threads that run a handle function.
+ * starts a group of threads that run a handle function, s->thread_count of them or one per processor. raises the
+ * file descriptor limit to fit the connections of the event engine.
  * </p>
  * @param s pointer to the state object.
  * @param err pointer to the dc_error struct.
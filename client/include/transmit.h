@@ -0,0 +1,125 @@
+#ifndef CLIENT_TRANSMIT_H
+#define CLIENT_TRANSMIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+struct handle_args;
+
+/**
+ * transmit_mode
+ * <p>
+ * how the payload of a request gets to the socket. copy writes it from the mapped payload, as every send path does by
+ * default; the kernel copies it into the socket buffer. sendfile has the kernel send it from the pages of the data
+ * file. zerocopy sends it from the mapped payload with MSG_ZEROCOPY, pinning the pages until the kernel reports the
+ * send complete on the socket's error queue. the header and trailer are always copied; they are too small to gain
+ * from the other modes, and the header changes from request to request. sendfile and zerocopy are linux only.
+ * </p>
+ */
+enum transmit_mode {
+    TRANSMIT_COPY,
+    TRANSMIT_SENDFILE,
+    TRANSMIT_ZEROCOPY,
+};
+
+/**
+ * transmit_name
+ * <p>
+ * get the name of a transmit mode, as passed with -x.
+ * </p>
+ * @param mode the mode.
+ * @return the name.
+ */
+const char *transmit_name(enum transmit_mode mode);
+
+/**
+ * transmit_parse
+ * <p>
+ * parse the name of a transmit mode.
+ * </p>
+ * @param dst where to store the mode.
+ * @param name the name: copy, sendfile or zerocopy.
+ * @return 0 on success. -1 if the name is not a mode.
+ */
+int transmit_parse(enum transmit_mode *dst, const char *name);
+
+/**
+ * transmit_open
+ * <p>
+ * prepare a new connection for the transmit mode of the handle arguments: zerocopy enables SO_ZEROCOPY on it. does
+ * nothing in the other modes.
+ * </p>
+ * @param sock the connection to the server.
+ * @param h_args the handle arguments.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int transmit_open(int sock, const struct handle_args *h_args);
+
+/**
+ * transmit_piece
+ * <p>
+ * send the next piece of a request that is going out, in the transmit mode of the handle arguments: the rest of the
+ * header, of the payload, or of the trailer, whichever the request has got to. the header, and the payload when a
+ * trailer follows it, are sent with MSG_MORE, so that the pieces leave in full segments. sendfile cannot pass
+ * MSG_MORE, so a request with a trailer is corked instead; see transmit_cork.
+ * </p>
+ * @param sock the connection to the server.
+ * @param h_args the handle arguments, in sendfile or zerocopy mode.
+ * @param header the encoded header.
+ * @param header_size the size of the header.
+ * @param payload_size the size of the payload, a prefix of the payload of the handle arguments.
+ * @param trailer the checksum trailer, PROTOCOL_CHECKSUM_SIZE bytes; NULL for none.
+ * @param sent bytes of the request sent so far.
+ * @param flags MSG_DONTWAIT for a socket that must not block; 0 otherwise.
+ * @return the number of bytes sent. -1 and set errno on failure.
+ */
+ssize_t transmit_piece(int sock, const struct handle_args *h_args, const uint8_t *header, size_t header_size,
+                       uint64_t payload_size, const uint8_t *trailer, uint64_t sent, int flags);
+
+/**
+ * transmit_framed
+ * <p>
+ * send a whole request with transmit_piece on a blocking socket, corked as transmit_cork says, then reap the zerocopy
+ * completions waiting on the socket.
+ * </p>
+ * @param sock the connection to the server.
+ * @param h_args the handle arguments, in sendfile or zerocopy mode.
+ * @param header the encoded header.
+ * @param header_size the size of the header.
+ * @param payload_size the size of the payload, a prefix of the payload of the handle arguments.
+ * @param trailer the checksum trailer, PROTOCOL_CHECKSUM_SIZE bytes; NULL for none.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int transmit_framed(int sock, const struct handle_args *h_args, const uint8_t *header, size_t header_size,
+                    uint64_t payload_size, const uint8_t *trailer);
+
+/**
+ * transmit_cork
+ * <p>
+ * cork or uncork a connection around a request in sendfile mode with checksums on. the trailer would otherwise go
+ * out as a segment of its own, which Nagle's algorithm holds back until the payload is ACKed. does nothing otherwise.
+ * </p>
+ * @param sock the connection to the server.
+ * @param h_args the handle arguments.
+ * @param on whether to cork, before the request, or uncork, after it.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int transmit_cork(int sock, const struct handle_args *h_args, bool on);
+
+/**
+ * transmit_reap
+ * <p>
+ * read the zerocopy completions waiting on a connection's error queue, without blocking, and log how many sends
+ * completed and how many of those the kernel copied after all, as it does over loopback. the error queue must be
+ * read, or the completions use up the socket's option memory and further zerocopy sends fail with ENOBUFS. does
+ * nothing outside zerocopy mode.
+ * </p>
+ * @param sock the connection to the server.
+ * @param h_args the handle arguments.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+int transmit_reap(int sock, const struct handle_args *h_args);
+
+#endif //CLIENT_TRANSMIT_H
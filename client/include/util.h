@@ -3,7 +3,10 @@
 
 #include <netinet/in.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
 
 /**
  * write_fully
@@ -17,6 +20,19 @@
  */
 int write_fully(int fd, void * data, size_t size);
 
+/**
+ * writev_fully
+ * <p>
+ * writes a vector of buffers fully to a file descriptor, in as few writev calls as the kernel allows.
+ * on a partial write the vector is advanced past what was written, so its contents are changed.
+ * </p>
+ * @param fd file descriptor to write to.
+ * @param iov the buffers to write.
+ * @param iovcnt number of buffers.
+ * @return 0 on success. On failure -1 and set errno.
+ */
+int writev_fully(int fd, struct iovec * iov, int iovcnt);
+
 /**
  * read_fully
  * <p>
@@ -72,6 +88,38 @@ int open_file(FILE **dst, const char * file_name, const char * mode);
  */
 int TCP_socket(int *dst);
 
+/**
+ * set_nodelay
+ * <p>
+ * disable Nagle's algorithm on a TCP socket, so small writes are sent without waiting for outstanding ACKs.
+ * </p>
+ * @param sock the socket.
+ * @return 0 on success. On failure, -1 and set errno.
+ */
+int set_nodelay(int sock);
+
+/**
+ * set_quickack
+ * <p>
+ * make a TCP socket ACK received data immediately instead of delaying the ACK. linux leaves quick ACK mode on its
+ * own, so this must be repeated after every read. fails with ENOPROTOOPT where TCP_QUICKACK is not supported.
+ * </p>
+ * @param sock the socket.
+ * @return 0 on success. On failure, -1 and set errno.
+ */
+int set_quickack(int sock);
+
+/**
+ * raise_fd_limit
+ * <p>
+ * raise the soft limit on open file descriptors to needed, as far as the hard limit allows.
+ * </p>
+ * @param needed the number of file descriptors needed.
+ * @param limit where to store the limit afterwards, which is below needed if the hard limit is.
+ * @return 0 on success. On failure, -1 and set errno.
+ */
+int raise_fd_limit(rlim_t needed, rlim_t *limit);
+
 /**
  * init_addr
  * <p>
@@ -96,4 +144,36 @@ int init_addr(struct sockaddr_in *dst, const char *ip, in_port_t port);
  */
 int parse_port(in_port_t *dst, const char *buff, int radix);
 
+/**
+ * parse_rate
+ * <p>
+ * parse a rate, a decimal number of at least 0, from a string.
+ * </p>
+ * @param dst where to assign the parsed rate.
+ * @param buff the string to parse.
+ * @return 0 on success. On failure, -1 and set errno.
+ */
+int parse_rate(double *dst, const char *buff);
+
+/**
+ * seed_random
+ * <p>
+ * turn a seed into the state of a random number generator with splitmix64, which spreads nearby seeds apart, so that
+ * generators seeded with thread IDs are not in step.
+ * </p>
+ * @param seed the seed.
+ * @return the state, never 0.
+ */
+uint64_t seed_random(uint64_t seed);
+
+/**
+ * next_random
+ * <p>
+ * draw the next number from a xorshift64* generator. fast and good enough to spread load, not for anything secret.
+ * </p>
+ * @param state the state, from seed_random; moved on.
+ * @return the number, uniform over 64 bits.
+ */
+uint64_t next_random(uint64_t *state);
+
 #endif //CLIENT_UTIL_H
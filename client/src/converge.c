@@ -0,0 +1,157 @@
+#include "converge.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONVERGE_MIN_BATCHES 5 // fewer, and the spread of the batches says little.
+#define CONVERGE_PERCENTILE 99
+#define NS_PER_US ((double) 1000)
+#define NS_PER_SEC ((double) 1000000000)
+
+/**
+ * t_value
+ * <p>
+ * the two-sided 95% critical value of student's t distribution: a table up to 30 degrees of freedom, and the
+ * cornish-fisher expansion about the normal's 1.96 beyond, which is within 0.01 of it there.
+ * </p>
+ * @param df degrees of freedom, at least 1.
+ * @return the critical value.
+ */
+static double t_value(size_t df);
+
+/**
+ * interval
+ * <p>
+ * estimate the mean of samples with the half width of its 95% confidence interval.
+ * </p>
+ * @param samples the samples.
+ * @param count the number of samples, at least 2.
+ * @param mean where to store the mean.
+ * @return the half width of the confidence interval.
+ */
+static double interval(const double *samples, size_t count, double *mean);
+
+void converge_init(struct converge *c, double precision, uint16_t batch_sec) {
+    memset(c, 0, sizeof(struct converge));
+    c->precision = precision;
+    c->batch_sec = batch_sec;
+}
+
+int converge_add(struct converge *c, const struct search_result *run) {
+    struct histogram batch;
+    double *throughput;
+    double *p99;
+    uint64_t measured_ns;
+    size_t size;
+
+    if (++c->intervals < c->batch_sec) {
+        return 0;
+    }
+    c->intervals = 0;
+
+    if (c->count == c->size) {
+        size = (c->size == 0) ? 64 : c->size * 2;
+        throughput = realloc(c->throughput, size * sizeof(double));
+        if (throughput != NULL) {
+            c->throughput = throughput;
+        }
+        p99 = realloc(c->p99, size * sizeof(double));
+        if (p99 != NULL) {
+            c->p99 = p99;
+        }
+        if (throughput == NULL || p99 == NULL) {
+            return -1; // the batch is lost; the ones before are kept.
+        }
+        c->size = size;
+    }
+
+    // the run's results only grow, so those of the batch are what they have grown by since it started.
+    memset(&batch, 0, sizeof(struct histogram));
+    for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        batch.buckets[i] = run->latency.buckets[i] - c->start.latency.buckets[i];
+    }
+    batch.count = run->latency.count - c->start.latency.count;
+    batch.max = run->latency.max;
+    measured_ns = run->measured_ns - c->start.measured_ns;
+    c->throughput[c->count] = (measured_ns > 0)
+                              ? (double) (run->requests - c->start.requests) * NS_PER_SEC / (double) measured_ns : 0;
+    c->p99[c->count] = (double) histogram_percentile(&batch, CONVERGE_PERCENTILE);
+    c->count++;
+    c->start = *run;
+
+    return 0;
+}
+
+bool converge_done(const struct converge *c) {
+    double throughput;
+    double p99;
+
+    if (c->count < CONVERGE_MIN_BATCHES) {
+        return false;
+    }
+
+    return interval(c->throughput, c->count, &throughput) <= c->precision * throughput && throughput > 0
+           && interval(c->p99, c->count, &p99) <= c->precision * p99 && p99 > 0;
+}
+
+void converge_print(const struct converge *c, FILE *out) {
+    double throughput;
+    double throughput_half;
+    double p99;
+    double p99_half;
+
+    if (c->count < 2) {
+        (void) fprintf(out, "Converged to within %g%%: no, too few batches of %u seconds to tell\n",
+                       c->precision * 100, c->batch_sec);
+        return;
+    }
+
+    throughput_half = interval(c->throughput, c->count, &throughput);
+    p99_half = interval(c->p99, c->count, &p99);
+    (void) fprintf(out, "Converged to within %g%%: %s, after %zu batches of %u seconds, at 95%% confidence\n",
+                   c->precision * 100, (converge_done(c)) ? "yes" : "no", c->count, c->batch_sec);
+    (void) fprintf(out, "    throughput %.1f +/- %.1f requests/s (%.1f%%), p99 %.1f +/- %.1fus (%.1f%%)\n", throughput,
+                   throughput_half, (throughput > 0) ? throughput_half * 100 / throughput : 0, p99 / NS_PER_US,
+                   p99_half / NS_PER_US, (p99 > 0) ? p99_half * 100 / p99 : 0);
+}
+
+void converge_free(struct converge *c) {
+    free(c->throughput);
+    free(c->p99);
+    c->throughput = NULL;
+    c->p99 = NULL;
+    c->count = 0;
+    c->size = 0;
+}
+
+static double t_value(size_t df) {
+    static const uint16_t table[] = {12706, 4303, 3182, 2776, 2571, 2447, 2365, 2306, 2262, 2228,
+                                     2201, 2179, 2160, 2145, 2131, 2120, 2110, 2101, 2093, 2086,
+                                     2080, 2074, 2069, 2064, 2060, 2056, 2052, 2048, 2045, 2042}; // thousandths.
+    const double z = (double) 196 / 100;
+
+    if (df <= sizeof(table) / sizeof(table[0])) {
+        return (double) table[df - 1] / 1000;
+    }
+
+    return z + (z * z * z + z) / (4 * (double) df);
+}
+
+static double interval(const double *samples, size_t count, double *mean) {
+    double sum;
+    double squares;
+
+    sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    *mean = sum / (double) count;
+
+    squares = 0;
+    for (size_t i = 0; i < count; i++) {
+        squares += (samples[i] - *mean) * (samples[i] - *mean);
+    }
+
+    return t_value(count - 1) * sqrt(squares / (double) (count - 1)) / sqrt((double) count);
+}
@@ -0,0 +1,1031 @@
+#include "event.h"
+#include "../../core/include/histogram.h"
+#include "../../protocol.h"
+
+#include <log.h>
+#include <schedule.h>
+#include <transmit.h>
+#include <util.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#define EVENT_BATCH 256 // most ready connections taken from epoll at once.
+#define EVENT_RECV_SIZE (64 * 1024) // most bytes read from a connection at once.
+#define EVENT_RETRY_NS 1000000000ULL // wait after a refused connection before trying again, as connect_server does.
+#define EVENT_RETRY_POLL_MS 100 // how often to look for connections due to be tried again.
+#define NS_PER_SEC 1000000000ULL // for the times of the timer.
+
+/**
+ * event_conn_state
+ * <p>
+ * where a connection of the event engine is in its life.
+ * </p>
+ */
+enum event_conn_state {
+    EVENT_CONN_RETRYING, // refused; waiting to try again.
+    EVENT_CONN_CONNECTING, // waiting for the server to accept.
+    EVENT_CONN_OPEN, // sending requests and reading acks.
+};
+
+/**
+ * event_conn
+ * <p>
+ * one connection of the event engine. requests go out one after another, and their acks, each followed by the echoed
+ * payload in echo mode, come back one after another; both directions move as far as the socket allows.
+ * </p>
+ */
+struct event_conn {
+    int fd; // -1 while retrying.
+    enum event_conn_state state;
+    uint64_t state_ns; // when connecting started, or when to try again.
+    uint32_t events; // the events registered with epoll.
+    struct in_flight *in_flight; // depth slots.
+    uint16_t outstanding; // requests started and not yet completed.
+    uint16_t started; // requests started since the connection was opened.
+    uint8_t header_buf[PROTOCOL_MAX_HEADER_SIZE]; // header of the request going out.
+    uint64_t header_size;
+    uint8_t trailer[PROTOCOL_CHECKSUM_SIZE]; // checksum trailer of the request going out.
+    uint64_t request_size; // header, payload and trailer of the request going out.
+    uint64_t sent; // bytes of the request going out sent.
+    bool sending; // whether a request is going out.
+    uint8_t ack_buf[PROTOCOL_MAX_HEADER_SIZE];
+    size_t ack_read; // bytes of the ack coming in read.
+    struct protocol_header ack;
+    struct in_flight *acked; // the request the ack coming in is for, once it is read.
+    struct in_flight *out; // the request going out.
+    uint64_t echo_read; // bytes of the echoed payload read.
+    bool idle; // whether the connection is on the idle stack.
+};
+
+/**
+ * event_wake
+ * <p>
+ * a slot of a closed loop connection thinking: its request has completed, and it sends the next one when due.
+ * </p>
+ */
+struct event_wake {
+    uint64_t due_ns;
+    struct event_conn *conn;
+};
+
+/**
+ * event_engine
+ * <p>
+ * the connections of one thread of the event engine and what they share.
+ * </p>
+ */
+struct event_engine {
+    struct handle_args *h_args;
+    struct event_conn *conns;
+    struct in_flight *slots; // the in flight slots of every connection, depth each.
+    struct epoll_event *ready; // EVENT_BATCH entries.
+    char *recv_buf; // where every connection reads into, in turn.
+    int epoll_fd;
+    uint16_t depth; // requests in flight per connection.
+    size_t ack_size;
+    uint16_t retrying; // connections waiting to try again.
+    uint64_t next_id;
+    bool open_loop; // whether requests are sent on a schedule, rather than as soon as a slot frees.
+    struct schedule schedule; // open loop only.
+    int timer_fd; // wakes the thread when the next request is due; open loop or think time only, -1 otherwise.
+    uint64_t armed_ns; // when the timer is set to go off; 0 for not set.
+    struct event_conn **idle; // open connections which may have room for a request; open loop only.
+    uint16_t idle_count;
+    bool thinking; // whether completed slots wait a think time before their next request; closed loop only.
+    struct event_wake *wakes; // the thinking slots, a heap with the soonest due first; depth a connection.
+    size_t wake_count;
+};
+
+/**
+ * open_engine
+ * <p>
+ * allocate the connections of a thread and create its epoll instance. nothing is connected yet.
+ * </p>
+ * @param engine the engine.
+ * @param h_args the handle arguments.
+ * @return 0 on success. -1 and set errno on failure, with nothing left allocated.
+ */
+static int open_engine(struct event_engine *engine, struct handle_args *h_args);
+
+/**
+ * close_engine
+ * <p>
+ * close every connection of a thread and free the engine. used as a cleanup handler.
+ * </p>
+ * @param args pointer to the engine.
+ */
+static void close_engine(void *args);
+
+/**
+ * event_connect
+ * <p>
+ * start connecting a connection to the server without blocking. a connection the server refuses at once is set to
+ * be tried again later.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection, closed.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int event_connect(struct event_engine *engine, struct event_conn *conn);
+
+/**
+ * event_refused
+ * <p>
+ * close a connection the server refused and set it to be tried again in EVENT_RETRY_NS.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int event_refused(struct event_engine *engine, struct event_conn *conn);
+
+/**
+ * event_dropped
+ * <p>
+ * replace a connection the server closed or reset, abandoning the requests in flight on it, which are logged as
+ * errors, so that one lost connection does not stop the others of the thread. any other failure is returned.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ * @return 0 on success. -1 and set errno on failure, or if the connection failed some other way.
+ */
+static int event_dropped(struct event_engine *engine, struct event_conn *conn);
+
+/**
+ * event_retry
+ * <p>
+ * start connecting the connections which are due to be tried again.
+ * </p>
+ * @param engine the engine.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int event_retry(struct event_engine *engine);
+
+/**
+ * event_ready
+ * <p>
+ * move a connection on as far as it can go without blocking, after epoll reported it ready.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ * @param events the events epoll reported.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int event_ready(struct event_engine *engine, struct event_conn *conn, uint32_t events);
+
+/**
+ * event_connected
+ * <p>
+ * finish connecting a connection: log the connection setup time, apply the TCP options and start sending.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int event_connected(struct event_engine *engine, struct event_conn *conn);
+
+/**
+ * event_start
+ * <p>
+ * start the next request on a connection, if it has a free slot and has not carried its share of requests.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ * @return whether a request was started.
+ */
+static bool event_start(struct event_engine *engine, struct event_conn *conn);
+
+/**
+ * event_has_room
+ * <p>
+ * check whether a connection could start a request now: it is open, nothing is going out on it, and it has a free slot
+ * and has not carried its share of requests.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ * @return whether the connection has room.
+ */
+static bool event_has_room(const struct event_engine *engine, const struct event_conn *conn);
+
+/**
+ * event_dispatch
+ * <p>
+ * open loop: start the requests that are due on idle connections, as far as there are any, and set the timer for the
+ * next request. requests left over wait for a connection to make room, keeping the time they were due.
+ * </p>
+ * @param engine the engine.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int event_dispatch(struct event_engine *engine);
+
+/**
+ * event_arm
+ * <p>
+ * set the timer to go off at a time, unless it is set for then already.
+ * </p>
+ * @param engine the engine.
+ * @param when_ns the time, from now_ns; 0 to disarm it.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int event_arm(struct event_engine *engine, uint64_t when_ns);
+
+/**
+ * event_tick
+ * <p>
+ * clear the timer after it went off.
+ * </p>
+ * @param engine the engine.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int event_tick(struct event_engine *engine);
+
+/**
+ * event_think
+ * <p>
+ * think time: hold the slot of a request just completed until a think time has passed, by counting it outstanding.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ */
+static void event_think(struct event_engine *engine, struct event_conn *conn);
+
+/**
+ * event_wake
+ * <p>
+ * think time: free the slots whose think time has passed, start requests in them, and set the timer for the next.
+ * </p>
+ * @param engine the engine.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int event_wake(struct event_engine *engine);
+
+/**
+ * event_forget
+ * <p>
+ * think time: drop the thinking slots of a connection being replaced, whose slots start afresh.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ */
+static void event_forget(struct event_engine *engine, const struct event_conn *conn);
+
+/**
+ * event_sift
+ * <p>
+ * restore the heap of thinking slots below an entry that may be due later than its children.
+ * </p>
+ * @param engine the engine.
+ * @param index the entry.
+ */
+static void event_sift(struct event_engine *engine, size_t index);
+
+/**
+ * event_refill
+ * <p>
+ * after slots free on a connection: replace it if it has carried its share, or else start requests in the slots.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int event_refill(struct event_engine *engine, struct event_conn *conn);
+
+/**
+ * event_send
+ * <p>
+ * send as much as the socket takes: the rest of the request going out, then new requests while slots are free.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int event_send(struct event_engine *engine, struct event_conn *conn);
+
+/**
+ * event_receive
+ * <p>
+ * read what the socket has, up to EVENT_RECV_SIZE bytes, and consume it.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ * @return 0 on success. -1 and set errno on failure; errno is EPROTO if the server's reply is wrong.
+ */
+static int event_receive(struct event_engine *engine, struct event_conn *conn);
+
+/**
+ * event_consume
+ * <p>
+ * take bytes read from a connection as acks and echoed payloads, completing requests as they finish.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ * @param buf the bytes.
+ * @param len the number of bytes.
+ * @return 0 on success. -1 and set errno on failure; errno is EPROTO if the server's reply is wrong.
+ */
+static int event_consume(struct event_engine *engine, struct event_conn *conn, const char *buf, size_t len);
+
+/**
+ * event_acked
+ * <p>
+ * decode a whole ack and find the request it is for.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ * @return 0 on success. -1 and set errno to EPROTO if the ack is wrong.
+ */
+static int event_acked(struct event_engine *engine, struct event_conn *conn);
+
+/**
+ * event_watch
+ * <p>
+ * register the events a connection waits for with epoll, if they have changed. in open loop, also put a connection
+ * with room on the idle stack.
+ * </p>
+ * @param engine the engine.
+ * @param conn the connection.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int event_watch(struct event_engine *engine, struct event_conn *conn);
+
+void handle_events(struct handle_args *h_args) {
+    struct event_engine engine;
+    int cancel_state;
+    int result;
+    int nready;
+
+    if (open_engine(&engine, h_args) == -1) {
+        return;
+    }
+    pthread_cleanup_push(close_engine, &engine)
+    // the thread is cancelled only while it waits, never with a request half sent or half logged.
+    (void) pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+
+    result = 0;
+    for (uint16_t conn = 0; result == 0 && conn < h_args->connections; conn++) {
+        result = event_connect(&engine, &engine.conns[conn]);
+    }
+
+    while (result == 0) {
+        (void) pthread_setcancelstate(cancel_state, NULL);
+        nready = epoll_wait(engine.epoll_fd, engine.ready, EVENT_BATCH,
+                            (engine.retrying > 0) ? EVENT_RETRY_POLL_MS : -1);
+        (void) pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        if (nready == -1) {
+            result = (errno == EINTR) ? 0 : -1;
+            continue;
+        }
+        for (int i = 0; result == 0 && i < nready; i++) {
+            result = (engine.ready[i].data.ptr == NULL) ? event_tick(&engine)
+                                                        : event_ready(&engine, engine.ready[i].data.ptr,
+                                                                      engine.ready[i].events);
+        }
+        if (result == 0 && engine.retrying > 0) {
+            result = event_retry(&engine);
+        }
+        if (result == 0 && engine.open_loop) {
+            result = event_dispatch(&engine);
+        } else if (result == 0 && engine.thinking) {
+            result = event_wake(&engine);
+        }
+    }
+    if (errno != EPROTO) { // a wrong reply has been described already.
+        perror("event engine");
+    }
+    (void) pthread_setcancelstate(cancel_state, NULL);
+
+    pthread_cleanup_pop(1);
+}
+
+static int open_engine(struct event_engine *engine, struct handle_args *h_args) {
+    struct epoll_event ev;
+
+    memset(engine, 0, sizeof(struct event_engine));
+    engine->h_args = h_args;
+    engine->epoll_fd = -1;
+    engine->timer_fd = -1;
+    engine->open_loop = h_args->rate > 0;
+    engine->thinking = !engine->open_loop && h_args->think.kind != THINK_NONE;
+    engine->depth = (h_args->protocol_version == PROTOCOL_VERSION_2) ? h_args->pipeline_depth : 1;
+    engine->ack_size = (h_args->protocol_version == PROTOCOL_VERSION_2) ? PROTOCOL_V2_HEADER_SIZE
+                                                                         : PROTOCOL_V1_HEADER_SIZE;
+
+    engine->conns = calloc(h_args->connections, sizeof(struct event_conn));
+    engine->slots = calloc((size_t) h_args->connections * engine->depth, sizeof(struct in_flight));
+    engine->ready = calloc(EVENT_BATCH, sizeof(struct epoll_event));
+    engine->recv_buf = malloc(EVENT_RECV_SIZE);
+    engine->idle = calloc(h_args->connections, sizeof(struct event_conn *));
+    engine->wakes = calloc((engine->thinking) ? (size_t) h_args->connections * engine->depth : 1,
+                           sizeof(struct event_wake));
+    if (engine->conns == NULL || engine->slots == NULL || engine->ready == NULL || engine->recv_buf == NULL
+        || engine->idle == NULL || engine->wakes == NULL) {
+        perror("malloc for event engine");
+        close_engine(engine);
+        return -1;
+    }
+    for (uint16_t conn = 0; conn < h_args->connections; conn++) {
+        engine->conns[conn].fd = -1;
+        engine->conns[conn].in_flight = &engine->slots[(size_t) conn * engine->depth];
+    }
+
+    engine->epoll_fd = epoll_create1(0);
+    if (engine->epoll_fd == -1) {
+        perror("epoll_create1");
+        close_engine(engine);
+        return -1;
+    }
+
+    if (engine->open_loop) {
+        schedule_init(&engine->schedule, h_args->rate, h_args->poisson, h_args->schedule_seed);
+    }
+    if (engine->open_loop || engine->thinking) { // the timer is the one descriptor in epoll without a connection.
+        engine->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC); // NOLINT(hicpp-signed-bitwise)
+        memset(&ev, 0, sizeof(struct epoll_event));
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (engine->timer_fd == -1 || epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, engine->timer_fd, &ev) == -1) {
+            perror("timerfd for the event engine");
+            close_engine(engine);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void close_engine(void *args) {
+    struct event_engine *engine;
+
+    engine = args;
+    if (engine->conns != NULL) {
+        for (uint16_t conn = 0; conn < engine->h_args->connections; conn++) {
+            if (engine->conns[conn].fd != -1) {
+                close_fd(engine->conns[conn].fd);
+            }
+        }
+    }
+    if (engine->timer_fd != -1) {
+        close_fd(engine->timer_fd);
+    }
+    if (engine->epoll_fd != -1) {
+        close_fd(engine->epoll_fd);
+    }
+    free(engine->conns);
+    free(engine->slots);
+    free(engine->ready);
+    free(engine->recv_buf);
+    free(engine->idle);
+    free(engine->wakes);
+    engine->conns = NULL;
+    engine->slots = NULL;
+    engine->ready = NULL;
+    engine->recv_buf = NULL;
+    engine->idle = NULL;
+    engine->wakes = NULL;
+    engine->timer_fd = -1;
+    engine->epoll_fd = -1;
+}
+
+static int event_connect(struct event_engine *engine, struct event_conn *conn) {
+    struct epoll_event ev;
+
+    if (engine->thinking && conn->outstanding > 0) {
+        event_forget(engine, conn);
+    }
+    memset(conn->in_flight, 0, engine->depth * sizeof(struct in_flight));
+    conn->outstanding = 0;
+    conn->started = 0;
+    conn->sending = false;
+    conn->ack_read = 0;
+    conn->acked = NULL;
+
+    conn->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0); // NOLINT(hicpp-signed-bitwise)
+    if (conn->fd == -1) {
+        return -1;
+    }
+    conn->state_ns = now_ns();
+    if (connect(conn->fd, (struct sockaddr *) &engine->h_args->server_addr, sizeof(struct sockaddr_in)) == -1
+        && errno != EINPROGRESS) {
+        return event_refused(engine, conn);
+    }
+
+    conn->state = EVENT_CONN_CONNECTING;
+    conn->events = EPOLLOUT; // writable once the server accepts, or refuses.
+    memset(&ev, 0, sizeof(struct epoll_event));
+    ev.events = conn->events;
+    ev.data.ptr = conn;
+
+    return epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, conn->fd, &ev);
+}
+
+static int event_refused(struct event_engine *engine, struct event_conn *conn) {
+    if (close_fd(conn->fd) == -1) { // also takes it out of epoll.
+        return -1;
+    }
+    conn->fd = -1;
+    conn->state = EVENT_CONN_RETRYING;
+    conn->state_ns = now_ns() + EVENT_RETRY_NS;
+    engine->retrying++;
+
+    return 0;
+}
+
+static int event_dropped(struct event_engine *engine, struct event_conn *conn) {
+    uint16_t lost;
+
+    if (errno != ECONNRESET && errno != EPIPE) {
+        return -1;
+    }
+
+    lost = conn->outstanding;
+    for (size_t i = 0; engine->thinking && i < engine->wake_count; i++) {
+        if (engine->wakes[i].conn == conn) { // completed, and thinking.
+            lost--;
+        }
+    }
+    (void) fprintf(stderr, "thread %d: server dropped a connection with %u requests in flight, reconnecting\n",
+                   engine->h_args->thread_id, lost);
+    if (lost > 0 && log_errors(engine->h_args->thread_id, lost) == -1) {
+        return -1;
+    }
+    if (close_fd(conn->fd) == -1) {
+        return -1;
+    }
+    conn->fd = -1;
+
+    return event_connect(engine, conn);
+}
+
+static int event_retry(struct event_engine *engine) {
+    struct event_conn *conn;
+    uint64_t now;
+
+    now = now_ns();
+    for (uint16_t i = 0; i < engine->h_args->connections; i++) {
+        conn = &engine->conns[i];
+        if (conn->state == EVENT_CONN_RETRYING && conn->state_ns <= now) {
+            engine->retrying--;
+            if (event_connect(engine, conn) == -1) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int event_ready(struct event_engine *engine, struct event_conn *conn, uint32_t events) {
+    const struct handle_args *h_args;
+
+    h_args = engine->h_args;
+    if (conn->state == EVENT_CONN_RETRYING) { // closed after it was reported ready.
+        return 0;
+    }
+    if (conn->state == EVENT_CONN_CONNECTING) {
+        return event_connected(engine, conn);
+    }
+
+    if (events & EPOLLERR && transmit_reap(conn->fd, h_args) == -1) { // NOLINT(hicpp-signed-bitwise)
+        return -1; // zerocopy completions are reported as errors.
+    }
+    if (events & EPOLLOUT && event_send(engine, conn) == -1) { // NOLINT(hicpp-signed-bitwise)
+        return event_dropped(engine, conn);
+    }
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR) && event_receive(engine, conn) == -1) { // NOLINT(hicpp-signed-bitwise)
+        return event_dropped(engine, conn);
+    }
+
+    return event_refill(engine, conn);
+}
+
+static int event_connected(struct event_engine *engine, struct event_conn *conn) {
+    socklen_t len;
+    int error;
+
+    error = 0;
+    len = sizeof(error);
+    if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &error, &len) == -1) {
+        return -1;
+    }
+    if (error != 0) {
+        return event_refused(engine, conn);
+    }
+    if (log_connect(engine->h_args->thread_id, now_ns() - conn->state_ns) == -1) {
+        return -1;
+    }
+    if (set_tcp_options(conn->fd, engine->h_args) == -1) {
+        return -1;
+    }
+    if (engine->open_loop && engine->schedule.next_ns == 0) { // nothing is due before there is somewhere to send it.
+        schedule_start(&engine->schedule, now_ns());
+    }
+
+    conn->state = EVENT_CONN_OPEN;
+    if (event_send(engine, conn) == -1) {
+        return event_dropped(engine, conn);
+    }
+
+    return event_watch(engine, conn);
+}
+
+static bool event_start(struct event_engine *engine, struct event_conn *conn) {
+    struct handle_args *h_args;
+    uint64_t due;
+    uint16_t slot;
+
+    h_args = engine->h_args;
+    if (conn->outstanding == engine->depth || (h_args->conn_messages > 0 && conn->started == h_args->conn_messages)) {
+        return false;
+    }
+    due = 0;
+    if (engine->open_loop) {
+        if (!schedule_due(&engine->schedule, now_ns())) {
+            return false;
+        }
+        due = schedule_take(&engine->schedule);
+    }
+
+    for (slot = 0; conn->in_flight[slot].start_ns != 0; slot++); // there is a free slot, and a free slot is zeroed.
+    conn->header_size = start_request(h_args, &conn->in_flight[slot], engine->next_id++, conn->header_buf);
+    if (engine->open_loop) { // latency counts from when the request was due, however long it waited to go out.
+        conn->in_flight[slot].start_ns = due;
+    }
+    conn->out = &conn->in_flight[slot];
+    conn->request_size = conn->header_size + conn->out->payload->size;
+    if (h_args->checksum) {
+        protocol_encode_checksum(conn->out->payload->crc, conn->trailer);
+        conn->request_size += PROTOCOL_CHECKSUM_SIZE;
+    }
+    conn->sent = 0;
+    conn->sending = true;
+    conn->outstanding++;
+    conn->started++;
+
+    return true;
+}
+
+static bool event_has_room(const struct event_engine *engine, const struct event_conn *conn) {
+    const struct handle_args *h_args;
+
+    h_args = engine->h_args;
+
+    return conn->state == EVENT_CONN_OPEN && !conn->sending && conn->outstanding < engine->depth
+           && (h_args->conn_messages == 0 || conn->started < h_args->conn_messages);
+}
+
+static int event_dispatch(struct event_engine *engine) {
+    struct event_conn *conn;
+
+    while (engine->idle_count > 0 && schedule_due(&engine->schedule, now_ns())) {
+        conn = engine->idle[--engine->idle_count];
+        conn->idle = false;
+        if (!event_has_room(engine, conn)) { // stale: it filled up, or was dropped, since it was pushed.
+            continue;
+        }
+        if (event_send(engine, conn) == -1) {
+            if (event_dropped(engine, conn) == -1) {
+                return -1;
+            }
+            continue;
+        }
+        if (event_watch(engine, conn) == -1) {
+            return -1;
+        }
+    }
+
+    return event_arm(engine, engine->schedule.next_ns);
+}
+
+static int event_arm(struct event_engine *engine, uint64_t when_ns) {
+    struct itimerspec when;
+
+    if (engine->armed_ns == when_ns) {
+        return 0;
+    }
+    engine->armed_ns = when_ns;
+    memset(&when, 0, sizeof(struct itimerspec));
+    when.it_value.tv_sec = (time_t) (engine->armed_ns / NS_PER_SEC);
+    when.it_value.tv_nsec = (long) (engine->armed_ns % NS_PER_SEC);
+
+    return timerfd_settime(engine->timer_fd, TFD_TIMER_ABSTIME, &when, NULL);
+}
+
+static int event_tick(struct event_engine *engine) {
+    uint64_t expirations;
+
+    if (read(engine->timer_fd, &expirations, sizeof(expirations)) == -1) {
+        // NOLINTNEXTLINE(misc-redundant-expression): EAGAIN and EWOULDBLOCK may differ
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+
+    return 0;
+}
+
+static void event_think(struct event_engine *engine, struct event_conn *conn) {
+    struct event_wake held;
+    size_t index;
+    size_t parent;
+
+    // a slot is held once for every request of its connection, so the heap, a slot's worth a connection, has room.
+    index = engine->wake_count++;
+    held.due_ns = now_ns() + think_draw(&engine->h_args->think, &engine->h_args->rng);
+    held.conn = conn;
+    for (; index > 0; index = parent) {
+        parent = (index - 1) / 2;
+        if (engine->wakes[parent].due_ns <= held.due_ns) {
+            break;
+        }
+        engine->wakes[index] = engine->wakes[parent];
+    }
+    engine->wakes[index] = held;
+}
+
+static int event_wake(struct event_engine *engine) {
+    struct event_conn *conn;
+    uint64_t now;
+
+    now = now_ns();
+    while (engine->wake_count > 0 && engine->wakes[0].due_ns <= now) {
+        conn = engine->wakes[0].conn;
+        engine->wakes[0] = engine->wakes[--engine->wake_count];
+        event_sift(engine, 0);
+
+        conn->outstanding--; // the slot is free at last.
+        if (event_refill(engine, conn) == -1) {
+            return -1;
+        }
+    }
+
+    return event_arm(engine, (engine->wake_count > 0) ? engine->wakes[0].due_ns : 0);
+}
+
+static void event_forget(struct event_engine *engine, const struct event_conn *conn) {
+    size_t kept;
+
+    kept = 0;
+    for (size_t i = 0; i < engine->wake_count; i++) {
+        if (engine->wakes[i].conn != conn) {
+            engine->wakes[kept++] = engine->wakes[i];
+        }
+    }
+    engine->wake_count = kept;
+    for (size_t i = kept / 2; i > 0; i--) {
+        event_sift(engine, i - 1);
+    }
+}
+
+static void event_sift(struct event_engine *engine, size_t index) {
+    struct event_wake held;
+    size_t child;
+
+    held = engine->wakes[index];
+    for (child = 2 * index + 1; child < engine->wake_count; child = 2 * index + 1) {
+        if (child + 1 < engine->wake_count && engine->wakes[child + 1].due_ns < engine->wakes[child].due_ns) {
+            child++;
+        }
+        if (held.due_ns <= engine->wakes[child].due_ns) {
+            break;
+        }
+        engine->wakes[index] = engine->wakes[child];
+        index = child;
+    }
+    engine->wakes[index] = held;
+}
+
+static int event_refill(struct event_engine *engine, struct event_conn *conn) {
+    const struct handle_args *h_args;
+
+    h_args = engine->h_args;
+    if (h_args->conn_messages > 0 && conn->started == h_args->conn_messages && conn->outstanding == 0) {
+        if (close_fd(conn->fd) == -1) { // carried its share; replace it.
+            return -1;
+        }
+        conn->fd = -1;
+        return event_connect(engine, conn);
+    }
+    if (!conn->sending && event_send(engine, conn) == -1) { // fill the slots completed requests freed.
+        return event_dropped(engine, conn);
+    }
+
+    return event_watch(engine, conn);
+}
+
+static int event_send(struct event_engine *engine, struct event_conn *conn) {
+    const struct handle_args *h_args;
+    struct msghdr msg;
+    struct iovec iov[3];
+    uint64_t offset;
+    ssize_t sent;
+    int iovcnt;
+
+    h_args = engine->h_args;
+    while (conn->sending || event_start(engine, conn)) {
+        if (h_args->transmit != TRANSMIT_COPY) {
+            if (conn->sent == 0 && transmit_cork(conn->fd, h_args, true) == -1) {
+                return -1;
+            }
+            sent = transmit_piece(conn->fd, h_args, conn->header_buf, (size_t) conn->header_size,
+                                  conn->out->payload->size, (h_args->checksum) ? conn->trailer : NULL, conn->sent,
+                                  MSG_DONTWAIT);
+        } else {
+            // the pieces of the request not yet sent: the rest of the header, payload and trailer.
+            iovcnt = 0;
+            offset = conn->sent;
+            if (offset < conn->header_size) {
+                iov[iovcnt].iov_base = conn->header_buf + offset;
+                iov[iovcnt].iov_len = (size_t) (conn->header_size - offset);
+                iovcnt++;
+                offset = 0;
+            } else {
+                offset -= conn->header_size;
+            }
+            if (offset < conn->out->payload->size) {
+                iov[iovcnt].iov_base = h_args->data + offset;
+                iov[iovcnt].iov_len = (size_t) (conn->out->payload->size - offset);
+                iovcnt++;
+                offset = 0;
+            } else {
+                offset -= conn->out->payload->size;
+            }
+            if (h_args->checksum) {
+                iov[iovcnt].iov_base = conn->trailer + offset;
+                iov[iovcnt].iov_len = (size_t) (PROTOCOL_CHECKSUM_SIZE - offset);
+                iovcnt++;
+            }
+
+            memset(&msg, 0, sizeof(struct msghdr));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iovcnt;
+            sent = sendmsg(conn->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL); // NOLINT(hicpp-signed-bitwise)
+        }
+        if (sent == -1) {
+            // NOLINTNEXTLINE(misc-redundant-expression): EAGAIN and EWOULDBLOCK may differ
+            return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+        }
+
+        conn->sent += (uint64_t) sent;
+        if (conn->sent == conn->request_size) {
+            conn->sending = false;
+            conn->out->sent_ns = now_ns();
+            if (transmit_cork(conn->fd, h_args, false) == -1) {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int event_receive(struct event_engine *engine, struct event_conn *conn) {
+    ssize_t nread;
+
+    nread = recv(conn->fd, engine->recv_buf, EVENT_RECV_SIZE, MSG_DONTWAIT);
+    if (nread == -1) {
+        // NOLINTNEXTLINE(misc-redundant-expression): EAGAIN and EWOULDBLOCK may differ
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    if (nread == 0) {
+        errno = ECONNRESET;
+        return -1;
+    }
+    if (engine->h_args->tcp_quickack && set_quickack(conn->fd) == -1) { // linux drops out of quick ACK mode.
+        return -1;
+    }
+
+    return event_consume(engine, conn, engine->recv_buf, (size_t) nread);
+}
+
+static int event_consume(struct event_engine *engine, struct event_conn *conn, const char *buf, size_t len) {
+    const struct handle_args *h_args;
+    uint64_t echo_left;
+    size_t take;
+
+    h_args = engine->h_args;
+    while (len > 0) {
+        if (conn->acked == NULL) { // the ack is coming in.
+            take = engine->ack_size - conn->ack_read;
+            take = (len < take) ? len : take;
+            memcpy(conn->ack_buf + conn->ack_read, buf, take);
+            conn->ack_read += take;
+            if (conn->ack_read == engine->ack_size && event_acked(engine, conn) == -1) {
+                return -1;
+            }
+        } else { // the echoed payload is coming in.
+            echo_left = conn->acked->payload->size - conn->echo_read;
+            take = (len < echo_left) ? len : (size_t) echo_left;
+            if (memcmp(buf, h_args->data + conn->echo_read, take) != 0) {
+                (void) fprintf(stderr, "thread %d: echoed payload differs from the payload sent\n",
+                               h_args->thread_id);
+                errno = EPROTO;
+                return -1;
+            }
+            conn->echo_read += take;
+        }
+        buf += take;
+        len -= take;
+
+        if (conn->acked != NULL && (!h_args->echo || conn->echo_read == conn->acked->payload->size)) {
+            if (log_request(h_args, conn->acked, conn->ack.length) == -1) {
+                return -1;
+            }
+            memset(conn->acked, 0, sizeof(struct in_flight)); // free the slot
+            conn->acked = NULL;
+            if (engine->thinking) { // still outstanding, until its think time has passed.
+                event_think(engine, conn);
+            } else {
+                conn->outstanding--;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int event_acked(struct event_engine *engine, struct event_conn *conn) {
+    const struct handle_args *h_args;
+    uint32_t server_resp;
+    uint16_t slot;
+
+    h_args = engine->h_args;
+    conn->ack_read = 0;
+    if (h_args->protocol_version == PROTOCOL_VERSION_1) { // one request in flight, in the first slot.
+        memcpy(&server_resp, conn->ack_buf, sizeof(server_resp));
+        memset(&conn->ack, 0, sizeof(struct protocol_header));
+        conn->ack.length = ntohl(server_resp);
+        conn->acked = &conn->in_flight[0];
+        conn->acked->acked_ns = now_ns();
+        return 0;
+    }
+
+    if (protocol_header_size(conn->ack_buf) != PROTOCOL_V2_HEADER_SIZE
+        || protocol_decode_header(conn->ack_buf, &conn->ack) == -1) {
+        (void) fprintf(stderr, "thread %d: server did not ack with protocol 2\n", h_args->thread_id);
+        errno = EPROTO;
+        return -1;
+    }
+
+    // acks may arrive in any order; find the request this one is for.
+    for (slot = 0; slot < engine->depth; slot++) {
+        if (conn->in_flight[slot].start_ns != 0 && conn->in_flight[slot].request_id == conn->ack.request_id) {
+            break;
+        }
+    }
+    if (slot == engine->depth) {
+        (void) fprintf(stderr, "thread %d: ack for unknown request %" PRIu64 "\n", h_args->thread_id,
+                       conn->ack.request_id);
+        errno = EPROTO;
+        return -1;
+    }
+    if (h_args->echo
+        && (!(conn->ack.flags & PROTOCOL_FLAG_ECHO) || conn->ack.length != conn->in_flight[slot].payload->size)) {
+        (void) fprintf(stderr, "thread %d: server did not echo\n", h_args->thread_id);
+        errno = EPROTO;
+        return -1;
+    }
+    conn->acked = &conn->in_flight[slot];
+    conn->acked->acked_ns = now_ns();
+    conn->echo_read = 0;
+
+    return 0;
+}
+
+static int event_watch(struct event_engine *engine, struct event_conn *conn) {
+    struct epoll_event ev;
+    uint32_t events;
+
+    if (engine->open_loop && !conn->idle && event_has_room(engine, conn)) {
+        conn->idle = true;
+        engine->idle[engine->idle_count++] = conn;
+    }
+
+    events = EPOLLIN | ((conn->sending) ? EPOLLOUT : 0); // NOLINT(hicpp-signed-bitwise)
+    if (events == conn->events) {
+        return 0;
+    }
+
+    conn->events = events;
+    memset(&ev, 0, sizeof(struct epoll_event));
+    ev.events = events;
+    ev.data.ptr = conn;
+
+    return epoll_ctl(engine->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+#else
+
+void handle_events(struct handle_args *h_args) {
+    (void) fprintf(stderr, "thread %d: the event engine requires epoll\n", h_args->thread_id);
+}
+
+#endif
@@ -1,15 +1,27 @@
 #include "handle.h"
+#include "../../core/include/histogram.h"
+#include "../../protocol.h"
 
+#include <event.h>
 #include <log.h>
+#include <transmit.h>
 #include <util.h>
 
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <poll.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "EndlessLoop" // suppress endless loop warning
 
@@ -22,20 +34,167 @@
  */
 static void hargs_cleanup_handler(void *args);
 
+/**
+ * echo_stream
+ * <p>
+ * the progress of one connection in echo mode. requests go out one after another, and their acks, each followed by
+ * the echoed payload, come back one after another. both directions move a piece at a time, as far as the socket
+ * allows, so that a payload bigger than the socket buffers cannot leave the client blocked sending while the server
+ * is blocked sending it back.
+ * </p>
+ */
+struct echo_stream {
+    uint8_t header_buf[PROTOCOL_V2_HEADER_SIZE]; // header of the request going out.
+    uint64_t sent; // bytes of the request going out sent, header and payload.
+    bool sending; // whether a request is going out.
+    uint8_t ack_buf[PROTOCOL_V2_HEADER_SIZE];
+    size_t ack_read; // bytes of the ack coming in read.
+    struct protocol_header ack;
+    struct in_flight *acked; // the request the ack coming in is for, once it is read.
+    struct in_flight *out; // the request going out.
+    char *echo; // where the echoed payload is read.
+    uint64_t echo_read; // bytes of the echoed payload read.
+};
+
+/**
+ * handle_pipelined
+ * <p>
+ * perform protocol v2 requests to the server over one connection, keeping pipeline_depth requests in flight.
+ * each ack is matched to its request by request ID, so acks may arrive in any order. a new request is sent as
+ * soon as one is acked. returns only on failure.
+ * </p>
+ * @param h_args the handle arguments.
+ */
+static void handle_pipelined(struct handle_args *h_args);
+
+/**
+ * handle_keepalive
+ * <p>
+ * perform protocol v1 requests to the server over the connections of the keep-alive pool, one after another in
+ * turn, so that no request pays for a handshake. a connection which has carried conn_messages messages is closed
+ * and replaced. returns only on failure.
+ * </p>
+ * @param h_args the handle arguments.
+ */
+static void handle_keepalive(struct handle_args *h_args);
+
+/**
+ * handle_echoed
+ * <p>
+ * perform protocol v2 echo requests to the server over one connection, keeping pipeline_depth requests in flight.
+ * the server sends each payload back after its ack, and the echoed bytes are compared with the bytes sent; a
+ * request is logged once its echo has been verified. returns only on failure.
+ * </p>
+ * @param h_args the handle arguments.
+ */
+static void handle_echoed(struct handle_args *h_args);
+
+/**
+ * connect_server
+ * <p>
+ * open a connection to the server, retrying every second until it accepts, and apply the TCP options. the time the
+ * attempt which succeeded took is logged as connection setup.
+ * </p>
+ * @param server_sock where to store the connection; -1 until it is open.
+ * @param h_args the handle arguments.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int connect_server(int *server_sock, struct handle_args *h_args);
+
+/**
+ * echo_send
+ * <p>
+ * send as much of the request going out as the socket takes without blocking.
+ * </p>
+ * @param server_sock the connection to the server.
+ * @param h_args the handle arguments.
+ * @param stream the echo stream.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int echo_send(int server_sock, struct handle_args *h_args, struct echo_stream *stream);
+
+/**
+ * echo_receive
+ * <p>
+ * read as much of the ack and echoed payload coming in as the socket has without blocking. when the echo is
+ * complete it is compared with the payload sent, and the request is logged.
+ * </p>
+ * @param server_sock the connection to the server.
+ * @param h_args the handle arguments.
+ * @param stream the echo stream.
+ * @param in_flight the requests in flight.
+ * @param done set to true when a request has completed.
+ * @return 0 on success. -1 and set errno on failure; errno is EPROTO if the server's reply is wrong.
+ */
+static int echo_receive(int server_sock, const struct handle_args *h_args, struct echo_stream *stream,
+                        struct in_flight *in_flight, bool *done);
+
+/**
+ * send_request
+ * <p>
+ * send one protocol v2 request and record it as in flight.
+ * </p>
+ * @param server_sock the connection to the server.
+ * @param h_args the handle arguments.
+ * @param slot where to record the request.
+ * @param request_id the ID of the request.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int send_request(int server_sock, struct handle_args *h_args, struct in_flight *slot, uint64_t request_id);
+
+/**
+ * send_framed
+ * <p>
+ * send a header followed by the payload, and the checksum trailer when checksums are on. with send_writev set all
+ * of it goes out in one writev, so the payload is never held back by Nagle's algorithm waiting for the header to be
+ * ACKed; otherwise the pieces are written one after the other. in the sendfile and zerocopy transmit modes the
+ * request goes out with transmit_framed instead.
+ * </p>
+ * @param server_sock the connection to the server.
+ * @param h_args the handle arguments.
+ * @param payload the size class of the payload.
+ * @param header the encoded header.
+ * @param header_size the size of the header.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int send_framed(int server_sock, const struct handle_args *h_args, const struct size_class *payload,
+                       void *header, size_t header_size);
+
+/**
+ * sock_cleanup_handler
+ * <p>
+ * closes the connection to the server on exit.
+ * </p>
+ * @param args pointer to the socket file descriptor.
+ */
+static void sock_cleanup_handler(void *args);
+
 void * handle(void *handle_args) {
     struct handle_args *h_args;
+    const struct size_class *payload;
     struct logger log;
     int server_sock;
-    uint32_t data_size;
     uint32_t server_resp;
     clock_t  start_time_granular;
     clock_t  end_time_granular;
+    uint64_t start_ns;
+    uint64_t sent_ns;
+    uint64_t end_ns;
 
     h_args = handle_args;
-    data_size = h_args->data_size; // done for uint32 cast (htonl)
     pthread_cleanup_push(hargs_cleanup_handler, (void*)h_args) // run hargs_cleanup_handler on thread exit
 
-    while (true) {
+    if (h_args->connections > 0) {
+        handle_events(h_args);
+    } else if (h_args->protocol_version == PROTOCOL_VERSION_2 && h_args->echo) {
+        handle_echoed(h_args);
+    } else if (h_args->protocol_version == PROTOCOL_VERSION_2) {
+        handle_pipelined(h_args);
+    } else if (h_args->pool.size > 0) {
+        handle_keepalive(h_args);
+    }
+
+    while (h_args->protocol_version == PROTOCOL_VERSION_1 && h_args->pool.size == 0 && h_args->connections == 0) {
         memset(&log, 0, sizeof(struct logger));
 
         if (TCP_socket(&server_sock) == -1) {
@@ -43,32 +202,46 @@ void * handle(void *handle_args) {
             return NULL;
         }
 
-        log.data_size = data_size;
+        payload = size_dist_draw(h_args->sizes, &h_args->rng);
+        log.data_size = (uint32_t) payload->size; // protocol 1 sizes are 32 bits; larger classes are rejected.
         log.start_time = time(NULL);
         start_time_granular = clock();
+        start_ns = now_ns();
 
         if (init_connection(server_sock, &h_args->server_addr) == -1) {
             close_fd(server_sock);
             // NOLINTNEXTLINE(concurrency-mt-unsafe) : No threads here
             sleep(1);
         } else {
-            uint32_t net_f_size = htonl(data_size);
-            if (write_fully(server_sock, &net_f_size, sizeof(net_f_size)) == -1) {
+            uint32_t net_f_size = htonl(log.data_size);
+            if (log_connect(h_args->thread_id, now_ns() - start_ns) == -1) {
+                close_fd(server_sock);
+                return NULL;
+            }
+            if (set_tcp_options(server_sock, h_args) == -1) {
                 close_fd(server_sock);
                 return NULL;
             }
 
-            if (write_fully(server_sock, h_args->data, data_size) == -1) {
+            if (send_framed(server_sock, h_args, payload, &net_f_size, sizeof(net_f_size)) == -1) {
                 close_fd(server_sock);
                 return NULL;
             }
+            sent_ns = now_ns();
 
             server_resp = 0;
             if (read_fully(server_sock, &server_resp, sizeof(server_resp)) == -1) {
                 close_fd(server_sock);
                 return NULL;
             }
+            end_ns = now_ns();
+            log.latency_ns = end_ns - start_ns;
+            log.ack_ns = end_ns - sent_ns;
             server_resp = ntohl(server_resp);
+            if (transmit_reap(server_sock, h_args) == -1) { // the payload has been read; the send is complete.
+                close_fd(server_sock);
+                return NULL;
+            }
 
             if (close_fd(server_sock) == -1) {
                 perror("close server fd");
@@ -88,13 +261,500 @@ void * handle(void *handle_args) {
     }
 
     pthread_cleanup_pop(1); // should never reach here, but set to 1 to run data_cleanup_handler anyway
+    return NULL;
+}
+
+static void handle_pipelined(struct handle_args *h_args) {
+    struct in_flight *in_flight;
+    struct protocol_header ack;
+    uint8_t ack_buf[PROTOCOL_V2_HEADER_SIZE];
+    int server_sock;
+    int result;
+    uint64_t next_id;
+    uint16_t slot;
+
+    in_flight = calloc(h_args->pipeline_depth, sizeof(struct in_flight));
+    if (in_flight == NULL) {
+        perror("calloc for in flight requests");
+        return;
+    }
+    server_sock = -1;
+    pthread_cleanup_push(free, in_flight)
+    pthread_cleanup_push(sock_cleanup_handler, &server_sock)
+
+    result = connect_server(&server_sock, h_args);
+
+    next_id = 0;
+    for (slot = 0; result == 0 && slot < h_args->pipeline_depth; slot++) { // fill the pipeline
+        result = send_request(server_sock, h_args, &in_flight[slot], next_id++);
+    }
+
+    while (result == 0) {
+        if (read_fully(server_sock, ack_buf, sizeof(ack_buf)) == -1) {
+            break;
+        }
+        if (h_args->tcp_quickack && set_quickack(server_sock) == -1) { // linux drops out of quick ACK mode.
+            break;
+        }
+        if (protocol_header_size(ack_buf) != PROTOCOL_V2_HEADER_SIZE || protocol_decode_header(ack_buf, &ack) == -1) {
+            (void) fprintf(stderr, "thread %d: server did not ack with protocol 2\n", h_args->thread_id);
+            break;
+        }
+
+        // acks may arrive in any order; find the request this one is for.
+        for (slot = 0; slot < h_args->pipeline_depth && in_flight[slot].request_id != ack.request_id; slot++);
+        if (slot == h_args->pipeline_depth) {
+            (void) fprintf(stderr, "thread %d: ack for unknown request %" PRIu64 "\n", h_args->thread_id,
+                           ack.request_id);
+            break;
+        }
+
+        result = log_request(h_args, &in_flight[slot], ack.length);
+
+        pthread_testcancel();
+        if (result == 0) {
+            result = send_request(server_sock, h_args, &in_flight[slot], next_id++); // reuse the acked slot
+        }
+    }
+
+    pthread_cleanup_pop(1);
+    pthread_cleanup_pop(1);
+}
+
+static void handle_keepalive(struct handle_args *h_args) {
+    const struct size_class *payload;
+    struct logger log;
+    uint32_t net_f_size;
+    uint32_t server_resp;
+    clock_t start_time_granular;
+    uint64_t start_ns;
+    uint64_t sent_ns;
+    uint64_t end_ns;
+    uint16_t conn;
+    int server_sock;
+
+    for (conn = 0;; conn = (uint16_t) ((conn + 1) % h_args->pool.size)) { // take the connections in turn
+        if (h_args->conn_messages > 0 && h_args->pool.messages[conn] == h_args->conn_messages) {
+            close_fd(h_args->pool.fds[conn]);
+            h_args->pool.fds[conn] = -1;
+            h_args->pool.messages[conn] = 0;
+            if (connect_server(&h_args->pool.fds[conn], h_args) == -1) {
+                return;
+            }
+        }
+        server_sock = h_args->pool.fds[conn];
+
+        memset(&log, 0, sizeof(struct logger));
+        payload = size_dist_draw(h_args->sizes, &h_args->rng);
+        log.data_size = (uint32_t) payload->size;
+        net_f_size = htonl(log.data_size);
+        log.start_time = time(NULL);
+        start_time_granular = clock();
+        start_ns = now_ns();
+
+        if (send_framed(server_sock, h_args, payload, &net_f_size, sizeof(net_f_size)) == -1) {
+            return;
+        }
+        sent_ns = now_ns();
+        server_resp = 0;
+        if (read_fully(server_sock, &server_resp, sizeof(server_resp)) == -1) {
+            return;
+        }
+        end_ns = now_ns();
+        log.latency_ns = end_ns - start_ns;
+        log.ack_ns = end_ns - sent_ns;
+        if (h_args->tcp_quickack && set_quickack(server_sock) == -1) { // linux drops out of quick ACK mode.
+            return;
+        }
+        h_args->pool.messages[conn]++;
+
+        log.end_time = time(NULL);
+        log.elapsed_time_granular = (double) (clock() - start_time_granular) / CLOCKS_PER_SEC;
+        log.server_resp = ntohl(server_resp);
+        log.thread_id = h_args->thread_id;
+        if (do_log(&log) == -1) {
+            return;
+        }
+        pthread_testcancel();
+    }
+}
+
+int open_pool(struct handle_args *h_args) {
+    struct connection_pool *pool;
+
+    pool = &h_args->pool;
+    pool->fds = malloc(pool->size * sizeof(int));
+    pool->messages = calloc(pool->size, sizeof(uint16_t));
+    if (pool->fds == NULL || pool->messages == NULL) {
+        perror("malloc for connection pool");
+        close_pool(pool);
+        return -1;
+    }
+
+    for (uint16_t conn = 0; conn < pool->size; conn++) {
+        pool->fds[conn] = -1;
+    }
+    for (uint16_t conn = 0; conn < pool->size; conn++) {
+        if (connect_server(&pool->fds[conn], h_args) == -1) {
+            close_pool(pool);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void close_pool(struct connection_pool *pool) {
+    if (pool->fds != NULL) {
+        for (uint16_t conn = 0; conn < pool->size; conn++) {
+            if (pool->fds[conn] != -1) {
+                close_fd(pool->fds[conn]);
+            }
+        }
+    }
+    free(pool->fds);
+    free(pool->messages);
+    pool->fds = NULL;
+    pool->messages = NULL;
+}
+
+static void handle_echoed(struct handle_args *h_args) {
+    struct echo_stream stream;
+    struct in_flight *in_flight;
+    struct pollfd pfd;
+    int server_sock;
+    int result;
+    uint64_t next_id;
+    uint16_t outstanding;
+    uint16_t slot;
+    bool done;
+
+    memset(&stream, 0, sizeof(struct echo_stream));
+    in_flight = calloc(h_args->pipeline_depth, sizeof(struct in_flight));
+    stream.echo = malloc((h_args->data_size > 0) ? (size_t) h_args->data_size : 1);
+    if (in_flight == NULL || stream.echo == NULL) {
+        perror("malloc for echo");
+        free(in_flight);
+        free(stream.echo);
+        return;
+    }
+    server_sock = -1;
+    pthread_cleanup_push(free, in_flight)
+    pthread_cleanup_push(free, stream.echo)
+    pthread_cleanup_push(sock_cleanup_handler, &server_sock)
+
+    result = connect_server(&server_sock, h_args);
+    if (result == 0) { // every call here is non-blocking, but sendfile takes no MSG_DONTWAIT; the socket must be.
+        result = fcntl(server_sock, F_SETFL, O_NONBLOCK); // a new socket has no other status flags to keep.
+    }
+
+    next_id = 0;
+    outstanding = 0;
+    while (result == 0) {
+        if (!stream.sending && outstanding < h_args->pipeline_depth) { // start the next request in a free slot
+            // a free slot is zeroed.
+            for (slot = 0; slot < h_args->pipeline_depth && in_flight[slot].start_ns != 0; slot++);
+            start_request(h_args, &in_flight[slot], next_id++, stream.header_buf);
+            stream.out = &in_flight[slot];
+            stream.sent = 0;
+            stream.sending = true;
+            outstanding++;
+        }
+
+        pfd.fd = server_sock;
+        pfd.events = (short) (POLLIN | ((stream.sending) ? POLLOUT : 0)); // NOLINT(hicpp-signed-bitwise)
+        pfd.revents = 0;
+        if (poll(&pfd, 1, -1) == -1) {
+            result = (errno == EINTR) ? 0 : -1;
+            continue;
+        }
+
+        if (pfd.revents & POLLERR) { // NOLINT(hicpp-signed-bitwise)
+            result = transmit_reap(server_sock, h_args); // zerocopy completions are reported as errors.
+        }
+        if (result == 0 && pfd.revents & POLLOUT) { // NOLINT(hicpp-signed-bitwise)
+            result = echo_send(server_sock, h_args, &stream);
+        }
+        if (result == 0 && pfd.revents & (POLLIN | POLLHUP | POLLERR)) { // NOLINT(hicpp-signed-bitwise)
+            done = false;
+            result = echo_receive(server_sock, h_args, &stream, in_flight, &done);
+            if (done) {
+                outstanding--;
+            }
+        }
+        pthread_testcancel();
+    }
+
+    pthread_cleanup_pop(1);
+    pthread_cleanup_pop(1);
+    pthread_cleanup_pop(1);
+}
+
+static int connect_server(int *server_sock, struct handle_args *h_args) {
+    uint64_t start_ns;
+    int result;
+
+    result = 0;
+    start_ns = 0;
+    while (result == 0 && *server_sock == -1) {
+        start_ns = now_ns();
+        result = TCP_socket(server_sock);
+        if (result == 0 && init_connection(*server_sock, &h_args->server_addr) == -1) {
+            close_fd(*server_sock);
+            *server_sock = -1;
+            // NOLINTNEXTLINE(concurrency-mt-unsafe) : No threads here
+            sleep(1);
+            pthread_testcancel();
+        }
+    }
+    if (result == 0) {
+        result = log_connect(h_args->thread_id, now_ns() - start_ns);
+    }
+    if (result == 0) {
+        result = set_tcp_options(*server_sock, h_args);
+    }
+
+    return result;
+}
+
+size_t start_request(struct handle_args *h_args, struct in_flight *slot, uint64_t request_id, uint8_t *header_buf) {
+    struct protocol_header header;
+    size_t header_size;
+
+    slot->payload = size_dist_draw(h_args->sizes, &h_args->rng);
+
+    header.version = (uint8_t) h_args->protocol_version;
+    header.flags = (h_args->echo) ? PROTOCOL_FLAG_ECHO : 0;
+    if (h_args->checksum) {
+        header.flags |= PROTOCOL_FLAG_CHECKSUM;
+    }
+    header.length = slot->payload->size;
+    header.request_id = request_id;
+    header_size = protocol_encode_header(&header, header_buf);
+
+    slot->request_id = request_id;
+    slot->start_time = time(NULL);
+    slot->start_time_granular = clock();
+    slot->start_ns = now_ns();
+    slot->sent_ns = 0;
+    slot->acked_ns = 0;
+
+    return header_size;
+}
+
+static int send_request(int server_sock, struct handle_args *h_args, struct in_flight *slot, uint64_t request_id) {
+    uint8_t header_buf[PROTOCOL_V2_HEADER_SIZE];
+
+    start_request(h_args, slot, request_id, header_buf);
+    if (send_framed(server_sock, h_args, slot->payload, header_buf, sizeof(header_buf)) == -1) {
+        return -1;
+    }
+    slot->sent_ns = now_ns();
+
+    return 0;
+}
+
+static int echo_send(int server_sock, struct handle_args *h_args, struct echo_stream *stream) {
+    struct msghdr msg;
+    struct iovec iov[2];
+    ssize_t sent;
+    size_t payload_sent;
+    uint64_t payload_size;
+    int iovcnt;
+
+    payload_size = stream->out->payload->size;
+    if (h_args->transmit != TRANSMIT_COPY) {
+        sent = transmit_piece(server_sock, h_args, stream->header_buf, sizeof(stream->header_buf), payload_size, NULL,
+                              stream->sent, MSG_DONTWAIT);
+    } else {
+        iovcnt = 0;
+        payload_sent = 0;
+        if (stream->sent < sizeof(stream->header_buf)) {
+            iov[iovcnt].iov_base = stream->header_buf + stream->sent;
+            iov[iovcnt].iov_len = sizeof(stream->header_buf) - stream->sent;
+            iovcnt++;
+        } else {
+            payload_sent = (size_t) stream->sent - sizeof(stream->header_buf);
+        }
+        iov[iovcnt].iov_base = h_args->data + payload_sent;
+        iov[iovcnt].iov_len = (size_t) payload_size - payload_sent;
+        iovcnt++;
+
+        memset(&msg, 0, sizeof(struct msghdr));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        sent = sendmsg(server_sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL); // NOLINT(hicpp-signed-bitwise)
+    }
+    if (sent == -1) {
+        // NOLINTNEXTLINE(misc-redundant-expression): EAGAIN and EWOULDBLOCK may differ
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+
+    stream->sent += (uint64_t) sent;
+    if (stream->sent == sizeof(stream->header_buf) + payload_size) {
+        stream->sending = false;
+        stream->out->sent_ns = now_ns();
+    }
+
+    return 0;
+}
+
+static int echo_receive(int server_sock, const struct handle_args *h_args, struct echo_stream *stream,
+                        struct in_flight *in_flight, bool *done) {
+    ssize_t nread;
+    uint16_t slot;
+
+    if (stream->ack_read < sizeof(stream->ack_buf)) {
+        nread = recv(server_sock, stream->ack_buf + stream->ack_read, sizeof(stream->ack_buf) - stream->ack_read,
+                     MSG_DONTWAIT);
+    } else {
+        nread = recv(server_sock, stream->echo + stream->echo_read,
+                     (size_t) (stream->acked->payload->size - stream->echo_read), MSG_DONTWAIT);
+    }
+    if (nread == -1) {
+        // NOLINTNEXTLINE(misc-redundant-expression): EAGAIN and EWOULDBLOCK may differ
+        return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    }
+    if (nread == 0) {
+        errno = ECONNRESET;
+        return -1;
+    }
+    if (h_args->tcp_quickack && set_quickack(server_sock) == -1) { // linux drops out of quick ACK mode.
+        return -1;
+    }
+
+    if (stream->ack_read < sizeof(stream->ack_buf)) {
+        stream->ack_read += (size_t) nread;
+        if (stream->ack_read < sizeof(stream->ack_buf)) {
+            return 0;
+        }
+        if (protocol_header_size(stream->ack_buf) != PROTOCOL_V2_HEADER_SIZE
+            || protocol_decode_header(stream->ack_buf, &stream->ack) == -1) {
+            (void) fprintf(stderr, "thread %d: server did not ack with protocol 2\n", h_args->thread_id);
+            errno = EPROTO;
+            return -1;
+        }
+        for (slot = 0; slot < h_args->pipeline_depth; slot++) {
+            if (in_flight[slot].start_ns != 0 && in_flight[slot].request_id == stream->ack.request_id) {
+                break;
+            }
+        }
+        if (slot == h_args->pipeline_depth) {
+            (void) fprintf(stderr, "thread %d: ack for unknown request %" PRIu64 "\n", h_args->thread_id,
+                           stream->ack.request_id);
+            errno = EPROTO;
+            return -1;
+        }
+        if (!(stream->ack.flags & PROTOCOL_FLAG_ECHO) || stream->ack.length != in_flight[slot].payload->size) {
+            (void) fprintf(stderr, "thread %d: server did not echo\n", h_args->thread_id);
+            errno = EPROTO;
+            return -1;
+        }
+        stream->acked = &in_flight[slot];
+        stream->acked->acked_ns = now_ns();
+        stream->echo_read = 0;
+    } else {
+        stream->echo_read += (uint64_t) nread;
+    }
+    if (stream->echo_read < stream->acked->payload->size) {
+        return 0;
+    }
+
+    if (memcmp(stream->echo, h_args->data, (size_t) stream->acked->payload->size) != 0) {
+        (void) fprintf(stderr, "thread %d: echoed payload differs from the payload sent\n", h_args->thread_id);
+        errno = EPROTO;
+        return -1;
+    }
+    if (log_request(h_args, stream->acked, stream->ack.length) == -1) {
+        return -1;
+    }
+    memset(stream->acked, 0, sizeof(struct in_flight)); // free the slot
+    stream->acked = NULL;
+    stream->ack_read = 0;
+    *done = true;
+
+    return 0;
+}
+
+int log_request(const struct handle_args *h_args, const struct in_flight *slot, uint64_t server_resp) {
+    struct logger log;
+    uint64_t end_ns;
+    uint64_t acked_ns;
+
+    end_ns = now_ns();
+    acked_ns = (slot->acked_ns != 0) ? slot->acked_ns : end_ns;
+    memset(&log, 0, sizeof(struct logger));
+    log.data_size = (uint32_t) slot->payload->size;
+    log.start_time = slot->start_time;
+    log.end_time = time(NULL);
+    log.elapsed_time_granular = (double) (clock() - slot->start_time_granular) / CLOCKS_PER_SEC;
+    log.latency_ns = end_ns - slot->start_ns;
+    log.ack_ns = (slot->sent_ns != 0 && acked_ns >= slot->sent_ns) ? acked_ns - slot->sent_ns : 0;
+    log.server_resp = (uint32_t) server_resp;
+    log.thread_id = h_args->thread_id;
+
+    return do_log(&log);
+}
+
+static int send_framed(int server_sock, const struct handle_args *h_args, const struct size_class *payload,
+                       void *header, size_t header_size) {
+    struct iovec iov[3];
+    uint8_t trailer[PROTOCOL_CHECKSUM_SIZE];
+
+    if (h_args->checksum) {
+        protocol_encode_checksum(payload->crc, trailer);
+    }
+
+    if (h_args->transmit != TRANSMIT_COPY) {
+        return transmit_framed(server_sock, h_args, header, header_size, payload->size,
+                               (h_args->checksum) ? trailer : NULL);
+    }
+
+    if (h_args->send_writev) {
+        iov[0].iov_base = header;
+        iov[0].iov_len = header_size;
+        iov[1].iov_base = h_args->data;
+        iov[1].iov_len = (size_t) payload->size;
+        iov[2].iov_base = trailer;
+        iov[2].iov_len = sizeof(trailer);
+        return writev_fully(server_sock, iov, (h_args->checksum) ? 3 : 2);
+    }
+
+    if (write_fully(server_sock, header, header_size) == -1) {
+        return -1;
+    }
+    if (write_fully(server_sock, h_args->data, (size_t) payload->size) == -1) {
+        return -1;
+    }
+
+    return (h_args->checksum) ? write_fully(server_sock, trailer, sizeof(trailer)) : 0;
+}
+
+int set_tcp_options(int server_sock, const struct handle_args *h_args) {
+    if (h_args->tcp_nodelay && set_nodelay(server_sock) == -1) {
+        return -1;
+    }
+    if (h_args->tcp_quickack && set_quickack(server_sock) == -1) {
+        return -1;
+    }
+
+    return transmit_open(server_sock, h_args);
+}
+
+static void sock_cleanup_handler(void *args) {
+    int *server_sock;
+
+    server_sock = args;
+    if (*server_sock != -1) {
+        close_fd(*server_sock);
+    }
 }
 
 static void hargs_cleanup_handler(void *args) {
     struct handle_args * h_args;
 
     h_args = args;
-    free(h_args->data);
+    close_pool(&h_args->pool);
     free(h_args);
 }
 
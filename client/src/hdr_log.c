@@ -0,0 +1,265 @@
+#include "hdr_log.h"
+
+#include <util.h>
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+
+#define HDR_SIGNIFICANT_DIGITS 1 // 32 sub-buckets per power of two, twice as fine as the client's histograms.
+#define HDR_HALF_MAGNITUDE 4 // log2 of half the sub-buckets.
+#define HDR_SUB_BUCKET_MASK 31ULL
+#define HDR_HIGHEST_NS 3600000000000ULL // an hour.
+#define HDR_ENCODING_COOKIE (0x1c849303 | 0x10) // V2, counts as ZigZag LEB128.
+#define HDR_COMPRESSION_COOKIE (0x1c849304 | 0x10)
+#define HDR_HEADER_SIZE 40
+#define HDR_VARINT_MAX 9 // bytes of one encoded count, or run of zeros.
+#define HDR_ENCODED_MAX (HDR_HEADER_SIZE + 2 * HISTOGRAM_BUCKETS * HDR_VARINT_MAX) // a run of zeros before each count.
+#define NS_PER_SEC ((double) 1000000000)
+#define NS_PER_MS ((double) 1000000)
+
+/**
+ * hdr_index
+ * <p>
+ * find the index of the count a value falls in, in the log's histograms.
+ * </p>
+ * @param value the value, at most HDR_HIGHEST_NS.
+ * @return the index.
+ */
+static size_t hdr_index(uint64_t value);
+
+/**
+ * put_be
+ * <p>
+ * store a value big-endian.
+ * </p>
+ * @param buf where to store it.
+ * @param value the value.
+ * @param size the number of bytes, 4 or 8.
+ * @return the number of bytes stored.
+ */
+static size_t put_be(uint8_t *buf, uint64_t value, size_t size);
+
+/**
+ * put_varint
+ * <p>
+ * store a count, or the negated length of a run of zeros, ZigZag LEB128 encoded as HdrHistogram does: seven bits a
+ * byte for eight bytes, then a ninth byte of eight bits.
+ * </p>
+ * @param buf where to store it, at least HDR_VARINT_MAX bytes.
+ * @param value the value.
+ * @return the number of bytes stored.
+ */
+static size_t put_varint(uint8_t *buf, int64_t value);
+
+/**
+ * put_count
+ * <p>
+ * store the count at an index, after the zeros from the last count stored.
+ * </p>
+ * @param buf where to store it, at least twice HDR_VARINT_MAX bytes.
+ * @param next the index after the last count stored; moved past this one.
+ * @param index the index, at least next.
+ * @param count the count.
+ * @return the number of bytes stored.
+ */
+static size_t put_count(uint8_t *buf, size_t *next, size_t index, uint64_t count);
+
+/**
+ * encode
+ * <p>
+ * encode a histogram in the V2 encoding, uncompressed.
+ * </p>
+ * @param h the histogram.
+ * @param buf where to encode it, at least HDR_ENCODED_MAX bytes.
+ * @return the size of the encoding.
+ */
+static size_t encode(const struct histogram *h, uint8_t *buf);
+
+/**
+ * write_base64
+ * <p>
+ * write bytes to a file as base64, with padding.
+ * </p>
+ * @param file the file.
+ * @param buf the bytes.
+ * @param len the number of bytes.
+ */
+static void write_base64(FILE *file, const uint8_t *buf, size_t len);
+
+int hdr_log_open(struct hdr_log *log, const char *file_name) {
+    struct timespec wall;
+    char date[32];
+    time_t seconds;
+    double start;
+
+    log->file = NULL;
+    if (open_file(&log->file, file_name, "w") == -1) {
+        return -1;
+    }
+    log->start_ns = now_ns();
+    if (clock_gettime(CLOCK_REALTIME, &wall) == -1) {
+        return -1;
+    }
+    seconds = wall.tv_sec;
+    if (ctime_r(&seconds, date) == NULL) {
+        return -1;
+    }
+    date[strcspn(date, "\n")] = '\0';
+    start = (double) wall.tv_sec + (double) wall.tv_nsec / NS_PER_SEC;
+
+    (void) fprintf(log->file, "#[Histogram log format version 1.3]\n");
+    (void) fprintf(log->file, "#[StartTime: %.3f (seconds since epoch), %s]\n", start, date);
+    (void) fprintf(log->file, "#[BaseTime: %.3f (seconds since epoch)]\n", start);
+    (void) fprintf(log->file, "\"StartTimestamp\",\"Interval_Length\",\"Interval_Max\","
+                              "\"Interval_Compressed_Histogram\"\n");
+
+    return (ferror(log->file)) ? -1 : 0;
+}
+
+int hdr_log_write(struct hdr_log *log, const char *tag, const struct histogram *h, uint64_t start_ns,
+                  uint64_t end_ns) {
+    static uint8_t encoded[HDR_ENCODED_MAX]; // only the main thread writes the log.
+    static uint8_t compressed[8 + HDR_ENCODED_MAX + HDR_ENCODED_MAX / 1000 + 64]; // cookie, length, and zlib's bound.
+    uLongf compressed_size;
+    size_t encoded_size;
+    uint64_t max;
+
+    encoded_size = encode(h, encoded);
+    compressed_size = sizeof(compressed) - 8;
+    if (compress(compressed + 8, &compressed_size, encoded, encoded_size) != Z_OK) {
+        errno = ENOMEM;
+        return -1;
+    }
+    (void) put_be(compressed, HDR_COMPRESSION_COOKIE, 4);
+    (void) put_be(compressed + 4, compressed_size, 4);
+    max = (h->max < HDR_HIGHEST_NS) ? h->max : HDR_HIGHEST_NS;
+
+    (void) fprintf(log->file, "Tag=%s,%.3f,%.3f,%.3f,", tag, (double) (start_ns - log->start_ns) / NS_PER_SEC,
+                   (double) (end_ns - start_ns) / NS_PER_SEC, (double) max / NS_PER_MS);
+    write_base64(log->file, compressed, 8 + (size_t) compressed_size);
+    (void) fputc('\n', log->file);
+
+    return (ferror(log->file)) ? -1 : 0;
+}
+
+int hdr_log_close(struct hdr_log *log) {
+    FILE *file;
+
+    file = log->file;
+    log->file = NULL;
+
+    return (file == NULL || fclose(file) == 0) ? 0 : -1;
+}
+
+static size_t hdr_index(uint64_t value) {
+    unsigned int bucket;
+
+    bucket = 64 - (unsigned int) __builtin_clzll(value | HDR_SUB_BUCKET_MASK) - (HDR_HALF_MAGNITUDE + 1);
+    return ((size_t) (bucket + 1) << HDR_HALF_MAGNITUDE) + (size_t) ((value >> bucket) - (1U << HDR_HALF_MAGNITUDE));
+}
+
+static size_t put_be(uint8_t *buf, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        buf[i] = (uint8_t) (value >> (8 * (size - 1 - i)));
+    }
+
+    return size;
+}
+
+static size_t put_varint(uint8_t *buf, int64_t value) {
+    uint64_t zigzag;
+    size_t len;
+
+    zigzag = ((uint64_t) value << 1U) ^ ((value < 0) ? UINT64_MAX : 0);
+    for (len = 0; len < HDR_VARINT_MAX - 1; len++) {
+        if ((zigzag >> 7U) == 0) {
+            buf[len] = (uint8_t) zigzag;
+            return len + 1;
+        }
+        buf[len] = (uint8_t) ((zigzag & 0x7FU) | 0x80U);
+        zigzag >>= 7U;
+    }
+    buf[len] = (uint8_t) zigzag;
+
+    return HDR_VARINT_MAX;
+}
+
+static size_t put_count(uint8_t *buf, size_t *next, size_t index, uint64_t count) {
+    size_t len;
+
+    len = 0;
+    if (index - *next > 1) { // a run of zeros is stored as its length, negated; a single zero as itself.
+        len += put_varint(buf, -(int64_t) (index - *next));
+    } else if (index - *next == 1) {
+        len += put_varint(buf, 0);
+    }
+    len += put_varint(buf + len, (int64_t) count);
+    *next = index + 1;
+
+    return len;
+}
+
+static size_t encode(const struct histogram *h, uint8_t *buf) {
+    size_t next; // the index the counts written so far reach.
+    size_t index;
+    size_t pending_index;
+    size_t len;
+    uint64_t value;
+    uint64_t pending; // the count at pending_index, held back while the next buckets may fall in it too.
+
+    len = HDR_HEADER_SIZE;
+    next = 0;
+    pending = 0;
+    pending_index = 0;
+    for (size_t bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+        if (h->buckets[bucket] == 0) {
+            continue;
+        }
+        value = histogram_bucket_upper_bound(bucket);
+        index = hdr_index((value < HDR_HIGHEST_NS) ? value : HDR_HIGHEST_NS); // every bucket above an hour is one.
+        if (pending > 0 && index != pending_index) {
+            len += put_count(buf + len, &next, pending_index, pending);
+            pending = 0;
+        }
+        pending_index = index;
+        pending += h->buckets[bucket];
+    }
+    if (pending > 0) {
+        len += put_count(buf + len, &next, pending_index, pending);
+    } else { // empty: the one count up to the largest value, 0.
+        len += put_varint(buf + len, 0);
+    }
+
+    (void) put_be(buf, HDR_ENCODING_COOKIE, 4);
+    (void) put_be(buf + 4, len - HDR_HEADER_SIZE, 4);
+    (void) put_be(buf + 8, 0, 4); // normalizing index offset.
+    (void) put_be(buf + 12, HDR_SIGNIFICANT_DIGITS, 4);
+    (void) put_be(buf + 16, 1, 8); // lowest discernible value.
+    (void) put_be(buf + 24, HDR_HIGHEST_NS, 8);
+    (void) put_be(buf + 32, 0x3FF0000000000000ULL, 8); // 1.0, the ratio of integer to double values.
+
+    return len;
+}
+
+static void write_base64(FILE *file, const uint8_t *buf, size_t len) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uint32_t group;
+    char out[4];
+
+    for (size_t i = 0; i < len; i += 3) {
+        group = (uint32_t) buf[i] << 16U;
+        if (i + 1 < len) {
+            group |= (uint32_t) buf[i + 1] << 8U;
+        }
+        if (i + 2 < len) {
+            group |= buf[i + 2];
+        }
+        out[0] = alphabet[(group >> 18U) & 0x3FU];
+        out[1] = alphabet[(group >> 12U) & 0x3FU];
+        out[2] = (i + 1 < len) ? alphabet[(group >> 6U) & 0x3FU] : '=';
+        out[3] = (i + 2 < len) ? alphabet[group & 0x3FU] : '=';
+        (void) fwrite(out, 1, sizeof(out), file);
+    }
+}
@@ -1,36 +1,169 @@
 #include "log.h"
+#include "../../core/include/histogram.h"
 
+#include <hdr_log.h>
 #include <util.h>
 
 #include <inttypes.h>
 #include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define LOG_FILE_NAME "log.csv"
 #define LOG_OPEN_MODE "w" // Mode is set to truncate for independent results from each experiment.
+#define LATENCY_FILE_NAME "latency.csv"
+#define LATENCY_OPEN_MODE "a" // Mode is set to append so that runs in different modes can be compared.
+#define HDR_LOG_FILE_NAME "latency.hlog" // Truncated too; one run's intervals.
+#define RUN_LABEL_SIZE 768
+#define NS_PER_US ((double) 1000)
+#define NS_PER_SEC ((double) 1000000000)
+#define MIB ((double) (1024 * 1024))
+#define LOG_BUFFER_SIZE (64 * 1024) // CSV rows a thread formats before writing them out at once.
+#define LOG_ROW_MAX 256 // room left for one more row.
+#define TIME_STR_SIZE 26 // what ctime_r writes.
 
 /**
- * log
+ * thread_log
  * <p>
- * Log the information from one received message into the log file in Comma Separated Value file format.
+ * what one client thread has logged. the thread records into its own histograms and counters, taking only its own
+ * lock, which nothing else holds but the main thread taking an interval once a second; its CSV rows gather in its
+ * own buffer and are written out a buffer at a time.
  * </p>
+ */
+struct thread_log {
+    pthread_mutex_t lock; // guards the histograms and counters.
+    struct histogram request; // request latencies of the interval.
+    struct histogram ack; // from each request being sent to its ack, of the interval.
+    struct histogram connect; // connection setup times of the interval.
+    uint64_t requests;
+    uint64_t connects;
+    uint64_t payload_bytes; // payload bytes of the requests completed.
+    uint64_t zerocopy_sends; // zerocopy sends completed.
+    uint64_t zerocopy_copied; // zerocopy sends the kernel copied after all.
+    uint64_t errors; // requests lost with dropped connections.
+    char *rows; // CSV rows not yet written out; the thread's alone.
+    size_t rows_len;
+    time_t stamp_time; // the last time formatted, which most rows share.
+    char stamp[TIME_STR_SIZE];
+};
+
+/**
+ * log_row
+ * <p>
+ * format the CSV row for one received message into the thread's buffer, writing the buffer out first if it is full.
+ * </p>
+ * @param tl the thread's log.
  * @param l pointer to the logger struct.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int log_row(struct thread_log *tl, const struct logger *l);
+
+/**
+ * time_str
+ * <p>
+ * format a time as ctime does, without the newline. the thread's last time is kept formatted, so that the times of a
+ * row, which are mostly the same second, cost one format a second rather than three a row.
+ * </p>
+ * @param tl the thread's log.
+ * @param t the time, 0 for none.
+ * @param buf where to format a time other than the thread's last.
+ * @return the formatted time.
+ */
+static const char *time_str(struct thread_log *tl, time_t t, char *buf);
+
+/**
+ * flush_rows
+ * <p>
+ * write out the CSV rows a thread has gathered, under the log file lock.
+ * </p>
+ * @param tl the thread's log.
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int flush_rows(struct thread_log *tl);
+
+/**
+ * close_thread_logs
+ * <p>
+ * write out the CSV rows of every thread and free the thread logs. the threads must have stopped.
+ * </p>
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int close_thread_logs(void);
+
+/**
+ * format_label
+ * <p>
+ * label the results with the send path, TCP options and load of the state, and with the scenario phase, if any.
+ * </p>
+ * @param s pointer to the state object.
+ * @param phase the name of the phase, or NULL.
  */
-static void log(struct logger * l);
+static void format_label(const struct state * s, const char * phase);
+
+/**
+ * reset_run
+ * <p>
+ * start the results of the run afresh.
+ * </p>
+ */
+static void reset_run(void);
+
+/**
+ * report_latency
+ * <p>
+ * print the latency summary and percentiles of the run to stdout and append the summary to the latency file.
+ * </p>
+ * @return 0 on success. -1 and set errno on failure.
+ */
+static int report_latency(void);
+
+/**
+ * print_percentiles
+ * <p>
+ * print a table of the request, send to ack and connection setup times at a range of percentiles.
+ * </p>
+ */
+static void print_percentiles(void);
 
 const char * csv_header = "TimeStamp, ThreadID, DataSize, ServerResponse, StartTime, EndTime, ElapsedTime\n";
 
 static bool initialized = false;
 static FILE * log_file;
-pthread_mutex_t log_lock;
+pthread_mutex_t log_lock; // guards the log file, which threads write a buffer of rows at a time.
+static struct thread_log *thread_logs; // one per client thread, by thread ID.
+static int n_thread_logs;
+// the rest is the main thread's alone.
+static struct histogram latency; // request latencies of the measured intervals.
+static struct histogram ack_latency; // send to ack times of the measured intervals.
+static struct histogram connect_latency; // connection setup times of the measured intervals.
+static uint64_t run_requests; // requests completed in the measured intervals.
+static uint64_t run_connects; // connections opened in the measured intervals.
+static uint64_t run_payload_bytes; // payload bytes of the requests completed in the measured intervals.
+static uint64_t run_zerocopy_sends; // zerocopy sends completed in the measured intervals.
+static uint64_t run_zerocopy_copied; // zerocopy sends the kernel copied, of those.
+static uint64_t run_errors; // requests lost in the measured intervals.
+static uint64_t measured_ns; // the length of the measured intervals.
+static uint64_t interval_start_ns; // when the interval being recorded started.
+static bool collected; // whether an interval has been taken.
+static struct hdr_log hdr_log; // the histograms of the measured intervals.
+static char run_label[RUN_LABEL_SIZE]; // the send path, TCP options and load of the run, or of the phase.
 
-int init_logger(void) {
+int init_logger(const struct state * s) {
     int result = 0;
 
     if (!initialized) {
+        reset_run();
+        collected = false;
+        format_label(s, NULL);
+
         if (open_file(&log_file, LOG_FILE_NAME, LOG_OPEN_MODE) == -1) {
             return -1;
         }
+        if (hdr_log_open(&hdr_log, HDR_LOG_FILE_NAME) == -1) {
+            perror("opening interval log");
+            (void) hdr_log_close(&hdr_log);
+            return -1;
+        }
 
         if (pthread_mutex_init(&log_lock, NULL) != 0) {
             perror("init log mutex");
@@ -62,6 +195,19 @@ int destroy_logger(void) {
     int ret = 0;
 
     if (initialized) {
+        if (!collected && log_interval(true) == -1) { // never measured in intervals; the whole run is one.
+            perror("recording interval");
+            ret = -1;
+        }
+        if (close_thread_logs() == -1) {
+            ret = -1;
+        }
+
+        if (report_latency() == -1) {
+            perror("recording latency");
+            ret = -1;
+        }
+
         if (pthread_mutex_destroy(&log_lock) != 0) {
             perror("destroying log mutex");
             ret = -1;
@@ -71,43 +217,413 @@ int destroy_logger(void) {
             perror("closing log file");
             ret = 0;
         }
+        if (hdr_log_close(&hdr_log) == -1) {
+            perror("closing interval log");
+            ret = -1;
+        }
     }
     initialized = false;
 
     return ret;
 }
 
+int log_phase(const struct state * s, const char * name) {
+    int ret = 0;
+
+    if (report_latency() == -1) { // the phase before, if it measured anything.
+        perror("recording latency");
+        ret = -1;
+    }
+    reset_run();
+    format_label(s, name);
+
+    return ret;
+}
+
+void log_result(struct search_result * dst) {
+    dst->requests = run_requests;
+    dst->errors = run_errors;
+    dst->measured_ns = measured_ns;
+    dst->latency = latency;
+}
+
+int open_thread_logs(int n) {
+    struct thread_log *tl;
+
+    if (thread_logs != NULL && close_thread_logs() == -1) {
+        return -1;
+    }
+
+    thread_logs = calloc((size_t) n, sizeof(struct thread_log));
+    if (thread_logs == NULL) {
+        perror("calloc for thread logs");
+        return -1;
+    }
+    for (n_thread_logs = 0; n_thread_logs < n; n_thread_logs++) {
+        tl = &thread_logs[n_thread_logs];
+        tl->rows = malloc(LOG_BUFFER_SIZE);
+        if (tl->rows == NULL || pthread_mutex_init(&tl->lock, NULL) != 0) {
+            perror("init thread log");
+            free(tl->rows);
+            (void) close_thread_logs(); // the ones before this one.
+            return -1;
+        }
+    }
+    interval_start_ns = now_ns();
+
+    return 0;
+}
+
 int do_log(struct logger * l) {
-    if (pthread_mutex_lock(&log_lock) != 0) {
-        perror("locking log mutex");
+    struct thread_log *tl;
+
+    tl = &thread_logs[l->thread_id];
+    if (log_row(tl, l) == -1) {
+        return -1;
+    }
+
+    if (pthread_mutex_lock(&tl->lock) != 0) {
+        perror("locking thread log mutex");
+        return -1;
+    }
+
+    if (l->latency_ns) {
+        histogram_record(&tl->request, l->latency_ns);
+    }
+    if (l->ack_ns) {
+        histogram_record(&tl->ack, l->ack_ns);
+    }
+    tl->requests++;
+    tl->payload_bytes += l->data_size;
+
+    if (pthread_mutex_unlock(&tl->lock) != 0) {
+        perror("unlocking thread log mutex");
+        return -1;
+    }
+
+    return 0;
+}
+
+int log_connect(int thread_id, uint64_t connect_ns) {
+    struct thread_log *tl;
+
+    tl = &thread_logs[thread_id];
+    if (pthread_mutex_lock(&tl->lock) != 0) {
+        perror("locking thread log mutex");
+        return -1;
+    }
+
+    histogram_record(&tl->connect, connect_ns);
+    tl->connects++;
+
+    if (pthread_mutex_unlock(&tl->lock) != 0) {
+        perror("unlocking thread log mutex");
         return -1;
     }
 
-    log(l);
+    return 0;
+}
+
+int log_zerocopy(int thread_id, uint64_t completed, uint64_t copied) {
+    struct thread_log *tl;
 
-    if (pthread_mutex_unlock(&log_lock) != 0) {
-        perror("unlocking log mutex");
+    tl = &thread_logs[thread_id];
+    if (pthread_mutex_lock(&tl->lock) != 0) {
+        perror("locking thread log mutex");
+        return -1;
+    }
+
+    tl->zerocopy_sends += completed;
+    tl->zerocopy_copied += copied;
+
+    if (pthread_mutex_unlock(&tl->lock) != 0) {
+        perror("unlocking thread log mutex");
         return -1;
     }
 
     return 0;
 }
 
-static void log(struct logger * l) {
-    time_t    time_stamp;
-    char      *time_stamp_str;
-    char      *start_time_str;
-    char      *end_time_str;
+int log_errors(int thread_id, uint64_t lost) {
+    struct thread_log *tl;
+
+    tl = &thread_logs[thread_id];
+    if (pthread_mutex_lock(&tl->lock) != 0) {
+        perror("locking thread log mutex");
+        return -1;
+    }
+
+    tl->errors += lost;
+
+    if (pthread_mutex_unlock(&tl->lock) != 0) {
+        perror("unlocking thread log mutex");
+        return -1;
+    }
+
+    return 0;
+}
+
+int log_interval(bool measured) {
+    static struct histogram request; // the interval's, from every thread.
+    static struct histogram ack;
+    static struct histogram connect;
+    struct thread_log *tl;
+    uint64_t requests;
+    uint64_t connects;
+    uint64_t payload_bytes;
+    uint64_t zerocopy_sends;
+    uint64_t zerocopy_copied;
+    uint64_t errors;
+    uint64_t end_ns;
+    int result;
+
+    memset(&request, 0, sizeof(struct histogram));
+    memset(&ack, 0, sizeof(struct histogram));
+    memset(&connect, 0, sizeof(struct histogram));
+    requests = 0;
+    connects = 0;
+    payload_bytes = 0;
+    zerocopy_sends = 0;
+    zerocopy_copied = 0;
+    errors = 0;
+    end_ns = now_ns();
+    for (int i = 0; i < n_thread_logs; i++) {
+        tl = &thread_logs[i];
+        if (pthread_mutex_lock(&tl->lock) != 0) {
+            perror("locking thread log mutex");
+            return -1;
+        }
+        histogram_merge(&request, &tl->request);
+        histogram_merge(&ack, &tl->ack);
+        histogram_merge(&connect, &tl->connect);
+        requests += tl->requests;
+        connects += tl->connects;
+        payload_bytes += tl->payload_bytes;
+        zerocopy_sends += tl->zerocopy_sends;
+        zerocopy_copied += tl->zerocopy_copied;
+        errors += tl->errors;
+        memset(&tl->request, 0, sizeof(struct histogram));
+        memset(&tl->ack, 0, sizeof(struct histogram));
+        memset(&tl->connect, 0, sizeof(struct histogram));
+        tl->requests = 0;
+        tl->connects = 0;
+        tl->payload_bytes = 0;
+        tl->zerocopy_sends = 0;
+        tl->zerocopy_copied = 0;
+        tl->errors = 0;
+        if (pthread_mutex_unlock(&tl->lock) != 0) {
+            perror("unlocking thread log mutex");
+            return -1;
+        }
+    }
+    collected = true;
+
+    result = 0;
+    if (measured) {
+        histogram_merge(&latency, &request);
+        histogram_merge(&ack_latency, &ack);
+        histogram_merge(&connect_latency, &connect);
+        run_requests += requests;
+        run_connects += connects;
+        run_payload_bytes += payload_bytes;
+        run_zerocopy_sends += zerocopy_sends;
+        run_zerocopy_copied += zerocopy_copied;
+        run_errors += errors;
+        measured_ns += end_ns - interval_start_ns;
+        if (hdr_log_write(&hdr_log, "request", &request, interval_start_ns, end_ns) == -1
+            || hdr_log_write(&hdr_log, "ack", &ack, interval_start_ns, end_ns) == -1
+            || hdr_log_write(&hdr_log, "connect", &connect, interval_start_ns, end_ns) == -1) {
+            result = -1;
+        }
+    }
+    interval_start_ns = end_ns;
+
+    return result;
+}
+
+static int log_row(struct thread_log *tl, const struct logger *l) {
+    char start_buf[TIME_STR_SIZE];
+    char end_buf[TIME_STR_SIZE];
+    const char *time_stamp_str;
+    const char *start_time_str;
+    const char *end_time_str;
+    int len;
+
+    if (tl->rows_len + LOG_ROW_MAX > LOG_BUFFER_SIZE && flush_rows(tl) == -1) {
+        return -1;
+    }
+
+    time_stamp_str = time_str(tl, time(NULL), NULL);
+    start_time_str = time_str(tl, l->start_time, start_buf);
+    end_time_str = time_str(tl, l->end_time, end_buf);
+    len = snprintf(tl->rows + tl->rows_len, LOG_BUFFER_SIZE - tl->rows_len,
+                   "%s, %d, %"PRIu32", %"PRIu32", %s, %s, %lf\n", time_stamp_str, l->thread_id, l->data_size,
+                   l->server_resp, start_time_str, end_time_str, l->elapsed_time_granular);
+    if (len > 0 && (size_t) len < LOG_BUFFER_SIZE - tl->rows_len) {
+        tl->rows_len += (size_t) len;
+    }
+
+    return 0;
+}
+
+static const char *time_str(struct thread_log *tl, time_t t, char *buf) {
+    if (t == 0) {
+        return "NULL";
+    }
+    if (buf == NULL || t == tl->stamp_time) {
+        if (t != tl->stamp_time && ctime_r(&t, tl->stamp) != NULL) {
+            tl->stamp[strcspn(tl->stamp, "\n")] = '\0';
+            tl->stamp_time = t;
+        }
+        return tl->stamp;
+    }
+
+    if (ctime_r(&t, buf) == NULL) {
+        return "NULL";
+    }
+    buf[strcspn(buf, "\n")] = '\0';
+
+    return buf;
+}
 
-    // NOLINTBEGIN(concurrency-mt-unsafe): Mutex being used
-    time_stamp = time(NULL);
-    time_stamp_str = ctime(&time_stamp);
-    *(time_stamp_str+ strlen(time_stamp_str) - 1) = '\0';
-    start_time_str = (l->start_time == 0) ? "NULL\0" : ctime(&l->start_time);
-    *(start_time_str + strlen(start_time_str) - 1) = '\0';
-    end_time_str = (l->end_time == 0) ? "NULL\0" : ctime(&l->end_time);
-    *(end_time_str + strlen(end_time_str) - 1) = '\0';
-    // NOLINTEND(concurrency-mt-unsafe)
+static int flush_rows(struct thread_log *tl) {
+    int cancel_state;
+    int result;
 
-    (void) fprintf(log_file, "%s, %d, %"PRIu32", %"PRIu32", %s, %s, %lf\n", time_stamp_str, l->thread_id, l->data_size, l->server_resp, start_time_str, end_time_str, l->elapsed_time_granular);
+    if (tl->rows_len == 0) {
+        return 0;
+    }
+
+    // writing may be a cancellation point; a thread must not be cancelled holding the lock.
+    (void) pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+    result = 0;
+    if (pthread_mutex_lock(&log_lock) != 0) {
+        perror("locking log mutex");
+        result = -1;
+    } else {
+        if (fwrite(tl->rows, 1, tl->rows_len, log_file) < tl->rows_len) {
+            perror("writing log file");
+            result = -1;
+        }
+        if (pthread_mutex_unlock(&log_lock) != 0) {
+            perror("unlocking log mutex");
+            result = -1;
+        }
+    }
+    (void) pthread_setcancelstate(cancel_state, NULL);
+    tl->rows_len = 0;
+
+    return result;
+}
+
+static int close_thread_logs(void) {
+    int ret = 0;
+
+    for (int i = 0; i < n_thread_logs; i++) {
+        if (flush_rows(&thread_logs[i]) == -1) {
+            ret = -1;
+        }
+        if (pthread_mutex_destroy(&thread_logs[i].lock) != 0) {
+            perror("destroying thread log mutex");
+            ret = -1;
+        }
+        free(thread_logs[i].rows);
+    }
+    free(thread_logs);
+    thread_logs = NULL;
+    n_thread_logs = 0;
+
+    return ret;
+}
+
+static void format_label(const struct state * s, const char * phase) {
+    int len;
+
+    len = snprintf(run_label, sizeof(run_label),
+                   "protocol=%u pipeline=%u send=%s nodelay=%s quickack=%s echo=%s checksum=%s keepalive=%u/%u"
+                   " threads=%u connections=%u rate=%.0f arrival=%s warmup=%u transmit=%s sizes=%s think=%s",
+                   s->protocol_version, s->pipeline_depth, (s->send_writev) ? "writev" : "write",
+                   (s->tcp_nodelay) ? "on" : "off", (s->tcp_quickack) ? "on" : "off", (s->echo) ? "on" : "off",
+                   (s->checksum) ? "on" : "off", s->pool_size, s->conn_messages, s->thread_count,
+                   s->connections, s->rate, (s->rate > 0) ? ((s->poisson) ? "poisson" : "fixed") : "closed",
+                   s->warmup_sec, transmit_name(s->transmit), s->sizes_spec, s->think_spec);
+    if (phase != NULL && len > 0 && (size_t) len < sizeof(run_label)) {
+        (void) snprintf(run_label + len, sizeof(run_label) - (size_t) len, " phase=%s", phase);
+    }
+}
+
+static void reset_run(void) {
+    memset(&latency, 0, sizeof(struct histogram));
+    memset(&ack_latency, 0, sizeof(struct histogram));
+    memset(&connect_latency, 0, sizeof(struct histogram));
+    run_requests = 0;
+    run_connects = 0;
+    run_payload_bytes = 0;
+    run_zerocopy_sends = 0;
+    run_zerocopy_copied = 0;
+    run_errors = 0;
+    measured_ns = 0;
+}
+
+static int report_latency(void) {
+    FILE * latency_file;
+
+    if (latency.count == 0) {
+        return 0;
+    }
+
+    (void) fprintf(stdout, "Latency, %s\n", run_label);
+    histogram_print(&latency, "    request", stdout);
+    if (ack_latency.count > 0) {
+        histogram_print(&ack_latency, "    send to ack", stdout);
+    }
+    if (connect_latency.count > 0) {
+        histogram_print(&connect_latency, "    connect", stdout);
+    }
+    (void) fprintf(stdout, "    %" PRIu64 " requests and %" PRIu64 " connections in %.1fs, %.1f requests/s\n",
+                   run_requests, run_connects, (double) measured_ns / NS_PER_SEC,
+                   (measured_ns > 0) ? (double) run_requests * NS_PER_SEC / (double) measured_ns : 0);
+    (void) fprintf(stdout, "    %.1f MiB of payload, %.1f MiB/s, %.0f bytes a request on average\n",
+                   (double) run_payload_bytes / MIB,
+                   (measured_ns > 0) ? (double) run_payload_bytes / MIB * NS_PER_SEC / (double) measured_ns : 0,
+                   (double) run_payload_bytes / (double) run_requests);
+    if (run_zerocopy_sends > 0) {
+        (void) fprintf(stdout, "    %" PRIu64 " zerocopy sends completed, %" PRIu64 " of them copied by the kernel\n",
+                       run_zerocopy_sends, run_zerocopy_copied);
+    }
+    if (run_errors > 0) {
+        (void) fprintf(stdout, "    %" PRIu64 " requests lost with connections the server dropped\n", run_errors);
+    }
+    print_percentiles();
+
+    if (open_file(&latency_file, LATENCY_FILE_NAME, LATENCY_OPEN_MODE) == -1) {
+        return -1;
+    }
+
+    if (ftell(latency_file) == 0) { // new file; write the header.
+        (void) fprintf(latency_file, "run,requests,mean (us),p50 (us),p90 (us),p99 (us),max (us)\n");
+    }
+    (void) fprintf(latency_file, "%s,%" PRIu64 ",%lf,%lf,%lf,%lf,%lf\n", run_label, latency.count,
+                   (double)latency.sum / (double)latency.count / NS_PER_US,
+                   (double)histogram_percentile(&latency, 50) / NS_PER_US,
+                   (double)histogram_percentile(&latency, 90) / NS_PER_US,
+                   (double)histogram_percentile(&latency, 99) / NS_PER_US,
+                   (double)latency.max / NS_PER_US);
+
+    return fclose(latency_file);
+}
+
+static void print_percentiles(void) {
+    static const uint32_t percentiles[] = {5000, 7500, 9000, 9500, 9900, 9990, 9999, 10000}; // hundredths.
+    double percentile;
+
+    (void) fprintf(stdout, "    %10s %16s %16s %16s\n", "percentile", "request (us)", "send to ack (us)",
+                   "connect (us)");
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+        percentile = (double) percentiles[i] / 100;
+        (void) fprintf(stdout, "    %10.3f %16.1f %16.1f %16.1f\n", percentile,
+                       (double) histogram_percentile(&latency, percentile) / NS_PER_US,
+                       (double) histogram_percentile(&ack_latency, percentile) / NS_PER_US,
+                       (double) histogram_percentile(&connect_latency, percentile) / NS_PER_US);
+    }
 }
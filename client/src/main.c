@@ -13,6 +13,24 @@
 
 #define DEFAULT_CONT_PORT "5000"
 #define DEFAULT_SERVER_PORT "5000"
+#define DEFAULT_ARRIVAL "fixed"
+#define DEFAULT_TRANSMIT "copy"
+#define DEFAULT_SIZES "fixed"
+#define DEFAULT_THINK "none"
+
+static const uint16_t default_protocol = 1; // not #defined so pointer can be used
+static const uint16_t default_pipeline = 1;
+static const uint16_t default_pool = 0;
+static const uint16_t default_conn_messages = 0;
+static const uint16_t default_threads = 0;
+static const uint16_t default_connections = 0;
+static const uint16_t default_warmup = 0;
+static const uint16_t default_max_duration = 0;
+static const bool default_writev = false;
+static const bool default_nodelay = false;
+static const bool default_quickack = false;
+static const bool default_echo = false;
+static const bool default_checksum = false;
 
 /**
  * application_settings
@@ -29,6 +47,27 @@ struct application_settings
     struct dc_setting_string *controller_port;
     struct dc_setting_string *data;
     struct dc_setting_uint16 *duration_sec;
+    struct dc_setting_uint16 *warmup_sec;
+    struct dc_setting_uint16 *protocol;
+    struct dc_setting_uint16 *pipeline;
+    struct dc_setting_uint16 *keepalive;
+    struct dc_setting_uint16 *conn_messages;
+    struct dc_setting_uint16 *threads;
+    struct dc_setting_uint16 *connections;
+    struct dc_setting_string *rate;
+    struct dc_setting_string *arrival;
+    struct dc_setting_string *transmit;
+    struct dc_setting_string *sizes;
+    struct dc_setting_string *think;
+    struct dc_setting_string *scenario;
+    struct dc_setting_string *slo;
+    struct dc_setting_string *precision;
+    struct dc_setting_uint16 *max_duration_sec;
+    struct dc_setting_bool   *writev;
+    struct dc_setting_bool   *nodelay;
+    struct dc_setting_bool   *quickack;
+    struct dc_setting_bool   *echo;
+    struct dc_setting_bool   *checksum;
 };
 
 /**
@@ -119,6 +158,27 @@ static struct dc_application_settings *create_settings(const struct dc_env *env,
     settings->controller_port         = dc_setting_string_create(env, err);
     settings->data                    = dc_setting_string_create(env, err);
     settings->duration_sec            = dc_setting_uint16_create(env, err);
+    settings->warmup_sec              = dc_setting_uint16_create(env, err);
+    settings->protocol                = dc_setting_uint16_create(env, err);
+    settings->pipeline                = dc_setting_uint16_create(env, err);
+    settings->keepalive               = dc_setting_uint16_create(env, err);
+    settings->conn_messages           = dc_setting_uint16_create(env, err);
+    settings->threads                 = dc_setting_uint16_create(env, err);
+    settings->connections             = dc_setting_uint16_create(env, err);
+    settings->rate                    = dc_setting_string_create(env, err);
+    settings->arrival                 = dc_setting_string_create(env, err);
+    settings->transmit                = dc_setting_string_create(env, err);
+    settings->sizes                   = dc_setting_string_create(env, err);
+    settings->think                   = dc_setting_string_create(env, err);
+    settings->scenario                = dc_setting_string_create(env, err);
+    settings->slo                     = dc_setting_string_create(env, err);
+    settings->precision               = dc_setting_string_create(env, err);
+    settings->max_duration_sec        = dc_setting_uint16_create(env, err);
+    settings->writev                  = dc_setting_bool_create(env, err);
+    settings->nodelay                 = dc_setting_bool_create(env, err);
+    settings->quickack                = dc_setting_bool_create(env, err);
+    settings->echo                    = dc_setting_bool_create(env, err);
+    settings->checksum                = dc_setting_bool_create(env, err);
 
     struct options opts[] = {
             {(struct dc_setting *) settings->opts.parent.config_path,
@@ -190,14 +250,224 @@ static struct dc_application_settings *create_settings(const struct dc_env *env,
                         dc_uint16_from_string,
                         "duration",
                         dc_uint16_from_config,
-                        0}
+                        0},
+            {(struct dc_setting *) settings->warmup_sec,
+                    dc_options_set_uint16,
+                    "warmup",
+                    required_argument,
+                    'W',
+                    "WARMUP",
+                    dc_uint16_from_string,
+                    "warmup",
+                    dc_uint16_from_config,
+                    &default_warmup},
+            {(struct dc_setting *) settings->protocol,
+                    dc_options_set_uint16,
+                    "protocol",
+                    required_argument,
+                    'r',
+                    "PROTOCOL",
+                    dc_uint16_from_string,
+                    "protocol",
+                    dc_uint16_from_config,
+                    &default_protocol},
+            {(struct dc_setting *) settings->pipeline,
+                    dc_options_set_uint16,
+                    "pipeline",
+                    required_argument,
+                    'w',
+                    "PIPELINE",
+                    dc_uint16_from_string,
+                    "pipeline",
+                    dc_uint16_from_config,
+                    &default_pipeline},
+            {(struct dc_setting *) settings->keepalive,
+                    dc_options_set_uint16,
+                    "keepalive",
+                    required_argument,
+                    'k',
+                    "KEEPALIVE",
+                    dc_uint16_from_string,
+                    "keepalive",
+                    dc_uint16_from_config,
+                    &default_pool},
+            {(struct dc_setting *) settings->conn_messages,
+                    dc_options_set_uint16,
+                    "messages",
+                    required_argument,
+                    'm',
+                    "MESSAGES",
+                    dc_uint16_from_string,
+                    "messages",
+                    dc_uint16_from_config,
+                    &default_conn_messages},
+            {(struct dc_setting *) settings->threads,
+                    dc_options_set_uint16,
+                    "threads",
+                    required_argument,
+                    'T',
+                    "THREADS",
+                    dc_uint16_from_string,
+                    "threads",
+                    dc_uint16_from_config,
+                    &default_threads},
+            {(struct dc_setting *) settings->connections,
+                    dc_options_set_uint16,
+                    "connections",
+                    required_argument,
+                    'N',
+                    "CONNECTIONS",
+                    dc_uint16_from_string,
+                    "connections",
+                    dc_uint16_from_config,
+                    &default_connections},
+            {(struct dc_setting *) settings->rate,
+                    dc_options_set_string,
+                    "rate",
+                    required_argument,
+                    'R',
+                    "RATE",
+                    dc_string_from_string,
+                    "rate",
+                    dc_string_from_config,
+                    NULL},
+            {(struct dc_setting *) settings->arrival,
+                    dc_options_set_string,
+                    "arrival",
+                    required_argument,
+                    'a',
+                    "ARRIVAL",
+                    dc_string_from_string,
+                    "arrival",
+                    dc_string_from_config,
+                    DEFAULT_ARRIVAL},
+            {(struct dc_setting *) settings->transmit,
+                    dc_options_set_string,
+                    "transmit",
+                    required_argument,
+                    'x',
+                    "TRANSMIT",
+                    dc_string_from_string,
+                    "transmit",
+                    dc_string_from_config,
+                    DEFAULT_TRANSMIT},
+            {(struct dc_setting *) settings->sizes,
+                    dc_options_set_string,
+                    "sizes",
+                    required_argument,
+                    'D',
+                    "SIZES",
+                    dc_string_from_string,
+                    "sizes",
+                    dc_string_from_config,
+                    DEFAULT_SIZES},
+            {(struct dc_setting *) settings->think,
+                    dc_options_set_string,
+                    "think",
+                    required_argument,
+                    'I',
+                    "THINK",
+                    dc_string_from_string,
+                    "think",
+                    dc_string_from_config,
+                    DEFAULT_THINK},
+            {(struct dc_setting *) settings->scenario,
+                    dc_options_set_string,
+                    "scenario",
+                    required_argument,
+                    'S',
+                    "SCENARIO",
+                    dc_string_from_string,
+                    "scenario",
+                    dc_string_from_config,
+                    NULL},
+            {(struct dc_setting *) settings->slo,
+                    dc_options_set_string,
+                    "slo",
+                    required_argument,
+                    'L',
+                    "SLO",
+                    dc_string_from_string,
+                    "slo",
+                    dc_string_from_config,
+                    NULL},
+            {(struct dc_setting *) settings->precision,
+                    dc_options_set_string,
+                    "precision",
+                    required_argument,
+                    'E',
+                    "PRECISION",
+                    dc_string_from_string,
+                    "precision",
+                    dc_string_from_config,
+                    NULL},
+            {(struct dc_setting *) settings->max_duration_sec,
+                    dc_options_set_uint16,
+                    "max_duration",
+                    required_argument,
+                    'M',
+                    "MAX_DURATION",
+                    dc_uint16_from_string,
+                    "max_duration",
+                    dc_uint16_from_config,
+                    &default_max_duration},
+            {(struct dc_setting *) settings->writev,
+                    dc_options_set_bool,
+                    "writev",
+                    no_argument,
+                    'v',
+                    "WRITEV",
+                    dc_flag_from_string,
+                    "writev",
+                    dc_flag_from_config,
+                    &default_writev},
+            {(struct dc_setting *) settings->nodelay,
+                    dc_options_set_bool,
+                    "nodelay",
+                    no_argument,
+                    'n',
+                    "NODELAY",
+                    dc_flag_from_string,
+                    "nodelay",
+                    dc_flag_from_config,
+                    &default_nodelay},
+            {(struct dc_setting *) settings->quickack,
+                    dc_options_set_bool,
+                    "quickack",
+                    no_argument,
+                    'q',
+                    "QUICKACK",
+                    dc_flag_from_string,
+                    "quickack",
+                    dc_flag_from_config,
+                    &default_quickack},
+            {(struct dc_setting *) settings->echo,
+                    dc_options_set_bool,
+                    "echo",
+                    no_argument,
+                    'e',
+                    "ECHO",
+                    dc_flag_from_string,
+                    "echo",
+                    dc_flag_from_config,
+                    &default_echo},
+            {(struct dc_setting *) settings->checksum,
+                    dc_options_set_bool,
+                    "checksum",
+                    no_argument,
+                    'C',
+                    "CHECKSUM",
+                    dc_flag_from_string,
+                    "checksum",
+                    dc_flag_from_config,
+                    &default_checksum}
     };
 
     settings->opts.opts_count = (sizeof(opts) / sizeof(struct options)) + 1;
     settings->opts.opts_size  = sizeof(struct options);
     settings->opts.opts       = dc_calloc(env, err, settings->opts.opts_count, settings->opts.opts_size);
     dc_memcpy(env, settings->opts.opts, opts, sizeof(opts));
-    settings->opts.flags      = "s:c:p:P:d:t:";
+    settings->opts.flags      = "s:c:p:P:d:t:W:r:w:k:m:T:N:R:a:x:D:I:S:L:E:M:vnqeC";
     settings->opts.env_prefix = "CLIENT_";
 
     return (struct dc_application_settings *) settings;
@@ -221,6 +491,27 @@ static int run(const struct dc_env *env, struct dc_error *err, struct dc_applica
     params.controller_port = dc_setting_string_get(env, app_settings->controller_port);
     params.data_file_name = dc_setting_string_get(env, app_settings->data);
     params.wait_period_sec = dc_setting_uint16_get(env, app_settings->duration_sec);
+    params.warmup_sec = dc_setting_uint16_get(env, app_settings->warmup_sec);
+    params.protocol_version = dc_setting_uint16_get(env, app_settings->protocol);
+    params.pipeline_depth = dc_setting_uint16_get(env, app_settings->pipeline);
+    params.pool_size = dc_setting_uint16_get(env, app_settings->keepalive);
+    params.conn_messages = dc_setting_uint16_get(env, app_settings->conn_messages);
+    params.thread_count = dc_setting_uint16_get(env, app_settings->threads);
+    params.connections = dc_setting_uint16_get(env, app_settings->connections);
+    params.rate = dc_setting_string_get(env, app_settings->rate);
+    params.arrival = dc_setting_string_get(env, app_settings->arrival);
+    params.transmit = dc_setting_string_get(env, app_settings->transmit);
+    params.sizes = dc_setting_string_get(env, app_settings->sizes);
+    params.think = dc_setting_string_get(env, app_settings->think);
+    params.scenario_file_name = dc_setting_string_get(env, app_settings->scenario);
+    params.slo = dc_setting_string_get(env, app_settings->slo);
+    params.precision = dc_setting_string_get(env, app_settings->precision);
+    params.max_duration_sec = dc_setting_uint16_get(env, app_settings->max_duration_sec);
+    params.send_writev = dc_setting_bool_get(env, app_settings->writev);
+    params.tcp_nodelay = dc_setting_bool_get(env, app_settings->nodelay);
+    params.tcp_quickack = dc_setting_bool_get(env, app_settings->quickack);
+    params.echo = dc_setting_bool_get(env, app_settings->echo);
+    params.checksum = dc_setting_bool_get(env, app_settings->checksum);
 
     init_result = init_state(&params, &s, err, env);
     if (init_result != -1)
@@ -1,16 +1,30 @@
 #include "run.h"
+#include "../../protocol.h"
 
+#include <converge.h>
+#include <log.h>
 #include <thread.h>
 #include <util.h>
 
+#include <inttypes.h>
 #include <poll.h>
 #include <unistd.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define START 1
 #define STOP 2
+#define SCENARIO 3
+#define SEARCH 4
+#define STEP 5
 #define POLL_TIMEOUT_MSECS 500
+#define INTERVAL_MSECS 1000
+#define MAX_SCENARIO_SIZE (1024 * 1024) // the largest scenario taken from the controller.
+#define SEARCH_FILE_NAME "saturation.csv" // truncated; one search's steps.
+#define SEARCH_START_RATE ((double) 1000) // requests per second of the first step of a search, without -R.
+#define MILLI ((double) 1000) // the controller sends the rate of a step in thousandths of a request per second.
+#define DURATION_BATCHES 10 // batches of early stopping in the duration, the shortest a run measures for.
 
 enum states {ERROR = -1, SUCCESS = 0, END = 1};
 
@@ -48,7 +62,8 @@ static int run_standalone(struct state * s, struct dc_error * err, struct dc_env
  * @param s pointer to the state object.
  * @param err pointer to the dc_error struct.
  * @param env pointer to the dc_env struct.
- * @return 1 if STOP is received, 0 if START is received. -1 and set errno on failure.
+ * @return 1 if STOP is received, or a scenario or a search is stopped, 0 if START is received or a scenario has run.
+ * -1 and set errno on failure.
  */
 static int handle_controller(struct pollfd *pfd, struct state * s, struct dc_error * err, struct dc_env * env);
 
@@ -64,10 +79,94 @@ static int handle_controller(struct pollfd *pfd, struct state * s, struct dc_err
  */
 int read_data(struct state * s, struct dc_error * err, struct dc_env * env);
 
+/**
+ * read_scenario
+ * <p>
+ * reads the index of this client and the scenario from the controller, in that order, and takes the scenario's phases
+ * for this client.
+ * </p>
+ * @param s pointer to the state structure.
+ * @return 0 on success. -1 on failure.
+ */
+static int read_scenario(struct state * s);
+
+/**
+ * run_scenario
+ * <p>
+ * run the phases of the scenario one after another. each phase starts the threads afresh with its settings and ends
+ * with them stopped; its results are reported on their own, as a run's are, unless it is not measured.
+ * </p>
+ * @param s pointer to the state structure.
+ * @param err pointer to the dc_error struct.
+ * @param env pointer to to the dc_env struct.
+ * @return 0 once every phase has run, 1 if the controller stopped the run first. -1 and set errno on failure.
+ */
+static int run_scenario(struct state * s, struct dc_error * err, struct dc_env * env);
+
+/**
+ * run_search
+ * <p>
+ * search for the highest rate the server sustains within the latency objective, a step of the duration at a time,
+ * each after the warm-up. every step is written to the saturation file as a point of the latency against throughput
+ * curve, and the highest throughput sustained is printed at the end.
+ * </p>
+ * @param s pointer to the state structure.
+ * @param err pointer to the dc_error struct.
+ * @param env pointer to to the dc_env struct.
+ * @return 0 once the search is over. -1 and set errno on failure.
+ */
+static int run_search(struct state * s, struct dc_error * err, struct dc_env * env);
+
+/**
+ * follow_search
+ * <p>
+ * run the steps of the controller's search as it sends them, each followed by what it measured, until the controller
+ * stops the run. the controller judges the steps of all its clients together.
+ * </p>
+ * @param s pointer to the state structure.
+ * @param err pointer to the dc_error struct.
+ * @param env pointer to to the dc_env struct.
+ * @return 1 once the controller stops the run. -1 and set errno on failure.
+ */
+static int follow_search(struct state * s, struct dc_error * err, struct dc_env * env);
+
+/**
+ * run_step
+ * <p>
+ * run one step of a search: the options at a rate, as a phase of its own.
+ * </p>
+ * @param s pointer to the state structure.
+ * @param rate the requests per second of this client.
+ * @param index the number of the step, from 1.
+ * @param duration_sec the seconds measured.
+ * @param warmup_sec the seconds of load before them.
+ * @param result where to store what the step measured.
+ * @param err pointer to the dc_error struct.
+ * @param env pointer to to the dc_env struct.
+ * @return 0 once the step is over, 1 if the controller stopped the run. -1 and set errno on failure.
+ */
+static int run_step(struct state * s, double rate, unsigned int index, uint16_t duration_sec, uint16_t warmup_sec,
+                    struct search_result * result, struct dc_error * err, struct dc_env * env);
+
+/**
+ * wait_phase
+ * <p>
+ * display progress while waiting out a phase, ending an interval of the results every second, as wait_duration does;
+ * the intervals of the warm-up are dropped. in controller mode, a stop from the controller ends the phase early.
+ * </p>
+ * @param s pointer to the state structure.
+ * @param phase the phase.
+ * @param warmup_sec the seconds of the phase, before its duration, that are not measured.
+ * @return 0 once the phase is over, 1 if the controller stopped the run. -1 and set errno on failure.
+ */
+static int wait_phase(struct state * s, const struct scenario_phase * phase, uint16_t warmup_sec);
+
 /**
 * wait_duration
 * <p>
-* print test start and display progress while waiting a duration.
+* print test start and display progress while waiting out the warm-up and the duration. every second ends an interval
+* of the results, so the thread results are merged as the run goes; the warm-up's intervals are dropped. with a
+* precision, the run goes on past the duration until its results converge, or until the maximum duration.
 * </p>
 * @param s the program state struct.
 * @param err pointer to a dc_err struct.
@@ -140,6 +239,12 @@ static int run_controller(struct state * s, struct dc_error * err, struct dc_env
 static int run_standalone(struct state * s, struct dc_error * err, struct dc_env * env) {
     struct sigaction sa;
     set_signal_handling(&sa);
+    if (s->scenario.count > 0) {
+        return (run_scenario(s, err, env) == ERROR) ? ERROR : SUCCESS;
+    }
+    if (s->search) {
+        return run_search(s, err, env);
+    }
     if (start_threads(s, err, env) == -1) return ERROR;
     wait_duration(s, err, env);
     return SUCCESS;
@@ -164,6 +269,16 @@ static int handle_controller(struct pollfd *pfd, struct state * s, struct dc_err
             return SUCCESS;
         case STOP:
             return END;
+        case SCENARIO:
+            if (read_data(s, err, env) == -1 || read_scenario(s) == -1) {
+                return ERROR;
+            }
+            return run_scenario(s, err, env);
+        case SEARCH:
+            if (read_data(s, err, env) == -1) {
+                return ERROR;
+            }
+            return follow_search(s, err, env);
         default:
             (void) fprintf(stderr, "unknown command %d received from controller\n", command);
             return ERROR;
@@ -196,15 +311,233 @@ int read_data(struct state * s, struct dc_error * err, struct dc_env * env) {
     return SUCCESS;
 }
 
+static int read_scenario(struct state * s) {
+    uint16_t client;
+    uint32_t size;
+    char *text;
+    int result;
+
+    if (read_fully(s->controller_fd, &client, sizeof(client)) == -1) return ERROR;
+    s->seed = seed_random(s->seed + ntohs(client)); // clients started at once on hosts alike still differ.
+    if (read_fully(s->controller_fd, &size, sizeof(size)) == -1) return ERROR;
+    size = ntohl(size);
+    if (size > MAX_SCENARIO_SIZE) {
+        (void) fprintf(stderr, "scenario from controller larger than %d bytes\n", MAX_SCENARIO_SIZE);
+        return ERROR;
+    }
+
+    text = malloc(size + 1);
+    if (text == NULL) return ERROR;
+    result = read_fully(s->controller_fd, text, size);
+    text[size] = '\0';
+    if (result != -1) {
+        result = init_scenario(s, text, ntohs(client));
+    }
+    free(text);
+
+    return result;
+}
+
+static int run_scenario(struct state * s, struct dc_error * err, struct dc_env * env) {
+    const struct scenario_phase *phase;
+    int result;
+
+    (void) fprintf(stdout, "Starting %" PRIu64 " second scenario of %zu phases with 1 client\n",
+                   scenario_duration(&s->scenario), s->scenario.count);
+    result = SUCCESS;
+    for (size_t i = 0; result == SUCCESS && i < s->scenario.count && !sig_quit; i++) {
+        phase = &s->scenario.phases[i];
+        if (apply_phase(s, phase) == -1 || log_phase(s, phase->name) == -1) return ERROR;
+        if (start_threads(s, err, env) == -1) return ERROR;
+        result = wait_phase(s, phase, 0);
+        if (stop_threads(err, env) == -1) {
+            result = ERROR;
+        }
+    }
+
+    return result;
+}
+
+static int run_search(struct state * s, struct dc_error * err, struct dc_env * env) {
+    struct search search;
+    struct search_step step;
+    struct search_result result;
+    FILE *csv;
+    bool more;
+    int ret;
+
+    if (open_file(&csv, SEARCH_FILE_NAME, "w") == -1) return ERROR;
+    search_init(&search, &s->slo, (s->rate > 0) ? s->rate : SEARCH_START_RATE);
+    (void) fprintf(stdout, "Starting saturation search for %s with 1 client, in %d second steps\n", s->slo.spec,
+                   s->wait_period_sec);
+
+    ret = SUCCESS;
+    more = true;
+    while (ret == SUCCESS && more && !sig_quit) {
+        ret = run_step(s, search.rate, search.steps + 1, s->wait_period_sec, s->warmup_sec, &result, err, env);
+        if (ret == SUCCESS && !sig_quit) { // a step cut short is not judged.
+            search_judge(&search, &result, &step);
+            search_write_step(&search, &step, csv);
+            more = search_next(&search, &step);
+        }
+    }
+    if (log_phase(s, NULL) == -1) { // the last step, so that the search's outcome comes after it.
+        ret = ERROR;
+    }
+    if (search.steps > 0) {
+        search_print(&search, stdout);
+    }
+
+    if (fclose(csv) == EOF) {
+        perror("closing saturation file");
+        ret = ERROR;
+    }
+
+    return ret;
+}
+
+static int follow_search(struct state * s, struct dc_error * err, struct dc_env * env) {
+    uint8_t buf[SEARCH_RESULT_SIZE];
+    struct search_result result;
+    uint16_t command;
+    uint16_t duration_sec;
+    uint16_t warmup_sec;
+    int ret;
+
+    ret = SUCCESS;
+    for (unsigned int index = 1; ret == SUCCESS; index++) {
+        if (read_fully(s->controller_fd, &command, sizeof(command)) == -1) return ERROR;
+        command = ntohs(command);
+        if (command == STOP) {
+            return END;
+        }
+        if (command != STEP) {
+            (void) fprintf(stderr, "unexpected command %d received from controller during a search\n", command);
+            return ERROR;
+        }
+
+        if (read_fully(s->controller_fd, buf, sizeof(uint64_t)) == -1) return ERROR;
+        if (read_fully(s->controller_fd, &duration_sec, sizeof(duration_sec)) == -1) return ERROR;
+        if (read_fully(s->controller_fd, &warmup_sec, sizeof(warmup_sec)) == -1) return ERROR;
+        if (protocol_get_u64(buf) == 0 || ntohs(duration_sec) == 0) {
+            (void) fprintf(stderr, "search step from controller without a rate or a duration\n");
+            return ERROR;
+        }
+
+        ret = run_step(s, (double) protocol_get_u64(buf) / MILLI, index, ntohs(duration_sec), ntohs(warmup_sec),
+                       &result, err, env);
+        if (ret == SUCCESS) {
+            search_result_encode(&result, buf);
+            if (write_fully(s->controller_fd, buf, sizeof(buf)) == -1) {
+                ret = ERROR;
+            }
+        }
+    }
+
+    return ret;
+}
+
+static int run_step(struct state * s, double rate, unsigned int index, uint16_t duration_sec, uint16_t warmup_sec,
+                    struct search_result * result, struct dc_error * err, struct dc_env * env) {
+    struct scenario_phase phase;
+    int ret;
+
+    memset(&phase, 0, sizeof(struct scenario_phase));
+    (void) snprintf(phase.name, sizeof(phase.name), "search.%u", index);
+    phase.duration_sec = duration_sec;
+    phase.measured = true;
+    phase.set = SCENARIO_RATE;
+    phase.rate = rate;
+
+    if (apply_phase(s, &phase) == -1 || log_phase(s, phase.name) == -1) return ERROR;
+    if (start_threads(s, err, env) == -1) return ERROR;
+    ret = wait_phase(s, &phase, warmup_sec);
+    if (stop_threads(err, env) == -1) {
+        ret = ERROR;
+    }
+    log_result(result);
+
+    return ret;
+}
+
+static int wait_phase(struct state * s, const struct scenario_phase * phase, uint16_t warmup_sec) {
+    struct pollfd fds[1];
+    uint16_t command;
+    int result;
+
+    fds[0].fd = (s->standalone) ? -1 : s->controller_fd; // poll skips a negative descriptor, and only waits.
+    fds[0].events = POLLIN;
+    (void) fprintf(stdout, "Phase %s, %" PRIu32 " seconds%s", phase->name, phase->duration_sec,
+                   (phase->measured) ? "" : " not measured");
+    if (warmup_sec > 0) {
+        (void) fprintf(stdout, " after a %u second warm-up", warmup_sec);
+    }
+    result = SUCCESS;
+    for (uint32_t i = 0; result == SUCCESS && i < warmup_sec + phase->duration_sec && !sig_quit; i++) {
+        (void) fprintf(stdout, (phase->measured && i >= warmup_sec) ? "." : "-");
+        (void) fflush(stdout);
+        fds[0].revents = 0;
+        if (poll(fds, 1, INTERVAL_MSECS) > 0) { // the controller only speaks mid-phase to stop it.
+            if (read_fully(s->controller_fd, &command, sizeof(command)) == -1) {
+                result = ERROR;
+            } else if (ntohs(command) == STOP) {
+                result = END;
+            } else {
+                (void) fprintf(stderr, "unexpected command %d received from controller during a phase\n",
+                               ntohs(command));
+                result = ERROR;
+            }
+        }
+        if (log_interval(phase->measured && i >= warmup_sec) == -1) {
+            perror("recording interval");
+        }
+    }
+    (void) fprintf(stdout, "done\n");
+
+    return result;
+}
+
 static void wait_duration(struct state * s, struct dc_error * err, struct dc_env * env) {
-    (void) fprintf(stdout, "Starting %d second load test with 1 client", s->wait_period_sec);
-    for (int i = 0; i < s->wait_period_sec && !sig_quit; i++) {
-        (void) fprintf(stdout, ".");
+    struct converge converge;
+    struct search_result run;
+    bool converged;
+    int duration;
+
+    duration = s->wait_period_sec;
+    if (s->precision > 0) {
+        duration = s->max_duration_sec;
+        converge_init(&converge, s->precision, (s->wait_period_sec > DURATION_BATCHES)
+                                               ? (uint16_t) (s->wait_period_sec / DURATION_BATCHES) : 1);
+        (void) fprintf(stdout, "Starting load test of %d to %d seconds with 1 client, until its results are known to"
+                               " within %g%%", s->wait_period_sec, duration, s->precision * 100);
+    } else {
+        (void) fprintf(stdout, "Starting %d second load test with 1 client", s->wait_period_sec);
+    }
+    if (s->warmup_sec > 0) {
+        (void) fprintf(stdout, " after a %d second warm-up", s->warmup_sec);
+    }
+    converged = false;
+    for (int i = 0; i < s->warmup_sec + duration && !sig_quit && !converged; i++) {
+        (void) fprintf(stdout, (i < s->warmup_sec) ? "-" : ".");
         (void)fflush(stdout);
         // NOLINTNEXTLINE(concurrency-mt-unsafe) : No threads here
         sleep(1);
+        if (log_interval(i >= s->warmup_sec) == -1) { // one interval a second; the warm-up's are dropped.
+            perror("recording interval");
+        }
+        if (s->precision > 0 && i >= s->warmup_sec) {
+            log_result(&run);
+            if (converge_add(&converge, &run) == -1) {
+                perror("estimating convergence");
+            }
+            converged = i + 1 - s->warmup_sec >= s->wait_period_sec && converge_done(&converge);
+        }
     }
     (void) fprintf(stdout, "done\n");
+    if (s->precision > 0) {
+        converge_print(&converge, stdout);
+        converge_free(&converge);
+    }
 }
 
 static void set_signal_handling(struct sigaction *sa)
@@ -0,0 +1,143 @@
+#include "schedule.h"
+#include "../../core/include/duration.h"
+
+#include <util.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NS_PER_SEC ((double) 1000000000)
+#define THINK_MAX_NS (3600 * NS_PER_SEC) // longer than any think time meant; keeps the sums in range.
+
+/**
+ * draw_uniform
+ * <p>
+ * draw a number uniformly from [0, 1).
+ * </p>
+ * @param rng the generator.
+ * @return the number.
+ */
+static double draw_uniform(uint64_t *rng);
+
+/**
+ * schedule_gap
+ * <p>
+ * draw the time from one request to the next.
+ * </p>
+ * @param sched the schedule.
+ * @return the time in nanoseconds.
+ */
+static double schedule_gap(struct schedule *sched);
+
+/**
+ * parse_time
+ * <p>
+ * parse a think time: a duration as duration_parse takes it, up to THINK_MAX_NS.
+ * </p>
+ * @param dst where to store the time, in nanoseconds.
+ * @param buff the string, which must hold the time and nothing else.
+ * @return 0 on success. -1 if the string is not a time.
+ */
+static int parse_time(double *dst, const char *buff);
+
+void schedule_init(struct schedule *sched, double rate, bool poisson, uint64_t seed) {
+    memset(sched, 0, sizeof(struct schedule));
+    sched->interval_ns = NS_PER_SEC / rate;
+    sched->poisson = poisson;
+    sched->rng = seed_random(seed);
+}
+
+void schedule_start(struct schedule *sched, uint64_t now) {
+    sched->start_ns = now;
+    sched->elapsed_ns = draw_uniform(&sched->rng) * sched->interval_ns;
+    sched->next_ns = sched->start_ns + (uint64_t) sched->elapsed_ns;
+}
+
+bool schedule_due(const struct schedule *sched, uint64_t now) {
+    return sched->next_ns != 0 && sched->next_ns <= now;
+}
+
+uint64_t schedule_take(struct schedule *sched) {
+    uint64_t due;
+
+    due = sched->next_ns;
+    sched->elapsed_ns += schedule_gap(sched);
+    sched->next_ns = sched->start_ns + (uint64_t) sched->elapsed_ns;
+
+    return due;
+}
+
+static double draw_uniform(uint64_t *rng) {
+    return ldexp((double) (next_random(rng) >> 11U), -53); // the top 53 bits fill a double.
+}
+
+static double schedule_gap(struct schedule *sched) {
+    if (!sched->poisson) {
+        return sched->interval_ns;
+    }
+
+    return -log1p(-draw_uniform(&sched->rng)) * sched->interval_ns; // exponential, with the interval as its mean.
+}
+
+int think_parse(struct think *dst, const char *spec) {
+    char buf[64]; // NOLINT(readability-magic-numbers)
+    char *save;
+    char *kind;
+    char *first;
+    char *second;
+
+    memset(dst, 0, sizeof(struct think));
+    if (strcmp(spec, "none") == 0) {
+        return 0;
+    }
+    if (strlen(spec) >= sizeof(buf)) {
+        return -1;
+    }
+    strcpy(buf, spec); // NOLINT(clang-analyzer-security.insecureAPI.strcpy): length checked
+
+    kind = strtok_r(buf, ":", &save);
+    first = strtok_r(NULL, ":", &save);
+    second = strtok_r(NULL, ":", &save);
+    if (kind == NULL || first == NULL || strtok_r(NULL, ":", &save) != NULL || parse_time(&dst->min_ns, first) == -1) {
+        return -1;
+    }
+    dst->max_ns = dst->min_ns;
+    if (strcmp(kind, "fixed") == 0 && second == NULL) {
+        dst->kind = THINK_FIXED;
+    } else if (strcmp(kind, "exp") == 0 && second == NULL) {
+        dst->kind = THINK_EXP;
+    } else if (strcmp(kind, "uniform") == 0 && second != NULL && parse_time(&dst->max_ns, second) == 0
+               && dst->max_ns >= dst->min_ns) {
+        dst->kind = THINK_UNIFORM;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+uint64_t think_draw(const struct think *think, uint64_t *rng) {
+    switch (think->kind) {
+        case THINK_FIXED:
+            return (uint64_t) think->min_ns;
+        case THINK_UNIFORM:
+            return (uint64_t) (think->min_ns + draw_uniform(rng) * (think->max_ns - think->min_ns));
+        case THINK_EXP:
+            return (uint64_t) fmin(-log1p(-draw_uniform(rng)) * think->min_ns, THINK_MAX_NS);
+        case THINK_NONE:
+        default:
+            return 0;
+    }
+}
+
+static int parse_time(double *dst, const char *buff) {
+    double ns;
+
+    if (duration_parse(&ns, buff) == -1 || ns > THINK_MAX_NS) {
+        return -1;
+    }
+    *dst = ns;
+
+    return 0;
+}
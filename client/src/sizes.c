@@ -0,0 +1,534 @@
+#include "sizes.h"
+#include "../../core/include/crc32c.h"
+#include "../../protocol.h"
+
+#include <util.h>
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIZES_BINS 128 // classes a continuous distribution is cut into.
+#define SIZES_MAX_CLASSES 4096 // most sizes a histogram file may hold.
+#define SIZES_MAX_BYTES PROTOCOL_MAX_LENGTH // the largest size; servers close connections sending more.
+#define SIZES_LOGNORMAL_SPAN 4 // standard deviations either side of the median the classes cover.
+#define SIZES_EXACT_SUM 1024 // widest zipf class whose weight is summed size by size, rather than integrated.
+#define SIZES_HALF ((double) 1 / 2) // a size's share of the zipf integral runs half a byte either side of it.
+#define SIZES_ZIPF_ONE ((double) 1 / 1000000000) // how near 1 an exponent is taken as 1.
+#define SIZES_LINE_SIZE 256
+
+/**
+ * weighted_size
+ * <p>
+ * a size and its weight, as a distribution is built.
+ * </p>
+ */
+struct weighted_size {
+    uint64_t size;
+    double weight;
+};
+
+/**
+ * parse_size
+ * <p>
+ * parse a size: bytes, optionally suffixed with K, M or G for powers of 1024.
+ * </p>
+ * @param dst where to store the size.
+ * @param buff the string, which must hold the size and nothing else.
+ * @return 0 on success. -1 if the string is not a size of at most SIZES_MAX_BYTES.
+ */
+static int parse_size(uint64_t *dst, const char *buff);
+
+/**
+ * parse_number
+ * <p>
+ * parse a decimal number of at least 0.
+ * </p>
+ * @param dst where to store the number.
+ * @param buff the string, which must hold the number and nothing else.
+ * @return 0 on success. -1 if the string is not such a number.
+ */
+static int parse_number(double *dst, const char *buff);
+
+/**
+ * build_uniform
+ * <p>
+ * cut a uniform distribution into classes of equal width.
+ * </p>
+ * @param sizes where to store the classes, SIZES_BINS of room.
+ * @param min the smallest size.
+ * @param max the largest size, at least min.
+ * @return the number of classes.
+ */
+static size_t build_uniform(struct weighted_size *sizes, uint64_t min, uint64_t max);
+
+/**
+ * build_lognormal
+ * <p>
+ * cut a log-normal distribution into geometrically spaced classes; the first and last take the tails beyond them.
+ * </p>
+ * @param sizes where to store the classes, SIZES_BINS of room.
+ * @param median the median size, at least 1.
+ * @param sigma the standard deviation of the logarithm of the size.
+ * @return the number of classes.
+ */
+static size_t build_lognormal(struct weighted_size *sizes, double median, double sigma);
+
+/**
+ * build_zipf
+ * <p>
+ * cut a zipf distribution into geometrically spaced classes, so that the small sizes, which carry most of the
+ * weight, keep classes of their own.
+ * </p>
+ * @param sizes where to store the classes, SIZES_BINS of room.
+ * @param min the smallest size, at least 1.
+ * @param max the largest size, at least min.
+ * @param s the exponent.
+ * @return the number of classes.
+ */
+static size_t build_zipf(struct weighted_size *sizes, uint64_t min, uint64_t max, double s);
+
+/**
+ * read_histogram
+ * <p>
+ * read an empirical histogram file.
+ * </p>
+ * @param sizes where to store the sizes, SIZES_MAX_CLASSES of room.
+ * @param file_name the name of the file.
+ * @param count where to store the number of sizes.
+ * @return 0 on success. -1 on failure, described on stderr.
+ */
+static int read_histogram(struct weighted_size *sizes, const char *file_name, size_t *count);
+
+/**
+ * compare_sizes
+ * <p>
+ * order weighted sizes by size, for qsort.
+ * </p>
+ * @param a a weighted size.
+ * @param b a weighted size.
+ * @return less than, equal to or greater than 0 as a is smaller than, the same as or larger than b.
+ */
+static int compare_sizes(const void *a, const void *b);
+
+/**
+ * build_alias
+ * <p>
+ * turn weighted sizes into the classes and alias table of a distribution, with Vose's method: sizes are sorted and
+ * merged, and sizes without weight dropped.
+ * </p>
+ * @param dist the distribution.
+ * @param sizes the weighted sizes; sorted in place.
+ * @param count the number of sizes.
+ * @return 0 on success. -1 on failure, described on stderr, with nothing left allocated.
+ */
+static int build_alias(struct size_dist *dist, struct weighted_size *sizes, size_t count);
+
+int size_dist_parse(struct size_dist *dist, const char *spec) {
+    struct weighted_size *sizes;
+    char buf[SIZES_LINE_SIZE];
+    const char *fields[4];
+    char *save;
+    size_t nfields;
+    size_t count;
+    uint64_t min;
+    uint64_t max;
+    double median;
+    double shape;
+    int result;
+
+    memset(dist, 0, sizeof(struct size_dist));
+    if (strncmp(spec, "file:", 5) == 0) { // the path may hold colons.
+        fields[0] = "file";
+        nfields = 1;
+    } else {
+        if (strlen(spec) >= sizeof(buf)) {
+            return -1;
+        }
+        strcpy(buf, spec); // NOLINT(clang-analyzer-security.insecureAPI.strcpy): length checked
+        nfields = 0;
+        for (char *field = strtok_r(buf, ":", &save); field != NULL; field = strtok_r(NULL, ":", &save)) {
+            if (nfields == sizeof(fields) / sizeof(fields[0])) {
+                nfields++; // too many for any distribution.
+                break;
+            }
+            fields[nfields++] = field;
+        }
+        if (nfields == 0) {
+            return -1;
+        }
+    }
+
+    sizes = calloc(SIZES_MAX_CLASSES, sizeof(struct weighted_size));
+    if (sizes == NULL) {
+        perror("malloc for sizes");
+        return -1;
+    }
+
+    result = -1;
+    count = 0;
+    if (strcmp(fields[0], "fixed") == 0 && nfields == 1) { // the whole payload, once it is known.
+        sizes[0].weight = 1;
+        count = 1;
+        result = build_alias(dist, sizes, count);
+        dist->whole = result == 0;
+    } else if (strcmp(fields[0], "fixed") == 0 && nfields == 2 && parse_size(&min, fields[1]) == 0) {
+        sizes[0].size = min;
+        sizes[0].weight = 1;
+        count = 1;
+        result = build_alias(dist, sizes, count);
+    } else if (strcmp(fields[0], "uniform") == 0 && nfields == 3 && parse_size(&min, fields[1]) == 0
+               && parse_size(&max, fields[2]) == 0 && min <= max) {
+        count = build_uniform(sizes, min, max);
+        result = build_alias(dist, sizes, count);
+    } else if (strcmp(fields[0], "lognormal") == 0 && nfields == 3 && parse_size(&min, fields[1]) == 0 && min > 0
+               && parse_number(&shape, fields[2]) == 0) {
+        median = (double) min;
+        count = build_lognormal(sizes, median, shape);
+        result = build_alias(dist, sizes, count);
+    } else if (strcmp(fields[0], "zipf") == 0 && nfields == 4 && parse_size(&min, fields[1]) == 0 && min > 0
+               && parse_size(&max, fields[2]) == 0 && min <= max && parse_number(&shape, fields[3]) == 0) {
+        count = build_zipf(sizes, min, max, shape);
+        result = build_alias(dist, sizes, count);
+    } else if (strcmp(fields[0], "file") == 0 && read_histogram(sizes, spec + 5, &count) == 0) {
+        result = build_alias(dist, sizes, count);
+    }
+    free(sizes);
+
+    return result;
+}
+
+int size_dist_prepare(struct size_dist *dist, const char *data, off_t data_size, bool checksum) {
+    const char *payload;
+    uint64_t max;
+    uint64_t done;
+    uint32_t crc;
+
+    if (dist->whole) {
+        if ((uint64_t) data_size > SIZES_MAX_BYTES) {
+            errno = EFBIG;
+            return -1;
+        }
+        dist->classes[0].size = (uint64_t) data_size;
+    }
+
+    free(dist->payload); // the extension of an earlier payload.
+    dist->payload = NULL;
+    payload = data;
+    max = size_dist_max(dist);
+    if (max > (uint64_t) data_size) { // repeat the payload up to the largest class.
+        dist->payload = malloc((size_t) max);
+        if (dist->payload == NULL) {
+            return -1;
+        }
+        for (done = 0; data_size > 0 && done < max; done += (uint64_t) data_size) {
+            memcpy(dist->payload + done, data, (size_t) ((max - done < (uint64_t) data_size) ? max - done
+                                                                                             : (uint64_t) data_size));
+        }
+        for (done = 0; data_size == 0 && done < max; done++) { // nothing to repeat; any bytes will do.
+            dist->payload[done] = (char) ('a' + done % 26);
+        }
+        payload = dist->payload;
+    }
+
+    if (checksum) { // the classes are prefixes in ascending order; each CRC extends the last.
+        crc = 0;
+        done = 0;
+        for (uint32_t i = 0; i < dist->count; i++) {
+            crc = crc32c(crc, payload + done, (size_t) (dist->classes[i].size - done));
+            done = dist->classes[i].size;
+            dist->classes[i].crc = crc;
+        }
+    }
+
+    return 0;
+}
+
+const struct size_class *size_dist_draw(const struct size_dist *dist, uint64_t *rng) {
+    uint64_t r;
+    uint32_t i;
+
+    if (dist->count == 1) {
+        return &dist->classes[0];
+    }
+    r = next_random(rng);
+    i = (uint32_t) (((r >> 32U) * dist->count) >> 32U); // the top half picks a class, the bottom half keeps it.
+
+    return (ldexp((double) (uint32_t) r, -32) < dist->keep[i]) ? &dist->classes[i] : &dist->classes[dist->alias[i]];
+}
+
+uint64_t size_dist_max(const struct size_dist *dist) {
+    return dist->classes[dist->count - 1].size;
+}
+
+void size_dist_free(struct size_dist *dist) {
+    free(dist->classes);
+    free(dist->keep);
+    free(dist->alias);
+    free(dist->payload);
+    memset(dist, 0, sizeof(struct size_dist));
+}
+
+static int parse_size(uint64_t *dst, const char *buff) {
+    unsigned long long value;
+    unsigned int shift;
+    char *end;
+
+    if (*buff < '0' || *buff > '9') { // strtoull would take a sign.
+        return -1;
+    }
+    errno = 0;
+    value = strtoull(buff, &end, 10);
+    switch (*end) {
+        case 'K':
+        case 'k':
+            shift = 10;
+            end++;
+            break;
+        case 'M':
+        case 'm':
+            shift = 20;
+            end++;
+            break;
+        case 'G':
+        case 'g':
+            shift = 30;
+            end++;
+            break;
+        default:
+            shift = 0;
+            break;
+    }
+    if (end == buff || *end != '\0' || errno == ERANGE || value > (SIZES_MAX_BYTES >> shift)) {
+        return -1;
+    }
+    *dst = (uint64_t) value << shift;
+
+    return 0;
+}
+
+static int parse_number(double *dst, const char *buff) {
+    char *end;
+    double d;
+
+    errno = 0;
+    d = strtod(buff, &end);
+    if (end == buff || *end != '\0' || errno == ERANGE || !(d >= 0) || isinf(d)) { // also NaN.
+        return -1;
+    }
+    *dst = d;
+
+    return 0;
+}
+
+static size_t build_uniform(struct weighted_size *sizes, uint64_t min, uint64_t max) {
+    uint64_t span;
+    uint64_t lo;
+    uint64_t hi;
+    size_t count;
+
+    span = max - min + 1;
+    count = (span < SIZES_BINS) ? (size_t) span : SIZES_BINS;
+    for (size_t i = 0; i < count; i++) {
+        lo = min + span * i / count;
+        hi = min + span * (i + 1) / count; // exclusive.
+        sizes[i].size = lo + (hi - 1 - lo) / 2;
+        sizes[i].weight = (double) (hi - lo);
+    }
+
+    return count;
+}
+
+static size_t build_lognormal(struct weighted_size *sizes, double median, double sigma) {
+    double lo;
+    double hi;
+    double edge;
+    double next_edge;
+    double below;
+    double next_below;
+
+    lo = fmax(median * exp(-SIZES_LOGNORMAL_SPAN * sigma), 1);
+    hi = fmin(median * exp(SIZES_LOGNORMAL_SPAN * sigma), (double) SIZES_MAX_BYTES);
+    if (!(hi > lo)) { // no spread; every request the median.
+        sizes[0].size = (uint64_t) llround(fmin(median, (double) SIZES_MAX_BYTES));
+        sizes[0].weight = 1;
+        return 1;
+    }
+
+    below = 0; // the chance of a size below the class; the first class takes the lower tail.
+    for (size_t i = 0; i < SIZES_BINS; i++) {
+        edge = lo * pow(hi / lo, (double) i / SIZES_BINS);
+        next_edge = lo * pow(hi / lo, (double) (i + 1) / SIZES_BINS);
+        next_below = (i + 1 == SIZES_BINS) ? 1 : erfc(-log(next_edge / median) / (sigma * sqrt(2))) / 2;
+        sizes[i].size = (uint64_t) llround(sqrt(edge * next_edge));
+        sizes[i].weight = next_below - below;
+        below = next_below;
+    }
+
+    return SIZES_BINS;
+}
+
+static size_t build_zipf(struct weighted_size *sizes, uint64_t min, uint64_t max, double s) {
+    uint64_t lo;
+    uint64_t hi;
+    double ratio;
+    double weight;
+    size_t count;
+
+    ratio = (double) (max + 1) / (double) min;
+    count = 0;
+    lo = min;
+    for (size_t i = 1; i <= SIZES_BINS && lo <= max; i++) {
+        hi = (i == SIZES_BINS) ? max + 1 : (uint64_t) llround((double) min * pow(ratio, (double) i / SIZES_BINS));
+        if (hi <= lo) { // narrower than a byte; joins the next class.
+            continue;
+        }
+        if (hi - lo <= SIZES_EXACT_SUM) {
+            weight = 0;
+            for (uint64_t k = lo; k < hi; k++) {
+                weight += pow((double) k, -s);
+            }
+        } else if (fabs(s - 1) < SIZES_ZIPF_ONE) { // the sum, taken as the integral around each size.
+            weight = log(((double) hi - SIZES_HALF) / ((double) lo - SIZES_HALF));
+        } else {
+            weight = (pow((double) hi - SIZES_HALF, 1 - s) - pow((double) lo - SIZES_HALF, 1 - s)) / (1 - s);
+        }
+        sizes[count].size = (uint64_t) llround(sqrt((double) lo * (double) (hi - 1)));
+        sizes[count].weight = weight;
+        count++;
+        lo = hi;
+    }
+
+    return count;
+}
+
+static int read_histogram(struct weighted_size *sizes, const char *file_name, size_t *count) {
+    char line[SIZES_LINE_SIZE];
+    char *fields[2];
+    char *save;
+    FILE *file;
+    int line_number;
+    int result;
+
+    if (open_file(&file, file_name, "r") == -1) {
+        return -1;
+    }
+
+    *count = 0;
+    line_number = 0;
+    result = 0;
+    while (result == 0 && fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+        fields[0] = strtok_r(line, " \t,\r\n", &save);
+        if (fields[0] == NULL || fields[0][0] == '#') {
+            continue;
+        }
+        fields[1] = strtok_r(NULL, " \t,\r\n", &save);
+        if (*count == SIZES_MAX_CLASSES) {
+            (void) fprintf(stderr, "%s:%d: more than %d sizes\n", file_name, line_number, SIZES_MAX_CLASSES);
+            result = -1;
+        } else if (fields[1] == NULL || strtok_r(NULL, " \t,\r\n", &save) != NULL
+                   || parse_size(&sizes[*count].size, fields[0]) == -1
+                   || parse_number(&sizes[*count].weight, fields[1]) == -1) {
+            (void) fprintf(stderr, "%s:%d: expected a size and a weight\n", file_name, line_number);
+            result = -1;
+        } else {
+            (*count)++;
+        }
+    }
+    if (result == 0 && ferror(file)) {
+        perror("reading sizes file");
+        result = -1;
+    }
+    (void) fclose(file);
+
+    return result;
+}
+
+static int compare_sizes(const void *a, const void *b) {
+    const struct weighted_size *x;
+    const struct weighted_size *y;
+
+    x = a;
+    y = b;
+
+    return (x->size > y->size) - (x->size < y->size);
+}
+
+static int build_alias(struct size_dist *dist, struct weighted_size *sizes, size_t count) {
+    uint32_t *small;
+    uint32_t *large;
+    uint32_t n_small;
+    uint32_t n_large;
+    uint32_t s;
+    uint32_t l;
+    size_t merged;
+    double total;
+
+    qsort(sizes, count, sizeof(struct weighted_size), compare_sizes);
+    merged = 0;
+    total = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!(sizes[i].weight > 0)) {
+            continue;
+        }
+        if (merged > 0 && sizes[merged - 1].size == sizes[i].size) {
+            sizes[merged - 1].weight += sizes[i].weight;
+        } else {
+            sizes[merged++] = sizes[i];
+        }
+        total += sizes[i].weight;
+    }
+    if (merged == 0 || isinf(total)) {
+        (void) fprintf(stderr, "parsing sizes: no size has a weight\n");
+        return -1;
+    }
+
+    dist->classes = calloc(merged, sizeof(struct size_class));
+    dist->keep = calloc(merged, sizeof(double));
+    dist->alias = calloc(merged, sizeof(uint32_t));
+    small = calloc(merged, sizeof(uint32_t));
+    large = calloc(merged, sizeof(uint32_t));
+    if (dist->classes == NULL || dist->keep == NULL || dist->alias == NULL || small == NULL || large == NULL) {
+        perror("malloc for sizes");
+        free(small);
+        free(large);
+        size_dist_free(dist);
+        return -1;
+    }
+    dist->count = (uint32_t) merged;
+
+    // scale the weights to average 1; classes below 1 are topped up from classes above it.
+    n_small = 0;
+    n_large = 0;
+    for (uint32_t i = 0; i < dist->count; i++) {
+        dist->classes[i].size = sizes[i].size;
+        dist->keep[i] = sizes[i].weight * (double) dist->count / total;
+        dist->alias[i] = i;
+        if (dist->keep[i] < 1) {
+            small[n_small++] = i;
+        } else {
+            large[n_large++] = i;
+        }
+    }
+    while (n_small > 0 && n_large > 0) {
+        s = small[--n_small];
+        l = large[--n_large];
+        dist->alias[s] = l;
+        dist->keep[l] -= 1 - dist->keep[s];
+        if (dist->keep[l] < 1) {
+            small[n_small++] = l;
+        } else {
+            large[n_large++] = l;
+        }
+    }
+    while (n_small > 0) { // left over from rounding; as good as 1.
+        dist->keep[small[--n_small]] = 1;
+    }
+    free(small);
+    free(large);
+
+    return 0;
+}
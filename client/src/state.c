@@ -1,30 +1,41 @@
 #include "../include/state.h"
+#include "../../protocol.h"
+#include "../../core/include/histogram.h"
 
 #include <log.h>
 #include <thread.h>
 #include <util.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
-#define DATA_OPEN_MODE "r"
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0 // Linux only; elsewhere the pages are read in as the first requests touch them.
+#endif
+
+#define RATE_STR_SIZE 32 // a phase's rate, formatted to be parsed as -R is.
 
 /**
- * load_data
+ * map_data
  * <p>
- * allocates space for and reads a file.
+ * map a file read-only, once for every thread, with its pages read in up front so that the first requests do not
+ * fault them in. an empty file, which cannot be mapped, gets an empty allocation instead.
  * </p>
- * @param dst where to allocate and store data.
+ * @param dst where to store the mapping.
  * @param size_dst where to store the data size.
- * @param file_name name of the file to read.
- * @param mode mode to open the file in.
+ * @param mapped_dst where to store whether dst is a mapping, rather than an allocation.
+ * @param file_name name of the file to map.
  * @param env pointer to the dc_env struct.
  * @return 0 on success. -1 on failure and set errno.
  */
-static int load_data(char **dst, off_t *size_dst, const char *file_name, const char *mode, struct dc_env * env);
+static int map_data(char **dst, off_t *size_dst, bool *mapped_dst, const char *file_name, struct dc_env * env);
 
 /**
  * validate_params
@@ -38,26 +49,89 @@ static int load_data(char **dst, off_t *size_dst, const char *file_name, const c
  */
 static int validate_params(struct init_state_params * params, struct state * s, struct dc_env * env);
 
+/**
+ * parse_precision
+ * <p>
+ * parse the precision of early stopping: a percentage, optionally followed by %.
+ * </p>
+ * @param dst where to store the precision, as a share.
+ * @param buff the string, which must hold the percentage and nothing else.
+ * @return 0 on success. -1 if the string is not a percentage above 0 and below 100.
+ */
+static int parse_precision(double *dst, const char *buff);
+
+/**
+ * validate_load
+ * <p>
+ * validates the settings of the load, which a scenario phase may change, as validate_params does the rest.
+ * </p>
+ * @param params pointer to the init_state_params structure.
+ * @param s pointer to the state structure.
+ * @return 0 if valid, -1 if invalid.
+ */
+static int validate_load(const struct init_state_params * params, struct state * s);
+
+/**
+ * load_params
+ * <p>
+ * set the load settings of the state from validated params, parsing the rate, sizes and think times.
+ * </p>
+ * @param params pointer to the init_state_params structure.
+ * @param s pointer to the state structure.
+ * @return 0 on success. -1 on failure, described on stderr.
+ */
+static int load_params(const struct init_state_params * params, struct state * s);
+
 int init_state(struct init_state_params * params, struct state * s, struct dc_error * err, struct dc_env * env) {
     DC_TRACE(env);
+    char *scenario;
+    int result;
 
     memset(s, 0, sizeof(struct state));
+    s->data_fd = -1;
+    s->params = *params;
+    s->seed = seed_random(((uint64_t) getpid() << 32U) ^ now_ns()); // clients on one host start apart, as do runs.
 
-    if (params->wait_period_sec != 0) {
+    if (params->wait_period_sec != 0 || params->scenario_file_name != NULL) {
         (void) fprintf(stdout, "Running in standalone mode\n");
         s->wait_period_sec = params->wait_period_sec;
+        s->warmup_sec = params->warmup_sec;
         s->standalone = true;
+        s->search = params->slo != NULL;
+        s->max_duration_sec = params->max_duration_sec;
     } else {
         (void) fprintf(stdout, "Running in controller mode\n");
         s->standalone = false;
     }
 
     if (validate_params(params, s, env) == -1) return -1;
+    s->protocol_version = params->protocol_version;
+    s->pipeline_depth = params->pipeline_depth;
+    s->send_writev = params->send_writev;
+    s->tcp_nodelay = params->tcp_nodelay;
+    s->tcp_quickack = params->tcp_quickack;
+    s->echo = params->echo;
+    s->checksum = params->checksum;
+    s->conn_messages = params->conn_messages;
+    if (load_params(params, s) == -1) return -1;
 
     if (s->standalone) {
         s->server_ip = params->server_ip;
         if (parse_port(&s->server_port, params->server_port, 10) == -1) return -1;
-        if (load_data(&s->data, &s->data_size, params->data_file_name, DATA_OPEN_MODE, env) == -1) return -1;
+        if (map_data(&s->data, &s->data_size, &s->data_mapped, params->data_file_name, env) == -1) return -1;
+        if (s->transmit == TRANSMIT_SENDFILE) {
+            s->data_fd = open(params->data_file_name, O_RDONLY | O_CLOEXEC); // NOLINT(hicpp-signed-bitwise)
+            if (s->data_fd == -1) {
+                perror("opening data file for sendfile");
+                return -1;
+            }
+        }
+        if (params->scenario_file_name != NULL) {
+            if (scenario_read(&scenario, params->scenario_file_name) == -1) return -1;
+            result = init_scenario(s, scenario, 0); // on its own, the client runs the phases of client 0.
+            free(scenario);
+            if (result == -1) return -1;
+        }
     } else {
         s->controller_ip = params->controller_ip;
         if (parse_port(&s->controller_port, params->controller_port, 10) == -1) return -1;
@@ -65,7 +139,58 @@ int init_state(struct init_state_params * params, struct state * s, struct dc_er
         if (TCP_socket(&s->controller_fd) == -1) return -1;
         if (init_connection(s->controller_fd, &s->controller_addr) == -1) return -1;
     }
-    if (init_logger() == -1) return -1;
+    if (init_logger(s) == -1) return -1;
+
+    return 0;
+}
+
+int init_scenario(struct state * s, const char * text, uint16_t client) {
+    scenario_free(&s->scenario);
+    if (scenario_parse(&s->scenario, text, client) == -1) return -1;
+
+    for (size_t i = 0; i < s->scenario.count; i++) {
+        if (apply_phase(s, &s->scenario.phases[i]) == -1) {
+            scenario_free(&s->scenario);
+            (void) load_params(&s->params, s); // back to the options, which were valid.
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int apply_phase(struct state * s, const struct scenario_phase * phase) {
+    struct init_state_params params;
+    char rate[RATE_STR_SIZE];
+
+    params = s->params;
+    if (phase->set & SCENARIO_THREADS) {
+        params.thread_count = phase->threads;
+    }
+    if (phase->set & SCENARIO_CONNECTIONS) {
+        params.connections = phase->connections;
+    }
+    if (phase->set & SCENARIO_DEPTH) {
+        params.pipeline_depth = phase->depth;
+    }
+    if (phase->set & SCENARIO_RATE) {
+        (void) snprintf(rate, sizeof(rate), "%.17g", phase->rate);
+        params.rate = (phase->rate > 0) ? rate : NULL;
+    }
+    if (phase->set & SCENARIO_ARRIVAL) {
+        params.arrival = phase->arrival;
+    }
+    if (phase->set & SCENARIO_THINK) {
+        params.think = phase->think;
+    }
+    if (phase->set & SCENARIO_SIZES) {
+        params.sizes = phase->sizes;
+    }
+
+    if (validate_load(&params, s) == -1 || load_params(&params, s) == -1) {
+        (void) fprintf(stderr, "Phase %s of the scenario cannot run with these settings\n", phase->name);
+        return -1;
+    }
 
     return 0;
 }
@@ -92,6 +217,44 @@ static int validate_params(struct init_state_params * params, struct state * s,
         if (params->controller_ip != NULL) {
             (void) fprintf(stdout, "WARNING: Controller IP not used for standalone mode\n");
         }
+        if (params->scenario_file_name != NULL && params->wait_period_sec > 0) {
+            (void) fprintf(stdout, "WARNING: Duration not used with a scenario, whose phases have their own\n");
+        }
+        if (params->precision == NULL && params->max_duration_sec > 0) {
+            (void) fprintf(stdout, "WARNING: Maximum duration not used without -E, which runs past the duration\n");
+        }
+        if (params->scenario_file_name != NULL && params->warmup_sec > 0) {
+            (void) fprintf(stdout, "WARNING: Warm-up not used with a scenario; warm up in a phase with measure=off\n");
+        }
+        if (params->scenario_file_name != NULL && params->slo != NULL) {
+            (void) fprintf(stderr, "A scenario sets its own load, do not pass both -S and -L\n");
+            return -1;
+        }
+        if (params->slo != NULL && search_slo_parse(&s->slo, params->slo) == -1) {
+            (void) fprintf(stderr, "Latency objective must be pPERCENTILE:TIME[:ERRORS%%], TIME with a unit of ns, us,"
+                                   " ms or s, pass with -L\n");
+            return -1;
+        }
+        if (params->slo != NULL && params->connections == 0) {
+            (void) fprintf(stderr, "Saturation search offers a rate, which requires the event engine, pass -N\n");
+            return -1;
+        }
+        if (params->slo != NULL && strcmp(params->think, "none") != 0) {
+            (void) fprintf(stderr, "Saturation search offers a rate, which think time is not for, do not pass -I\n");
+            return -1;
+        }
+        if (params->precision != NULL && (params->scenario_file_name != NULL || params->slo != NULL)) {
+            (void) fprintf(stderr, "Phases and search steps have set durations, do not pass -E with -S or -L\n");
+            return -1;
+        }
+        if (params->precision != NULL && parse_precision(&s->precision, params->precision) == -1) {
+            (void) fprintf(stderr, "Precision must be a percentage above 0 and below 100, pass with -E\n");
+            return -1;
+        }
+        if (params->precision != NULL && params->max_duration_sec <= params->wait_period_sec) {
+            (void) fprintf(stderr, "Early stopping needs a maximum duration longer than the duration, pass with -M\n");
+            return -1;
+        }
         // controller port would go here, but has a default value if not passed
     } else {
         // errors
@@ -111,46 +274,194 @@ static int validate_params(struct init_state_params * params, struct state * s,
         if (params->data_file_name != NULL) {
             (void) fprintf(stdout, "WARNING: Data file overridden in controller mode\n");
         }
+        if (params->warmup_sec > 0) {
+            (void) fprintf(stdout, "WARNING: Warm-up not used in controller mode, which measures until told to stop\n");
+        }
+        if (params->scenario_file_name != NULL) {
+            (void) fprintf(stdout, "WARNING: Scenario file not used in controller mode, which runs the controller's\n");
+        }
+        if (params->slo != NULL) {
+            (void) fprintf(stdout, "WARNING: Latency objective not used in controller mode, which searches with the"
+                                   " controller's\n");
+        }
+        if (params->precision != NULL) {
+            (void) fprintf(stdout,
+                           "WARNING: Precision not used in controller mode, which measures until told to stop\n");
+        }
+
+        // errors
+        if (strcmp(params->transmit, "sendfile") == 0) {
+            (void) fprintf(stderr, "Sendfile requires a data file, which controller mode does not have\n");
+            return -1;
+        }
         // server port would go here, but has a default value if not passed
     }
 
+    if (validate_load(params, s) == -1) return -1;
+
+    // warnings
+    if (params->protocol_version == PROTOCOL_VERSION_1 && params->pipeline_depth > 1) {
+        (void) fprintf(stdout, "WARNING: Pipeline depth not used for protocol 1, which has one request in flight\n");
+    }
+    if (params->connections > 0 && params->pool_size > 0) {
+        (void) fprintf(stdout, "WARNING: Keep-alive pool not used by the event engine, which keeps connections open\n");
+    } else if (params->protocol_version == PROTOCOL_VERSION_2 && params->pool_size > 0) {
+        (void) fprintf(stdout, "WARNING: Keep-alive pool not used for protocol 2, which keeps its connection open\n");
+    }
+    if (s->transmit != TRANSMIT_COPY && params->send_writev) {
+        (void) fprintf(stdout, "WARNING: Send path not used with -x %s, which sends the payload apart\n",
+                       params->transmit);
+    } else if (params->connections > 0 && params->send_writev) {
+        (void) fprintf(stdout, "WARNING: Send path not used by the event engine, which sends each request at once\n");
+    }
+    if (params->rate == NULL && strcmp(params->arrival, "poisson") == 0) {
+        (void) fprintf(stdout, "WARNING: Arrival not used without -R, which sends requests as slots free\n");
+    }
+    if (params->pool_size == 0 && params->connections == 0 && params->conn_messages > 0) {
+        (void) fprintf(stdout,
+                       "WARNING: Messages per connection not used without -k or -N, which keep connections open\n");
+    }
+
     return 0;
 }
 
-static int load_data(char **dst, off_t *size_dst, const char *file_name, const char *mode, struct dc_env * env) {
-    DC_TRACE(env);
-    FILE * data_file;
-    struct stat data_info;
-    size_t nread;
-    int result;
+static int parse_precision(double *dst, const char *buff) {
+    char *end;
 
-    result = stat(file_name, &data_info);
-    if (result == -1) {
-        perror("stat on data file");
+    errno = 0;
+    *dst = strtod(buff, &end) / 100;
+    if (end == buff || (*end != '\0' && strcmp(end, "%") != 0) || errno != 0 || !(*dst > 0) || *dst >= 1) {
         return -1;
     }
 
-    *dst = malloc(data_info.st_size);
-    if (*dst == NULL) {
-        perror("malloc for data");
+    return 0;
+}
+
+static int validate_load(const struct init_state_params * params, struct state * s) {
+    // errors
+    if (params->protocol_version != PROTOCOL_VERSION_1 && params->protocol_version != PROTOCOL_VERSION_2) {
+        (void) fprintf(stderr, "Protocol must be %d or %d, pass with -r\n", PROTOCOL_VERSION_1, PROTOCOL_VERSION_2);
+        return -1;
+    }
+    if (params->pipeline_depth == 0) {
+        (void) fprintf(stderr, "Pipeline depth must be at least 1, pass with -w\n");
         return -1;
     }
+    if (params->echo && params->protocol_version != PROTOCOL_VERSION_2) {
+        (void) fprintf(stderr, "Echo mode requires protocol %d, pass with -r\n", PROTOCOL_VERSION_2);
+        return -1;
+    }
+    if (params->checksum && params->protocol_version != PROTOCOL_VERSION_2) {
+        (void) fprintf(stderr, "Checksums require protocol %d, pass with -r\n", PROTOCOL_VERSION_2);
+        return -1;
+    }
+    if (params->checksum && params->echo) {
+        (void) fprintf(stderr, "Echo mode verifies every byte already, do not pass both -e and -C\n");
+        return -1;
+    }
+    if (strcmp(params->arrival, "fixed") != 0 && strcmp(params->arrival, "poisson") != 0) {
+        (void) fprintf(stderr, "Arrival must be fixed or poisson, pass with -a\n");
+        return -1;
+    }
+    if (transmit_parse(&s->transmit, params->transmit) == -1) {
+        (void) fprintf(stderr, "Transmit mode must be copy, sendfile or zerocopy, pass with -x\n");
+        return -1;
+    }
+    if (params->rate != NULL && params->connections == 0) {
+        (void) fprintf(stderr, "Open loop requires the event engine, pass -N\n");
+        return -1;
+    }
+    if (strcmp(params->think, "none") != 0 && params->connections == 0) {
+        (void) fprintf(stderr, "Think time requires the event engine, pass -N\n");
+        return -1;
+    }
+    if (strcmp(params->think, "none") != 0 && params->rate != NULL) {
+        (void) fprintf(stderr, "Think time is for closed loop, which waits on replies, do not pass both -R and -I\n");
+        return -1;
+    }
+#if !defined(__linux__)
+    if (params->connections > 0) {
+        (void) fprintf(stderr, "The event engine requires epoll, which this platform lacks, do not pass -N\n");
+        return -1;
+    }
+    if (s->transmit != TRANSMIT_COPY) {
+        (void) fprintf(stderr, "Transmit mode %s is linux only, pass -x copy\n", params->transmit);
+        return -1;
+    }
+#endif
+#ifndef TCP_QUICKACK
+    if (params->tcp_quickack) {
+        (void) fprintf(stderr, "Quick ACK mode is not supported on this platform, do not pass -q\n");
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+static int load_params(const struct init_state_params * params, struct state * s) {
+    s->pipeline_depth = params->pipeline_depth;
+    s->pool_size = (params->protocol_version == PROTOCOL_VERSION_1 && params->connections == 0) ? params->pool_size : 0;
+    s->thread_count = params->thread_count;
+    s->connections = params->connections;
+    s->poisson = strcmp(params->arrival, "poisson") == 0;
+    s->rate = 0;
+    if (params->rate != NULL && parse_rate(&s->rate, params->rate) == -1) return -1;
+    size_dist_free(&s->sizes); // a phase before may have had its own.
+    if (size_dist_parse(&s->sizes, params->sizes) == -1) {
+        (void) fprintf(stderr, "Sizes must be fixed[:SIZE], uniform:MIN:MAX, lognormal:MEDIAN:SIGMA, zipf:MIN:MAX:S"
+                               " or file:PATH, pass with -D\n");
+        return -1;
+    }
+    s->sizes_spec = params->sizes;
+    if (think_parse(&s->think, params->think) == -1) {
+        (void) fprintf(stderr, "Think time must be none, fixed:TIME, uniform:MIN:MAX or exp:MEAN, each TIME with a unit"
+                               " of ns, us, ms or s, pass with -I\n");
+        return -1;
+    }
+    s->think_spec = params->think;
+
+    return 0;
+}
+
+static int map_data(char **dst, off_t *size_dst, bool *mapped_dst, const char *file_name, struct dc_env * env) {
+    DC_TRACE(env);
+    struct stat data_info;
+    void *data;
+    int fd;
+    int result;
 
-    if (open_file(&data_file, file_name, mode) == -1) return -1;
+    fd = open(file_name, O_RDONLY | O_CLOEXEC); // NOLINT(hicpp-signed-bitwise)
+    if (fd == -1) {
+        perror("opening data file");
+        return -1;
+    }
 
-    nread = fread(*dst, sizeof(char), data_info.st_size, data_file);
-    if (nread < (size_t)data_info.st_size) {
-        if (feof(data_file))
-            (void) fprintf(stderr, "reading data file: unexpected end of file\n");
-        else if (ferror(data_file)) {
-            perror("reading data file");
+    result = fstat(fd, &data_info);
+    if (result == -1) {
+        perror("stat on data file");
+    } else if (data_info.st_size == 0) {
+        *dst = malloc(1);
+        *size_dst = 0;
+        *mapped_dst = false;
+        if (*dst == NULL) {
+            perror("malloc for data");
+            result = -1;
+        }
+    } else {
+        data = mmap(NULL, (size_t) data_info.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0); // NOLINT
+        if (data == MAP_FAILED) {
+            perror("mapping data file");
+            result = -1;
+        } else {
+            *dst = data;
+            *size_dst = data_info.st_size;
+            *mapped_dst = true;
         }
-        result = -1;
     }
-    *size_dst = data_info.st_size;
-    
-    // close file regardless of result
-    if (fclose(data_file) == -1) {
+
+    // the mapping outlives the descriptor; close it regardless of result
+    if (close(fd) == -1) {
         perror("closing data file");
         result = -1;
     }
@@ -173,7 +484,20 @@ int destroy_state(struct state * s, struct dc_error * err, struct dc_env * env)
         }
     }
 
-    if (s->data) {
+    size_dist_free(&s->sizes);
+    scenario_free(&s->scenario);
+
+    if (s->data_fd != -1 && close(s->data_fd) == -1) {
+        perror("closing data file");
+        ret = -1;
+    }
+
+    if (s->data_mapped) {
+        if (munmap(s->data, (size_t) s->data_size) == -1) {
+            perror("unmapping data file");
+            ret = -1;
+        }
+    } else if (s->data) {
         free(s->data);
     }
 
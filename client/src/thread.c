@@ -1,13 +1,18 @@
 #include "thread.h"
+#include "../../core/include/crc32c.h"
 
 #include <handle.h>
+#include <log.h>
 #include <util.h>
 
+#include <inttypes.h>
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
-#include <string.h>
 #include <unistd.h>
 
+#define FD_HEADROOM 64 // file descriptors besides the event engine's: standard streams, logs, the controller.
+
 /**
  * get_processors
  * <p>
@@ -21,7 +26,7 @@ static int get_processors(int *dst);
 /**
  * create_threads
  * <p>
- * create n threads that are each passed their own copy of state.data and run handle from handle.h.
+ * create n threads that each send state.data, shared, and run handle from handle.h.
  * </p>
  * @param n number of threads to create.
  * @param s pointer to the state object holding the data.
@@ -38,10 +43,24 @@ static int n_processors; // number of system processors
 int start_threads(struct state * s, struct dc_error * err, struct dc_env * env) {
     DC_TRACE(env);
     int result;
+    int n;
+    rlim_t fd_needed;
+    rlim_t fd_limit;
 
     if (get_processors(&n_processors) == -1) return -1;
+    n = (s->thread_count > 0) ? s->thread_count : n_processors;
+
+    if (s->connections > 0) { // every connection of the event engine holds a descriptor, as does every epoll.
+        fd_needed = (rlim_t) n * (s->connections + 1U) + FD_HEADROOM;
+        if (raise_fd_limit(fd_needed, &fd_limit) == -1) return -1;
+        if (fd_limit < fd_needed) {
+            (void) fprintf(stdout, "WARNING: %d connections exceed the file descriptor limit of %ju\n",
+                           n * s->connections, (uintmax_t) fd_limit);
+        }
+    }
 
-    result = create_threads(n_processors, s, err, env);
+    if (open_thread_logs(n) == -1) return -1;
+    result = create_threads(n, s, err, env);
     if (result == -1) {
         stop_threads(err, env);
         return -1;
@@ -53,6 +72,22 @@ int start_threads(struct state * s, struct dc_error * err, struct dc_env * env)
 static int create_threads(int n, struct state * s, struct dc_error * err, struct dc_env * env) {
     DC_TRACE(env);
 
+    // every request sends a prefix of the one payload, so one pass covers every size class.
+    if (size_dist_prepare(&s->sizes, s->data, s->data_size, s->checksum) == -1) {
+        perror("preparing payload sizes");
+        return -1;
+    }
+    if (s->transmit == TRANSMIT_SENDFILE && size_dist_max(&s->sizes) > (uint64_t) s->data_size) {
+        (void) fprintf(stderr, "Sendfile cannot send sizes beyond the data file, pass a larger file with -d\n");
+        return -1;
+    }
+    if (s->checksum && s->sizes.count == 1) {
+        (void) fprintf(stdout, "Payload CRC32C %08x, computed with %s\n", s->sizes.classes[0].crc, crc32c_kernel());
+    } else if (s->checksum) {
+        (void) fprintf(stdout, "Payload CRC32C of %" PRIu32 " size classes computed with %s\n", s->sizes.count,
+                       crc32c_kernel());
+    }
+
     t_ids = malloc(n * sizeof(pthread_t));
     if (t_ids == NULL) {
         perror("malloc thread id array");
@@ -66,24 +101,41 @@ static int create_threads(int n, struct state * s, struct dc_error * err, struct
             return -1;
         }
 
-        h_args->data = calloc(s->data_size, sizeof(char));
-        if (h_args->data  == NULL) {
+        if (init_addr(&h_args->server_addr, s->server_ip, s->server_port) == -1) {
             free(h_args);
-            perror("calloc for data copy");
             return -1;
         }
-        strncpy(h_args->data , s->data, s->data_size);
 
-        if (init_addr(&h_args->server_addr, s->server_ip, s->server_port) == -1) {
-            free(h_args->data);
+        // every thread sends the one payload, which nothing writes, extended to the largest size if need be.
+        h_args->data = (s->sizes.payload != NULL) ? s->sizes.payload : s->data;
+        h_args->data_size = (off_t) size_dist_max(&s->sizes);
+        h_args->data_fd = s->data_fd; // shared too; sendfile takes its offset as an argument, not from the file.
+        h_args->transmit = s->transmit;
+        h_args->thread_id = i;
+        h_args->protocol_version = s->protocol_version;
+        h_args->pipeline_depth = s->pipeline_depth;
+        h_args->send_writev = s->send_writev;
+        h_args->tcp_nodelay = s->tcp_nodelay;
+        h_args->tcp_quickack = s->tcp_quickack;
+        h_args->echo = s->echo;
+        h_args->checksum = s->checksum;
+        h_args->sizes = &s->sizes;
+        h_args->schedule_seed = s->seed + (uint64_t) i; // seed_random spreads the seeds of the threads apart.
+        h_args->rng = seed_random(s->seed + (uint64_t) (n + i)); // apart from the seeds of the schedules.
+        h_args->conn_messages = s->conn_messages;
+        h_args->connections = s->connections;
+        h_args->rate = s->rate / n; // each thread keeps its own schedule, for its share of the rate.
+        h_args->poisson = s->poisson;
+        h_args->think = s->think;
+        h_args->pool.size = s->pool_size;
+        h_args->pool.fds = NULL;
+        h_args->pool.messages = NULL;
+        if (h_args->pool.size > 0 && open_pool(h_args) == -1) { // connect before the run, not during it.
             free(h_args);
             return -1;
         }
-
-        h_args->data_size = s->data_size;
-        h_args->thread_id = i;
         if(pthread_create(&t_ids[i], NULL, handle, (void *)h_args) != 0) {
-            free(h_args->data);
+            close_pool(&h_args->pool);
             free(h_args);
             return -1;
         }
@@ -0,0 +1,268 @@
+#include "transmit.h"
+#include "../../protocol.h"
+
+#include <handle.h>
+#include <log.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static const char *const transmit_names[] = {"copy", "sendfile", "zerocopy"}; // by mode.
+
+const char *transmit_name(enum transmit_mode mode) {
+    return transmit_names[mode];
+}
+
+int transmit_parse(enum transmit_mode *dst, const char *name) {
+    for (size_t i = 0; i < sizeof(transmit_names) / sizeof(transmit_names[0]); i++) {
+        if (strcmp(name, transmit_names[i]) == 0) {
+            *dst = (enum transmit_mode) i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+#if defined(__linux__)
+#include <linux/errqueue.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED 1
+#endif
+
+/**
+ * send_payload
+ * <p>
+ * send part of the payload from where it has got to, with sendfile or MSG_ZEROCOPY. a zerocopy send refused with
+ * ENOBUFS, the completions having filled the socket's option memory, reaps them and tries again, and is copied if
+ * that does not free enough.
+ * </p>
+ * @param sock the connection to the server.
+ * @param h_args the handle arguments.
+ * @param offset bytes of the payload sent.
+ * @param size the size of the payload of the request.
+ * @param flags flags for send, besides MSG_ZEROCOPY.
+ * @return the number of bytes sent. -1 and set errno on failure.
+ */
+static ssize_t send_payload(int sock, const struct handle_args *h_args, uint64_t offset, uint64_t size, int flags);
+
+int transmit_open(int sock, const struct handle_args *h_args) {
+    int on = 1;
+
+    if (h_args->transmit != TRANSMIT_ZEROCOPY) {
+        return 0;
+    }
+    if (setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == -1) {
+        perror("setting SO_ZEROCOPY");
+        return -1;
+    }
+
+    return 0;
+}
+
+ssize_t transmit_piece(int sock, const struct handle_args *h_args, const uint8_t *header, size_t header_size,
+                       uint64_t payload_size, const uint8_t *trailer, uint64_t sent, int flags) {
+    int more;
+
+    flags |= MSG_NOSIGNAL; // NOLINT(hicpp-signed-bitwise)
+    if (sent < header_size) {
+        more = (payload_size > 0 || trailer != NULL) ? MSG_MORE : 0;
+        return send(sock, header + sent, header_size - (size_t) sent, flags | more); // NOLINT(hicpp-signed-bitwise)
+    }
+    sent -= header_size;
+    if (sent < payload_size) {
+        more = (trailer != NULL) ? MSG_MORE : 0;
+        return send_payload(sock, h_args, sent, payload_size, flags | more); // NOLINT(hicpp-signed-bitwise)
+    }
+    sent -= payload_size;
+
+    return send(sock, trailer + sent, PROTOCOL_CHECKSUM_SIZE - (size_t) sent, flags);
+}
+
+int transmit_framed(int sock, const struct handle_args *h_args, const uint8_t *header, size_t header_size,
+                    uint64_t payload_size, const uint8_t *trailer) {
+    uint64_t request_size;
+    uint64_t sent;
+    ssize_t n;
+
+    request_size = header_size + payload_size + ((trailer != NULL) ? PROTOCOL_CHECKSUM_SIZE : 0);
+    if (transmit_cork(sock, h_args, true) == -1) {
+        return -1;
+    }
+    for (sent = 0; sent < request_size; sent += (uint64_t) n) {
+        n = transmit_piece(sock, h_args, header, header_size, payload_size, trailer, sent, 0);
+        if (n == -1 && errno == EINTR) {
+            n = 0;
+        } else if (n == -1) {
+            perror("transmit");
+            return -1;
+        }
+    }
+    if (transmit_cork(sock, h_args, false) == -1) {
+        return -1;
+    }
+
+    return transmit_reap(sock, h_args);
+}
+
+int transmit_cork(int sock, const struct handle_args *h_args, bool on) {
+    int cork;
+
+    if (h_args->transmit != TRANSMIT_SENDFILE || !h_args->checksum) {
+        return 0;
+    }
+    cork = on;
+    if (setsockopt(sock, IPPROTO_TCP, TCP_CORK, &cork, sizeof(cork)) == -1) {
+        perror("setting TCP_CORK");
+        return -1;
+    }
+
+    return 0;
+}
+
+int transmit_reap(int sock, const struct handle_args *h_args) {
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err))];
+    const struct sock_extended_err *ee;
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    uint64_t completed;
+    uint64_t copied;
+    uint32_t sends;
+    int cancel_state;
+    int result;
+
+    if (h_args->transmit != TRANSMIT_ZEROCOPY) {
+        return 0;
+    }
+
+    // recvmsg is a cancellation point, though it never blocks here; completions read are logged before the thread
+    // can be cancelled.
+    (void) pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancel_state);
+    completed = 0;
+    copied = 0;
+    for (;;) {
+        memset(&msg, 0, sizeof(struct msghdr));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) { // NOLINT(hicpp-signed-bitwise)
+            break;
+        }
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR) {
+                continue;
+            }
+            ee = (const struct sock_extended_err *) (void *) CMSG_DATA(cmsg);
+            if (ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            sends = ee->ee_data - ee->ee_info + 1; // the range of sends completed, counted from the first.
+            completed += sends;
+            if (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) { // NOLINT(hicpp-signed-bitwise)
+                copied += sends;
+            }
+        }
+    }
+    result = 0;
+    // NOLINTNEXTLINE(misc-redundant-expression): EAGAIN and EWOULDBLOCK may differ
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        perror("reading zerocopy completions");
+        result = -1;
+    }
+    if (completed > 0 && log_zerocopy(h_args->thread_id, completed, copied) == -1) {
+        result = -1;
+    }
+    (void) pthread_setcancelstate(cancel_state, NULL);
+
+    return result;
+}
+
+static ssize_t send_payload(int sock, const struct handle_args *h_args, uint64_t offset, uint64_t size, int flags) {
+    off_t file_offset;
+    ssize_t n;
+
+    if (h_args->transmit == TRANSMIT_SENDFILE) { // blocks, or not, as the socket does; flags do not apply.
+        file_offset = (off_t) offset;
+        n = sendfile(sock, h_args->data_fd, &file_offset, (size_t) (size - offset));
+        if (n == 0) { // the file shrank since it was mapped.
+            errno = ENODATA;
+            return -1;
+        }
+        return n;
+    }
+
+    n = send(sock, h_args->data + offset, (size_t) (size - offset),
+             flags | MSG_ZEROCOPY); // NOLINT(hicpp-signed-bitwise)
+    if (n == -1 && errno == ENOBUFS) {
+        if (transmit_reap(sock, h_args) == -1) {
+            return -1;
+        }
+        n = send(sock, h_args->data + offset, (size_t) (size - offset),
+                 flags | MSG_ZEROCOPY); // NOLINT(hicpp-signed-bitwise)
+    }
+    if (n == -1 && errno == ENOBUFS) {
+        n = send(sock, h_args->data + offset, (size_t) (size - offset), flags);
+    }
+
+    return n;
+}
+
+#else
+
+int transmit_open(int sock, const struct handle_args *h_args) {
+    (void) sock;
+    (void) h_args;
+    return 0;
+}
+
+ssize_t transmit_piece(int sock, const struct handle_args *h_args, const uint8_t *header, size_t header_size,
+                       uint64_t payload_size, const uint8_t *trailer, uint64_t sent, int flags) {
+    (void) sock;
+    (void) h_args;
+    (void) header;
+    (void) header_size;
+    (void) payload_size;
+    (void) trailer;
+    (void) sent;
+    (void) flags;
+    errno = ENOTSUP;
+    return -1;
+}
+
+int transmit_framed(int sock, const struct handle_args *h_args, const uint8_t *header, size_t header_size,
+                    uint64_t payload_size, const uint8_t *trailer) {
+    return (int) transmit_piece(sock, h_args, header, header_size, payload_size, trailer, 0, 0);
+}
+
+int transmit_cork(int sock, const struct handle_args *h_args, bool on) {
+    (void) sock;
+    (void) h_args;
+    (void) on;
+    return 0;
+}
+
+int transmit_reap(int sock, const struct handle_args *h_args) {
+    (void) sock;
+    (void) h_args;
+    return 0;
+}
+
+#endif
@@ -3,10 +3,13 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <limits.h>
+#include <math.h>
+#include <netinet/tcp.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <unistd.h>
 
 int write_fully(int fd, void * data, size_t size) {
@@ -25,6 +28,31 @@ int write_fully(int fd, void * data, size_t size) {
     return 0;
 }
 
+int writev_fully(int fd, struct iovec * iov, int iovcnt) {
+    ssize_t result;
+
+    while (iovcnt > 0) {
+        result = writev(fd, iov, iovcnt);
+        if (result == -1) {
+            perror("writing vector fully");
+            return -1;
+        }
+
+        // skip the buffers that were written, then the written part of the next one.
+        while (iovcnt > 0 && (size_t)result >= iov->iov_len) {
+            result -= (ssize_t)iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = ((char*)iov->iov_base)+result;
+            iov->iov_len -= result;
+        }
+    }
+
+    return 0;
+}
+
 int read_fully(int fd, void * data, size_t size) {
     ssize_t result;
     ssize_t nread = 0;
@@ -89,6 +117,53 @@ int TCP_socket(int *dst) {
     return 0;
 }
 
+int set_nodelay(int sock) {
+    int on = 1;
+
+    if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) == -1) {
+        perror("setting TCP_NODELAY");
+        return -1;
+    }
+
+    return 0;
+}
+
+int set_quickack(int sock) {
+#ifdef TCP_QUICKACK
+    int on = 1;
+
+    if (setsockopt(sock, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on)) == -1) {
+        perror("setting TCP_QUICKACK");
+        return -1;
+    }
+
+    return 0;
+#else
+    (void)sock;
+    errno = ENOPROTOOPT;
+    return -1;
+#endif
+}
+
+int raise_fd_limit(rlim_t needed, rlim_t *limit) {
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) == -1) {
+        perror("getting file descriptor limit");
+        return -1;
+    }
+    if (rl.rlim_cur < needed && rl.rlim_cur != RLIM_INFINITY) {
+        rl.rlim_cur = (rl.rlim_max == RLIM_INFINITY || rl.rlim_max > needed) ? needed : rl.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &rl) == -1) {
+            perror("raising file descriptor limit");
+            return -1;
+        }
+    }
+
+    *limit = rl.rlim_cur;
+    return 0;
+}
+
 int init_addr(struct sockaddr_in *dst, const char *ip, in_port_t port) {
     (*dst).sin_family = PF_INET;
     (*dst).sin_port = htons(port);
@@ -146,3 +221,61 @@ int parse_port(in_port_t *dst, const char *buff, int radix)
 
     return 0;
 }
+
+int parse_rate(double *dst, const char *buff)
+{
+    char *end;
+    double d;
+    const char *msg;
+
+    errno = 0;
+    d = strtod(buff, &end);
+
+    if(end == buff)
+    {
+        msg = "not a decimal number";
+    }
+    else if(*end != '\0')
+    {
+        msg = "extra characters at end of input";
+    }
+    else if(ERANGE == errno || isinf(d))
+    {
+        msg = "out of range of type double";
+    }
+    else if(!(d >= 0)) // also NaN.
+    {
+        msg = "less than 0";
+    }
+    else
+    {
+        msg = NULL;
+    }
+
+    if(msg)
+    {
+        (void) fprintf(stderr, "parsing rate: %s\n", msg);
+        return -1;
+    }
+
+    *dst = d;
+
+    return 0;
+}
+
+uint64_t seed_random(uint64_t seed) {
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27U)) * 0x94D049BB133111EBULL;
+    seed ^= seed >> 31U;
+
+    return (seed != 0) ? seed : 1; // xorshift must not start at 0.
+}
+
+uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12U;
+    *state ^= *state << 25U;
+    *state ^= *state >> 27U;
+
+    return *state * 0x2545F4914F6CDD1DULL;
+}
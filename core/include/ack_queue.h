@@ -0,0 +1,95 @@
+#ifndef SCALABLE_SERVER_ACK_QUEUE_H
+#define SCALABLE_SERVER_ACK_QUEUE_H
+
+#include "../../protocol.h"
+#include "syscall_stats.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The number of acks a queue holds; a full queue is flushed before the next ack is queued.
+ */
+#define ACK_QUEUE_CAPACITY 32
+
+/**
+ * ack_queue
+ * <p>
+ * Acks for one connection, waiting to be sent. Acks are encoded back to back, so that all of the acks completed on
+ * a connection in one event loop iteration go out in a single send instead of one send each.
+ * </p>
+ */
+struct ack_queue {
+    uint8_t buf[ACK_QUEUE_CAPACITY * PROTOCOL_MAX_HEADER_SIZE];
+    size_t  len; // Bytes queued.
+};
+
+/**
+ * ack_queue_push
+ * <p>
+ * Queue the ack to a request, in the version of the request. If the queue is full, flush it first, without raising
+ * SIGPIPE. A failure belongs to the one connection: the peer is gone, or it reads its acks too slowly to make room.
+ * </p>
+ * @param stats the stats object, may be NULL
+ * @param fd the connection the request arrived on
+ * @param queue the ack queue of the connection
+ * @param request the header of the request
+ * @param bytes the number of payload bytes received
+ * @return 0 on success, -1 and set errno on failure
+ */
+int ack_queue_push(struct syscall_stats *stats, int fd, struct ack_queue *queue,
+                   const struct protocol_header *request, uint64_t bytes);
+
+/**
+ * ack_queue_flush
+ * <p>
+ * Send the queued acks with one send. Whatever the socket does not take stays queued for the next flush.
+ * </p>
+ * @param stats the stats object, may be NULL
+ * @param fd the connection
+ * @param queue the ack queue of the connection
+ * @param flags flags for send, such as MSG_MORE when another flush is expected soon
+ * @return 0 on success, -1 and set errno on failure
+ */
+int ack_queue_flush(struct syscall_stats *stats, int fd, struct ack_queue *queue, int flags);
+
+/**
+ * ack_queue_pending
+ * <p>
+ * Check whether a queue holds acks which have not been sent.
+ * </p>
+ * @param queue the ack queue
+ * @return true if there are acks to flush
+ */
+static inline bool ack_queue_pending(const struct ack_queue *queue)
+{
+    return queue->len > 0;
+}
+
+/**
+ * ack_queue_full
+ * <p>
+ * Check whether a queue has no room for another ack without being flushed.
+ * </p>
+ * @param queue the ack queue
+ * @return true if the next push would have to flush first
+ */
+static inline bool ack_queue_full(const struct ack_queue *queue)
+{
+    return queue->len + PROTOCOL_MAX_HEADER_SIZE > sizeof(queue->buf);
+}
+
+/**
+ * ack_queue_clear
+ * <p>
+ * Drop the queued acks, such as when the connection is closed.
+ * </p>
+ * @param queue the ack queue
+ */
+static inline void ack_queue_clear(struct ack_queue *queue)
+{
+    queue->len = 0;
+}
+
+#endif //SCALABLE_SERVER_ACK_QUEUE_H
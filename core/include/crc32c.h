@@ -0,0 +1,32 @@
+#ifndef SCALABLE_SERVER_CRC32C_H
+#define SCALABLE_SERVER_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * crc32c
+ * <p>
+ * Compute the CRC32C (Castagnoli) of a buffer, or extend one. Pass 0 to start; to checksum data which arrives in
+ * pieces, pass the result for the pieces so far. The kernel is chosen for the CPU at run time: on x86-64 with SSE4.2
+ * the crc32 instruction, running three streams at once and joining them with carry-less multiplies where PCLMUL is
+ * available too; the ARMv8 crc32c instructions where the compiler targets them; and a table lookup per byte
+ * elsewhere. Every kernel gives the same result.
+ * </p>
+ * @param crc the CRC32C of the data before buf, 0 for none
+ * @param buf the data
+ * @param len the length of the data
+ * @return the CRC32C of the data before buf followed by buf
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+/**
+ * crc32c_kernel
+ * <p>
+ * Get the name of the kernel crc32c uses on this CPU, for reports.
+ * </p>
+ * @return "sse4.2+pclmul", "sse4.2", "armv8-crc", or "table"
+ */
+const char *crc32c_kernel(void);
+
+#endif //SCALABLE_SERVER_CRC32C_H
@@ -0,0 +1,16 @@
+#ifndef SCALABLE_SERVER_DURATION_H
+#define SCALABLE_SERVER_DURATION_H
+
+/**
+ * duration_parse
+ * <p>
+ * Parse a duration, a decimal number of at least 0 followed by a unit of ns, us, ms or s, as think times and latency
+ * objectives are written: 250us, 1.5ms.
+ * </p>
+ * @param dst where to store the duration, in nanoseconds
+ * @param buff the string, which must hold the duration and nothing else
+ * @return 0 on success. -1 if the string is not a duration, with dst left as it was.
+ */
+int duration_parse(double *dst, const char *buff);
+
+#endif //SCALABLE_SERVER_DURATION_H
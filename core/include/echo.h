@@ -0,0 +1,120 @@
+#ifndef SCALABLE_SERVER_ECHO_H
+#define SCALABLE_SERVER_ECHO_H
+
+#include "syscall_stats.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#ifndef MSG_MORE
+#define MSG_MORE 0 // Not supported; the ack is sent alone.
+#endif
+
+/**
+ * The most payload bytes an echo holds between taking them from the socket and giving them back; the default
+ * capacity of a Linux pipe. A pipe may fill before it holds this many, when the payload arrives in small fragments.
+ */
+#define ECHO_CHUNK_SIZE (64 * 1024)
+
+/**
+ * echo_pipe
+ * <p>
+ * Where an echoed payload waits between being received and being sent back. On Linux it is a pipe, and the
+ * payload is spliced from the socket into the pipe and from the pipe back into the socket, so it never enters
+ * user space; the pipe is non-blocking, as the thread that fills it is the one that drains it. Elsewhere it is a
+ * buffer, filled with recv and drained with send.
+ * </p>
+ */
+struct echo_pipe {
+    bool open;
+#if defined(__linux__)
+    int fds[2]; // Read end, write end.
+#else
+    uint8_t *buf;
+    size_t head; // Offset of the first byte not yet sent back.
+#endif
+    size_t piped; // Bytes taken from the socket and not yet sent back.
+};
+
+/**
+ * echo_ack_flags
+ * <p>
+ * Get the send flags to add for the ack to an echo request. When a payload follows, the ack is sent with MSG_MORE
+ * so that it goes out with the start of the payload. Sent alone, it would leave the payload held back by Nagle's
+ * algorithm until the client ACKs it, which a client that delays its ACKs does only after a timeout.
+ * </p>
+ * @param length the length of the payload
+ * @return MSG_MORE if a payload follows, 0 otherwise
+ */
+static inline int echo_ack_flags(uint64_t length)
+{
+    return (length > 0) ? MSG_MORE : 0;
+}
+
+/**
+ * echo_pipe_open
+ * <p>
+ * Open an echo pipe, if it is not open already. Also ignores SIGPIPE for the process: splicing into a socket
+ * cannot pass MSG_NOSIGNAL, and a client which hangs up part way through an echo must not kill the server.
+ * </p>
+ * @param echo the echo pipe
+ * @return 0 on success, -1 and set errno on failure
+ */
+int echo_pipe_open(struct echo_pipe *echo);
+
+/**
+ * echo_pipe_close
+ * <p>
+ * Close an echo pipe, dropping anything in it. Does nothing if it is not open.
+ * </p>
+ * @param echo the echo pipe
+ */
+void echo_pipe_close(struct echo_pipe *echo);
+
+/**
+ * echo_take
+ * <p>
+ * Move up to len bytes from a socket into an echo pipe, as many as the socket has and the pipe has room for.
+ * Counted as a splice on Linux, a recv elsewhere. A full pipe is not waited on; give back what it holds first.
+ * </p>
+ * @param stats the stats object, may be NULL
+ * @param fd the socket
+ * @param echo the echo pipe
+ * @param len the most bytes to take
+ * @return the number of bytes taken, 0 if the peer closed, -1 and set errno on failure, to EAGAIN if the pipe is
+ * full or a non-blocking socket has nothing
+ */
+ssize_t echo_take(struct syscall_stats *stats, int fd, struct echo_pipe *echo, size_t len);
+
+/**
+ * echo_give
+ * <p>
+ * Move bytes from an echo pipe back into a socket, as many as the socket takes. Counted as a splice on Linux,
+ * a send elsewhere.
+ * </p>
+ * @param stats the stats object, may be NULL
+ * @param fd the socket
+ * @param echo the echo pipe
+ * @param more whether more of the payload follows, so that the socket may hold back a partial segment
+ * @return the number of bytes given, -1 and set errno on failure
+ */
+ssize_t echo_give(struct syscall_stats *stats, int fd, struct echo_pipe *echo, bool more);
+
+/**
+ * echo_payload
+ * <p>
+ * Send a whole payload back as it is received, over a blocking socket.
+ * </p>
+ * @param stats the stats object, may be NULL
+ * @param fd the socket
+ * @param echo an open, empty echo pipe
+ * @param len the length of the payload
+ * @param echoed where to store the number of bytes echoed, less than len if the peer closed
+ * @return 0 on success, -1 and set errno on failure
+ */
+int echo_payload(struct syscall_stats *stats, int fd, struct echo_pipe *echo, uint64_t len, uint64_t *echoed);
+
+#endif //SCALABLE_SERVER_ECHO_H
@@ -0,0 +1,98 @@
+#ifndef SCALABLE_SERVER_HISTOGRAM_H
+#define SCALABLE_SERVER_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/**
+ * The number of linear sub-buckets in each power of two. Bounds the error of a recorded value to 1/8.
+ */
+#define HISTOGRAM_SUB_BUCKETS 8
+
+/**
+ * The number of buckets needed to cover every uint64_t value.
+ */
+#define HISTOGRAM_BUCKETS ((64 - 3 + 1) * HISTOGRAM_SUB_BUCKETS)
+
+/**
+ * histogram
+ * <p>
+ * Log-linear histogram of nanosecond durations. Recording is a few instructions and never allocates.
+ * </p>
+ */
+struct histogram {
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+};
+
+/**
+ * now_ns
+ * <p>
+ * Get the time on the monotonic clock in nanoseconds. The clock is shared by all processes on the host.
+ * </p>
+ * @return the monotonic time in nanoseconds
+ */
+static inline uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * histogram_record
+ * <p>
+ * Record one value in the histogram.
+ * </p>
+ * @param h the histogram
+ * @param value_ns the value in nanoseconds
+ */
+void histogram_record(struct histogram *h, uint64_t value_ns);
+
+/**
+ * histogram_merge
+ * <p>
+ * Add the values recorded in one histogram to another, as if they had been recorded there.
+ * </p>
+ * @param dst the histogram to add to
+ * @param src the histogram to add
+ */
+void histogram_merge(struct histogram *dst, const struct histogram *src);
+
+/**
+ * histogram_bucket_upper_bound
+ * <p>
+ * Get the largest value that belongs in a bucket, the value a bucket stands for when it is reported.
+ * </p>
+ * @param index the index of the bucket, less than HISTOGRAM_BUCKETS
+ * @return the largest value in the bucket
+ */
+uint64_t histogram_bucket_upper_bound(size_t index);
+
+/**
+ * histogram_percentile
+ * <p>
+ * Get the value at a percentile of the recorded values. The value is the upper bound of the bucket it falls in.
+ * </p>
+ * @param h the histogram
+ * @param percentile the percentile, from 0 to 100
+ * @return the value in nanoseconds, 0 if the histogram is empty
+ */
+uint64_t histogram_percentile(const struct histogram *h, double percentile);
+
+/**
+ * histogram_print
+ * <p>
+ * Print a one line summary of the histogram: count, mean, p50, p90, p99, p99.9 and max, in microseconds.
+ * </p>
+ * @param h the histogram
+ * @param name the name to print the summary under
+ * @param out the file to print to
+ */
+void histogram_print(const struct histogram *h, const char *name, FILE *out);
+
+#endif //SCALABLE_SERVER_HISTOGRAM_H
@@ -2,14 +2,66 @@
 #define SCALABLE_SERVER_OBJECTS_H
 
 #include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
+/**
+ * engine_options
+ * <p>
+ * Tuning options from the command line. Read by the core and by the loaded library.
+ * </p>
+ */
+struct engine_options {
+    uint16_t stall_threshold_ms; // Event loop iteration length over which a stall is logged, 0 to never log.
+    bool ack_more; // Send queued acks with MSG_MORE while the connection has more request bytes waiting.
+    uint16_t budget_kib; // KiB a connection may read in one event loop iteration, 0 for no limit.
+    bool rcvlowat; // Set SO_RCVLOWAT to the rest of the payload, so a connection wakes when its request is complete.
+    bool sink; // Count payload bytes and discard them in the kernel instead of copying them into a buffer.
+};
+
+/**
+ * handler_response
+ * <p>
+ * What a request handler sends back for one message.
+ * </p>
+ */
+struct handler_response {
+    uint64_t length; // Sent as the length in the ack. The engine sets it to the message length before the first chunk.
+};
+
+/**
+ * handler_message
+ * <p>
+ * Definition of the on_message function of a request handler.
+ * </p>
+ */
+typedef int (*handler_message) (void *state, void *message, const uint8_t *chunk, size_t chunk_len, uint64_t length,
+                                struct handler_response *response);
+
+/**
+ * handler
+ * <p>
+ * A request handler loaded from a shared library, and the state it returned when it was initialized. Engines
+ * pass it the payload of every message; on_message is NULL when no handler is loaded.
+ * </p>
+ */
+struct handler {
+    int (*initialize)(void **state);
+    int (*begin)(void *state, uint64_t length, void **message);
+    handler_message on_message;
+    void (*end)(void *state, void *message);
+    void (*close)(void *state);
+    void *state;
+};
+
 /**
  * core_object
  * <p>
  * Holds the core information for the execution of the framework, regardless
  * of the library loaded. Includes dc_env, dc_error, memory_manager, log file,
- * and state_object. state_object contains library-dependent data, and will be
+ * syscall_stats, event loop watchdog, engine options, request handler, and state_object. state_object contains library-dependent data, and will be
  * assigned and handled by the loaded library.
  * </p>
  */
@@ -19,6 +71,10 @@ struct core_object {
     struct memory_manager *mm;
     FILE *log_file;
     struct sockaddr_in listen_addr;
+    struct syscall_stats *stats;
+    struct watchdog *watchdog;
+    struct engine_options options;
+    struct handler handler;
     struct state_object *so;
 };
 
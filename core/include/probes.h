@@ -0,0 +1,36 @@
+#ifndef SCALABLE_SERVER_PROBES_H
+#define SCALABLE_SERVER_PROBES_H
+
+/*
+ * USDT static tracepoints on the accept, dispatch, receive, and ack paths of the engines.
+ *
+ * Probes are compiled in when ENABLE_USDT is defined (configure with -DUSDT=ON), which requires <sys/sdt.h>
+ * from systemtap-sdt-dev. Otherwise SERVER_PROBE expands to nothing and there is no dependency.
+ *
+ * Attach to a running server without restarting it, for example:
+ *     bpftrace -e 'usdt:./libpoll-server.so:scalable_server:recv_done { @[arg0] = count(); }'
+ *
+ * Probes, with their arguments:
+ *     accept           (client fd, connection index)
+ *     dispatch_start   (parent client fd)                      process-server parent, before the domain socket
+ *     dispatch_sent    (parent client fd)                      process-server parent, after sendmsg
+ *     fd_received      (parent client fd, child client fd)     process-server child, after recvmsg
+ *     recv_start       (client fd, bytes to read)              after the length header is read
+ *     recv_done        (client fd, bytes read)                 after the receive loop
+ *     ack              (client fd, bytes acknowledged)         after the ack is sent
+ */
+
+#ifdef ENABLE_USDT
+#include <sys/sdt.h>
+/**
+ * Fire a static tracepoint. Takes at least one argument after the probe name.
+ */
+#define SERVER_PROBE(name, ...) STAP_PROBEV(scalable_server, name, __VA_ARGS__)
+#else
+/**
+ * Static tracepoints are compiled out; arguments are not evaluated.
+ */
+#define SERVER_PROBE(name, ...) do { } while (0)
+#endif
+
+#endif //SCALABLE_SERVER_PROBES_H
@@ -0,0 +1,44 @@
+#ifndef SCALABLE_SERVER_PROFILER_H
+#define SCALABLE_SERVER_PROFILER_H
+
+/*
+ * Sampling CPU profiler for the --profile mode.
+ *
+ * setitimer(ITIMER_PROF) delivers SIGPROF for every PROFILE_INTERVAL_US of CPU time used by the process. The
+ * handler walks the frame pointers of the interrupted stack into a preallocated ring of samples, so it neither
+ * allocates nor locks. backtrace() is not async-signal-safe, so it is not used. Code built without frame pointers,
+ * such as most of libc, hides the caller of the frame it was interrupted in. Forked worker processes re-arm the
+ * timer and sample into their own copy of the ring.
+ *
+ * When the profiler is stopped, each process writes profile.<pid>.folded in the folded stack format read by
+ * flamegraph.pl, inferno, and speedscope: one line per distinct stack, frames from the root separated by ';',
+ * followed by the number of samples. Frames are named with dladdr(); frames without an exported symbol, such as
+ * static functions in an engine library, are named <library>+0x<offset>, which addr2line -f -e <library> resolves.
+ */
+
+/**
+ * The CPU time between samples in microseconds.
+ */
+#define PROFILE_INTERVAL_US 1000
+
+/**
+ * start_profiler
+ * <p>
+ * Allocate the sample ring, install the SIGPROF handler, and start the profiling timer. Register a fork handler
+ * so that child processes are profiled too.
+ * </p>
+ * @return 0 on success, -1 and set errno on failure
+ */
+int start_profiler(void);
+
+/**
+ * stop_profiler
+ * <p>
+ * Stop the profiling timer and write the samples taken by this process to profile.<pid>.folded.
+ * Does nothing if the profiler was not started.
+ * </p>
+ * @return 0 on success, -1 and set errno on failure
+ */
+int stop_profiler(void);
+
+#endif //SCALABLE_SERVER_PROFILER_H
@@ -0,0 +1,119 @@
+#ifndef SCALABLE_SERVER_SCENARIO_H
+#define SCALABLE_SERVER_SCENARIO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCENARIO_NAME_SIZE 32
+#define SCENARIO_SPEC_SIZE 128
+
+/**
+ * scenario_setting
+ * <p>
+ * The load settings a scenario phase can set, as bits of scenario_phase.set.
+ * </p>
+ */
+enum scenario_setting
+{
+    SCENARIO_THREADS = 1U << 0U,
+    SCENARIO_CONNECTIONS = 1U << 1U,
+    SCENARIO_DEPTH = 1U << 2U,
+    SCENARIO_RATE = 1U << 3U,
+    SCENARIO_ARRIVAL = 1U << 4U,
+    SCENARIO_THINK = 1U << 5U,
+    SCENARIO_SIZES = 1U << 6U,
+};
+
+/**
+ * scenario_phase
+ * <p>
+ * One phase of a scenario, as one client runs it. A phase keeps every setting of the phase before it that it does
+ * not set itself; the settings no phase has set stay as the client's options have them.
+ * </p>
+ */
+struct scenario_phase
+{
+    char name[SCENARIO_NAME_SIZE];
+    uint32_t duration_sec;
+    bool measured; // Whether the phase's results are reported; off for a warm-up.
+    unsigned int set; // The scenario_setting bits of the settings below that hold a value.
+    uint16_t threads;
+    uint16_t connections; // Per thread, for the event engine.
+    uint16_t depth;
+    double rate; // Requests per second across the client's threads; 0 for closed loop.
+    char arrival[SCENARIO_SPEC_SIZE];
+    char think[SCENARIO_SPEC_SIZE];
+    char sizes[SCENARIO_SPEC_SIZE];
+};
+
+/**
+ * scenario
+ * <p>
+ * The phases of a scenario, in the order they run.
+ * </p>
+ */
+struct scenario
+{
+    struct scenario_phase *phases;
+    size_t count;
+};
+
+/**
+ * scenario_parse
+ * <p>
+ * Parse a scenario, one directive per line; blank lines and lines starting with # are ignored.
+ * </p>
+ * <p>
+ * "phase NAME KEY=VALUE..." starts a phase. Its keys are duration, in seconds or with an s, m or h suffix, which
+ * every phase needs; measure, on or off, on unless set; steps, which cuts the phase into that many equal steps
+ * ramping threads, connections, depth and rate from the values of the phase before to its own; and the load
+ * settings threads, connections, depth, rate (0 for closed loop), arrival, think and sizes, whose values are those of
+ * the client's -T, -N, -w, -R, -a, -I and -D options.
+ * </p>
+ * <p>
+ * "client INDEX KEY=VALUE..." sets load settings of the phase above it for one client only, the clients numbered
+ * from 0 in the order they connected to the controller; a client on its own is client 0. Durations, steps and
+ * measure cannot differ between clients, so every client moves from phase to phase at the same time.
+ * </p>
+ * <p>
+ * The values of the load settings are checked by the client as it takes the phases.
+ * </p>
+ * @param scenario where to store the scenario
+ * @param text the scenario
+ * @param client the index of the client the phases are for
+ * @return 0 on success. -1 on failure, described on stderr, with nothing left allocated.
+ */
+int scenario_parse(struct scenario *scenario, const char *text, uint16_t client);
+
+/**
+ * scenario_read
+ * <p>
+ * Read a scenario file whole, to parse or to send to clients.
+ * </p>
+ * @param dst where to store the text, NUL terminated; free it when done
+ * @param file_name the name of the file
+ * @return 0 on success. -1 on failure, described on stderr.
+ */
+int scenario_read(char **dst, const char *file_name);
+
+/**
+ * scenario_duration
+ * <p>
+ * Get how long a scenario runs.
+ * </p>
+ * @param scenario the scenario
+ * @return the sum of the durations of its phases, in seconds
+ */
+uint64_t scenario_duration(const struct scenario *scenario);
+
+/**
+ * scenario_free
+ * <p>
+ * Free a scenario. Does nothing to one already freed, or zeroed.
+ * </p>
+ * @param scenario the scenario
+ */
+void scenario_free(struct scenario *scenario);
+
+#endif //SCALABLE_SERVER_SCENARIO_H
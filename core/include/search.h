@@ -0,0 +1,181 @@
+#ifndef SCALABLE_SERVER_SEARCH_H
+#define SCALABLE_SERVER_SEARCH_H
+
+#include "histogram.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * The size of an encoded search_result: its counters, the histogram's count, sum and max, and the buckets.
+ */
+#define SEARCH_RESULT_SIZE ((6 + HISTOGRAM_BUCKETS) * sizeof(uint64_t))
+
+/**
+ * search_slo
+ * <p>
+ * The latency objective a saturation search holds the load to.
+ * </p>
+ */
+struct search_slo
+{
+    double percentile; // The percentile of request latency held to latency_ns, from 0 to 100.
+    uint64_t latency_ns;
+    double error_rate; // The largest share of requests that may be lost, from 0 to 1; above 1 if not held to one.
+    char spec[64]; // The objective as parsed, for reports.
+};
+
+/**
+ * search_result
+ * <p>
+ * What one step of a search measured, on one client or, merged, on all of them.
+ * </p>
+ */
+struct search_result
+{
+    uint64_t requests; // Requests completed.
+    uint64_t errors; // Requests lost, with the connections the server dropped.
+    uint64_t measured_ns; // How long the requests were measured for.
+    struct histogram latency;
+};
+
+/**
+ * search_step
+ * <p>
+ * One step of a search: the load offered, what it achieved and whether it held to the objective.
+ * </p>
+ */
+struct search_step
+{
+    unsigned int index; // From 1, in the order the steps ran.
+    double rate; // Requests per second offered.
+    double throughput; // Requests per second completed.
+    uint64_t p50_ns;
+    uint64_t latency_ns; // At the objective's percentile.
+    uint64_t max_ns;
+    uint64_t requests;
+    uint64_t errors;
+    bool sustained;
+};
+
+/**
+ * search
+ * <p>
+ * A saturation search: the rate doubles from the first step's until a step misses the objective, then the rate
+ * between the highest sustained and the lowest missed is halved until they are close.
+ * </p>
+ */
+struct search
+{
+    struct search_slo slo;
+    double rate; // Requests per second of the next step.
+    bool have_sustained; // Whether any rate was sustained yet.
+    double sustained; // The highest rate sustained; only with have_sustained.
+    bool have_missed; // Whether any rate missed the objective yet.
+    double missed; // The lowest rate that missed the objective; only with have_missed.
+    struct search_step best; // The step at the highest rate sustained.
+    unsigned int steps; // The steps run.
+};
+
+/**
+ * search_slo_parse
+ * <p>
+ * Parse a latency objective, pPERCENTILE:TIME[:ERRORS%], with TIME in ns, us, ms or s: p99:5ms holds the 99th
+ * percentile of latency to 5 milliseconds, and p99.9:2ms:1% does as much for the 99.9th with at most 1% of requests
+ * lost as well.
+ * </p>
+ * @param slo where to store the objective
+ * @param spec the objective
+ * @return 0 on success. -1 if the spec is not an objective.
+ */
+int search_slo_parse(struct search_slo *slo, const char *spec);
+
+/**
+ * search_init
+ * <p>
+ * Start a search.
+ * </p>
+ * @param search the search
+ * @param slo the objective
+ * @param rate the requests per second of the first step, above 0
+ */
+void search_init(struct search *search, const struct search_slo *slo, double rate);
+
+/**
+ * search_judge
+ * <p>
+ * Judge a step at the search's rate by what it measured. A step is sustained if it held to the objective and
+ * completed nearly the requests offered; a target the load cannot keep up with is saturated however fast the
+ * requests it does complete are.
+ * </p>
+ * @param search the search
+ * @param result what the step measured
+ * @param step where to store the step
+ */
+void search_judge(const struct search *search, const struct search_result *result, struct search_step *step);
+
+/**
+ * search_next
+ * <p>
+ * Take a judged step into the search and pick the rate of the next.
+ * </p>
+ * @param search the search
+ * @param step the step
+ * @return true if another step is to run at the search's rate, false if the search is over
+ */
+bool search_next(struct search *search, const struct search_step *step);
+
+/**
+ * search_result_merge
+ * <p>
+ * Add the result of one client to those of the others, as if one client had measured them all.
+ * </p>
+ * @param dst the result to add to
+ * @param src the result to add
+ */
+void search_result_merge(struct search_result *dst, const struct search_result *src);
+
+/**
+ * search_result_encode
+ * <p>
+ * Store a result in network byte order, to send from a client to the controller.
+ * </p>
+ * @param result the result
+ * @param buf where to store it, SEARCH_RESULT_SIZE bytes
+ */
+void search_result_encode(const struct search_result *result, uint8_t *buf);
+
+/**
+ * search_result_decode
+ * <p>
+ * Load a result stored by search_result_encode.
+ * </p>
+ * @param result where to store the result
+ * @param buf the result, SEARCH_RESULT_SIZE bytes
+ */
+void search_result_decode(struct search_result *result, const uint8_t *buf);
+
+/**
+ * search_write_step
+ * <p>
+ * Write a step as a row of the latency against throughput curve, with the header before the first.
+ * </p>
+ * @param search the search
+ * @param step the step
+ * @param csv the CSV file
+ */
+void search_write_step(const struct search *search, const struct search_step *step, FILE *csv);
+
+/**
+ * search_print
+ * <p>
+ * Print the outcome of a search: the highest throughput sustained, and its latency.
+ * </p>
+ * @param search the search, over
+ * @param out the file to print to
+ */
+void search_print(const struct search *search, FILE *out);
+
+#endif //SCALABLE_SERVER_SEARCH_H
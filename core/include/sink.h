@@ -0,0 +1,39 @@
+#ifndef SCALABLE_SERVER_SINK_H
+#define SCALABLE_SERVER_SINK_H
+
+#include "syscall_stats.h"
+
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+/**
+ * The most bytes sink_recv takes per call where the kernel cannot discard them.
+ */
+#define SINK_SCRATCH_SIZE (64 * 1024)
+
+/**
+ * sink_recv
+ * <p>
+ * Receive up to len payload bytes from a TCP socket and throw them away, for the count-only sink mode. On Linux,
+ * MSG_TRUNC makes TCP drop the bytes in the kernel without copying them to user space, so no buffer is needed.
+ * Elsewhere the bytes are read into a scratch buffer which every call overwrites. Counted as a recv.
+ * </p>
+ * @param stats the stats object, may be NULL
+ * @param fd the socket
+ * @param len the most bytes to take
+ * @param flags flags for recv
+ * @return the number of bytes taken, 0 if the peer closed, -1 and set errno on failure
+ */
+static inline ssize_t sink_recv(struct syscall_stats *stats, int fd, size_t len, int flags)
+{
+#if defined(__linux__) && defined(MSG_TRUNC)
+    return counted_recv(stats, fd, NULL, len, flags | MSG_TRUNC); // NOLINT(hicpp-signed-bitwise)
+#else
+    static char scratch[SINK_SCRATCH_SIZE]; // NOLINT(cppcoreguidelines-avoid-non-const-global-variables): never read
+
+    return counted_recv(stats, fd, scratch, (len < sizeof(scratch)) ? len : sizeof(scratch), flags);
+#endif
+}
+
+#endif //SCALABLE_SERVER_SINK_H
@@ -0,0 +1,243 @@
+#ifndef SCALABLE_SERVER_SYSCALL_STATS_H
+#define SCALABLE_SERVER_SYSCALL_STATS_H
+
+#include <fcntl.h>
+#include <poll.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * Syscall_Kinds
+ * <p>
+ * The socket, IPC, and semaphore calls counted by the syscall wrappers.
+ * </p>
+ */
+enum Syscall_Kinds {
+    SYSCALL_ACCEPT = 0,
+    SYSCALL_RECV,
+    SYSCALL_SEND,
+    SYSCALL_SENDMSG,
+    SYSCALL_RECVMSG,
+    SYSCALL_POLL,
+    SYSCALL_SELECT,
+    SYSCALL_READ,
+    SYSCALL_WRITE,
+    SYSCALL_SEM_WAIT,
+    SYSCALL_SEM_POST,
+    SYSCALL_GETPEERNAME,
+    SYSCALL_IOCTL,
+    SYSCALL_SETSOCKOPT,
+    SYSCALL_SPLICE,
+    SYSCALL_KINDS // Number of kinds; not a syscall.
+};
+
+/**
+ * syscall_stats
+ * <p>
+ * Counts of calls made by the loaded library, the number and payload of the messages it completed, and how many
+ * payload checksums it verified. The object is mapped shared so that the counts of forked worker processes are
+ * included. Only the process that created the object reports it.
+ * </p>
+ */
+struct syscall_stats {
+    _Atomic uint64_t calls[SYSCALL_KINDS];
+    _Atomic uint64_t messages;
+    _Atomic uint64_t payload_bytes;
+    _Atomic uint64_t checksums;
+    _Atomic uint64_t checksum_mismatches;
+    pid_t            owner;
+};
+
+/**
+ * setup_syscall_stats
+ * <p>
+ * Map a zeroed syscall_stats object into memory shared with any child processes.
+ * </p>
+ * @return the stats object, or NULL and set errno on failure
+ */
+struct syscall_stats *setup_syscall_stats(void);
+
+/**
+ * report_syscall_stats
+ * <p>
+ * Print the average number of each call per completed message to stdout, with the CPU time used per message and
+ * per MiB of payload and any checksum mismatches, and append the same row to the syscall stats file so that every
+ * run is tracked. A stats file with other columns, from another build, is moved aside first. CPU time includes
+ * child processes which have been waited for. Does nothing outside of the process that created the stats.
+ * </p>
+ * @param stats the stats object
+ * @param lib_name the name of the library which was run
+ * @param options_label the engine options of the run, to tell runs of the same library apart
+ * @return 0 on success, -1 and set errno on failure
+ */
+int report_syscall_stats(struct syscall_stats *stats, const char *lib_name, const char *options_label);
+
+/**
+ * destroy_syscall_stats
+ * <p>
+ * Unmap a syscall_stats object.
+ * </p>
+ * @param stats the stats object
+ */
+void destroy_syscall_stats(struct syscall_stats *stats);
+
+/**
+ * count_syscall
+ * <p>
+ * Increment the count of a kind of call. Safe to use from any process sharing the stats.
+ * </p>
+ * @param stats the stats object, may be NULL
+ * @param kind the kind of call
+ */
+static inline void count_syscall(struct syscall_stats *stats, enum Syscall_Kinds kind)
+{
+    if (stats)
+    {
+        atomic_fetch_add_explicit(&stats->calls[kind], 1, memory_order_relaxed);
+    }
+}
+
+/**
+ * count_message
+ * <p>
+ * Increment the count of completed messages. A message is complete when its response has been sent.
+ * </p>
+ * @param stats the stats object, may be NULL
+ * @param payload_bytes the number of payload bytes in the message
+ */
+static inline void count_message(struct syscall_stats *stats, uint64_t payload_bytes)
+{
+    if (stats)
+    {
+        atomic_fetch_add_explicit(&stats->messages, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&stats->payload_bytes, payload_bytes, memory_order_relaxed);
+    }
+}
+
+/**
+ * count_checksum
+ * <p>
+ * Count a verified payload checksum, and whether it was wrong.
+ * </p>
+ * @param stats the stats object, may be NULL
+ * @param match whether the checksum the client sent matched the payload received
+ */
+static inline void count_checksum(struct syscall_stats *stats, bool match)
+{
+    if (stats)
+    {
+        atomic_fetch_add_explicit(&stats->checksums, 1, memory_order_relaxed);
+        if (!match)
+        {
+            atomic_fetch_add_explicit(&stats->checksum_mismatches, 1, memory_order_relaxed);
+        }
+    }
+}
+
+// The wrappers below count a call, then make it. They take the same arguments as the call they wrap.
+
+static inline int counted_accept(struct syscall_stats *stats, int fd, struct sockaddr *addr, socklen_t *addr_len)
+{
+    count_syscall(stats, SYSCALL_ACCEPT);
+    return accept(fd, addr, addr_len);
+}
+
+static inline ssize_t counted_recv(struct syscall_stats *stats, int fd, void *buf, size_t len, int flags)
+{
+    count_syscall(stats, SYSCALL_RECV);
+    return recv(fd, buf, len, flags);
+}
+
+static inline ssize_t counted_send(struct syscall_stats *stats, int fd, const void *buf, size_t len, int flags)
+{
+    count_syscall(stats, SYSCALL_SEND);
+    return send(fd, buf, len, flags);
+}
+
+static inline ssize_t counted_sendmsg(struct syscall_stats *stats, int fd, const struct msghdr *msg, int flags)
+{
+    count_syscall(stats, SYSCALL_SENDMSG);
+    return sendmsg(fd, msg, flags);
+}
+
+static inline ssize_t counted_recvmsg(struct syscall_stats *stats, int fd, struct msghdr *msg, int flags)
+{
+    count_syscall(stats, SYSCALL_RECVMSG);
+    return recvmsg(fd, msg, flags);
+}
+
+static inline int counted_poll(struct syscall_stats *stats, struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    count_syscall(stats, SYSCALL_POLL);
+    return poll(fds, nfds, timeout);
+}
+
+static inline int counted_select(struct syscall_stats *stats, int nfds, fd_set *read_fds, fd_set *write_fds,
+                                 fd_set *except_fds, struct timeval *timeout)
+{
+    count_syscall(stats, SYSCALL_SELECT);
+    return select(nfds, read_fds, write_fds, except_fds, timeout);
+}
+
+static inline ssize_t counted_read(struct syscall_stats *stats, int fd, void *buf, size_t len)
+{
+    count_syscall(stats, SYSCALL_READ);
+    return read(fd, buf, len);
+}
+
+static inline ssize_t counted_write(struct syscall_stats *stats, int fd, const void *buf, size_t len)
+{
+    count_syscall(stats, SYSCALL_WRITE);
+    return write(fd, buf, len);
+}
+
+static inline int counted_sem_wait(struct syscall_stats *stats, sem_t *sem)
+{
+    count_syscall(stats, SYSCALL_SEM_WAIT);
+    return sem_wait(sem);
+}
+
+static inline int counted_sem_post(struct syscall_stats *stats, sem_t *sem)
+{
+    count_syscall(stats, SYSCALL_SEM_POST);
+    return sem_post(sem);
+}
+
+static inline int counted_getpeername(struct syscall_stats *stats, int fd, struct sockaddr *addr,
+                                      socklen_t *addr_len)
+{
+    count_syscall(stats, SYSCALL_GETPEERNAME);
+    return getpeername(fd, addr, addr_len);
+}
+
+static inline int counted_ioctl(struct syscall_stats *stats, int fd, unsigned long request, void *arg)
+{
+    count_syscall(stats, SYSCALL_IOCTL);
+    return ioctl(fd, request, arg); // NOLINT(cppcoreguidelines-pro-type-vararg): ioctl is variadic
+}
+
+static inline int counted_setsockopt(struct syscall_stats *stats, int fd, int level, int name, const void *value,
+                                     socklen_t value_len)
+{
+    count_syscall(stats, SYSCALL_SETSOCKOPT);
+    return setsockopt(fd, level, name, value, value_len);
+}
+
+#if defined(__linux__)
+static inline ssize_t counted_splice(struct syscall_stats *stats, int fd_in, int fd_out, size_t len,
+                                     unsigned int flags)
+{
+    count_syscall(stats, SYSCALL_SPLICE);
+    return splice(fd_in, NULL, fd_out, NULL, len, flags);
+}
+#endif
+
+#endif //SCALABLE_SERVER_SYSCALL_STATS_H
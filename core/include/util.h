@@ -10,6 +10,9 @@
 #define DEFAULT_LIBRARY "../../one-to-one/cmake-build-debug/libone-to-one.dylib" // TODO: relative path should be changed to absolute.
 #define DEFAULT_PORT "5000"
 #define DEFAULT_IP "123.123.123.123" // TODO: will need to get the IP address by default
+#define DEFAULT_STALL_THRESHOLD_MS 10
+#define DEFAULT_BUDGET_KIB 64
+#define ENGINE_OPTIONS_LABEL_SIZE 128
 
 /**
  * api_functions
@@ -47,10 +50,26 @@ void trace_reporter(const struct dc_env *env, const char *file_name, const char
  * @param err the error object
  * @param port_num the port number to listen on
  * @param ip_addr the ip address to listen on
+ * @param options the engine options, copied into the core object
  * @return 0 on success. On failure, -1 and set errno.
  */
 int setup_core_object(struct core_object *co, const struct dc_env *env, struct dc_error *err, in_port_t port_num,
-                      const char *ip_addr);
+                      const char *ip_addr, const struct engine_options *options);
+
+/**
+ * describe_engine_options
+ * <p>
+ * Write the engine options and the request handler as a short label, such as
+ * "budget=64 ack-more=off rcvlowat=off sink=off handler=none", so that runs with different options can be told
+ * apart in the stats files.
+ * </p>
+ * @param options the engine options
+ * @param handler_name the name of the request handler library, NULL if there is none
+ * @param label where to store the label
+ * @param size the size of label; ENGINE_OPTIONS_LABEL_SIZE is enough unless the handler name is long
+ */
+void describe_engine_options(const struct engine_options *options, const char *handler_name, char *label,
+                             size_t size);
 
 /**
  * get_api
@@ -64,6 +83,18 @@ int setup_core_object(struct core_object *co, const struct dc_env *env, struct d
  */
 void *get_api(struct api_functions *api, const char *lib_name, const struct dc_env *env);
 
+/**
+ * get_handler
+ * <p>
+ * Open a request handler library and load its functions into the handler struct.
+ * </p>
+ * @param handler struct to hold the handler functions.
+ * @param lib_name name of the library.
+ * @param env pointer to a dc_env struct.
+ * @return The opened library. NULL and set errno on failure.
+ */
+void *get_handler(struct handler *handler, const char *lib_name, const struct dc_env *env);
+
 /**
  * close_lib
  * <p>
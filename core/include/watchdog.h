@@ -0,0 +1,123 @@
+#ifndef SCALABLE_SERVER_WATCHDOG_H
+#define SCALABLE_SERVER_WATCHDOG_H
+
+#include "histogram.h"
+
+#include <mem_manager/manager.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * watchdog
+ * <p>
+ * Measures the responsiveness of an event loop. An iteration starts when the loop wakes from its wait and ends
+ * when every ready descriptor has been serviced. Lag is the time from the wake to the start of servicing a
+ * descriptor, so a descriptor waiting behind a slow one shows up as lag. Readiness is observed when the wait
+ * returns; a descriptor that became ready while the previous iteration ran is counted in that iteration's length.
+ * An iteration longer than the stall threshold is logged as a stall.
+ * </p>
+ */
+struct watchdog {
+    struct histogram lag;
+    struct histogram iteration;
+    uint64_t         threshold_ns;
+    uint64_t         stalls;
+    uint64_t         wake_ns; // Time the loop last woke.
+    uint64_t         service_start_ns; // Time servicing of the current descriptor started.
+    int              service_fd; // The descriptor being serviced.
+    size_t           serviced; // Descriptors serviced in this iteration.
+    uint64_t         slowest_ns; // Longest service time in this iteration.
+    int              slowest_fd; // The descriptor with the longest service time in this iteration.
+};
+
+/**
+ * setup_watchdog
+ * <p>
+ * Allocate a zeroed watchdog.
+ * </p>
+ * @param mm the memory manager
+ * @param threshold_ms the iteration length in milliseconds over which a stall is logged, 0 to never log stalls
+ * @return the watchdog, or NULL and set errno on failure
+ */
+struct watchdog *setup_watchdog(struct memory_manager *mm, uint16_t threshold_ms);
+
+/**
+ * watchdog_iteration_end
+ * <p>
+ * End an iteration of the event loop. Record its length, and log a stall to stderr if it is longer than the
+ * threshold. The stall line names the slowest descriptor of the iteration; no stack is captured.
+ * </p>
+ * @param wd the watchdog, may be NULL
+ */
+void watchdog_iteration_end(struct watchdog *wd);
+
+/**
+ * report_watchdog
+ * <p>
+ * Print the lag and iteration histograms and the number of stalls to stdout.
+ * </p>
+ * @param wd the watchdog, may be NULL
+ * @param lib_name the name of the library which was run
+ */
+void report_watchdog(const struct watchdog *wd, const char *lib_name);
+
+/**
+ * watchdog_wake
+ * <p>
+ * Start an iteration of the event loop. Call when the wait for ready descriptors returns.
+ * </p>
+ * @param wd the watchdog, may be NULL
+ */
+static inline void watchdog_wake(struct watchdog *wd)
+{
+    if (wd)
+    {
+        wd->wake_ns    = now_ns();
+        wd->serviced   = 0;
+        wd->slowest_ns = 0;
+        wd->slowest_fd = -1;
+    }
+}
+
+/**
+ * watchdog_service_start
+ * <p>
+ * Record the lag of a ready descriptor. Call before servicing it.
+ * </p>
+ * @param wd the watchdog, may be NULL
+ * @param fd the descriptor
+ */
+static inline void watchdog_service_start(struct watchdog *wd, int fd)
+{
+    if (wd)
+    {
+        wd->service_start_ns = now_ns();
+        wd->service_fd       = fd;
+        histogram_record(&wd->lag, wd->service_start_ns - wd->wake_ns);
+    }
+}
+
+/**
+ * watchdog_service_end
+ * <p>
+ * Finish servicing the descriptor passed to watchdog_service_start.
+ * </p>
+ * @param wd the watchdog, may be NULL
+ */
+static inline void watchdog_service_end(struct watchdog *wd)
+{
+    uint64_t service_ns;
+
+    if (wd)
+    {
+        service_ns = now_ns() - wd->service_start_ns;
+        ++wd->serviced;
+        if (service_ns >= wd->slowest_ns)
+        {
+            wd->slowest_ns = service_ns;
+            wd->slowest_fd = wd->service_fd;
+        }
+    }
+}
+
+#endif //SCALABLE_SERVER_WATCHDOG_H
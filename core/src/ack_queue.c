@@ -0,0 +1,51 @@
+#include "../include/ack_queue.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+int ack_queue_push(struct syscall_stats *stats, int fd, struct ack_queue *queue,
+                   const struct protocol_header *request, uint64_t bytes)
+{
+    if (ack_queue_full(queue))
+    {
+        if (ack_queue_flush(stats, fd, queue, MSG_NOSIGNAL) == -1) // A reset peer fails the send, not the server.
+        {
+            return -1;
+        }
+        if (ack_queue_full(queue)) // The socket took too little to make room.
+        {
+            errno = ENOBUFS;
+            return -1;
+        }
+    }
+
+    queue->len += protocol_encode_ack(request, bytes, queue->buf + queue->len);
+
+    return 0;
+}
+
+int ack_queue_flush(struct syscall_stats *stats, int fd, struct ack_queue *queue, int flags)
+{
+    ssize_t sent;
+
+    if (queue->len == 0)
+    {
+        return 0;
+    }
+
+    sent = counted_send(stats, fd, queue->buf, queue->len, flags);
+    if (sent == -1)
+    {
+        // NOLINTNEXTLINE(misc-redundant-expression): EAGAIN and EWOULDBLOCK may differ
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1; // Non-blocking and full; keep for next flush.
+    }
+
+    queue->len -= (size_t) sent;
+    if (queue->len > 0)
+    {
+        memmove(queue->buf, queue->buf + sent, queue->len);
+    }
+
+    return 0;
+}
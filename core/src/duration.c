@@ -0,0 +1,33 @@
+#include "../include/duration.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+int duration_parse(double *dst, const char *buff)
+{
+    static const struct
+    {
+        const char *suffix;
+        double ns;
+    } units[] = {{"ns", 1}, {"us", 1000}, {"ms", 1000000}, {"s", 1000000000}};
+    double value;
+    char *end;
+
+    errno = 0;
+    value = strtod(buff, &end);
+    if (end == buff || errno != 0 || !(value >= 0))
+    {
+        return -1;
+    }
+    for (size_t index = 0; index < sizeof(units) / sizeof(units[0]); ++index)
+    {
+        if (strcmp(end, units[index].suffix) == 0)
+        {
+            *dst = value * units[index].ns;
+            return 0;
+        }
+    }
+
+    return -1;
+}
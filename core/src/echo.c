@@ -0,0 +1,191 @@
+#include "../include/echo.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // SIGPIPE is ignored instead.
+#endif
+
+/**
+ * The capacity asked for an echo pipe. A pipe holds a number of buffers, one per page of its capacity, and a splice
+ * from a socket fills one per fragment of the payload, however small; 64 of them hold ECHO_CHUNK_SIZE in fragments
+ * down to 1 KiB, where the default 16 may fill with a few MTU sized ones.
+ */
+#define ECHO_PIPE_SIZE (256 * 1024)
+
+/**
+ * ignore_sigpipe
+ * <p>
+ * Ignore SIGPIPE, so that writing to a socket whose peer has gone fails with EPIPE instead of killing the process.
+ * </p>
+ * @return 0 on success, -1 and set errno on failure
+ */
+static int ignore_sigpipe(void);
+
+int echo_pipe_open(struct echo_pipe *echo)
+{
+    if (echo->open)
+    {
+        return 0;
+    }
+
+    if (ignore_sigpipe() == -1)
+    {
+        return -1;
+    }
+
+#if defined(__linux__)
+    // Non-blocking, so a splice into a full pipe fails rather than waits on the one thread that drains it.
+    if (pipe2(echo->fds, O_NONBLOCK) == -1)
+    {
+        return -1;
+    }
+    (void) fcntl(echo->fds[1], F_SETPIPE_SZ, ECHO_PIPE_SIZE); // Past the limits of the user, the default will do.
+#else
+    echo->buf = (uint8_t *) malloc(ECHO_CHUNK_SIZE);
+    if (!echo->buf)
+    {
+        return -1;
+    }
+    echo->head = 0;
+#endif
+    echo->piped = 0;
+    echo->open  = true;
+
+    return 0;
+}
+
+void echo_pipe_close(struct echo_pipe *echo)
+{
+    if (!echo->open)
+    {
+        return;
+    }
+
+#if defined(__linux__)
+    (void) close(echo->fds[0]);
+    (void) close(echo->fds[1]);
+#else
+    free(echo->buf);
+    echo->buf = NULL;
+#endif
+    echo->piped = 0;
+    echo->open  = false;
+}
+
+ssize_t echo_take(struct syscall_stats *stats, int fd, struct echo_pipe *echo, size_t len)
+{
+    ssize_t taken;
+    size_t  room;
+
+    room = ECHO_CHUNK_SIZE - echo->piped;
+    if (room == 0)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+    len = (len < room) ? len : room;
+#if defined(__linux__)
+    taken = counted_splice(stats, fd, echo->fds[1], len, SPLICE_F_MOVE);
+#else
+    if (echo->piped == 0)
+    {
+        echo->head = 0;
+    }
+    if (echo->head + echo->piped + len > ECHO_CHUNK_SIZE) // Keep the waiting bytes in one piece.
+    {
+        memmove(echo->buf, echo->buf + echo->head, echo->piped);
+        echo->head = 0;
+    }
+    taken = counted_recv(stats, fd, echo->buf + echo->head + echo->piped, len, 0);
+#endif
+    if (taken > 0)
+    {
+        echo->piped += (size_t) taken;
+    }
+
+    return taken;
+}
+
+ssize_t echo_give(struct syscall_stats *stats, int fd, struct echo_pipe *echo, bool more)
+{
+    ssize_t given;
+
+    if (echo->piped == 0)
+    {
+        return 0;
+    }
+
+#if defined(__linux__)
+    given = counted_splice(stats, echo->fds[0], fd, echo->piped,
+                           SPLICE_F_MOVE | ((more) ? SPLICE_F_MORE : 0)); // NOLINT(hicpp-signed-bitwise)
+#else
+    (void) more;
+    given = counted_send(stats, fd, echo->buf + echo->head, echo->piped, MSG_NOSIGNAL);
+    if (given > 0)
+    {
+        echo->head += (size_t) given;
+    }
+#endif
+    if (given > 0)
+    {
+        echo->piped -= (size_t) given;
+    }
+
+    return given;
+}
+
+int echo_payload(struct syscall_stats *stats, int fd, struct echo_pipe *echo, uint64_t len, uint64_t *echoed)
+{
+    uint64_t remaining;
+    ssize_t  moved;
+
+    *echoed   = 0;
+    remaining = len;
+    while (remaining > 0 || echo->piped > 0)
+    {
+        if (remaining > 0)
+        {
+            moved = echo_take(stats, fd, echo, (remaining < ECHO_CHUNK_SIZE) ? (size_t) remaining : ECHO_CHUNK_SIZE);
+            // NOLINTNEXTLINE(misc-redundant-expression): EAGAIN and EWOULDBLOCK may differ
+            if (moved == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                return -1;
+            }
+            if (moved == 0) // Closed; give back what was taken, the peer may still be reading.
+            {
+                remaining = 0;
+                continue;
+            }
+            if (moved > 0) // Otherwise the pipe is full; give first.
+            {
+                remaining -= (uint64_t) moved;
+                *echoed   += (uint64_t) moved;
+            }
+        }
+
+        if (echo_give(stats, fd, echo, remaining > 0) == -1)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int ignore_sigpipe(void)
+{
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(struct sigaction));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = SIG_IGN;
+
+    return sigaction(SIGPIPE, &sa, NULL);
+}
@@ -0,0 +1,113 @@
+#include "../include/histogram.h"
+
+#include <inttypes.h>
+
+#define NS_PER_US ((double) 1000)
+
+/**
+ * bucket_index
+ * <p>
+ * Find the bucket a value belongs in. Values below the sub-bucket count have a bucket each; above that,
+ * every power of two is split into HISTOGRAM_SUB_BUCKETS linear buckets.
+ * </p>
+ * @param value the value
+ * @return the index of the bucket
+ */
+static size_t bucket_index(uint64_t value);
+
+void histogram_record(struct histogram *h, uint64_t value_ns)
+{
+    ++h->buckets[bucket_index(value_ns)];
+    ++h->count;
+    h->sum += value_ns;
+    if (value_ns > h->max)
+    {
+        h->max = value_ns;
+    }
+}
+
+void histogram_merge(struct histogram *dst, const struct histogram *src)
+{
+    for (size_t index = 0; index < HISTOGRAM_BUCKETS; ++index)
+    {
+        dst->buckets[index] += src->buckets[index];
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->max > dst->max)
+    {
+        dst->max = src->max;
+    }
+}
+
+uint64_t histogram_percentile(const struct histogram *h, double percentile)
+{
+    uint64_t rank;
+    uint64_t seen;
+
+    if (h->count == 0)
+    {
+        return 0;
+    }
+
+    rank = (uint64_t) ((percentile * (double) h->count + 50) / 100); // Rounded to the nearest rank.
+    rank = (rank == 0) ? 1 : rank;
+    seen = 0;
+    for (size_t index = 0; index < HISTOGRAM_BUCKETS; ++index)
+    {
+        seen += h->buckets[index];
+        if (seen >= rank)
+        {
+            // The bucket bound can overshoot the largest recorded value.
+            return (histogram_bucket_upper_bound(index) < h->max) ? histogram_bucket_upper_bound(index) : h->max;
+        }
+    }
+
+    return h->max;
+}
+
+void histogram_print(const struct histogram *h, const char *name, FILE *out)
+{
+    if (h->count == 0)
+    {
+        (void) fprintf(out, "%-24s count=0\n", name);
+        return;
+    }
+
+    (void) fprintf(out,
+                   "%-24s count=%" PRIu64 " mean=%.1fus p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus\n",
+                   name, h->count, (double) h->sum / (double) h->count / NS_PER_US,
+                   (double) histogram_percentile(h, 50) / NS_PER_US,
+                   (double) histogram_percentile(h, 90) / NS_PER_US,
+                   (double) histogram_percentile(h, 99) / NS_PER_US,
+                   (double) histogram_percentile(h, (double) 999 / 10) / NS_PER_US,
+                   (double) h->max / NS_PER_US);
+}
+
+static size_t bucket_index(uint64_t value)
+{
+    unsigned int exponent;
+
+    if (value < HISTOGRAM_SUB_BUCKETS)
+    {
+        return (size_t) value;
+    }
+
+    exponent = 63 - (unsigned int) __builtin_clzll(value); // Position of the highest set bit; at least 3.
+    return (size_t) (exponent - 2) * HISTOGRAM_SUB_BUCKETS + (size_t) ((value >> (exponent - 3)) & 7);
+}
+
+uint64_t histogram_bucket_upper_bound(size_t index)
+{
+    unsigned int exponent;
+    uint64_t     lower;
+
+    if (index < HISTOGRAM_SUB_BUCKETS)
+    {
+        return (uint64_t) index;
+    }
+
+    exponent = (unsigned int) (index / HISTOGRAM_SUB_BUCKETS) + 2;
+    lower    = (uint64_t) (HISTOGRAM_SUB_BUCKETS + index % HISTOGRAM_SUB_BUCKETS) << (exponent - 3);
+    return lower + (((uint64_t) 1 << (exponent - 3)) - 1);
+}
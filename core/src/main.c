@@ -1,4 +1,7 @@
 #include "util.h"
+#include "profiler.h"
+#include "syscall_stats.h"
+#include "watchdog.h"
 
 #include <dc_application/options.h>
 #include <dc_c/dc_stdlib.h>
@@ -23,6 +26,12 @@
 #define API_RUN "run_server"
 #define API_CLOSE "close_server"
 
+static const uint16_t default_stall_threshold_ms = DEFAULT_STALL_THRESHOLD_MS; // not #defined so pointer can be used
+static const bool     default_profile            = false;
+static const bool     default_ack_more           = false;
+static const uint16_t default_budget_kib         = DEFAULT_BUDGET_KIB;
+static const bool     default_rcvlowat           = false;
+static const bool     default_sink               = false;
 
 /**
  * application_settings
@@ -36,6 +45,13 @@ struct application_settings
     struct dc_setting_string    *library;
     struct dc_setting_in_port_t *port_num;
     struct dc_setting_string    *ip_addr;
+    struct dc_setting_uint16    *stall_threshold_ms;
+    struct dc_setting_bool      *profile;
+    struct dc_setting_bool      *ack_more;
+    struct dc_setting_uint16    *budget_kib;
+    struct dc_setting_bool      *rcvlowat;
+    struct dc_setting_bool      *sink;
+    struct dc_setting_string    *handler;
     // storing a struct is not possible, only use as app settings for now
 };
 
@@ -85,6 +101,28 @@ static int destroy_settings(const struct dc_env *env, struct dc_error *err, stru
  */
 static int run_core(struct core_object *co, const char *lib_name);
 
+/**
+ * open_handler
+ * <p>
+ * Open the request handler library, load its functions into the core object, and initialize it.
+ * </p>
+ * @param co the core object
+ * @param handler_name the name of the handler library to open
+ * @return the opened library. NULL and set errno on failure.
+ */
+static void *open_handler(struct core_object *co, const char *handler_name);
+
+/**
+ * close_handler
+ * <p>
+ * Close the request handler of this process and its library, if one was opened.
+ * </p>
+ * @param co the core object
+ * @param handler_lib the handler library, may be NULL
+ * @param handler_name the name of the handler library
+ */
+static void close_handler(struct core_object *co, void *handler_lib, const char *handler_name);
+
 int main(int argc, char *argv[])
 {
     int                        ret_val;
@@ -122,6 +160,13 @@ static struct dc_application_settings *create_settings(const struct dc_env *env,
     settings->library                 = dc_setting_string_create(env, err);
     settings->port_num                = dc_setting_in_port_t_create(env, err);
     settings->ip_addr                 = dc_setting_string_create(env, err);
+    settings->stall_threshold_ms      = dc_setting_uint16_create(env, err);
+    settings->profile                 = dc_setting_bool_create(env, err);
+    settings->ack_more                = dc_setting_bool_create(env, err);
+    settings->budget_kib              = dc_setting_uint16_create(env, err);
+    settings->rcvlowat                = dc_setting_bool_create(env, err);
+    settings->sink                    = dc_setting_bool_create(env, err);
+    settings->handler                 = dc_setting_string_create(env, err);
     
     struct options opts[] = {
             {(struct dc_setting *) settings->opts.parent.config_path,
@@ -164,13 +209,83 @@ static struct dc_application_settings *create_settings(const struct dc_env *env,
                     "ip-addr",
                     dc_string_from_config,
                     DEFAULT_IP},
+            {(struct dc_setting *) settings->stall_threshold_ms,
+                    dc_options_set_uint16,
+                    "stall-threshold",
+                    required_argument,
+                    's',
+                    "STALL_THRESHOLD",
+                    dc_uint16_from_string,
+                    "stall-threshold",
+                    dc_uint16_from_config,
+                    &default_stall_threshold_ms},
+            {(struct dc_setting *) settings->profile,
+                    dc_options_set_bool,
+                    "profile",
+                    no_argument,
+                    'P',
+                    "PROFILE",
+                    dc_flag_from_string,
+                    "profile",
+                    dc_flag_from_config,
+                    &default_profile},
+            {(struct dc_setting *) settings->ack_more,
+                    dc_options_set_bool,
+                    "ack-more",
+                    no_argument,
+                    'm',
+                    "ACK_MORE",
+                    dc_flag_from_string,
+                    "ack-more",
+                    dc_flag_from_config,
+                    &default_ack_more},
+            {(struct dc_setting *) settings->budget_kib,
+                    dc_options_set_uint16,
+                    "budget",
+                    required_argument,
+                    'b',
+                    "BUDGET",
+                    dc_uint16_from_string,
+                    "budget",
+                    dc_uint16_from_config,
+                    &default_budget_kib},
+            {(struct dc_setting *) settings->rcvlowat,
+                    dc_options_set_bool,
+                    "rcvlowat",
+                    no_argument,
+                    'r',
+                    "RCVLOWAT",
+                    dc_flag_from_string,
+                    "rcvlowat",
+                    dc_flag_from_config,
+                    &default_rcvlowat},
+            {(struct dc_setting *) settings->sink,
+                    dc_options_set_bool,
+                    "sink",
+                    no_argument,
+                    'k',
+                    "SINK",
+                    dc_flag_from_string,
+                    "sink",
+                    dc_flag_from_config,
+                    &default_sink},
+            {(struct dc_setting *) settings->handler,
+                    dc_options_set_string,
+                    "handler",
+                    required_argument,
+                    'H',
+                    "HANDLER",
+                    dc_string_from_string,
+                    "handler",
+                    dc_string_from_config,
+                    NULL},
     };
     
     settings->opts.opts_count = (sizeof(opts) / sizeof(struct options)) + 1;
     settings->opts.opts_size  = sizeof(struct options);
     settings->opts.opts       = dc_calloc(env, err, settings->opts.opts_count, settings->opts.opts_size);
     dc_memcpy(env, settings->opts.opts, opts, sizeof(opts));
-    settings->opts.flags      = "l:p:i:";
+    settings->opts.flags      = "l:p:i:s:Pmb:rkH:";
     settings->opts.env_prefix = "SCALABLE_SERVER_";
     
     return (struct dc_application_settings *) settings;
@@ -182,25 +297,77 @@ static int run(const struct dc_env *env, struct dc_error *err, struct dc_applica
     struct application_settings *app_settings;
     struct core_object          co;
     const char                  *lib_name;
+    const char                  *handler_name;
+    void                        *handler_lib;
     in_port_t                   port_num;
     const char                  *ip_addr;
+    struct engine_options       options;
+    char                        options_label[ENGINE_OPTIONS_LABEL_SIZE];
+    bool                        profile;
     
     int ret_val;
     
-    app_settings = (struct application_settings *) settings;
-    lib_name     = dc_setting_string_get(env, app_settings->library);
-    port_num     = dc_setting_in_port_t_get(env, app_settings->port_num);
-    ip_addr      = dc_setting_string_get(env, app_settings->ip_addr);
+    app_settings       = (struct application_settings *) settings;
+    lib_name           = dc_setting_string_get(env, app_settings->library);
+    port_num           = dc_setting_in_port_t_get(env, app_settings->port_num);
+    ip_addr            = dc_setting_string_get(env, app_settings->ip_addr);
+    profile            = dc_setting_bool_get(env, app_settings->profile);
+    handler_name       = dc_setting_string_get(env, app_settings->handler);
+    
+    memset(&options, 0, sizeof(struct engine_options));
+    options.stall_threshold_ms = dc_setting_uint16_get(env, app_settings->stall_threshold_ms);
+    options.ack_more           = dc_setting_bool_get(env, app_settings->ack_more);
+    options.budget_kib         = dc_setting_uint16_get(env, app_settings->budget_kib);
+    options.rcvlowat           = dc_setting_bool_get(env, app_settings->rcvlowat);
+    options.sink               = dc_setting_bool_get(env, app_settings->sink);
+    describe_engine_options(&options, handler_name, options_label, sizeof(options_label));
+    
+    if (handler_name && options.sink)
+    {
+        (void) fprintf(stderr, "Fatal: a request handler needs the payload, so it cannot be used with --sink\n");
+        return EXIT_FAILURE;
+    }
     
     // create core object
-    ret_val = setup_core_object(&co, env, err, port_num, ip_addr);
+    ret_val = setup_core_object(&co, env, err, port_num, ip_addr, &options);
     if (ret_val == -1)
     {
         return EXIT_FAILURE;
     }
     
+    handler_lib = NULL;
+    if (handler_name)
+    {
+        handler_lib = open_handler(&co, handler_name);
+        if (!handler_lib)
+        {
+            destroy_core_object(&co);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    if (profile && start_profiler() == -1)
+    {
+        // NOLINTNEXTLINE(concurrency-mt-unsafe) : No threads here
+        (void) fprintf(stderr, "Error: could not start profiler: %s\n", strerror(errno));
+    }
+    
     ret_val = run_core(&co, lib_name);
     
+    if (stop_profiler() == -1) // Runs in every process that returns from the library, so each writes its profile.
+    {
+        // NOLINTNEXTLINE(concurrency-mt-unsafe) : No threads here
+        (void) fprintf(stderr, "Error: could not write profile: %s\n", strerror(errno));
+    }
+    
+    if (report_syscall_stats(co.stats, lib_name, options_label) == -1)
+    {
+        // NOLINTNEXTLINE(concurrency-mt-unsafe) : No threads here
+        (void) fprintf(stderr, "Error: could not record syscall stats: %s\n", strerror(errno));
+    }
+    report_watchdog(co.watchdog, lib_name);
+    close_handler(&co, handler_lib, handler_name);
+    
     destroy_core_object(&co);
     return ret_val;
 }
@@ -268,6 +435,40 @@ static int run_core(struct core_object *co, const char *lib_name)
     return exit_status;
 }
 
+static void *open_handler(struct core_object *co, const char *handler_name)
+{
+    void *handler_lib;
+    
+    handler_lib = get_handler(&co->handler, handler_name, co->env);
+    if (!handler_lib)
+    {
+        return NULL;
+    }
+    
+    if (co->handler.initialize(&co->handler.state) == -1)
+    {
+        // NOLINTNEXTLINE(concurrency-mt-unsafe) : No threads here
+        (void) fprintf(stderr, "Fatal: could not initialize handler %s: %s\n", handler_name, strerror(errno));
+        memset(&co->handler, 0, sizeof(struct handler));
+        close_lib(handler_lib, handler_name);
+        return NULL;
+    }
+    
+    return handler_lib;
+}
+
+static void close_handler(struct core_object *co, void *handler_lib, const char *handler_name)
+{
+    if (!handler_lib)
+    {
+        return;
+    }
+    
+    co->handler.close(co->handler.state);
+    memset(&co->handler, 0, sizeof(struct handler));
+    close_lib(handler_lib, handler_name);
+}
+
 static int destroy_settings(const struct dc_env *env, struct dc_error *err, struct dc_application_settings **psettings)
 {
     struct application_settings *app_settings;
@@ -275,6 +476,7 @@ static int destroy_settings(const struct dc_env *env, struct dc_error *err, stru
     DC_TRACE(env);
     app_settings = (struct application_settings *) *psettings;
     dc_setting_string_destroy(env, &app_settings->library);
+    dc_setting_string_destroy(env, &app_settings->handler);
     dc_free(env, app_settings->opts.opts);
     dc_free(env, *psettings);
     
@@ -0,0 +1,427 @@
+#include "../include/profiler.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#define PROFILE_SAMPLES 32768 // Size of the ring; once full, the oldest samples are overwritten.
+#define PROFILE_MAX_DEPTH 64
+#define PROFILE_FILE_FORMAT "profile.%d.folded"
+#define PROFILE_FILE_NAME_SIZE 64
+#define US_PER_SEC 1000000
+
+/**
+ * profile_sample
+ * <p>
+ * One stack, innermost first: the interrupted instruction, then the return address of each frame above it.
+ * </p>
+ */
+struct profile_sample
+{
+    int  depth;
+    void *frames[PROFILE_MAX_DEPTH];
+};
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables): must be reachable from the signal handler
+/**
+ * The ring of samples. Mapped private, so forked processes sample into their own copy.
+ */
+static struct profile_sample *samples = NULL;
+
+/**
+ * The number of samples taken by this process. The next sample goes in samples[next_sample % PROFILE_SAMPLES].
+ */
+static _Atomic uint64_t next_sample = 0;
+
+/**
+ * Whether the signal handler should take samples.
+ */
+static volatile sig_atomic_t profiling = 0;
+
+/**
+ * The bounds of the stack of the profiled thread. A frame pointer outside them is not followed.
+ */
+static uintptr_t stack_low  = 0;
+static uintptr_t stack_high = 0;
+// NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+/**
+ * set_profile_timer
+ * <p>
+ * Arm or disarm the profiling timer.
+ * </p>
+ * @param interval_us the CPU time between signals in microseconds, 0 to disarm
+ * @return 0 on success, -1 and set errno on failure
+ */
+static int set_profile_timer(long interval_us);
+
+/**
+ * find_stack
+ * <p>
+ * Store the bounds of the stack of the calling thread in stack_low and stack_high.
+ * </p>
+ * @return 0 on success, -1 and set errno on failure
+ */
+static int find_stack(void);
+
+/**
+ * profile_handler
+ * <p>
+ * SIGPROF handler. Store the interrupted stack in the next slot of the ring. Only touches preallocated memory.
+ * </p>
+ * @param signal the signal received
+ * @param info the signal information
+ * @param context the context of the interrupted thread
+ */
+static void profile_handler(int signal, siginfo_t *info, void *context);
+
+/**
+ * walk_frames
+ * <p>
+ * Unwind the interrupted stack by following its frame pointers, which is async-signal-safe where backtrace() is
+ * not. Each frame pointer must lie above the one before it and inside the stack, so a register that does not hold
+ * a frame pointer ends the walk instead of faulting.
+ * </p>
+ * @param context the context of the interrupted thread
+ * @param frames where to store the addresses, innermost first
+ * @param max_depth the most addresses to store
+ * @return the number of addresses stored, 0 on architectures it does not know the registers of
+ */
+static int walk_frames(const ucontext_t *context, void **frames, int max_depth);
+
+/**
+ * profile_atfork_child
+ * <p>
+ * Start the profile of a forked child process over. Interval timers are not inherited across fork, so re-arm.
+ * </p>
+ */
+static void profile_atfork_child(void);
+
+/**
+ * normalize_samples
+ * <p>
+ * Replace each address with the start of the function it is in, so that samples taken at different points in the
+ * same functions fold into one stack. Addresses without a symbol are kept, stepped back into the call instruction.
+ * </p>
+ * @param count the number of samples in the ring
+ */
+static void normalize_samples(size_t count);
+
+/**
+ * compare_samples
+ * <p>
+ * Order samples so that identical stacks are adjacent.
+ * </p>
+ * @param a the first sample
+ * @param b the second sample
+ * @return less than, equal to, or greater than 0 as a orders before, with, or after b
+ */
+static int compare_samples(const void *a, const void *b);
+
+/**
+ * write_folded
+ * <p>
+ * Write the sorted samples as folded stacks to the profile file of this process.
+ * </p>
+ * @param count the number of samples in the ring
+ * @param taken the number of samples taken, including those overwritten
+ * @return 0 on success, -1 and set errno on failure
+ */
+static int write_folded(size_t count, uint64_t taken);
+
+/**
+ * write_frame
+ * <p>
+ * Write the name of one frame: its symbol if it has one, otherwise its library and offset.
+ * </p>
+ * @param file the file to write to
+ * @param address the address in the frame
+ */
+static void write_frame(FILE *file, const void *address);
+
+int start_profiler(void)
+{
+    struct sigaction sa;
+
+    samples = mmap(NULL, sizeof(struct profile_sample) * PROFILE_SAMPLES, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (samples == MAP_FAILED)
+    {
+        samples = NULL;
+        return -1;
+    }
+
+    if (find_stack() == -1)
+    {
+        return -1;
+    }
+
+    memset(&sa, 0, sizeof(struct sigaction));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags     = SA_RESTART | SA_SIGINFO; // Restart blocking recv and send instead of failing them with EINTR.
+    sa.sa_sigaction = profile_handler;
+    if (sigaction(SIGPROF, &sa, NULL) == -1)
+    {
+        return -1;
+    }
+
+    errno = pthread_atfork(NULL, NULL, profile_atfork_child);
+    if (errno)
+    {
+        return -1;
+    }
+
+    profiling = 1;
+
+    return set_profile_timer(PROFILE_INTERVAL_US);
+}
+
+int stop_profiler(void)
+{
+    uint64_t taken;
+    size_t   count;
+    int      ret_val;
+
+    if (!samples)
+    {
+        return 0;
+    }
+
+    profiling = 0;
+    (void) set_profile_timer(0);
+
+    taken = atomic_load(&next_sample);
+    count = (taken < PROFILE_SAMPLES) ? (size_t) taken : PROFILE_SAMPLES;
+    normalize_samples(count);
+    qsort(samples, count, sizeof(struct profile_sample), compare_samples);
+
+    ret_val = write_folded(count, taken);
+
+    (void) munmap(samples, sizeof(struct profile_sample) * PROFILE_SAMPLES);
+    samples = NULL;
+
+    return ret_val;
+}
+
+static int set_profile_timer(long interval_us)
+{
+    struct itimerval timer;
+
+    timer.it_interval.tv_sec  = interval_us / US_PER_SEC;
+    timer.it_interval.tv_usec = interval_us % US_PER_SEC;
+    timer.it_value            = timer.it_interval;
+
+    return setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+static int find_stack(void)
+{
+#if defined(__APPLE__)
+    stack_high = (uintptr_t) pthread_get_stackaddr_np(pthread_self());
+    stack_low  = stack_high - pthread_get_stacksize_np(pthread_self());
+#else
+    pthread_attr_t attr;
+    void           *low;
+    size_t         size;
+
+    errno = pthread_getattr_np(pthread_self(), &attr);
+    if (errno)
+    {
+        return -1;
+    }
+    errno = pthread_attr_getstack(&attr, &low, &size);
+    (void) pthread_attr_destroy(&attr);
+    if (errno)
+    {
+        return -1;
+    }
+    stack_low  = (uintptr_t) low;
+    stack_high = stack_low + size;
+#endif
+
+    return 0;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+
+static void profile_handler(int signal, siginfo_t *info, void *context)
+{
+    int                   saved_errno;
+    uint64_t              index;
+    struct profile_sample *sample;
+
+    saved_errno = errno;
+    if (profiling)
+    {
+        index  = atomic_fetch_add_explicit(&next_sample, 1, memory_order_relaxed);
+        sample = &samples[index % PROFILE_SAMPLES];
+        sample->depth = walk_frames((const ucontext_t *) context, sample->frames, PROFILE_MAX_DEPTH);
+    }
+    errno = saved_errno;
+}
+
+#pragma GCC diagnostic pop
+
+static int walk_frames(const ucontext_t *context, void **frames, int max_depth)
+{
+    const uintptr_t *frame;
+    uintptr_t       pc;
+    uintptr_t       fp;
+    uintptr_t       sp;
+    int             depth;
+
+#if defined(__linux__) && defined(__x86_64__)
+    pc = (uintptr_t) context->uc_mcontext.gregs[REG_RIP];
+    fp = (uintptr_t) context->uc_mcontext.gregs[REG_RBP];
+    sp = (uintptr_t) context->uc_mcontext.gregs[REG_RSP];
+#elif defined(__linux__) && defined(__aarch64__)
+    pc = (uintptr_t) context->uc_mcontext.pc;
+    fp = (uintptr_t) context->uc_mcontext.regs[29];
+    sp = (uintptr_t) context->uc_mcontext.sp;
+#elif defined(__APPLE__) && defined(__x86_64__)
+    pc = (uintptr_t) context->uc_mcontext->__ss.__rip;
+    fp = (uintptr_t) context->uc_mcontext->__ss.__rbp;
+    sp = (uintptr_t) context->uc_mcontext->__ss.__rsp;
+#elif defined(__APPLE__) && defined(__arm64__)
+    pc = (uintptr_t) context->uc_mcontext->__ss.__pc;
+    fp = (uintptr_t) context->uc_mcontext->__ss.__fp;
+    sp = (uintptr_t) context->uc_mcontext->__ss.__sp;
+#else
+    return 0;
+#endif
+
+    frames[0] = (void *) pc;
+    depth     = 1;
+    // A frame holds the caller's frame pointer, then the return address into the caller.
+    while (depth < max_depth && fp >= sp && fp >= stack_low && fp <= stack_high - 2 * sizeof(uintptr_t)
+           && fp % sizeof(uintptr_t) == 0)
+    {
+        frame = (const uintptr_t *) fp;
+        if (frame[1] == 0)
+        {
+            break;
+        }
+        frames[depth++] = (void *) frame[1];
+        if (frame[0] <= fp) // The stack grows down, so the caller's frame is above this one.
+        {
+            break;
+        }
+        fp = frame[0];
+    }
+
+    return depth;
+}
+
+static void profile_atfork_child(void)
+{
+    if (profiling)
+    {
+        atomic_store(&next_sample, 0);
+        (void) set_profile_timer(PROFILE_INTERVAL_US);
+    }
+}
+
+static void normalize_samples(size_t count)
+{
+    Dl_info info;
+    char    *address;
+
+    for (size_t s = 0; s < count; ++s)
+    {
+        for (int f = 0; f < samples[s].depth; ++f)
+        {
+            // Return addresses point after the call; step back into the call for callers of the sampled frame.
+            address = (char *) samples[s].frames[f] - ((f > 0) ? 1 : 0);
+            samples[s].frames[f] = (dladdr(address, &info) && info.dli_saddr) ? info.dli_saddr : address;
+        }
+    }
+}
+
+static int compare_samples(const void *a, const void *b)
+{
+    const struct profile_sample *sample_a = (const struct profile_sample *) a;
+    const struct profile_sample *sample_b = (const struct profile_sample *) b;
+
+    if (sample_a->depth != sample_b->depth)
+    {
+        return (sample_a->depth < sample_b->depth) ? -1 : 1;
+    }
+
+    return memcmp(sample_a->frames, sample_b->frames, (size_t) sample_a->depth * sizeof(void *));
+}
+
+static int write_folded(size_t count, uint64_t taken)
+{
+    char   file_name[PROFILE_FILE_NAME_SIZE];
+    FILE   *file;
+    size_t run_length;
+
+    (void) snprintf(file_name, sizeof(file_name), PROFILE_FILE_FORMAT, getpid());
+    file = fopen(file_name, "w");
+    if (!file)
+    {
+        return -1;
+    }
+
+    for (size_t s = 0; s < count; s += run_length)
+    {
+        run_length = 1;
+        while (s + run_length < count && compare_samples(&samples[s], &samples[s + run_length]) == 0)
+        {
+            ++run_length;
+        }
+
+        if (samples[s].depth == 0)
+        {
+            continue; // The registers of the interrupted thread are not known on this architecture.
+        }
+
+        // Folded stacks start at the root, which the walk puts last.
+        for (int f = samples[s].depth - 1; f >= 0; --f)
+        {
+            write_frame(file, samples[s].frames[f]);
+            (void) fputc((f > 0) ? ';' : ' ', file);
+        }
+        (void) fprintf(file, "%zu\n", run_length);
+    }
+
+    (void) fprintf(stdout, "Profile of %d: %" PRIu64 " samples, %zu kept, written to %s\n", getpid(), taken, count,
+                   file_name);
+
+    return fclose(file);
+}
+
+static void write_frame(FILE *file, const void *address)
+{
+    Dl_info    info;
+    const char *library;
+
+    if (!dladdr(address, &info))
+    {
+        (void) fprintf(file, "0x%" PRIxPTR, (uintptr_t) address);
+        return;
+    }
+
+    if (info.dli_sname)
+    {
+        (void) fputs(info.dli_sname, file);
+        return;
+    }
+
+    library = (info.dli_fname) ? strrchr(info.dli_fname, '/') : NULL;
+    library = (library) ? library + 1 : info.dli_fname;
+    (void) fprintf(file, "%s+0x%" PRIxPTR, (library) ? library : "?",
+                   (uintptr_t) address - (uintptr_t) info.dli_fbase);
+}
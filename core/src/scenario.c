@@ -0,0 +1,532 @@
+#include "../include/scenario.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SCENARIO_MAX_PHASES 1024 // after steps are cut.
+#define SCENARIO_MAX_SIZE (1024 * 1024) // the largest scenario file read.
+#define SCENARIO_LINE_SIZE 512
+#define SCENARIO_DELIMITERS " \t\r"
+
+/**
+ * scenario_parser
+ * <p>
+ * Where parsing a scenario has got to.
+ * </p>
+ */
+struct scenario_parser
+{
+    struct scenario *scenario;
+    struct scenario_phase phase; // The phase being read.
+    struct scenario_phase last; // The last phase finished, whole; the phase being read starts from it.
+    uint32_t steps; // The steps of the phase being read.
+    int phase_line; // The line the phase being read started on; 0 before the first phase.
+    int line;
+};
+
+/**
+ * parse_directive
+ * <p>
+ * Parse one line of a scenario.
+ * </p>
+ * @param parser the parser
+ * @param line the line, which is cut into words
+ * @param client the index of the client the phases are for
+ * @return 0 on success. -1 on failure, described on stderr.
+ */
+static int parse_directive(struct scenario_parser *parser, char *line, uint16_t client);
+
+/**
+ * parse_pair
+ * <p>
+ * Parse one KEY=VALUE of a directive into a phase.
+ * </p>
+ * @param parser the parser
+ * @param phase the phase
+ * @param pair the KEY=VALUE, which is cut in two
+ * @param whole whether the pair is for the whole phase, rather than one client
+ * @return 0 on success. -1 on failure, described on stderr.
+ */
+static int parse_pair(struct scenario_parser *parser, struct scenario_phase *phase, char *pair, bool whole);
+
+/**
+ * finish_phase
+ * <p>
+ * Add the phase being read to the scenario, cut into its steps.
+ * </p>
+ * @param parser the parser
+ * @return 0 on success. -1 on failure, described on stderr.
+ */
+static int finish_phase(struct scenario_parser *parser);
+
+/**
+ * parse_uint
+ * <p>
+ * Parse a decimal number no greater than a limit.
+ * </p>
+ * @param dst where to store the number
+ * @param buff the string, which must hold the number and nothing else
+ * @param max the limit
+ * @return 0 on success. -1 if the string is not such a number.
+ */
+static int parse_uint(uint32_t *dst, const char *buff, uint32_t max);
+
+/**
+ * parse_duration
+ * <p>
+ * Parse a duration in seconds, optionally suffixed with s, m or h.
+ * </p>
+ * @param dst where to store the duration, in seconds
+ * @param buff the string, which must hold the duration and nothing else
+ * @return 0 on success. -1 if the string is not a duration of at least a second.
+ */
+static int parse_duration(uint32_t *dst, const char *buff);
+
+/**
+ * parse_spec
+ * <p>
+ * Copy a setting whose value the client parses.
+ * </p>
+ * @param dst where to copy it, SCENARIO_SPEC_SIZE bytes
+ * @param buff the value
+ * @return 0 on success. -1 if it is empty or too long.
+ */
+static int parse_spec(char *dst, const char *buff);
+
+/**
+ * step_value
+ * <p>
+ * Interpolate a setting for one step of a phase.
+ * </p>
+ * @param from the value of the phase before
+ * @param to the value of the phase
+ * @param step the step, from 1
+ * @param steps the number of steps
+ * @return the value of the step
+ */
+static double step_value(double from, double to, uint32_t step, uint32_t steps);
+
+int scenario_parse(struct scenario *scenario, const char *text, uint16_t client)
+{
+    struct scenario_parser parser;
+    char line[SCENARIO_LINE_SIZE];
+    const char *end;
+    size_t len;
+    int result;
+
+    memset(scenario, 0, sizeof(struct scenario));
+    memset(&parser, 0, sizeof(struct scenario_parser));
+    parser.scenario = scenario;
+
+    result = 0;
+    while (result == 0 && *text != '\0')
+    {
+        ++parser.line;
+        end = strchr(text, '\n');
+        len = (end != NULL) ? (size_t) (end - text) : strlen(text);
+        if (len >= sizeof(line))
+        {
+            (void) fprintf(stderr, "scenario line %d: longer than %d bytes\n", parser.line, SCENARIO_LINE_SIZE - 1);
+            result = -1;
+            break;
+        }
+        memcpy(line, text, len);
+        line[len] = '\0';
+        text += len + ((end != NULL) ? 1 : 0);
+        result = parse_directive(&parser, line, client);
+    }
+    if (result == 0 && parser.phase_line > 0)
+    {
+        result = finish_phase(&parser);
+    }
+    if (result == 0 && scenario->count == 0)
+    {
+        (void) fprintf(stderr, "scenario: no phases\n");
+        result = -1;
+    }
+    if (result == -1)
+    {
+        scenario_free(scenario);
+    }
+
+    return result;
+}
+
+int scenario_read(char **dst, const char *file_name)
+{
+    FILE *file;
+    long size;
+    size_t nread;
+    int result;
+
+    file = fopen(file_name, "r");
+    if (file == NULL)
+    {
+        perror("opening scenario file");
+        return -1;
+    }
+
+    result = 0;
+    *dst = NULL;
+    if (fseek(file, 0, SEEK_END) == -1 || (size = ftell(file)) == -1 || fseek(file, 0, SEEK_SET) == -1)
+    {
+        perror("sizing scenario file");
+        result = -1;
+    }
+    else if (size > SCENARIO_MAX_SIZE)
+    {
+        (void) fprintf(stderr, "scenario file larger than %d bytes\n", SCENARIO_MAX_SIZE);
+        result = -1;
+    }
+    else if ((*dst = malloc((size_t) size + 1)) == NULL)
+    {
+        perror("malloc for scenario");
+        result = -1;
+    }
+    else
+    {
+        nread = fread(*dst, 1, (size_t) size, file);
+        if (nread < (size_t) size)
+        {
+            perror("reading scenario file");
+            result = -1;
+        }
+        (*dst)[nread] = '\0';
+    }
+    if (result == -1)
+    {
+        free(*dst);
+        *dst = NULL;
+    }
+    (void) fclose(file);
+
+    return result;
+}
+
+uint64_t scenario_duration(const struct scenario *scenario)
+{
+    uint64_t duration;
+
+    duration = 0;
+    for (size_t index = 0; index < scenario->count; ++index)
+    {
+        duration += scenario->phases[index].duration_sec;
+    }
+
+    return duration;
+}
+
+void scenario_free(struct scenario *scenario)
+{
+    free(scenario->phases);
+    scenario->phases = NULL;
+    scenario->count = 0;
+}
+
+static int parse_directive(struct scenario_parser *parser, char *line, uint16_t client)
+{
+    struct scenario_phase scratch;
+    struct scenario_phase *phase;
+    char *save;
+    char *word;
+    uint32_t index;
+
+    word = strtok_r(line, SCENARIO_DELIMITERS, &save);
+    if (word == NULL || word[0] == '#')
+    {
+        return 0;
+    }
+
+    if (strcmp(word, "phase") == 0)
+    {
+        if (parser->phase_line > 0 && finish_phase(parser) == -1)
+        {
+            return -1;
+        }
+        word = strtok_r(NULL, SCENARIO_DELIMITERS, &save);
+        if (word == NULL || strlen(word) >= SCENARIO_NAME_SIZE)
+        {
+            (void) fprintf(stderr, "scenario line %d: a phase needs a name of at most %d bytes\n", parser->line,
+                           SCENARIO_NAME_SIZE - 1);
+            return -1;
+        }
+        parser->phase = parser->last; // the settings carry on from the phase before.
+        strcpy(parser->phase.name, word); // NOLINT(clang-analyzer-security.insecureAPI.strcpy): length checked
+        parser->phase.duration_sec = 0;
+        parser->phase.measured = true;
+        parser->steps = 1;
+        parser->phase_line = parser->line;
+        phase = &parser->phase;
+    }
+    else if (strcmp(word, "client") == 0)
+    {
+        word = strtok_r(NULL, SCENARIO_DELIMITERS, &save);
+        if (parser->phase_line == 0 || word == NULL || parse_uint(&index, word, UINT16_MAX) == -1)
+        {
+            (void) fprintf(stderr, "scenario line %d: client settings need a client index, after a phase\n",
+                           parser->line);
+            return -1;
+        }
+        scratch = parser->phase; // another client's settings are checked all the same.
+        phase = (index == client) ? &parser->phase : &scratch;
+    }
+    else
+    {
+        (void) fprintf(stderr, "scenario line %d: expected phase or client, not %s\n", parser->line, word);
+        return -1;
+    }
+
+    for (word = strtok_r(NULL, SCENARIO_DELIMITERS, &save); word != NULL;
+         word = strtok_r(NULL, SCENARIO_DELIMITERS, &save))
+    {
+        if (parse_pair(parser, phase, word, phase == &parser->phase && parser->phase_line == parser->line) == -1)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int parse_pair(struct scenario_parser *parser, struct scenario_phase *phase, char *pair, bool whole)
+{
+    static const char *const names[] = {"threads", "connections", "depth", "rate", "arrival", "think", "sizes"};
+    unsigned int setting;
+    uint32_t value;
+    char *key;
+    char *equals;
+    char *end;
+    int result;
+
+    key = pair;
+    equals = strchr(pair, '=');
+    if (equals == NULL)
+    {
+        (void) fprintf(stderr, "scenario line %d: expected KEY=VALUE, not %s\n", parser->line, pair);
+        return -1;
+    }
+    *equals = '\0';
+
+    result = -1;
+    if (whole && (strcmp(key, "duration") == 0 || strcmp(key, "steps") == 0 || strcmp(key, "measure") == 0))
+    {
+        if (strcmp(key, "duration") == 0)
+        {
+            result = parse_duration(&phase->duration_sec, equals + 1);
+        }
+        else if (strcmp(key, "steps") == 0)
+        {
+            result = (parse_uint(&parser->steps, equals + 1, SCENARIO_MAX_PHASES) == 0 && parser->steps > 0) ? 0 : -1;
+        }
+        else if (strcmp(equals + 1, "on") == 0 || strcmp(equals + 1, "off") == 0)
+        {
+            phase->measured = strcmp(equals + 1, "on") == 0;
+            result = 0;
+        }
+        if (result == -1)
+        {
+            (void) fprintf(stderr, "scenario line %d: bad %s %s\n", parser->line, key, equals + 1);
+        }
+        return result;
+    }
+
+    setting = 0;
+    for (size_t index = 0; index < sizeof(names) / sizeof(names[0]); ++index)
+    {
+        if (strcmp(key, names[index]) == 0)
+        {
+            setting = 1U << index;
+        }
+    }
+
+    value = 0;
+    switch (setting)
+    {
+        case SCENARIO_THREADS:
+            result = parse_uint(&value, equals + 1, UINT16_MAX);
+            phase->threads = (uint16_t) value;
+            break;
+        case SCENARIO_CONNECTIONS:
+            result = parse_uint(&value, equals + 1, UINT16_MAX);
+            phase->connections = (uint16_t) value;
+            break;
+        case SCENARIO_DEPTH:
+            result = parse_uint(&value, equals + 1, UINT16_MAX);
+            phase->depth = (uint16_t) value;
+            break;
+        case SCENARIO_RATE:
+            errno = 0;
+            phase->rate = strtod(equals + 1, &end);
+            result = (end != equals + 1 && *end == '\0' && errno == 0 && phase->rate >= 0 && !isinf(phase->rate))
+                     ? 0 : -1;
+            break;
+        case SCENARIO_ARRIVAL:
+            result = parse_spec(phase->arrival, equals + 1);
+            break;
+        case SCENARIO_THINK:
+            result = parse_spec(phase->think, equals + 1);
+            break;
+        case SCENARIO_SIZES:
+            result = parse_spec(phase->sizes, equals + 1);
+            break;
+        default:
+            (void) fprintf(stderr, "scenario line %d: %s cannot be set %s\n", parser->line, key,
+                           (whole) ? "in a phase" : "for one client");
+            return -1;
+    }
+    if (result == -1)
+    {
+        (void) fprintf(stderr, "scenario line %d: bad %s %s\n", parser->line, key, equals + 1);
+        return -1;
+    }
+    phase->set |= setting;
+
+    return 0;
+}
+
+static int finish_phase(struct scenario_parser *parser)
+{
+    struct scenario_phase *phases;
+    struct scenario_phase *step;
+    const struct scenario_phase *from;
+    const struct scenario_phase *to;
+    uint32_t duration;
+
+    to = &parser->phase;
+    from = &parser->last;
+    duration = to->duration_sec;
+    if (duration == 0 || parser->steps > duration)
+    {
+        (void) fprintf(stderr, "scenario line %d: phase %s needs a duration of at least a second a step\n",
+                       parser->phase_line, to->name);
+        return -1;
+    }
+    if (parser->scenario->count + parser->steps > SCENARIO_MAX_PHASES)
+    {
+        (void) fprintf(stderr, "scenario line %d: more than %d phases, counting steps\n", parser->phase_line,
+                       SCENARIO_MAX_PHASES);
+        return -1;
+    }
+
+    phases = realloc(parser->scenario->phases, (parser->scenario->count + parser->steps) * sizeof(*phases));
+    if (phases == NULL)
+    {
+        perror("realloc for scenario phases");
+        return -1;
+    }
+    parser->scenario->phases = phases;
+
+    for (uint32_t index = 1; index <= parser->steps; ++index)
+    {
+        step = &phases[parser->scenario->count++];
+        *step = *to;
+        if (parser->steps == 1)
+        {
+            continue;
+        }
+        (void) snprintf(step->name, sizeof(step->name), "%.*s.%u", SCENARIO_NAME_SIZE - 7, to->name, index);
+        // the steps' durations add up to the phase's, however it divides.
+        step->duration_sec = (uint32_t) ((uint64_t) duration * index / parser->steps
+                                         - (uint64_t) duration * (index - 1) / parser->steps);
+        // a setting the phase before also had ramps from its value; others take the phase's at once.
+        if (from->set & to->set & SCENARIO_THREADS)
+        {
+            step->threads = (uint16_t) lround(step_value(from->threads, to->threads, index, parser->steps));
+        }
+        if (from->set & to->set & SCENARIO_CONNECTIONS)
+        {
+            step->connections = (uint16_t) lround(step_value(from->connections, to->connections, index,
+                                                             parser->steps));
+        }
+        if (from->set & to->set & SCENARIO_DEPTH)
+        {
+            step->depth = (uint16_t) lround(step_value(from->depth, to->depth, index, parser->steps));
+        }
+        if (from->set & to->set & SCENARIO_RATE)
+        {
+            step->rate = step_value(from->rate, to->rate, index, parser->steps);
+        }
+    }
+    parser->last = *to;
+
+    return 0;
+}
+
+static int parse_uint(uint32_t *dst, const char *buff, uint32_t max)
+{
+    unsigned long value;
+    char *end;
+
+    if (*buff < '0' || *buff > '9') // strtoul would take a sign.
+    {
+        return -1;
+    }
+    errno = 0;
+    value = strtoul(buff, &end, 10);
+    if (*end != '\0' || errno == ERANGE || value > max)
+    {
+        return -1;
+    }
+    *dst = (uint32_t) value;
+
+    return 0;
+}
+
+static int parse_duration(uint32_t *dst, const char *buff)
+{
+    char number[SCENARIO_NAME_SIZE];
+    uint32_t value;
+    uint32_t unit;
+    size_t len;
+
+    len = strlen(buff);
+    if (len == 0 || len >= sizeof(number))
+    {
+        return -1;
+    }
+    memcpy(number, buff, len + 1);
+    unit = 1;
+    switch (number[len - 1])
+    {
+        case 'h':
+            unit *= 60; // NOLINT(readability-magic-numbers)
+            // fall through
+        case 'm':
+            unit *= 60; // NOLINT(readability-magic-numbers)
+            // fall through
+        case 's':
+            number[len - 1] = '\0';
+            break;
+        default:
+            break;
+    }
+    if (parse_uint(&value, number, UINT32_MAX / unit) == -1 || value == 0)
+    {
+        return -1;
+    }
+    *dst = value * unit;
+
+    return 0;
+}
+
+static int parse_spec(char *dst, const char *buff)
+{
+    size_t len;
+
+    len = strlen(buff);
+    if (len == 0 || len >= SCENARIO_SPEC_SIZE)
+    {
+        return -1;
+    }
+    memcpy(dst, buff, len + 1);
+
+    return 0;
+}
+
+static double step_value(double from, double to, uint32_t step, uint32_t steps)
+{
+    return from + (to - from) * step / steps;
+}
@@ -0,0 +1,223 @@
+#include "../include/search.h"
+#include "../include/duration.h"
+#include "../../protocol.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEARCH_MAX_STEPS 32
+#define SEARCH_GROWTH 2 // How much the rate grows each step until one misses the objective.
+#define SEARCH_PRECISION ((double) 5 / 100) // How near the lowest rate missed the highest sustained is at the end.
+#define SEARCH_MIN_RATE 1 // The lowest rate tried, should nothing be sustained.
+#define SEARCH_COMPLETED ((double) 95 / 100) // The share of the requests offered a sustained step completes.
+#define NS_PER_US ((double) 1000)
+#define NS_PER_SEC ((double) 1000000000)
+
+/**
+ * parse_latency
+ * <p>
+ * Parse the latency of an objective, a duration as duration_parse takes it, of at least a nanosecond.
+ * </p>
+ * @param dst where to store the latency, in nanoseconds
+ * @param buff the string, which must hold the latency and nothing else
+ * @return 0 on success. -1 if the string is not a duration, or rounds to 0 or past INT64_MAX nanoseconds.
+ */
+static int parse_latency(uint64_t *dst, const char *buff);
+
+int search_slo_parse(struct search_slo *slo, const char *spec)
+{
+    char buff[sizeof(slo->spec)];
+    char *save;
+    char *field;
+    char *end;
+
+    if (strlen(spec) >= sizeof(buff) || spec[0] != 'p')
+    {
+        return -1;
+    }
+    memset(slo, 0, sizeof(struct search_slo));
+    strcpy(slo->spec, spec); // NOLINT(clang-analyzer-security.insecureAPI.strcpy): length checked
+    strcpy(buff, spec + 1); // NOLINT(clang-analyzer-security.insecureAPI.strcpy): length checked
+
+    field = strtok_r(buff, ":", &save);
+    errno = 0;
+    slo->percentile = (field != NULL) ? strtod(field, &end) : 0;
+    if (field == NULL || end == field || *end != '\0' || errno != 0 || !(slo->percentile > 0)
+        || slo->percentile > 100)
+    {
+        return -1;
+    }
+
+    field = strtok_r(NULL, ":", &save);
+    if (field == NULL || parse_latency(&slo->latency_ns, field) == -1)
+    {
+        return -1;
+    }
+
+    slo->error_rate = 2; // any share of requests lost holds to it.
+    field = strtok_r(NULL, ":", &save);
+    if (field != NULL)
+    {
+        errno = 0;
+        slo->error_rate = strtod(field, &end) / 100;
+        if (end == field || strcmp(end, "%") != 0 || errno != 0 || !(slo->error_rate >= 0) || slo->error_rate > 1)
+        {
+            return -1;
+        }
+    }
+
+    return (strtok_r(NULL, ":", &save) == NULL) ? 0 : -1;
+}
+
+void search_init(struct search *search, const struct search_slo *slo, double rate)
+{
+    memset(search, 0, sizeof(struct search));
+    search->slo = *slo;
+    search->rate = rate;
+}
+
+void search_judge(const struct search *search, const struct search_result *result, struct search_step *step)
+{
+    double lost;
+
+    memset(step, 0, sizeof(struct search_step));
+    step->index = search->steps + 1;
+    step->rate = search->rate;
+    step->throughput = (result->measured_ns > 0) ? (double) result->requests * NS_PER_SEC
+                                                   / (double) result->measured_ns : 0;
+    step->p50_ns = histogram_percentile(&result->latency, 50);
+    step->latency_ns = histogram_percentile(&result->latency, search->slo.percentile);
+    step->max_ns = result->latency.max;
+    step->requests = result->requests;
+    step->errors = result->errors;
+
+    lost = (result->requests + result->errors > 0)
+           ? (double) result->errors / (double) (result->requests + result->errors) : 0;
+    step->sustained = result->latency.count > 0 && step->latency_ns <= search->slo.latency_ns
+                      && lost <= search->slo.error_rate && step->throughput >= step->rate * SEARCH_COMPLETED;
+}
+
+bool search_next(struct search *search, const struct search_step *step)
+{
+    ++search->steps;
+    if (step->sustained && (!search->have_sustained || step->rate > search->sustained))
+    {
+        search->have_sustained = true;
+        search->sustained = step->rate;
+        search->best = *step;
+    }
+    else if (!step->sustained && (!search->have_missed || step->rate < search->missed))
+    {
+        search->have_missed = true;
+        search->missed = step->rate;
+    }
+
+    if (search->steps >= SEARCH_MAX_STEPS)
+    {
+        return false;
+    }
+    if (!search->have_missed)
+    {
+        search->rate = search->sustained * SEARCH_GROWTH;
+        return true;
+    }
+    if (!search->have_sustained)
+    {
+        search->rate = search->missed / 2;
+        return search->rate >= SEARCH_MIN_RATE;
+    }
+    // a rate missed below one sustained is noise in the measurements; the two are as close as they will get.
+    if (search->missed - search->sustained <= search->sustained * SEARCH_PRECISION)
+    {
+        return false;
+    }
+    search->rate = (search->sustained + search->missed) / 2;
+
+    return true;
+}
+
+void search_result_merge(struct search_result *dst, const struct search_result *src)
+{
+    dst->requests += src->requests;
+    dst->errors += src->errors;
+    if (src->measured_ns > dst->measured_ns) // the clients measure side by side, not one after another.
+    {
+        dst->measured_ns = src->measured_ns;
+    }
+    histogram_merge(&dst->latency, &src->latency);
+}
+
+void search_result_encode(const struct search_result *result, uint8_t *buf)
+{
+    protocol_put_u64(buf, result->requests);
+    protocol_put_u64(buf + 8, result->errors);
+    protocol_put_u64(buf + 16, result->measured_ns);
+    protocol_put_u64(buf + 24, result->latency.count);
+    protocol_put_u64(buf + 32, result->latency.sum);
+    protocol_put_u64(buf + 40, result->latency.max);
+    for (size_t index = 0; index < HISTOGRAM_BUCKETS; ++index)
+    {
+        protocol_put_u64(buf + 48 + index * sizeof(uint64_t), result->latency.buckets[index]);
+    }
+}
+
+void search_result_decode(struct search_result *result, const uint8_t *buf)
+{
+    result->requests = protocol_get_u64(buf);
+    result->errors = protocol_get_u64(buf + 8);
+    result->measured_ns = protocol_get_u64(buf + 16);
+    result->latency.count = protocol_get_u64(buf + 24);
+    result->latency.sum = protocol_get_u64(buf + 32);
+    result->latency.max = protocol_get_u64(buf + 40);
+    for (size_t index = 0; index < HISTOGRAM_BUCKETS; ++index)
+    {
+        result->latency.buckets[index] = protocol_get_u64(buf + 48 + index * sizeof(uint64_t));
+    }
+}
+
+void search_write_step(const struct search *search, const struct search_step *step, FILE *csv)
+{
+    if (step->index == 1)
+    {
+        (void) fprintf(csv, "step,offered (req/s),throughput (req/s),p50 (us),p%g (us),max (us),requests,errors,"
+                            "sustained\n", search->slo.percentile);
+    }
+    (void) fprintf(csv, "%u,%.1f,%.1f,%.1f,%.1f,%.1f,%" PRIu64 ",%" PRIu64 ",%s\n", step->index, step->rate,
+                   step->throughput, (double) step->p50_ns / NS_PER_US, (double) step->latency_ns / NS_PER_US,
+                   (double) step->max_ns / NS_PER_US, step->requests, step->errors, (step->sustained) ? "yes" : "no");
+    (void) fflush(csv);
+}
+
+void search_print(const struct search *search, FILE *out)
+{
+    if (!search->have_sustained)
+    {
+        (void) fprintf(out, "Saturation search, %s: no rate tried held to it, the lowest being %.1f requests/s\n",
+                       search->slo.spec, search->missed);
+        return;
+    }
+    (void) fprintf(out, "Saturation search, %s: %.1f requests/s sustained, offered %.1f, with p50 %.1fus and p%g"
+                        " %.1fus, after %u steps\n", search->slo.spec, search->best.throughput, search->best.rate,
+                   (double) search->best.p50_ns / NS_PER_US, search->slo.percentile,
+                   (double) search->best.latency_ns / NS_PER_US, search->steps);
+    if (!search->have_missed)
+    {
+        (void) fprintf(out, "    the rate never missed the objective; the target may have more headroom\n");
+    }
+}
+
+static int parse_latency(uint64_t *dst, const char *buff)
+{
+    double ns;
+
+    if (duration_parse(&ns, buff) == -1 || !(ns < (double) INT64_MAX))
+    {
+        return -1;
+    }
+    *dst = (uint64_t) llround(ns);
+
+    return (*dst > 0) ? 0 : -1;
+}
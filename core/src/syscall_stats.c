@@ -0,0 +1,268 @@
+#include "../include/syscall_stats.h"
+#include "../include/crc32c.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#define STATS_FILE_NAME "syscalls.csv"
+#define STATS_OLD_FILE_NAME "syscalls.old.csv" // Where a file with other columns is moved; replaced each time.
+#define STATS_OPEN_MODE "a+" // Mode is set to append so that every run is tracked, and to read to check the header.
+#define STATS_HEADER_SIZE 1024
+#define US_PER_SEC ((double) 1000000)
+#define BYTES_PER_MIB ((double) (1024 * 1024))
+
+/**
+ * run_cost
+ * <p>
+ * What a run cost per completed message and per MiB of payload, and what its payload checksums found.
+ * </p>
+ */
+struct run_cost
+{
+    double   payload_mib;
+    double   user_us_per_message;
+    double   sys_us_per_message;
+    double   cpu_us_per_mib;
+    uint64_t checksums;
+    uint64_t checksum_mismatches;
+};
+
+/**
+ * Names of the counted calls, in the order of Syscall_Kinds.
+ */
+static const char *const syscall_names[SYSCALL_KINDS] = {
+        "accept",
+        "recv",
+        "send",
+        "sendmsg",
+        "recvmsg",
+        "poll",
+        "select",
+        "read",
+        "write",
+        "sem_wait",
+        "sem_post",
+        "getpeername",
+        "ioctl",
+        "setsockopt",
+        "splice"
+};
+
+/**
+ * format_stats_header
+ * <p>
+ * Format the header row of the stats file, newline included.
+ * </p>
+ * @param buf where to store the header
+ * @param size the size of buf, at least STATS_HEADER_SIZE
+ */
+static void format_stats_header(char *buf, size_t size);
+
+/**
+ * open_stats_file
+ * <p>
+ * Open the stats file to append a row. A file whose header is not this build's, left by a build with other columns,
+ * is moved to STATS_OLD_FILE_NAME, and a new one started; its rows would not line up with the header otherwise.
+ * </p>
+ * @return the file, positioned after its header, NULL and set errno on failure
+ */
+static FILE *open_stats_file(void);
+
+/**
+ * write_stats_row
+ * <p>
+ * Append a row of per-message call averages to the stats file, after the header if the file is new.
+ * </p>
+ * @param lib_name the name of the library which was run
+ * @param options_label the engine options of the run
+ * @param messages the number of completed messages
+ * @param per_message the average number of each call per message
+ * @param total_per_message the average number of all calls per message
+ * @param cost the CPU cost of the run
+ * @return 0 on success, -1 and set errno on failure
+ */
+static int write_stats_row(const char *lib_name, const char *options_label, uint64_t messages,
+                           const double *per_message, double total_per_message, const struct run_cost *cost);
+
+/**
+ * get_run_cost
+ * <p>
+ * Get the CPU time used by this process and its waited for children, per message and per MiB of payload.
+ * </p>
+ * @param stats the stats object
+ * @param messages the number of completed messages, not 0
+ * @param cost where to store the cost
+ * @return 0 on success, -1 and set errno on failure
+ */
+static int get_run_cost(struct syscall_stats *stats, uint64_t messages, struct run_cost *cost);
+
+struct syscall_stats *setup_syscall_stats(void)
+{
+    struct syscall_stats *stats;
+
+    // Shared so that the counts of forked child processes are visible to the parent.
+    stats = mmap(NULL, sizeof(struct syscall_stats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (stats == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    memset(stats, 0, sizeof(struct syscall_stats)); // Anonymous maps are zeroed; here for clarity.
+    stats->owner = getpid();
+
+    return stats;
+}
+
+int report_syscall_stats(struct syscall_stats *stats, const char *lib_name, const char *options_label)
+{
+    double          per_message[SYSCALL_KINDS];
+    double          total_per_message;
+    uint64_t        messages;
+    struct run_cost cost;
+
+    if (!stats || stats->owner != getpid()) // Child processes do not report.
+    {
+        return 0;
+    }
+
+    messages = atomic_load(&stats->messages);
+    if (messages == 0)
+    {
+        (void) fprintf(stdout, "%s: no completed messages, syscalls/msg not available\n", lib_name);
+        return 0;
+    }
+
+    total_per_message = 0;
+    (void) fprintf(stdout, "%s: %" PRIu64 " messages\n", lib_name, messages);
+    for (size_t kind = 0; kind < SYSCALL_KINDS; ++kind)
+    {
+        per_message[kind] = (double) atomic_load(&stats->calls[kind]) / (double) messages;
+        total_per_message += per_message[kind];
+        if (per_message[kind] > 0)
+        {
+            (void) fprintf(stdout, "    %-12s %8.2f/msg\n", syscall_names[kind], per_message[kind]);
+        }
+    }
+    (void) fprintf(stdout, "%s: %.2f syscalls/msg\n", lib_name, total_per_message);
+
+    if (get_run_cost(stats, messages, &cost) == -1)
+    {
+        return -1;
+    }
+    (void) fprintf(stdout, "%s: cpu %.2f us/msg user, %.2f us/msg sys, %.2f us/MiB over %.2f MiB of payload (%s)\n",
+                   lib_name, cost.user_us_per_message, cost.sys_us_per_message, cost.cpu_us_per_mib,
+                   cost.payload_mib, options_label);
+    if (cost.checksums > 0)
+    {
+        (void) fprintf(stdout, "%s: %" PRIu64 " checksums verified with %s, %" PRIu64 " mismatched\n", lib_name,
+                       cost.checksums, crc32c_kernel(), cost.checksum_mismatches);
+    }
+
+    return write_stats_row(lib_name, options_label, messages, per_message, total_per_message, &cost);
+}
+
+static int get_run_cost(struct syscall_stats *stats, uint64_t messages, struct run_cost *cost)
+{
+    struct rusage self;
+    struct rusage children;
+    double        user_us;
+    double        sys_us;
+
+    if (getrusage(RUSAGE_SELF, &self) == -1 || getrusage(RUSAGE_CHILDREN, &children) == -1)
+    {
+        return -1;
+    }
+
+    user_us = (double) (self.ru_utime.tv_sec + children.ru_utime.tv_sec) * US_PER_SEC +
+              (double) (self.ru_utime.tv_usec + children.ru_utime.tv_usec);
+    sys_us  = (double) (self.ru_stime.tv_sec + children.ru_stime.tv_sec) * US_PER_SEC +
+              (double) (self.ru_stime.tv_usec + children.ru_stime.tv_usec);
+
+    cost->payload_mib         = (double) atomic_load(&stats->payload_bytes) / BYTES_PER_MIB;
+    cost->user_us_per_message = user_us / (double) messages;
+    cost->sys_us_per_message  = sys_us / (double) messages;
+    cost->cpu_us_per_mib      = (cost->payload_mib > 0) ? (user_us + sys_us) / cost->payload_mib : 0;
+    cost->checksums           = atomic_load(&stats->checksums);
+    cost->checksum_mismatches = atomic_load(&stats->checksum_mismatches);
+
+    return 0;
+}
+
+static void format_stats_header(char *buf, size_t size)
+{
+    size_t len;
+
+    len = (size_t) snprintf(buf, size, "library,messages");
+    for (size_t kind = 0; kind < SYSCALL_KINDS; ++kind)
+    {
+        len += (size_t) snprintf(buf + len, size - len, ",%s/msg", syscall_names[kind]);
+    }
+    (void) snprintf(buf + len, size - len, ",syscalls/msg,payload (MiB),cpu user (us)/msg,cpu sys (us)/msg"
+                                           ",cpu (us)/MiB,checksums,checksum mismatches,options\n");
+}
+
+static FILE *open_stats_file(void)
+{
+    char header[STATS_HEADER_SIZE];
+    char found[STATS_HEADER_SIZE];
+    FILE *stats_file;
+
+    format_stats_header(header, sizeof(header));
+    stats_file = fopen(STATS_FILE_NAME, STATS_OPEN_MODE);
+    if (stats_file && fseek(stats_file, 0, SEEK_END) == 0 && ftell(stats_file) > 0)
+    {
+        rewind(stats_file);
+        if (fgets(found, sizeof(found), stats_file) && strcmp(found, header) == 0)
+        {
+            return stats_file; // Rows are appended whatever the position.
+        }
+        (void) fclose(stats_file);
+        if (rename(STATS_FILE_NAME, STATS_OLD_FILE_NAME) == -1)
+        {
+            return NULL;
+        }
+        (void) fprintf(stderr, "%s has other columns, moved to %s\n", STATS_FILE_NAME, STATS_OLD_FILE_NAME);
+        stats_file = fopen(STATS_FILE_NAME, STATS_OPEN_MODE);
+    }
+    if (stats_file && fputs(header, stats_file) == EOF)
+    {
+        (void) fclose(stats_file);
+        return NULL;
+    }
+
+    return stats_file;
+}
+
+static int write_stats_row(const char *lib_name, const char *options_label, uint64_t messages,
+                           const double *per_message, double total_per_message, const struct run_cost *cost)
+{
+    FILE *stats_file;
+
+    stats_file = open_stats_file();
+    if (!stats_file)
+    {
+        return -1;
+    }
+
+    (void) fprintf(stats_file, "%s,%" PRIu64, lib_name, messages);
+    for (size_t kind = 0; kind < SYSCALL_KINDS; ++kind)
+    {
+        (void) fprintf(stats_file, ",%lf", per_message[kind]);
+    }
+    (void) fprintf(stats_file, ",%lf,%lf,%lf,%lf,%lf,%" PRIu64 ",%" PRIu64 ",%s\n", total_per_message,
+                   cost->payload_mib, cost->user_us_per_message, cost->sys_us_per_message, cost->cpu_us_per_mib,
+                   cost->checksums, cost->checksum_mismatches, options_label);
+
+    return fclose(stats_file);
+}
+
+void destroy_syscall_stats(struct syscall_stats *stats)
+{
+    if (stats)
+    {
+        (void) munmap(stats, sizeof(struct syscall_stats));
+    }
+}
@@ -1,9 +1,12 @@
 #include "../include/objects.h"
+#include "../include/syscall_stats.h"
 #include "../include/util.h"
+#include "../include/watchdog.h"
 
 #include <arpa/inet.h>
 #include <dlfcn.h>
 #include <mem_manager/manager.h>
+#include <stdio.h>
 #include <string.h>
 
 #define LOG_FILE_NAME "log.csv"
@@ -12,6 +15,11 @@
 #define API_INIT "initialize_server"
 #define API_RUN "run_server"
 #define API_CLOSE "close_server"
+#define HANDLER_INIT "handler_initialize"
+#define HANDLER_BEGIN "on_message_begin"
+#define HANDLER_MESSAGE "on_message"
+#define HANDLER_END "on_message_end"
+#define HANDLER_CLOSE "handler_close"
 
 /**
  * open_file
@@ -65,13 +73,14 @@ void trace_reporter(const struct dc_env *env, const char *file_name, const char
 }
 
 int setup_core_object(struct core_object *co, const struct dc_env *env, struct dc_error *err, const in_port_t port_num,
-                      const char *ip_addr)
+                      const char *ip_addr, const struct engine_options *options)
 {
     DC_TRACE(env);
     memset(co, 0, sizeof(struct core_object));
     
-    co->env = env;
-    co->err = err;
+    co->env     = env;
+    co->err     = err;
+    co->options = *options;
     co->mm  = init_mem_manager();
     if (!co->mm)
     {
@@ -86,6 +95,20 @@ int setup_core_object(struct core_object *co, const struct dc_env *env, struct d
         (void) fprintf(stderr, "Fatal: could not open %s: %s\n", LOG_FILE_NAME, strerror(errno));
         return -1;
     }
+    co->stats = setup_syscall_stats();
+    if (!co->stats)
+    {
+        // NOLINTNEXTLINE(concurrency-mt-unsafe) : No threads here
+        (void) fprintf(stderr, "Fatal: could not set up syscall stats: %s\n", strerror(errno));
+        return -1;
+    }
+    co->watchdog = setup_watchdog(co->mm, options->stall_threshold_ms);
+    if (!co->watchdog)
+    {
+        // NOLINTNEXTLINE(concurrency-mt-unsafe) : No threads here
+        (void) fprintf(stderr, "Fatal: could not set up event loop watchdog: %s\n", strerror(errno));
+        return -1;
+    }
     
     if (assemble_listen_addr(&co->listen_addr, port_num, ip_addr) == -1)
     {
@@ -97,6 +120,15 @@ int setup_core_object(struct core_object *co, const struct dc_env *env, struct d
     return 0;
 }
 
+void describe_engine_options(const struct engine_options *options, const char *handler_name, char *label,
+                             size_t size)
+{
+    (void) snprintf(label, size, "budget=%u ack-more=%s rcvlowat=%s sink=%s handler=%s",
+                    (unsigned int) options->budget_kib, (options->ack_more) ? "on" : "off",
+                    (options->rcvlowat) ? "on" : "off", (options->sink) ? "on" : "off",
+                    (handler_name) ? handler_name : "none");
+}
+
 static FILE *open_file(const char *file_name, const char *mode)
 {
     FILE *file;
@@ -207,6 +239,64 @@ void *get_api(struct api_functions *api, const char *lib_name, const struct dc_e
     return lib;
 }
 
+void *get_handler(struct handler *handler, const char *lib_name, const struct dc_env *env)
+{
+    DC_TRACE(env);
+    void *lib;
+    bool get_func_err;
+    
+    // NOLINTBEGIN(concurrency-mt-unsafe) : No threads here
+    lib = open_lib(lib_name, RTLD_LAZY);
+    if (lib == NULL)
+    {
+        (void) fprintf(stderr, "Fatal: could not open handler library %s: %s\n", lib_name, dlerror());
+        return lib;
+    }
+    
+    memset(handler, 0, sizeof(struct handler));
+    get_func_err = false;
+    handler->initialize = (int (*)(void **)) get_func(lib, HANDLER_INIT);
+    if (handler->initialize == NULL)
+    {
+        (void) fprintf(stderr, "Fatal: could not load handler function %s: %s\n", HANDLER_INIT, strerror(errno));
+        get_func_err = true;
+    }
+    handler->begin = (int (*)(void *, uint64_t, void **)) get_func(lib, HANDLER_BEGIN);
+    if (handler->begin == NULL)
+    {
+        (void) fprintf(stderr, "Fatal: could not load handler function %s: %s\n", HANDLER_BEGIN, strerror(errno));
+        get_func_err = true;
+    }
+    handler->on_message = (handler_message) get_func(lib, HANDLER_MESSAGE);
+    if (handler->on_message == NULL)
+    {
+        (void) fprintf(stderr, "Fatal: could not load handler function %s: %s\n", HANDLER_MESSAGE, strerror(errno));
+        get_func_err = true;
+    }
+    handler->end = (void (*)(void *, void *)) get_func(lib, HANDLER_END);
+    if (handler->end == NULL)
+    {
+        (void) fprintf(stderr, "Fatal: could not load handler function %s: %s\n", HANDLER_END, strerror(errno));
+        get_func_err = true;
+    }
+    handler->close = (void (*)(void *)) get_func(lib, HANDLER_CLOSE);
+    if (handler->close == NULL)
+    {
+        (void) fprintf(stderr, "Fatal: could not load handler function %s: %s\n", HANDLER_CLOSE, strerror(errno));
+        get_func_err = true;
+    }
+    // NOLINTEND(concurrency-mt-unsafe)
+    
+    if (get_func_err)
+    {
+        memset(handler, 0, sizeof(struct handler));
+        close_lib(lib, lib_name);
+        return NULL;
+    }
+    
+    return lib;
+}
+
 static void *get_func(void *lib, const char *func_name)
 {
     void *func;
@@ -223,5 +313,6 @@ void destroy_core_object(struct core_object *co)
     {
         (void) fclose(co->log_file);
     }
+    destroy_syscall_stats(co->stats);
     free_mem_manager(co->mm);
 }
@@ -0,0 +1,55 @@
+#include "../include/watchdog.h"
+
+#include <inttypes.h>
+
+#define NS_PER_MS 1000000
+
+struct watchdog *setup_watchdog(struct memory_manager *mm, uint16_t threshold_ms)
+{
+    struct watchdog *wd;
+
+    wd = (struct watchdog *) Mmm_calloc(1, sizeof(struct watchdog), mm);
+    if (!wd)
+    {
+        return NULL;
+    }
+
+    wd->threshold_ns = (uint64_t) threshold_ms * NS_PER_MS;
+    wd->slowest_fd   = -1;
+
+    return wd;
+}
+
+void watchdog_iteration_end(struct watchdog *wd)
+{
+    uint64_t iteration_ns;
+
+    if (!wd)
+    {
+        return;
+    }
+
+    iteration_ns = now_ns() - wd->wake_ns;
+    histogram_record(&wd->iteration, iteration_ns);
+
+    if (wd->threshold_ns && iteration_ns > wd->threshold_ns)
+    {
+        ++wd->stalls;
+        (void) fprintf(stderr, "Stall: loop iteration took %.3f ms (threshold %" PRIu64 " ms); "
+                               "%zu descriptors serviced, slowest fd %d took %.3f ms\n",
+                       (double) iteration_ns / (double) NS_PER_MS, wd->threshold_ns / NS_PER_MS, wd->serviced,
+                       wd->slowest_fd, (double) wd->slowest_ns / (double) NS_PER_MS);
+    }
+}
+
+void report_watchdog(const struct watchdog *wd, const char *lib_name)
+{
+    if (!wd || wd->iteration.count == 0) // Nothing ran, or a child process which never ran the loop.
+    {
+        return;
+    }
+
+    (void) fprintf(stdout, "%s: event loop, %" PRIu64 " stalls\n", lib_name, wd->stalls);
+    histogram_print(&wd->lag, "    ready lag", stdout);
+    histogram_print(&wd->iteration, "    iteration", stdout);
+}
@@ -0,0 +1,55 @@
+#ifndef HASH_HANDLER_HASH_HANDLER_H
+#define HASH_HANDLER_HASH_HANDLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The environment variable giving the number of times each payload is hashed, to scale the CPU cost of a message.
+ */
+#define HASH_ROUNDS_ENV "SCALABLE_SERVER_HASH_ROUNDS"
+#define DEFAULT_HASH_ROUNDS 1
+
+#define FNV1A_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV1A_PRIME 0x100000001b3ULL
+
+/**
+ * hash_state
+ * <p>
+ * The state of the hash handler in one process. Each message is hashed with 64-bit FNV-1a, with every byte mixed
+ * in once per round. The hash depends only on the payload, not on how it was split into chunks, so digests can be
+ * compared across engines. The hashes of the messages that ended are folded together and reported when the handler
+ * closes, which also keeps the work from being optimised away.
+ * </p>
+ */
+struct hash_state {
+    unsigned int rounds;
+    uint64_t     digest; // Sum of the hashes of all messages, so that it does not depend on their order.
+    uint64_t     messages;
+    uint64_t     bytes;
+};
+
+/**
+ * hash_message
+ * <p>
+ * The state of one message being received, so that messages received side by side are hashed apart.
+ * </p>
+ */
+struct hash_message {
+    uint64_t hash; // Running hash of the payload so far.
+};
+
+/**
+ * fnv1a_update
+ * <p>
+ * Continue a 64-bit FNV-1a hash over more bytes, mixing in each byte rounds times.
+ * </p>
+ * @param hash the hash so far, FNV1A_OFFSET_BASIS to start
+ * @param bytes the bytes to hash
+ * @param len the number of bytes
+ * @param rounds the number of times to mix in each byte, at least 1
+ * @return the updated hash
+ */
+uint64_t fnv1a_update(uint64_t hash, const uint8_t *bytes, size_t len, unsigned int rounds);
+
+#endif //HASH_HANDLER_HASH_HANDLER_H
@@ -0,0 +1,144 @@
+#include "../include/hash_handler.h"
+#include "../../api_functions.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BYTES_PER_MIB ((double) (1024 * 1024))
+#define DECIMAL 10
+
+/**
+ * get_rounds
+ * <p>
+ * Read the number of hash rounds from the environment.
+ * </p>
+ * @param rounds where to store the number of rounds
+ * @return 0 on success, -1 and set errno to EINVAL if the value is not a positive number
+ */
+static int get_rounds(unsigned int *rounds);
+
+int handler_initialize(void **state)
+{
+    struct hash_state *hs;
+    
+    hs = (struct hash_state *) calloc(1, sizeof(struct hash_state));
+    if (!hs)
+    {
+        return -1;
+    }
+    
+    if (get_rounds(&hs->rounds) == -1)
+    {
+        free(hs);
+        return -1;
+    }
+    *state = hs;
+    
+    return 0;
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+
+int on_message_begin(void *state, uint64_t length, void **message)
+{
+    struct hash_message *hm;
+    
+    hm = (struct hash_message *) malloc(sizeof(struct hash_message));
+    if (!hm)
+    {
+        return -1;
+    }
+    hm->hash = FNV1A_OFFSET_BASIS;
+    
+    *message = hm;
+    
+    return 0;
+}
+
+int on_message(void *state, void *message, const uint8_t *chunk, size_t chunk_len, uint64_t length,
+               struct handler_response *response)
+{
+    struct hash_state   *hs;
+    struct hash_message *hm;
+    
+    hs = (struct hash_state *) state;
+    hm = (struct hash_message *) message;
+    if (chunk)
+    {
+        hm->hash = fnv1a_update(hm->hash, chunk, chunk_len, hs->rounds);
+        return 0;
+    }
+    
+    // The end of the message. The response keeps its default: the length, as the engines ack without a handler.
+    hs->digest += hm->hash;
+    hs->bytes  += length;
+    ++hs->messages;
+    
+    return 0;
+}
+
+void on_message_end(void *state, void *message)
+{
+    free(message);
+}
+
+#pragma GCC diagnostic pop
+
+void handler_close(void *state)
+{
+    struct hash_state *hs;
+    
+    hs = (struct hash_state *) state;
+    if (hs->messages)
+    {
+        (void) fprintf(stdout, "hash-handler %d: %" PRIu64 " messages, %.2f MiB hashed %u time(s), digest %016" PRIx64
+                               "\n", getpid(), hs->messages, (double) hs->bytes / BYTES_PER_MIB, hs->rounds,
+                       hs->digest);
+    }
+    free(hs);
+}
+
+uint64_t fnv1a_update(uint64_t hash, const uint8_t *bytes, size_t len, unsigned int rounds)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        for (unsigned int r = 0; r < rounds; ++r)
+        {
+            hash ^= bytes[i];
+            hash *= FNV1A_PRIME;
+        }
+    }
+    
+    return hash;
+}
+
+static int get_rounds(unsigned int *rounds)
+{
+    const char    *value;
+    char          *end;
+    unsigned long parsed;
+    
+    value = getenv(HASH_ROUNDS_ENV); // NOLINT(concurrency-mt-unsafe) : No threads here
+    if (!value)
+    {
+        *rounds = DEFAULT_HASH_ROUNDS;
+        return 0;
+    }
+    
+    errno  = 0;
+    parsed = strtoul(value, &end, DECIMAL);
+    if (errno || end == value || *end != '\0' || parsed == 0 || parsed > UINT16_MAX)
+    {
+        (void) fprintf(stderr, "%s must be a number from 1 to %d\n", HASH_ROUNDS_ENV, UINT16_MAX);
+        errno = EINVAL;
+        return -1;
+    }
+    *rounds = (unsigned int) parsed;
+    
+    return 0;
+}
@@ -1,6 +1,8 @@
 #ifndef ONE_TO_ONE_ONE_TO_ONE_H
 #define ONE_TO_ONE_ONE_TO_ONE_H
 
+#include "../../core/include/syscall_stats.h"
+
 #include <mem_manager/manager.h>
 #include <netinet/in.h>
 #include <signal.h>
@@ -65,10 +67,11 @@ int handle_client (struct core_object *co);
  * <p>
  * Accept connection
  * </p>
+ * @param stats the syscall stats
  * @param listen_fd as int
  * @return int on accepted socket, -1 and set errno on failure
  */
-int accept_conn(int listen_fd, int* fd_out);
+int accept_conn(struct syscall_stats *stats, int listen_fd, int* fd_out);
 
 /**
  * signal_handler
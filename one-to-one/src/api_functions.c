@@ -29,7 +29,7 @@ int run_server(struct core_object *co) {
     int handle_result;
     do {
         close(co->so->client_fd);
-        int accept_result = accept_conn(co->so->listen_fd, &co->so->client_fd);
+        int accept_result = accept_conn(co->stats, co->so->listen_fd, &co->so->client_fd);
         if(accept_result == CLIENT_RESULT_TERMINATION){
             return CLOSE_SERVER;
         }
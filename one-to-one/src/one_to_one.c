@@ -1,7 +1,16 @@
 #include "../include/objects.h"
 #include "../include/one_to_one.h"
+#include "../../api_functions.h"
+#include "../../protocol.h"
+#include "../../core/include/crc32c.h"
+#include "../../core/include/echo.h"
+#include "../../core/include/probes.h"
+#include "../../core/include/sink.h"
+#include "../../core/include/syscall_stats.h"
+#include "../../core/include/watchdog.h"
 
 #include <errno.h>
+#include <stdint.h>
 #include <arpa/inet.h>
 #include <time.h>
 #include <string.h>
@@ -12,6 +21,9 @@
 #include <netinet/in.h>
 #include <sys/select.h>
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // Not supported; a send to a closed client raises SIGPIPE.
+#endif
 
 /**
  * Defines if the server is running
@@ -44,10 +56,26 @@ static void log(struct core_object *co, struct state_object *so, ssize_t bytes,
  * <p>
  * Checks any file descriptor along with signal pipe
  * <p>
+ * @param stats the syscall stats
  * @param fd file descriptor
  * @return returns resulting state
  */
-static int check_fd(int fd);
+static int check_fd(struct syscall_stats *stats, int fd);
+
+/**
+ * receive_body
+ * <p>
+ * Receive the payload of a request and its checksum trailer, passing the payload to the request handler as it
+ * arrives, and finish the message in the handler once it is all in.
+ * </p>
+ * @param co the core object
+ * @param header the header of the request
+ * @param message the request handler's state for the request
+ * @param response the response to the request
+ * @return the message result
+ */
+static int receive_body(struct core_object *co, const struct protocol_header *header, void *message,
+                        struct handler_response *response);
 
 struct state_object *setup_state(struct memory_manager *mm)
 {
@@ -99,21 +127,21 @@ int open_server_for_listen(struct state_object *so, struct sockaddr_in *listen_a
     return 0;
 }
 
-static int check_fd(int fd){
+static int check_fd(struct syscall_stats *stats, int fd){
     fd_set rfds;
-    FD_ZERO(&rfds);
-    FD_SET(fd, &rfds);
-    FD_SET(self_pipe[0], &rfds);
+    int maxfd = fd > self_pipe[0] ? fd : self_pipe[0];
+    int num_ready;
 
     // block on select() until a new connection is received or self-pipe is written to
-    int maxfd = fd > self_pipe[0] ? fd : self_pipe[0];
-    int num_ready = select(maxfd + 1, &rfds, NULL, NULL, NULL);
+    // select is never restarted; a termination signal will have written to the self-pipe, so look again.
+    do {
+        FD_ZERO(&rfds);
+        FD_SET(fd, &rfds);
+        FD_SET(self_pipe[0], &rfds);
+        num_ready = counted_select(stats, maxfd + 1, &rfds, NULL, NULL, NULL);
+    } while (num_ready < 0 && errno == EINTR);
     if (num_ready < 0) { //error
-        if (errno == EINTR){
-            return CLIENT_RESULT_TERMINATION;
-        } else {
-            return CLIENT_RESULT_ERROR;
-        }
+        return CLIENT_RESULT_ERROR;
     }
     if (FD_ISSET(self_pipe[0], &rfds)) {
         return CLIENT_RESULT_TERMINATION;
@@ -121,16 +149,16 @@ static int check_fd(int fd){
     return CLIENT_RESULT_SUCCESS;
 }
 
-int accept_conn(int listen_fd, int* fd_out){
+int accept_conn(struct syscall_stats *stats, int listen_fd, int* fd_out){
     struct sockaddr addr;
     socklen_t len = sizeof(addr);
 
-    int checked_fd = check_fd(listen_fd);
+    int checked_fd = check_fd(stats, listen_fd);
     if (checked_fd != CLIENT_RESULT_SUCCESS){
         return checked_fd;
     }
 
-    int fd = accept(listen_fd, &addr, &len);
+    int fd = counted_accept(stats, listen_fd, &addr, &len);
     if (fd == -1){
         if(errno == EINTR){
             return CLIENT_RESULT_TERMINATION;
@@ -139,6 +167,7 @@ int accept_conn(int listen_fd, int* fd_out){
     }
 
     *fd_out = fd;
+    SERVER_PROBE(accept, fd, 0);
     return CLIENT_RESULT_SUCCESS;
 }
 
@@ -149,8 +178,8 @@ enum msg_result {
     MSG_RESULT_TERMINATION,
 };
 
-static int check_fd_msg(int fd){
-    switch(check_fd(fd)){
+static int check_fd_msg(struct syscall_stats *stats, int fd){
+    switch(check_fd(stats, fd)){
         case CLIENT_RESULT_SUCCESS:
             return MSG_RESULT_SUCCESS;
         case CLIENT_RESULT_TERMINATION:
@@ -160,15 +189,103 @@ static int check_fd_msg(int fd){
     }
 }
 
-static int receive_message (struct core_object *co){
-    uint32_t msg_size;
-    {
-        int checked_fd = check_fd_msg(co->so->client_fd);
-        if (checked_fd != MSG_RESULT_SUCCESS) {
-            return checked_fd;
+/**
+ * send_ack
+ * <p>
+ * Send the ack to a request, in the version of the request.
+ * </p>
+ * @param co the core object
+ * @param header the header of the request
+ * @param length the length to ack
+ * @return the message result
+ */
+static int send_ack(struct core_object *co, const struct protocol_header *header, uint64_t length) {
+    uint8_t ack_buf[PROTOCOL_MAX_HEADER_SIZE];
+    ssize_t to_send = (ssize_t) protocol_encode_ack(header, length, ack_buf);
+    int flags = MSG_NOSIGNAL;
+
+    if (header->flags & PROTOCOL_FLAG_ECHO) {
+        flags |= echo_ack_flags(length); // NOLINT(hicpp-signed-bitwise)
+    }
+    for (const char* size_p = (const char*)ack_buf; to_send > 0;) {
+        ssize_t sent_bytes = counted_send(co->stats, co->so->client_fd, size_p, to_send, flags);
+        if (sent_bytes == 0) {
+            return MSG_RESULT_CLOSED;
+        } else if (sent_bytes == -1) {
+            if (errno == EPIPE || errno == ECONNRESET) // The client has gone; not a server error.
+                return MSG_RESULT_CLOSED;
+            return MSG_RESULT_ERROR;
         }
+        to_send -= sent_bytes;
+        size_p += sent_bytes;
     }
-    ssize_t read_bytes = recv(co->so->client_fd, &msg_size, sizeof (msg_size), MSG_WAITALL);
+
+    return MSG_RESULT_SUCCESS;
+}
+
+/**
+ * echo_message
+ * <p>
+ * Ack an echo request, then send its payload back as it arrives. The payload goes through the echo pipe without
+ * being read into the server, and is not passed to the request handler.
+ * </p>
+ * @param co the core object
+ * @param header the header of the request
+ * @return the message result
+ */
+static int echo_message(struct core_object *co, const struct protocol_header *header) {
+    uint64_t echoed;
+    int result;
+
+    SERVER_PROBE(recv_start, co->so->client_fd, header->length);
+    time_t start_time = time(NULL);
+    clock_t start_time_granular = clock();
+
+    if (echo_pipe_open(&co->so->echo) == -1) {
+        return MSG_RESULT_ERROR;
+    }
+    result = send_ack(co, header, header->length); // The ack goes first; the payload follows it.
+    if (result != MSG_RESULT_SUCCESS) {
+        return result;
+    }
+    if (echo_payload(co->stats, co->so->client_fd, &co->so->echo, header->length, &echoed) == -1) {
+        echo_pipe_close(&co->so->echo); // Whatever is left in it belongs to this client.
+        if (errno == EINTR)
+            return MSG_RESULT_TERMINATION;
+        if (errno == EPIPE || errno == ECONNRESET) // Hung up part way through; not a server error.
+            return MSG_RESULT_CLOSED;
+        return MSG_RESULT_ERROR;
+    }
+    if (echoed < header->length) {
+        return MSG_RESULT_CLOSED;
+    }
+
+    SERVER_PROBE(recv_done, co->so->client_fd, echoed);
+    clock_t end_time_granular = clock();
+    double elapsed_time_granular = (double) (end_time_granular - start_time_granular) / CLOCKS_PER_SEC;
+    log(co, co->so, (ssize_t) echoed, start_time, time(NULL), elapsed_time_granular);
+    SERVER_PROBE(ack, co->so->client_fd, echoed);
+    count_message(co->stats, echoed);
+    watchdog_service_end(co->watchdog);
+    watchdog_iteration_end(co->watchdog);
+
+    return MSG_RESULT_SUCCESS;
+}
+
+/**
+ * verify_checksum
+ * <p>
+ * Receive the checksum trailer of a request and count whether it matches the payload. In sink mode the payload
+ * was never read, so the trailer is received but not checked.
+ * </p>
+ * @param co the core object
+ * @param crc the CRC32C of the payload received
+ * @return the message result
+ */
+static int verify_checksum(struct core_object *co, uint32_t crc) {
+    uint8_t trailer[PROTOCOL_CHECKSUM_SIZE];
+
+    ssize_t read_bytes = counted_recv(co->stats, co->so->client_fd, trailer, sizeof(trailer), MSG_WAITALL);
     if (read_bytes == 0) {
         return MSG_RESULT_CLOSED;
     } else if (read_bytes == -1) {
@@ -176,46 +293,135 @@ static int receive_message (struct core_object *co){
             return MSG_RESULT_TERMINATION;
         return MSG_RESULT_ERROR;
     }
-    msg_size = ntohl(msg_size);
-    char buf[1024 * 1024];
-    time_t start_time = time(NULL);
-    clock_t start_time_granular = clock();
+    if (!co->options.sink) {
+        count_checksum(co->stats, protocol_decode_checksum(trailer) == crc);
+    }
+
+    return MSG_RESULT_SUCCESS;
+}
 
+static int receive_body(struct core_object *co, const struct protocol_header *header, void *message,
+                        struct handler_response *response) {
+    char buf[1024 * 1024];
+    uint64_t msg_size = header->length;
+    ssize_t read_bytes;
+    uint32_t crc = 0;
 
     // Reducing the size of the msg to reach the end of the msg.
-    for (uint32_t remaining_bytes = msg_size; remaining_bytes > 0; remaining_bytes -= read_bytes) {
-        int checked_fd = check_fd_msg(co->so->client_fd);
+    for (uint64_t remaining_bytes = msg_size; remaining_bytes > 0; remaining_bytes -= read_bytes) {
+        int checked_fd = check_fd_msg(co->stats, co->so->client_fd);
         if (checked_fd != MSG_RESULT_SUCCESS){
             return checked_fd;
         }
-        read_bytes = recv(co->so->client_fd, &buf, sizeof(buf) < remaining_bytes ? sizeof(buf) : remaining_bytes, 0);
+        if (co->options.sink) { // Count the bytes and let the kernel drop them.
+            read_bytes = sink_recv(co->stats, co->so->client_fd,
+                                   SIZE_MAX < remaining_bytes ? SIZE_MAX : (size_t) remaining_bytes, 0);
+        } else {
+            read_bytes = counted_recv(co->stats, co->so->client_fd, &buf,
+                                      sizeof(buf) < remaining_bytes ? sizeof(buf) : remaining_bytes, 0);
+        }
+        if (read_bytes == 0) {
+            return MSG_RESULT_CLOSED;
+        } else if (read_bytes == -1) {
+            if(errno == EINTR)
+                return MSG_RESULT_TERMINATION;
+            return MSG_RESULT_ERROR;
+        }
+        if ((header->flags & PROTOCOL_FLAG_CHECKSUM) && !co->options.sink) {
+            crc = crc32c(crc, buf, (size_t) read_bytes);
+        }
+        if (handle_chunk(co, message, buf, (size_t) read_bytes, msg_size, response) == -1) {
+            return MSG_RESULT_ERROR;
+        }
+    }
+    if (header->flags & PROTOCOL_FLAG_CHECKSUM) {
+        int checksum_result = verify_checksum(co, crc);
+        if (checksum_result != MSG_RESULT_SUCCESS) {
+            return checksum_result;
+        }
+    }
+    if (handle_chunk(co, message, NULL, 0, msg_size, response) == -1) {
+        return MSG_RESULT_ERROR;
+    }
+
+    return MSG_RESULT_SUCCESS;
+}
+
+static int receive_message (struct core_object *co){
+    uint8_t header_buf[PROTOCOL_MAX_HEADER_SIZE];
+    struct protocol_header header;
+    struct handler_response response;
+    size_t header_size;
+    uint64_t msg_size;
+    {
+        int checked_fd = check_fd_msg(co->stats, co->so->client_fd);
+        if (checked_fd != MSG_RESULT_SUCCESS) {
+            return checked_fd;
+        }
+    }
+    // One descriptor per loop, so an iteration is one message and a stall is a message that took too long.
+    watchdog_wake(co->watchdog);
+    watchdog_service_start(co->watchdog, co->so->client_fd);
+    ssize_t read_bytes = counted_recv(co->stats, co->so->client_fd, header_buf, PROTOCOL_PREFIX_SIZE, MSG_WAITALL);
+    if (read_bytes == 0) {
+        return MSG_RESULT_CLOSED;
+    } else if (read_bytes == -1) {
+        if(errno == EINTR)
+            return MSG_RESULT_TERMINATION;
+        if(errno == ECONNRESET) // Reset between requests, such as with an echo unread; not a server error.
+            return MSG_RESULT_CLOSED;
+        return MSG_RESULT_ERROR;
+    }
+    header_size = protocol_header_size(header_buf);
+    if (header_size > PROTOCOL_PREFIX_SIZE) { // v2; read the rest of the header.
+        read_bytes = counted_recv(co->stats, co->so->client_fd, header_buf + PROTOCOL_PREFIX_SIZE,
+                                  header_size - PROTOCOL_PREFIX_SIZE, MSG_WAITALL);
         if (read_bytes == 0) {
             return MSG_RESULT_CLOSED;
         } else if (read_bytes == -1) {
             if(errno == EINTR)
                 return MSG_RESULT_TERMINATION;
+            if(errno == ECONNRESET)
+                return MSG_RESULT_CLOSED;
             return MSG_RESULT_ERROR;
         }
     }
+    if (protocol_decode_header(header_buf, &header) == -1) {
+        return MSG_RESULT_CLOSED; // A bad header, such as a length too large; drop the client, not the server.
+    }
+    if (header.flags & PROTOCOL_FLAG_ECHO) {
+        return echo_message(co, &header);
+    }
+    msg_size = header.length;
+    response.length = msg_size;
+    SERVER_PROBE(recv_start, co->so->client_fd, msg_size);
+    time_t start_time = time(NULL);
+    clock_t start_time_granular = clock();
+
+    void *message;
+    if (handle_begin(co, msg_size, &message) == -1) {
+        return MSG_RESULT_ERROR;
+    }
+    int body_result = receive_body(co, &header, message, &response);
+    handle_end(co, &message); // Whether the body arrived or the client went away part way.
+    if (body_result != MSG_RESULT_SUCCESS) {
+        return body_result;
+    }
 
+    SERVER_PROBE(recv_done, co->so->client_fd, msg_size);
     time_t  end_time = time(NULL);
     clock_t end_time_granular = clock();
     double elapsed_time_granular = (double) (end_time_granular - start_time_granular) / CLOCKS_PER_SEC;
     log(co, co->so, msg_size, start_time, end_time, elapsed_time_granular);
 
-    ssize_t to_send = sizeof(msg_size);
-    msg_size = htonl(msg_size);
-
-    for (const char* size_p = (const char*)&msg_size; to_send > 0;) {
-        ssize_t sent_bytes = send(co->so->client_fd, size_p, to_send, 0);
-        if (sent_bytes == 0) {
-            return MSG_RESULT_CLOSED;
-        } else if (sent_bytes == -1) {
-            return MSG_RESULT_ERROR;
-        }
-        to_send -= sent_bytes;
-        size_p += sent_bytes;
+    int ack_result = send_ack(co, &header, response.length);
+    if (ack_result != MSG_RESULT_SUCCESS) {
+        return ack_result;
     }
+    SERVER_PROBE(ack, co->so->client_fd, msg_size);
+    count_message(co->stats, msg_size);
+    watchdog_service_end(co->watchdog);
+    watchdog_iteration_end(co->watchdog);
 
     return MSG_RESULT_SUCCESS;
 }
@@ -290,6 +496,8 @@ void destroy_state(struct state_object *so)
 {
     int status;
 
+    echo_pipe_close(&so->echo);
+
     status = close(so->listen_fd);
     if (status == -1)
     {
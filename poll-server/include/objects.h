@@ -1,7 +1,12 @@
 #ifndef SCALABLE_SERVER_POLL_OBJECTS_H
 #define SCALABLE_SERVER_POLL_OBJECTS_H
 
+#include "../../core/include/ack_queue.h"
+#include "../../core/include/echo.h"
 #include "../../core/include/objects.h"
+#include "../../protocol.h"
+
+#include <time.h>
 
 /**
  * The maximum number of connections that can be accepted by the poll server.
@@ -13,11 +18,58 @@
  */
 #define CONNECTION_QUEUE 100
 
+/**
+ * Connection_States
+ * <p>
+ * What a connection is waiting to do next. Connections are non-blocking and only advance by the bytes available.
+ * </p>
+ */
+enum Connection_States {
+    READ_HEADER = 0, // Reading the header of the next request.
+    READ_BODY, // Reading the payload of the current request.
+    READ_TRAILER, // Reading the checksum trailer of the current request.
+    ECHO_BODY, // Sending the payload of the current echo request back as it arrives.
+    WRITE_ACK // Reading is paused until the queued acks have been sent.
+};
+
+/**
+ * connection
+ * <p>
+ * The progress of the request being read on one connection, and the acks waiting to be sent on it.
+ * </p>
+ */
+struct connection {
+    enum Connection_States state;
+    uint8_t header_buf[PROTOCOL_MAX_HEADER_SIZE];
+    size_t header_size; // PROTOCOL_PREFIX_SIZE until the prefix has been read, then the size of the whole header.
+    size_t header_read;
+    struct protocol_header header;
+    char *body; // NULL in sink mode, where the payload is only counted.
+    uint64_t body_read;
+    void *message; // The request handler's state for this request, NULL without a handler.
+    struct handler_response response; // Filled in by the request handler, if one is loaded.
+    uint32_t crc; // CRC32C of the payload read so far, for requests with a checksum.
+    uint8_t trailer[PROTOCOL_CHECKSUM_SIZE];
+    size_t trailer_read;
+    time_t start_time;
+    clock_t start_time_granular;
+    uint64_t body_wakeups; // Times the connection was serviced part way through the payload of this request.
+    int rcvlowat; // The SO_RCVLOWAT of the socket.
+    struct ack_queue acks; // Acks completed this iteration, flushed at its end.
+    struct echo_pipe echo; // Opened by the first echo request on the connection.
+};
+
 struct state_object {
     int listen_fd;
     int client_fd[MAX_CONNECTIONS];
     struct sockaddr_in client_addr[MAX_CONNECTIONS];
     size_t num_connections;
+    struct connection connections[MAX_CONNECTIONS];
+    size_t next_conn; // Connection serviced first in the next iteration; rotates so that none is always first.
+    uint64_t services; // Times a connection was serviced.
+    uint64_t budgets_exhausted; // Times a connection stopped because it had read its budget.
+    uint64_t body_wakeups; // Times a connection was serviced part way through a payload.
+    uint64_t split_requests; // Requests whose payload took more than one service to read.
 };
 
 #endif //SCALABLE_SERVER_POLL_OBJECTS_H
@@ -39,7 +39,8 @@ int run_poll_server(struct core_object *co);
 /**
  * destroy_poll_state
  * <p>
- * Close all connections and all open sockets.
+ * Close all connections and all open sockets. Report how often connections used up their read budget, and how
+ * many wakeups it took to read payloads which did not arrive at once.
  * </p>
  * @param co the core object
  * @param so the state object
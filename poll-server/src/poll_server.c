@@ -1,9 +1,19 @@
 #include "../include/objects.h"
 #include "../include/poll_server.h"
+#include "../../api_functions.h"
+#include "../../protocol.h"
+#include "../../core/include/crc32c.h"
+#include "../../core/include/echo.h"
+#include "../../core/include/probes.h"
+#include "../../core/include/sink.h"
+#include "../../core/include/syscall_stats.h"
+#include "../../core/include/watchdog.h"
 
 #include <arpa/inet.h>
 #include <dc_env/env.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <mem_manager/manager.h>
 #include <netinet/in.h>
 #include <poll.h>
@@ -14,6 +24,17 @@
 #include <time.h>
 #include <unistd.h>
 
+#define BYTES_PER_KIB 1024
+#define PERCENT ((double) 100)
+#define RCVLOWAT_MAX (256 * BYTES_PER_KIB) // Low enough that the socket buffer can always hold it.
+
+#ifndef MSG_MORE
+#define MSG_MORE 0 // Not supported; acks are sent when they are flushed.
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // Not supported; a send to a closed client raises SIGPIPE.
+#endif
+
 // NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables): must be non-const
 /**
  * Whether the poll loop should be running.
@@ -76,8 +97,10 @@ static int get_conn_index(const int *client_fds);
 /**
  * poll_comm
  * <p>
- * Read from all file descriptors in pollfds for which POLLIN is set.
- * Remove all file descriptors in pollfds for which POLLHUP is set.
+ * Service all connections in pollfds for which POLLIN or POLLOUT is set, starting one connection further along
+ * each iteration.
+ * Remove all file descriptors in pollfds for which POLLHUP is set and nothing is left to read.
+ * Flush the acks queued during the iteration.
  * </p>
  * @param co the core object
  * @param so the state object
@@ -87,15 +110,120 @@ static int get_conn_index(const int *client_fds);
 static int poll_comm(struct core_object *co, struct state_object *so, struct pollfd *pollfds);
 
 /**
- * poll_recv_and_log
+ * poll_service_connection
  * <p>
- * Read from a file descriptor. Log the results in the log file.
+ * Advance the state machine of a connection as far as the bytes available on its socket allow, without blocking.
+ * Every request completed on the way has its ack queued. Reading stops when the socket has no more bytes, when the
+ * connection has read its budget for the iteration, or when the ack queue is full, in which case the connection
+ * waits in WRITE_ACK until its acks have been sent. A connection stopped by its budget keeps its place in the
+ * request it was reading; poll reports it ready again, since its bytes are still in the socket. With the rcvlowat
+ * option, a connection left part way through a payload is not reported ready until the rest of it has arrived.
+ * A connection echoing a payload waits for POLLOUT while its echo pipe holds bytes the socket would not take.
  * </p>
  * @param co the core object
- * @param pollfd the file descriptor
+ * @param so the state object
+ * @param pollfd the pollfd of the connection
+ * @param conn_index the index of the connection in the array of client_fds and client_addrs
  * @return 0 on success, -1 on failure and set errno
  */
-static int poll_recv_and_log(struct core_object *co, struct pollfd *pollfd, size_t fd_num);
+static int poll_service_connection(struct core_object *co, struct state_object *so, struct pollfd *pollfd,
+                                   size_t conn_index);
+
+/**
+ * poll_recv
+ * <p>
+ * Make one recv into the header, the body, or the checksum trailer of the request being read, depending on the state
+ * of the connection.
+ * </p>
+ * @param co the core object
+ * @param fd the socket of the connection
+ * @param conn the connection
+ * @param limit the most bytes to read
+ * @return the number of bytes read, 0 if the client closed, -1 and set errno on failure
+ */
+static ssize_t poll_recv(struct core_object *co, int fd, struct connection *conn, size_t limit);
+
+/**
+ * poll_echo
+ * <p>
+ * Move the payload of an echo request along: send back what is waiting in the echo pipe, then take more from the
+ * socket and send it straight back. Nothing is taken until the queued acks, the ack to this request last, have
+ * all been sent, and nothing more is taken while the socket will not take what is in the pipe.
+ * </p>
+ * @param co the core object
+ * @param fd the socket of the connection
+ * @param conn the connection
+ * @param limit the most bytes to take from the socket
+ * @return the number of bytes moved in both directions, 0 if the client closed, -1 and set errno on failure,
+ * EAGAIN if nothing could be moved
+ */
+static ssize_t poll_echo(struct core_object *co, int fd, struct connection *conn, size_t limit);
+
+/**
+ * poll_update_rcvlowat
+ * <p>
+ * With the rcvlowat option, set the SO_RCVLOWAT of a connection going back to poll. Part way through a payload it
+ * is the rest of the payload, capped by the read budget and RCVLOWAT_MAX; otherwise it is 1, so that the next
+ * header wakes the loop. Only calls setsockopt when the value changes.
+ * </p>
+ * @param co the core object
+ * @param fd the socket of the connection
+ * @param conn the connection
+ * @return 0 on success, -1 and set errno on failure
+ */
+static int poll_update_rcvlowat(struct core_object *co, int fd, struct connection *conn);
+
+/**
+ * poll_start_body
+ * <p>
+ * Decode the completed header of a request and allocate the buffer for its payload. An echo request has no buffer;
+ * its ack is queued at once, since the payload follows the ack back to the client.
+ * </p>
+ * @param co the core object
+ * @param fd the socket of the connection
+ * @param conn the connection
+ * @return 0 on success, 1 if the header is rejected, its payload cannot be buffered, or its ack cannot be queued, -1
+ * and set errno on failure
+ */
+static int poll_start_body(struct core_object *co, int fd, struct connection *conn);
+
+/**
+ * poll_finish_request
+ * <p>
+ * Log a completed request, free its payload, and queue its ack, unless it was echoed and its ack has been sent.
+ * Reset the connection to read the next request.
+ * </p>
+ * @param co the core object
+ * @param so the state object
+ * @param fd the socket of the connection
+ * @param conn_index the index of the connection in the array of client_fds and client_addrs
+ * @return 0 on success, 1 if the ack cannot be queued and the client should be dropped, -1 on failure and set errno
+ */
+static int poll_finish_request(struct core_object *co, struct state_object *so, int fd, size_t conn_index);
+
+/**
+ * poll_reset_connection
+ * <p>
+ * Set a connection up to read the header of a new request. Does not touch its queued acks.
+ * </p>
+ * @param conn the connection
+ */
+static void poll_reset_connection(struct connection *conn);
+
+/**
+ * poll_flush_acks
+ * <p>
+ * Send the acks queued on each connection during this iteration, one send per connection. With the ack-more
+ * option, a connection part way through reading its next request is sent its acks with MSG_MORE, since another
+ * flush will follow once that request is read. A connection whose acks did not all fit in its socket waits for
+ * POLLOUT in WRITE_ACK; one whose acks have all been sent reads again.
+ * </p>
+ * @param co the core object
+ * @param so the state object
+ * @param pollfds the pollfds array
+ * @return 0 on success, -1 and set errno on failure
+ */
+static int poll_flush_acks(struct core_object *co, struct state_object *so, struct pollfd *pollfds);
 
 /**
  * log
@@ -128,6 +256,17 @@ static void
 poll_remove_connection(struct core_object *co, struct state_object *so, struct pollfd *pollfd, size_t conn_index,
                        struct pollfd *listen_pollfd);
 
+/**
+ * poll_report_budget
+ * <p>
+ * Print the read budget and how often connections used it up to stdout. Print how many wakeups it took to read
+ * payloads which did not arrive at once, which the rcvlowat option brings down to about one each.
+ * </p>
+ * @param co the core object
+ * @param so the state object
+ */
+static void poll_report_budget(const struct core_object *co, const struct state_object *so);
+
 /**
  * close_fd_report_undefined_error
  * <p>
@@ -227,19 +366,26 @@ static int execute_poll(struct core_object *co, struct pollfd *pollfds, nfds_t n
     
     while (GOGO_POLL)
     {
-        poll_status = poll(pollfds, nfds, -1);
+        poll_status = counted_poll(co->stats, pollfds, nfds, -1);
         if (poll_status == -1)
         {
-            return (errno == EINTR) ? 0 : -1;
+            if (errno == EINTR) // Interrupted by a signal; the loop condition decides whether to stop.
+            {
+                continue;
+            }
+            return -1;
         }
+        watchdog_wake(co->watchdog);
         
         // If action on the listen socket.
         if ((*pollfds).revents == POLLIN)
         {
+            watchdog_service_start(co->watchdog, pollfds->fd);
             if (poll_accept(co, co->so, pollfds) == -1)
             {
                 return -1;
             }
+            watchdog_service_end(co->watchdog);
         } else
         {
             if (poll_comm(co, co->so, pollfds) == -1)
@@ -247,6 +393,7 @@ static int execute_poll(struct core_object *co, struct pollfd *pollfds, nfds_t n
                 return -1;
             }
         }
+        watchdog_iteration_end(co->watchdog);
     }
     
     return 0;
@@ -284,16 +431,27 @@ static int poll_accept(struct core_object *co, struct state_object *so, struct p
     conn_index    = get_conn_index(so->client_fd);
     sockaddr_size = sizeof(struct sockaddr_in);
     
-    new_cfd = accept(so->listen_fd, (struct sockaddr *) &so->client_addr[conn_index], &sockaddr_size);
+    new_cfd = counted_accept(co->stats, so->listen_fd, (struct sockaddr *) &so->client_addr[conn_index],
+                             &sockaddr_size);
     if (new_cfd == -1)
     {
         return -1;
     }
     
+    // Connections never block; each is advanced only by the bytes available.
+    if (fcntl(new_cfd, F_SETFL, fcntl(new_cfd, F_GETFL) | O_NONBLOCK) == -1) // NOLINT(hicpp-signed-bitwise)
+    {
+        close_fd_report_undefined_error(new_cfd, "state of client socket is undefined.");
+        return -1;
+    }
+    poll_reset_connection(&so->connections[conn_index]);
+    so->connections[conn_index].rcvlowat = 1; // The default of a new socket.
+    
     so->client_fd[conn_index] = new_cfd; // Only save in array if valid.
     pollfds[conn_index + 1].fd     = new_cfd; // Plus one because listen_fd.
     pollfds[conn_index + 1].events = POLLIN;
     ++so->num_connections;
+    SERVER_PROBE(accept, new_cfd, conn_index);
     
     if (so->num_connections >= MAX_CONNECTIONS)
     {
@@ -326,86 +484,432 @@ static int poll_comm(struct core_object *co, struct state_object *so, struct pol
 {
     DC_TRACE(co->env);
     struct pollfd *pollfd;
+    size_t        fd_num;
     
-    for (size_t fd_num = 1; fd_num <= MAX_CONNECTIONS; ++fd_num)
+    for (size_t i = 0; i < MAX_CONNECTIONS; ++i)
     {
+        fd_num = 1 + (so->next_conn + i) % MAX_CONNECTIONS; // Round robin, so no connection always goes first.
         pollfd = pollfds + fd_num;
-        if (pollfd->revents == POLLIN)
+        // NOLINTNEXTLINE(hicpp-signed-bitwise): never negative
+        if (!(pollfd->revents & POLLERR) && (pollfd->revents & (POLLIN | POLLOUT)))
         {
-            if (poll_recv_and_log(co, pollfd, fd_num) == -1)
+            // Read what is available, including the last bytes from a client that has hung up.
+            watchdog_service_start(co->watchdog, pollfd->fd); // Lag grows with every connection serviced before this one.
+            if (poll_service_connection(co, so, pollfd, fd_num - 1) == -1)
             {
                 return -1;
             }
+            watchdog_service_end(co->watchdog);
             // NOLINTNEXTLINE(hicpp-signed-bitwise): never negative
         } else if ((pollfd->revents & POLLHUP) || (pollfd->revents & POLLERR))
             // Client has closed other end of socket.
             // On MacOS, POLLHUP will be set; on Linux, POLLERR will be set.
         {
+            watchdog_service_start(co->watchdog, pollfd->fd);
             (poll_remove_connection(co, so, pollfd, fd_num - 1, pollfds));
+            watchdog_service_end(co->watchdog);
         }
         pollfd->revents = 0;
     }
+    so->next_conn = (so->next_conn + 1) % MAX_CONNECTIONS;
     
-    return 0;
+    return poll_flush_acks(co, so, pollfds);
 }
 
-static int poll_recv_and_log(struct core_object *co, struct pollfd *pollfd, size_t fd_num)
+static int poll_service_connection(struct core_object *co, struct state_object *so, struct pollfd *pollfd,
+                                   size_t conn_index)
 {
     DC_TRACE(co->env);
-    ssize_t  bytes;
-    char     *buffer;
-    size_t   buffer_size;
-    uint32_t bytes_to_read;
-    uint32_t bytes_read;
-    time_t   start_time;
-    time_t   end_time;
-    clock_t  start_time_granular;
-    clock_t  end_time_granular;
-    double   elapsed_time_granular;
-    
-    // Read the number of bytes that will be sent in the message.
-    bytes = recv(pollfd->fd, &bytes_to_read, sizeof(bytes_to_read), 0);
-    if (bytes == -1)
+    struct connection *conn;
+    ssize_t           bytes;
+    int               status;
+    size_t            budget;
+    
+    conn   = &so->connections[conn_index];
+    budget = (co->options.budget_kib) ? (size_t) co->options.budget_kib * BYTES_PER_KIB : SIZE_MAX;
+    ++so->services;
+    if (conn->state == READ_BODY)
+    {
+        ++so->body_wakeups;
+        ++conn->body_wakeups;
+    }
+    while (conn->state != WRITE_ACK)
+    {
+        if (budget == 0) // Leave the rest for the next iteration, after the other connections have had a turn.
+        {
+            ++so->budgets_exhausted;
+            break;
+        }
+        bytes = (conn->state == ECHO_BODY) ? poll_echo(co, pollfd->fd, conn, budget) :
+                poll_recv(co, pollfd->fd, conn, budget);
+        if (bytes == -1)
+        {
+            // NOLINTNEXTLINE(misc-redundant-expression): EAGAIN and EWOULDBLOCK may differ
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break; // Nothing more for now; back to poll.
+            }
+            if (errno != EPIPE && errno != ECONNRESET)
+            {
+                return -1;
+            }
+            bytes = 0; // The client went away, such as with an echo unread; drop it rather than stop the server.
+        }
+        if (bytes == 0)
+        {
+            poll_remove_connection(co, so, pollfd, conn_index, pollfd - (conn_index + 1));
+            return 0;
+        }
+        budget -= ((size_t) bytes < budget) ? (size_t) bytes : budget; // An echo moves bytes both ways.
+        
+        if (conn->state == READ_HEADER)
+        {
+            conn->header_read += (size_t) bytes;
+            if (conn->header_read == PROTOCOL_PREFIX_SIZE && conn->header_size == PROTOCOL_PREFIX_SIZE)
+            {
+                conn->header_size = protocol_header_size(conn->header_buf); // v2; read the rest of the header.
+            }
+            if (conn->header_read < conn->header_size)
+            {
+                continue;
+            }
+            status = poll_start_body(co, pollfd->fd, conn);
+            if (status == -1)
+            {
+                return -1;
+            }
+            if (status == 1) // A bad header or a payload too large to hold; drop the client, not the server.
+            {
+                poll_remove_connection(co, so, pollfd, conn_index, pollfd - (conn_index + 1));
+                return 0;
+            }
+        } else if (conn->state == READ_BODY) // An echo keeps its own count.
+        {
+            if (handle_chunk(co, conn->message, (conn->body) ? conn->body + conn->body_read : NULL, (size_t) bytes,
+                             conn->header.length, &conn->response) == -1)
+            {
+                return -1;
+            }
+            if ((conn->header.flags & PROTOCOL_FLAG_CHECKSUM) && conn->body) // While the bytes are still in cache.
+            {
+                conn->crc = crc32c(conn->crc, conn->body + conn->body_read, (size_t) bytes);
+            }
+            conn->body_read += (uint64_t) bytes;
+            if (conn->body_read == conn->header.length && (conn->header.flags & PROTOCOL_FLAG_CHECKSUM))
+            {
+                conn->state = READ_TRAILER;
+                continue;
+            }
+        } else if (conn->state == READ_TRAILER)
+        {
+            conn->trailer_read += (size_t) bytes;
+            if (conn->trailer_read < sizeof(conn->trailer))
+            {
+                continue;
+            }
+            if (conn->body) // In sink mode the payload was never read, so there is nothing to check.
+            {
+                count_checksum(co->stats, protocol_decode_checksum(conn->trailer) == conn->crc);
+            }
+        }
+        
+        if ((conn->state == READ_BODY || (conn->state == READ_TRAILER && conn->trailer_read == sizeof(conn->trailer)) ||
+             (conn->state == ECHO_BODY && conn->echo.piped == 0)) && conn->body_read == conn->header.length)
+        {
+            status = poll_finish_request(co, so, pollfd->fd, conn_index);
+            if (status == -1)
+            {
+                return -1;
+            }
+            if (status == 1) // The client is gone or not reading its acks; drop it rather than stop the server.
+            {
+                poll_remove_connection(co, so, pollfd, conn_index, pollfd - (conn_index + 1));
+                return 0;
+            }
+        }
+    }
+    
+    if (conn->state != WRITE_ACK) // Acks waiting to be flushed add POLLOUT after this.
+    {
+        pollfd->events = (conn->state == ECHO_BODY && conn->echo.piped > 0) ? POLLOUT : POLLIN;
+    }
+    
+    return poll_update_rcvlowat(co, pollfd->fd, conn);
+}
+
+static int poll_update_rcvlowat(struct core_object *co, int fd, struct connection *conn)
+{
+    DC_TRACE(co->env);
+    uint64_t lowat;
+    int      rcvlowat;
+    
+    if (!co->options.rcvlowat)
+    {
+        return 0;
+    }
+    
+    lowat = 1;
+    if (conn->state == READ_BODY)
+    {
+        lowat = conn->header.length - conn->body_read;
+        if (conn->header.flags & PROTOCOL_FLAG_CHECKSUM)
+        {
+            lowat += PROTOCOL_CHECKSUM_SIZE; // Wake for the trailer too.
+        }
+        if (co->options.budget_kib && lowat > (uint64_t) co->options.budget_kib * BYTES_PER_KIB)
+        {
+            lowat = (uint64_t) co->options.budget_kib * BYTES_PER_KIB; // No point waiting for more than one turn.
+        }
+        lowat = (lowat < RCVLOWAT_MAX) ? lowat : RCVLOWAT_MAX;
+    }
+    
+    rcvlowat = (int) lowat;
+    if (rcvlowat == conn->rcvlowat) // Most requests arrive whole and never change it.
+    {
+        return 0;
+    }
+    if (counted_setsockopt(co->stats, fd, SOL_SOCKET, SO_RCVLOWAT, &rcvlowat, sizeof(rcvlowat)) == -1)
     {
         return -1;
     }
+    conn->rcvlowat = rcvlowat;
+    
+    return 0;
+}
+
+static ssize_t poll_recv(struct core_object *co, int fd, struct connection *conn, size_t limit)
+{
+    uint64_t wanted;
+    
+    if (conn->state == READ_HEADER)
+    {
+        wanted = conn->header_size - conn->header_read;
+        return counted_recv(co->stats, fd, conn->header_buf + conn->header_read, (wanted < limit) ? wanted : limit, 0);
+    }
+    if (conn->state == READ_TRAILER)
+    {
+        wanted = sizeof(conn->trailer) - conn->trailer_read;
+        return counted_recv(co->stats, fd, conn->trailer + conn->trailer_read, (wanted < limit) ? wanted : limit, 0);
+    }
     
-    bytes_to_read = ntohl(bytes_to_read);
+    // Never read past this request; with pipelining the next one follows it.
+    wanted = conn->header.length - conn->body_read;
+    if (co->options.sink)
+    {
+        return sink_recv(co->stats, fd, (wanted < limit) ? wanted : limit, 0);
+    }
+    return counted_recv(co->stats, fd, conn->body + conn->body_read, (wanted < limit) ? wanted : limit, 0);
+}
+
+static ssize_t poll_echo(struct core_object *co, int fd, struct connection *conn, size_t limit)
+{
+    uint64_t wanted;
+    ssize_t  given;
+    ssize_t  taken;
+    ssize_t  given_after;
     
-    // Allocate the buffer based on bytes to read.
-    buffer_size = (bytes_to_read + 1 * sizeof(char));
-    buffer      = (char *) Mmm_malloc(buffer_size, co->mm);
-    if (!buffer)
+    if (ack_queue_pending(&conn->acks) &&
+        ack_queue_flush(co->stats, fd, &conn->acks,
+                        MSG_NOSIGNAL | echo_ack_flags(conn->header.length)) == -1) // NOLINT(hicpp-signed-bitwise)
     {
         return -1;
     }
+    given  = 0;
+    wanted = conn->header.length - conn->body_read;
+    if (!ack_queue_pending(&conn->acks))
+    {
+        given = echo_give(co->stats, fd, &conn->echo, wanted > 0);
+        if (given == -1)
+        {
+            return -1;
+        }
+    }
+    if (ack_queue_pending(&conn->acks) || conn->echo.piped > 0 || wanted == 0) // The socket is full, or all is in.
+    {
+        if (given > 0)
+        {
+            return given;
+        }
+        errno = EAGAIN;
+        return -1;
+    }
     
-    bytes_read                  = 0;
-    start_time                  = time(NULL);
-    start_time_granular         = clock();
-    while (bytes_read < bytes_to_read && bytes != 0)
+    taken = echo_take(co->stats, fd, &conn->echo, (wanted < limit) ? (size_t) wanted : limit);
+    if (taken <= 0)
     {
-        bytes = recv(pollfd->fd, buffer + bytes_read, sizeof(buffer), 0); // Recv into buffer
-        if (bytes == -1)
+        return (given > 0) ? given : taken; // Closed or empty; found again on the next call.
+    }
+    conn->body_read += (uint64_t) taken;
+    
+    given_after = echo_give(co->stats, fd, &conn->echo, conn->body_read < conn->header.length);
+    // NOLINTNEXTLINE(misc-redundant-expression): EAGAIN and EWOULDBLOCK may differ
+    if (given_after == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+        return -1;
+    }
+    
+    return given + taken + ((given_after > 0) ? given_after : 0);
+}
+
+static int poll_start_body(struct core_object *co, int fd, struct connection *conn)
+{
+    DC_TRACE(co->env);
+    
+    if (protocol_decode_header(conn->header_buf, &conn->header) == -1)
+    {
+        return 1;
+    }
+    
+    if (conn->header.flags & PROTOCOL_FLAG_ECHO)
+    {
+        if (echo_pipe_open(&conn->echo) == -1)
         {
-            co->mm->mm_free(co->mm, buffer);
             return -1;
         }
-        bytes_read += bytes;
+        if (ack_queue_push(co->stats, fd, &conn->acks, &conn->header, conn->header.length) == -1)
+        {
+            return 1; // The client is gone or not reading its acks.
+        }
+    }
+    // Allocate the buffer based on bytes to read, unless the payload is only counted or goes straight back.
+    else if (!co->options.sink)
+    {
+        conn->body = (char *) Mmm_malloc(conn->header.length + 1 * sizeof(char), co->mm);
+        if (!conn->body)
+        {
+            return 1;
+        }
+    }
+    // Each request gets its own handler state, as requests on other connections arrive between its chunks.
+    if (!(conn->header.flags & PROTOCOL_FLAG_ECHO) && handle_begin(co, conn->header.length, &conn->message) == -1)
+    {
+        return -1;
+    }
+    
+    SERVER_PROBE(recv_start, fd, conn->header.length);
+    conn->state               = (conn->header.flags & PROTOCOL_FLAG_ECHO) ? ECHO_BODY : READ_BODY;
+    conn->body_read           = 0;
+    conn->trailer_read        = 0;
+    if (conn->header.length == 0 && (conn->header.flags & PROTOCOL_FLAG_CHECKSUM)) // No body to end with its trailer.
+    {
+        conn->state = READ_TRAILER;
     }
-    end_time_granular           = clock();
-    end_time                    = time(NULL);
-    elapsed_time_granular       = (double) (end_time_granular - start_time_granular) / CLOCKS_PER_SEC;
-    log(co, co->so, fd_num, bytes_read, start_time, end_time, elapsed_time_granular);
+    conn->response.length     = conn->header.length;
+    conn->start_time          = time(NULL);
+    conn->start_time_granular = clock();
+    
+    return 0;
+}
+
+static int poll_finish_request(struct core_object *co, struct state_object *so, int fd, size_t conn_index)
+{
+    DC_TRACE(co->env);
+    struct connection *conn;
+    clock_t           end_time_granular;
+    time_t            end_time;
+    double            elapsed_time_granular;
     
-    co->mm->mm_free(co->mm, buffer);
+    conn                  = &so->connections[conn_index];
+    end_time_granular     = clock();
+    end_time              = time(NULL);
+    SERVER_PROBE(recv_done, fd, conn->body_read);
+    elapsed_time_granular = (double) (end_time_granular - conn->start_time_granular) / CLOCKS_PER_SEC;
+    log(co, so, conn_index + 1, (ssize_t) conn->body_read, conn->start_time, end_time, elapsed_time_granular);
     
-    bytes_read = htonl(bytes_read);
-    bytes      = send(pollfd->fd, &bytes_read, sizeof(bytes_read), 0); // Send back the number of bytes read.
-    if (bytes == -1)
+    if (conn->state != ECHO_BODY &&
+        handle_chunk(co, conn->message, NULL, 0, conn->header.length, &conn->response) == -1)
     {
         return -1;
     }
+    handle_end(co, &conn->message);
+    if (conn->body)
+    {
+        co->mm->mm_free(co->mm, conn->body);
+        conn->body = NULL;
+    }
+    
+    // Queue the ack to send back; it goes out with any others from this iteration.
+    if (conn->state != ECHO_BODY &&
+        ack_queue_push(co->stats, fd, &conn->acks, &conn->header, conn->response.length) == -1)
+    {
+        return 1;
+    }
+    SERVER_PROBE(ack, fd, conn->body_read);
+    count_message(co->stats, conn->body_read);
+    if (conn->body_wakeups)
+    {
+        ++so->split_requests;
+    }
+    
+    poll_reset_connection(conn);
+    if (ack_queue_full(&conn->acks))
+    {
+        conn->state = WRITE_ACK; // Stop reading until there is room for the next ack.
+    }
+    
+    return 0;
+}
+
+static void poll_reset_connection(struct connection *conn)
+{
+    conn->state        = READ_HEADER;
+    conn->header_size  = PROTOCOL_PREFIX_SIZE;
+    conn->header_read  = 0;
+    conn->body         = NULL;
+    conn->body_read    = 0;
+    conn->body_wakeups = 0;
+    conn->crc          = 0;
+    conn->trailer_read = 0;
+}
+
+static int poll_flush_acks(struct core_object *co, struct state_object *so, struct pollfd *pollfds)
+{
+    DC_TRACE(co->env);
+    struct connection *conn;
+    int               flags;
+    
+    for (size_t conn_index = 0; conn_index < MAX_CONNECTIONS; ++conn_index)
+    {
+        conn = &so->connections[conn_index];
+        if (!ack_queue_pending(&conn->acks))
+        {
+            continue;
+        }
+        
+        flags = MSG_NOSIGNAL;
+        if (co->options.ack_more && (conn->state == READ_BODY || conn->state == READ_TRAILER || conn->header_read > 0))
+        {
+            flags |= MSG_MORE; // NOLINT(hicpp-signed-bitwise): flags are never negative
+        }
+        if (ack_queue_flush(co->stats, so->client_fd[conn_index], &conn->acks, flags) == -1)
+        {
+            if (errno != EPIPE && errno != ECONNRESET)
+            {
+                return -1;
+            }
+            // The client is gone; drop it rather than stop the server.
+            poll_remove_connection(co, so, pollfds + conn_index + 1, conn_index, pollfds);
+            continue;
+        }
+        
+        if (ack_queue_pending(&conn->acks)) // The socket is full; wait until it can take the rest.
+        {
+            if (conn->state == READ_HEADER && conn->header_read == 0)
+            {
+                conn->state = WRITE_ACK; // Between requests; stop reading until the client reads its acks.
+            }
+            // NOLINTNEXTLINE(hicpp-signed-bitwise): never negative
+            pollfds[conn_index + 1].events = (conn->state == WRITE_ACK || conn->state == ECHO_BODY) ? POLLOUT :
+                                             (POLLIN | POLLOUT); // An echo waits for its ack to go first.
+        } else
+        {
+            if (conn->state == WRITE_ACK)
+            {
+                conn->state = READ_HEADER;
+            }
+            pollfds[conn_index + 1].events = POLLIN;
+        }
+    }
     
     return 0;
 }
@@ -467,6 +971,14 @@ poll_remove_connection(struct core_object *co, struct state_object *so, struct p
     memset(pollfd, 0, sizeof(struct pollfd));
     memset(&so->client_addr[conn_index], 0, sizeof(struct sockaddr_in));
     so->client_fd[conn_index] = 0;
+    if (so->connections[conn_index].body)
+    {
+        co->mm->mm_free(co->mm, so->connections[conn_index].body); // Part way through a request.
+    }
+    handle_end(co, &so->connections[conn_index].message);
+    poll_reset_connection(&so->connections[conn_index]);
+    ack_queue_clear(&so->connections[conn_index].acks); // Nobody to send them to.
+    echo_pipe_close(&so->connections[conn_index].echo);
     --so->num_connections;
     
     if (listen_pollfd->events != POLLIN && so->num_connections < MAX_CONNECTIONS)
@@ -484,6 +996,31 @@ void destroy_poll_state(struct core_object *co, struct state_object *so)
     for (size_t sfd_num = 0; sfd_num < MAX_CONNECTIONS; ++sfd_num)
     {
         close_fd_report_undefined_error(*(so->client_fd + sfd_num), "state of client socket is undefined.");
+        echo_pipe_close(&so->connections[sfd_num].echo);
+        handle_end(co, &so->connections[sfd_num].message);
+    }
+    
+    poll_report_budget(co, so);
+}
+
+static void poll_report_budget(const struct core_object *co, const struct state_object *so)
+{
+    if (so->services == 0) // Nothing serviced.
+    {
+        return;
+    }
+    
+    if (co->options.budget_kib)
+    {
+        (void) fprintf(stdout, "poll-server: read budget %u KiB, used up in %" PRIu64 " of %" PRIu64
+                               " connection services (%.2f%%)\n", co->options.budget_kib, so->budgets_exhausted,
+                       so->services, PERCENT * (double) so->budgets_exhausted / (double) so->services);
+    }
+    if (so->split_requests)
+    {
+        (void) fprintf(stdout, "poll-server: %" PRIu64 " wakeups part way through %" PRIu64 " split payloads "
+                               "(%.2f each), SO_RCVLOWAT %s\n", so->body_wakeups, so->split_requests,
+                       (double) so->body_wakeups / (double) so->split_requests, (co->options.rcvlowat) ? "on" : "off");
     }
 }
 
@@ -1,7 +1,9 @@
 #ifndef SCALABLE_SERVER_PROCESS_OBJECTS_H
 #define SCALABLE_SERVER_PROCESS_OBJECTS_H
 
+#include "../../core/include/echo.h"
 #include "../../core/include/objects.h"
+#include "../../core/include/histogram.h"
 
 #include <semaphore.h>
 #include <poll.h>
@@ -66,6 +68,38 @@
  */
 #define FOR_EACH_SOCKET_POLLFD_p_IN_POLLFDS for (size_t p = 2; p < POLLFDS_SIZE; ++p)
 
+/**
+ * Points in the dispatch of a message at which a timestamp is taken.
+ */
+enum Dispatch_Stamps
+{
+    STAMP_POLL_WAKE = 0, // Parent: poll returned with action on the client socket.
+    STAMP_SENDMSG,       // Parent: about to send the client socket over the domain socket.
+    STAMP_SEM_ACQUIRED,  // Child: acquired the domain socket read semaphore.
+    STAMP_RECVMSG,       // Child: received the client socket from the domain socket.
+    STAMP_FIRST_BYTE,    // Child: received the message length, the first bytes of the message.
+    STAMP_PAYLOAD_DONE,  // Child: received the whole payload.
+    STAMP_PIPE_READ,     // Parent: read the dispatch record back from the child-to-parent pipe.
+    STAMP_REENABLED,     // Parent: re-enabled the client socket in the pollfds.
+    DISPATCH_STAMPS      // Number of stamps; not a stamp.
+};
+
+/**
+ * Stages of the dispatch of a message, each the time between two consecutive stamps.
+ */
+#define DISPATCH_STAGES (DISPATCH_STAMPS - 1)
+
+/**
+ * The record of the dispatch of one message. Travels with the client socket from the parent to the child over
+ * the domain socket, and back to the parent over the child-to-parent pipe. Smaller than PIPE_BUF, so writes to the
+ * pipe are atomic.
+ */
+struct dispatch_record
+{
+    int      client_fd; // The file descriptor number of the client socket in the parent.
+    uint64_t stamps[DISPATCH_STAMPS]; // Monotonic time in nanoseconds of each stamp.
+};
+
 /**
  * Contains information about the program state.
  */
@@ -79,6 +113,7 @@ struct state_object
     sem_t                *log_sem;
     struct parent_struct *parent;
     struct child_struct  *child;
+    struct echo_pipe     echo; // In a child process; opened by its first echo request.
 };
 
 /**
@@ -89,6 +124,8 @@ struct parent_struct
     struct pollfd      pollfds[POLLFDS_SIZE]; // 0th position is the listen socket fd, 1st position is pipe.
     struct sockaddr_in client_addrs[MAX_CONNECTIONS];
     size_t             num_connections;
+    uint64_t           poll_wake_ns; // Time the poll loop last woke up.
+    struct histogram   dispatch_stages[DISPATCH_STAGES]; // Time spent in each stage of dispatch.
 };
 
 /**
@@ -96,9 +133,10 @@ struct parent_struct
  */
 struct child_struct
 {
-    int                client_fd_parent;
-    int                client_fd_local;
-    struct sockaddr_in client_addr;
+    int                    client_fd_parent;
+    int                    client_fd_local;
+    struct sockaddr_in     client_addr;
+    struct dispatch_record record; // The dispatch record received with the client socket.
 };
 
 #endif //SCALABLE_SERVER_PROCESS_OBJECTS_H
@@ -1,6 +1,14 @@
 #include "../include/objects.h"
 #include "../include/process_server.h"
 #include "../include/setup_teardown.h"
+#include "../../api_functions.h"
+#include "../../protocol.h"
+#include "../../core/include/crc32c.h"
+#include "../../core/include/echo.h"
+#include "../../core/include/probes.h"
+#include "../../core/include/sink.h"
+#include "../../core/include/syscall_stats.h"
+#include "../../core/include/watchdog.h"
 
 #include <arpa/inet.h>
 #include <dc_env/env.h>
@@ -23,6 +31,19 @@
 volatile int GOGO_PROCESS = 1;
 // NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
 
+/**
+ * Names of the dispatch stages, in the order of Dispatch_Stamps. Stage n is the time from stamp n to stamp n + 1.
+ */
+static const char *const dispatch_stage_names[DISPATCH_STAGES] = {
+        "poll wake -> sendmsg",
+        "sendmsg -> sem_wait",
+        "sem_wait -> recvmsg",
+        "recvmsg -> first byte",
+        "payload receive",
+        "pipe notification",
+        "re-enable fd"
+};
+
 /**
  * p_run_poll_loop
  * <p>
@@ -57,6 +78,18 @@ static int setup_signal_handler(struct sigaction *sa, int signal);
  */
 static void end_gogo_handler(int signal);
 
+/**
+ * sem_wait_restart
+ * <p>
+ * Wait on a semaphore. Restart the wait if it is interrupted by a signal that does not stop the server, such as
+ * SIGPROF from the profiler.
+ * </p>
+ * @param stats the syscall stats
+ * @param sem the semaphore
+ * @return 0 on success, -1 and set errno on failure or when interrupted by a signal that stops the server
+ */
+static int sem_wait_restart(struct syscall_stats *stats, sem_t *sem);
+
 /**
  * p_accept_new_connection
  * <p>
@@ -92,6 +125,25 @@ static size_t p_get_pollfd_index(const struct pollfd *pollfds);
  */
 static int p_read_pipe_reenable_fd(struct core_object *co, struct state_object *so, struct pollfd *pollfds);
 
+/**
+ * p_record_dispatch_stages
+ * <p>
+ * Record the time spent in each stage of a finished dispatch in the dispatch stage histograms.
+ * </p>
+ * @param parent the parent struct
+ * @param record the finished dispatch record
+ */
+static void p_record_dispatch_stages(struct parent_struct *parent, const struct dispatch_record *record);
+
+/**
+ * p_report_dispatch_stages
+ * <p>
+ * Print the dispatch stage histograms to stdout.
+ * </p>
+ * @param parent the parent struct
+ */
+static void p_report_dispatch_stages(const struct parent_struct *parent);
+
 /**
  * p_handle_socket_action
  * <p>
@@ -108,7 +160,8 @@ static int p_handle_socket_action(struct core_object *co, struct state_object *s
 /**
  * p_send_to_child
  * <p>
- * Send an active socket over the domain socket to one of the child processes.
+ * Send an active socket over the domain socket to one of the child processes, along with a dispatch record
+ * stamped with the poll wake time and the send time.
  * </p>
  * @param co the core object
  * @param so the state object
@@ -186,16 +239,51 @@ static int c_recv_log_notify_parent_respond(struct core_object *co, struct state
 /**
  * c_get_message_length
  * <p>
- * Get the length of the message to receive. Allocate a buffer of that size to store the message.
+ * Read the header of the message to receive, of either protocol version. Allocate a buffer of the message length
+ * to store the message, unless it is only counted in sink mode or is to be echoed, where the buffer is NULL. If the
+ * client sent a header that is rejected, such as one longer than PROTOCOL_MAX_LENGTH, or the buffer cannot be
+ * allocated, shut the connection down so the parent drops it.
  * </p>
  * @param co the core object
  * @param child the child struct
  * @param buffer the buffer to allocate
- * @param bytes_to_read integer holding number of bytes to read
- * @return 0 on success, -1 and set errno on failure
+ * @param header the header of the message
+ * @return 0 on success, 1 if the connection is closed and there is no message, -1 and set errno on failure
  */
-static int c_get_message_length(struct core_object *co, const struct child_struct *child,
-                                char **buffer, uint32_t *bytes_to_read);
+static int c_get_message_length(struct core_object *co, struct child_struct *child,
+                                char **buffer, struct protocol_header *header);
+
+/**
+ * c_echo_notify_parent
+ * <p>
+ * Ack an echo request and send its payload back as it arrives, through the echo pipe of the child, without
+ * reading it into the child. Only then hand the socket back to the parent, so that the next request on it cannot
+ * be dispatched while the payload is still being echoed. Echoed payloads are not passed to the request handler.
+ * A client which hangs up part way through is dropped, not treated as an error.
+ * </p>
+ * @param co the core object
+ * @param so the state object
+ * @param child the child struct
+ * @param header the header of the request
+ * @return 0 on success, -1 and set errno on failure.
+ */
+static int c_echo_notify_parent(struct core_object *co, struct state_object *so, struct child_struct *child,
+                                const struct protocol_header *header);
+
+/**
+ * c_verify_checksum
+ * <p>
+ * Receive the checksum trailer of a request and count whether it matches the payload. In sink mode there is no
+ * payload buffer, so the trailer is received but not checked.
+ * </p>
+ * @param co the core object
+ * @param child the child struct
+ * @param buffer the payload, or NULL
+ * @param length the length of the payload
+ * @return 0 on success or if the connection closed, -1 and set errno on failure
+ */
+static int c_verify_checksum(struct core_object *co, struct child_struct *child, const char *buffer,
+                             uint64_t length);
 
 /**
  * c_log
@@ -218,7 +306,7 @@ c_log(struct core_object *co, struct state_object *so, struct child_struct *chil
 /**
  * c_inform_parent_recv_finished
  * <p>
- * Send the original fd number to the parent over the child-to-parent pipe.
+ * Send the dispatch record, which holds the original fd number, to the parent over the child-to-parent pipe.
  * </p>
  * @param co the core object
  * @param so the state object
@@ -302,24 +390,34 @@ static int p_run_poll_loop(struct core_object *co, struct state_object *so, stru
     
     while (GOGO_PROCESS)
     {
-        poll_status = poll(pollfds, nfds, -1);
+        poll_status = counted_poll(co->stats, pollfds, nfds, -1);
         if (poll_status == -1)
         {
-            return (errno == EINTR) ? 0 : -1;
+            if (errno == EINTR) // Interrupted by a signal; the loop condition decides whether to stop.
+            {
+                continue;
+            }
+            return -1;
         }
+        parent->poll_wake_ns = now_ns();
+        watchdog_wake(co->watchdog);
         
         if ((*pollfds).revents == POLLIN) // Action on the listen socket.
         {
+            watchdog_service_start(co->watchdog, pollfds->fd);
             if (p_accept_new_connection(co, so->parent, pollfds) == -1)
             {
                 return -1;
             }
+            watchdog_service_end(co->watchdog);
         } else if ((*(pollfds + 1)).revents == POLLIN) // Action on child-to-parent pipe.
         {
+            watchdog_service_start(co->watchdog, (pollfds + 1)->fd);
             if (p_read_pipe_reenable_fd(co, so, pollfds) == -1)
             {
                 return -1;
             }
+            watchdog_service_end(co->watchdog);
         } else // Action on a client socket.
         {
             if (p_handle_socket_action(co, so, pollfds) == -1)
@@ -327,6 +425,7 @@ static int p_run_poll_loop(struct core_object *co, struct state_object *so, stru
                 return -1;
             }
         }
+        watchdog_iteration_end(co->watchdog);
     }
     
     return 0;
@@ -354,6 +453,18 @@ static void end_gogo_handler(int signal)
 
 #pragma GCC diagnostic pop
 
+static int sem_wait_restart(struct syscall_stats *stats, sem_t *sem)
+{
+    int status;
+    
+    do
+    {
+        status = counted_sem_wait(stats, sem);
+    } while (status == -1 && errno == EINTR && GOGO_PROCESS);
+    
+    return status;
+}
+
 static int p_accept_new_connection(struct core_object *co, struct parent_struct *parent, struct pollfd *pollfds)
 {
     DC_TRACE(co->env);
@@ -365,7 +476,8 @@ static int p_accept_new_connection(struct core_object *co, struct parent_struct
     sockaddr_size = sizeof(struct sockaddr_in);
     
     // pollfds->fd is listen socket.
-    new_cfd = accept(pollfds->fd, (struct sockaddr *) &parent->client_addrs[pollfd_index - 2], &sockaddr_size);
+    new_cfd = counted_accept(co->stats, pollfds->fd, (struct sockaddr *) &parent->client_addrs[pollfd_index - 2],
+                             &sockaddr_size);
     if (new_cfd == -1)
     {
         return -1;
@@ -375,6 +487,7 @@ static int p_accept_new_connection(struct core_object *co, struct parent_struct
     pollfds[pollfd_index].fd     = new_cfd; // Plus one because listen_fd.
     pollfds[pollfd_index].events = POLLIN;
     ++parent->num_connections;
+    SERVER_PROBE(accept, new_cfd, pollfd_index - 2);
     
     // Don't need to short-circuit here; will only be in this function if listen socket events == POLLIN.
     if (parent->num_connections >= MAX_CONNECTIONS)
@@ -408,29 +521,53 @@ static size_t p_get_pollfd_index(const struct pollfd *pollfds)
 static int p_read_pipe_reenable_fd(struct core_object *co, struct state_object *so, struct pollfd *pollfds)
 {
     DC_TRACE(co->env);
-    int     fd;
-    ssize_t bytes_read;
+    struct dispatch_record record;
+    ssize_t                bytes_read;
     
-    bytes_read = read(so->c_to_p_pipe_fds[READ], &fd, sizeof(int));
+    bytes_read = counted_read(co->stats, so->c_to_p_pipe_fds[READ], &record, sizeof(struct dispatch_record));
     
-    sem_post(so->c_to_p_pipe_sem_write);
+    counted_sem_post(co->stats, so->c_to_p_pipe_sem_write);
     
     if (bytes_read == -1)
     {
         return -1;
     }
+    record.stamps[STAMP_PIPE_READ] = now_ns();
     
     FOR_EACH_SOCKET_POLLFD_p_IN_POLLFDS
     {
-        if (pollfds[p].fd == fd * -1) // pollfd.fd here is negative.
+        if (pollfds[p].fd == record.client_fd * -1) // pollfd.fd here is negative.
         {
             pollfds[p].fd = pollfds[p].fd * -1; // Invert pollfd.fd so it will be read from in poll loop.
         }
     }
+    record.stamps[STAMP_REENABLED] = now_ns();
+    
+    p_record_dispatch_stages(so->parent, &record);
     
     return 0;
 }
 
+static void p_record_dispatch_stages(struct parent_struct *parent, const struct dispatch_record *record)
+{
+    for (size_t stage = 0; stage < DISPATCH_STAGES; ++stage)
+    {
+        // Stamps taken in different processes on the same monotonic clock; guard against reordering anyway.
+        histogram_record(&parent->dispatch_stages[stage],
+                         (record->stamps[stage + 1] > record->stamps[stage])
+                         ? record->stamps[stage + 1] - record->stamps[stage] : 0);
+    }
+}
+
+static void p_report_dispatch_stages(const struct parent_struct *parent)
+{
+    (void) fprintf(stdout, "Dispatch stage latencies:\n");
+    for (size_t stage = 0; stage < DISPATCH_STAGES; ++stage)
+    {
+        histogram_print(&parent->dispatch_stages[stage], dispatch_stage_names[stage], stdout);
+    }
+}
+
 static int p_handle_socket_action(struct core_object *co, struct state_object *so, struct pollfd *pollfds)
 {
     DC_TRACE(co->env);
@@ -441,17 +578,21 @@ static int p_handle_socket_action(struct core_object *co, struct state_object *s
         pollfd = pollfds + p;
         if (pollfd->revents == POLLIN)
         {
+            watchdog_service_start(co->watchdog, pollfd->fd); // Dispatch blocks while the domain socket is full.
             if (p_send_to_child(co, so, pollfd) == -1)
             {
                 return -1;
             }
+            watchdog_service_end(co->watchdog);
             pollfd->fd *= -1; // Disable the pollfd until it is signaled by the child to be re-enabled.
             
             // NOLINTNEXTLINE(hicpp-signed-bitwise): never negative
         } else if ((pollfd->revents & POLLHUP) || (pollfd->revents & POLLERR)) // Client has closed other end of socket.
             // On macOS, POLLHUP will be set; on Linux, POLLERR will be set.
         {
+            watchdog_service_start(co->watchdog, pollfd->fd);
             (p_remove_connection(co, so->parent, pollfd, p - 2, pollfds));
+            watchdog_service_end(co->watchdog);
         }
         pollfd->revents = 0; // Reset revents to be sure.
     }
@@ -462,18 +603,23 @@ static int p_handle_socket_action(struct core_object *co, struct state_object *s
 static int p_send_to_child(struct core_object *co, struct state_object *so, struct pollfd *active_pollfd)
 {
     DC_TRACE(co->env);
-    ssize_t        bytes_sent;
-    struct msghdr  msghdr;
-    struct iovec   iovec;
-    struct cmsghdr *cmsghdr;
-    char           control_buffer[CMSG_SPACE(sizeof(int))]; // Create space for one cmsghdr storing an integer.
+    ssize_t                bytes_sent;
+    struct msghdr          msghdr;
+    struct iovec           iovec;
+    struct cmsghdr         *cmsghdr;
+    struct dispatch_record record;
+    char                   control_buffer[CMSG_SPACE(sizeof(int))]; // Space for one cmsghdr storing an integer.
     
     memset(&msghdr, 0, sizeof(struct msghdr));
     memset(&iovec, 0, sizeof(struct iovec));
     memset(&control_buffer, 0, sizeof(control_buffer));
+    memset(&record, 0, sizeof(struct dispatch_record));
+    
+    record.client_fd                = active_pollfd->fd; // The original file descriptor number to send.
+    record.stamps[STAMP_POLL_WAKE]  = so->parent->poll_wake_ns;
     
-    iovec.iov_base = &active_pollfd->fd; // The original file descriptor number to send.
-    iovec.iov_len  = sizeof(int);
+    iovec.iov_base = &record;
+    iovec.iov_len  = sizeof(struct dispatch_record);
     
     msghdr.msg_iov        = &iovec; // Put the IO vector in the msghdr to send.
     msghdr.msg_iovlen     = 1;
@@ -491,16 +637,19 @@ static int p_send_to_child(struct core_object *co, struct state_object *so, stru
     cmsghdr->cmsg_len   = CMSG_LEN(sizeof(int));
     *((int *) CMSG_DATA(cmsghdr)) = active_pollfd->fd; // The file description to send.
     
-    if (sem_wait(so->domain_sems[WRITE]) == -1)
+    SERVER_PROBE(dispatch_start, active_pollfd->fd);
+    if (sem_wait_restart(co->stats, so->domain_sems[WRITE]) == -1)
     {
         return (errno == EINTR) ? 0 : -1;
     }
-    bytes_sent = sendmsg(so->domain_fds[WRITE], &msghdr, 0); // Send the msghdr.
+    record.stamps[STAMP_SENDMSG] = now_ns();
+    bytes_sent = counted_sendmsg(co->stats, so->domain_fds[WRITE], &msghdr, 0); // Send the msghdr.
     if (bytes_sent == -1)
     {
         return -1;
     }
-    sem_post(so->domain_sems[READ]);
+    counted_sem_post(co->stats, so->domain_sems[READ]);
+    SERVER_PROBE(dispatch_sent, active_pollfd->fd);
     
     return 0;
 }
@@ -592,27 +741,29 @@ static int c_get_file_description_from_domain_socket(struct core_object *co, str
     struct cmsghdr *cmsghdr;
     char           control_buffer[CMSG_SPACE(sizeof(int))]; // Create space for one cmsghdr storing an integer.
     socklen_t      socklen;
+    uint64_t       sem_acquired_ns;
     
     memset(&msghdr, 0, sizeof(struct msghdr));
     memset(&iovec, 0, sizeof(struct iovec));
     memset(&control_buffer, 0, sizeof(control_buffer));
     
-    iovec.iov_base = &child->client_fd_parent; // The original file descriptor.
-    iovec.iov_len  = sizeof(int);
+    iovec.iov_base = &child->record; // The dispatch record, holding the original file descriptor.
+    iovec.iov_len  = sizeof(struct dispatch_record);
     
     msghdr.msg_iov        = &iovec; // Put the IO vector in the msghdr to receive.
     msghdr.msg_iovlen     = 1;
     msghdr.msg_control    = control_buffer; // Put the control buffer into the msghdr to receive.
     msghdr.msg_controllen = sizeof(control_buffer);
     
-    if (sem_wait(so->domain_sems[READ]) == -1) // Wait for the domain socket read semaphore.
+    if (sem_wait_restart(co->stats, so->domain_sems[READ]) == -1) // Wait for the domain socket read semaphore.
     {
         return (errno == EINTR) ? 0 : -1;
     }
+    sem_acquired_ns = now_ns(); // recvmsg overwrites the record, so hold the stamp until it returns.
     
-    bytes_recv = recvmsg(so->domain_fds[READ], &msghdr, 0);
+    bytes_recv = counted_recvmsg(co->stats, so->domain_fds[READ], &msghdr, 0);
     
-    sem_post(so->domain_sems[WRITE]); // Signal the domain socket write semaphore.
+    counted_sem_post(co->stats, so->domain_sems[WRITE]); // Signal the domain socket write semaphore.
     
     if (bytes_recv == -1)
     {
@@ -620,9 +771,14 @@ static int c_get_file_description_from_domain_socket(struct core_object *co, str
     }
     
     // Store the information from the message in the child object.
+    child->record.stamps[STAMP_SEM_ACQUIRED] = sem_acquired_ns;
+    child->record.stamps[STAMP_RECVMSG]      = now_ns();
+    child->client_fd_parent                  = child->record.client_fd; // The original file descriptor.
     cmsghdr = CMSG_FIRSTHDR(&msghdr);
     child->client_fd_local = *((int *) CMSG_DATA(cmsghdr)); // The file description.
-    if (getpeername(child->client_fd_local, (struct sockaddr *) &child->client_addr, &socklen) == -1)
+    SERVER_PROBE(fd_received, child->client_fd_parent, child->client_fd_local);
+    if (counted_getpeername(co->stats, child->client_fd_local, (struct sockaddr *) &child->client_addr, &socklen)
+        == -1)
     {
         return -1;
     }
@@ -637,40 +793,99 @@ static int c_get_file_description_from_domain_socket(struct core_object *co, str
 static int c_recv_log_notify_parent_respond(struct core_object *co, struct state_object *so, struct child_struct *child)
 {
     DC_TRACE(co->env);
-    ssize_t  bytes;
-    char     *buffer;
-    uint32_t bytes_to_read;
-    uint32_t bytes_read;
-    time_t   start_time;
-    time_t   end_time;
-    clock_t  start_time_granular;
-    clock_t  end_time_granular;
-    double   elapsed_time_granular;
-    
-    if (c_get_message_length(co, child, &buffer, &bytes_to_read) == -1)
+    ssize_t                bytes;
+    char                   *buffer;
+    struct protocol_header header;
+    struct handler_response response;
+    void                   *message;
+    uint64_t               bytes_to_read;
+    uint64_t               bytes_read;
+    uint8_t                ack_buf[PROTOCOL_MAX_HEADER_SIZE];
+    size_t                 ack_size;
+    time_t                 start_time;
+    time_t                 end_time;
+    clock_t                start_time_granular;
+    clock_t                end_time_granular;
+    double                 elapsed_time_granular;
+    
+    switch (c_get_message_length(co, child, &buffer, &header))
+    {
+        case 0:
+        {
+            break;
+        }
+        case 1: // Closed; hand the socket back so the parent sees the hangup.
+        {
+            child->record.stamps[STAMP_PAYLOAD_DONE] = child->record.stamps[STAMP_FIRST_BYTE];
+            return c_inform_parent_recv_finished(co, so, child);
+        }
+        default:
+        {
+            return -1;
+        }
+    }
+    if (header.flags & PROTOCOL_FLAG_ECHO)
+    {
+        return c_echo_notify_parent(co, so, child, &header);
+    }
+    bytes_to_read   = header.length;
+    response.length = bytes_to_read;
+    if (handle_begin(co, bytes_to_read, &message) == -1)
     {
+        if (buffer)
+        {
+            co->mm->mm_free(co->mm, buffer);
+        }
         return -1;
     }
     
+    SERVER_PROBE(recv_start, child->client_fd_local, bytes_to_read);
     bytes               = 1;
     bytes_read          = 0;
     start_time          = time(NULL);
     start_time_granular = clock();
     while (bytes_read < bytes_to_read && bytes != 0)
     {
-        bytes = recv(child->client_fd_local, buffer + bytes_read, sizeof(buffer), 0); // Recv into buffer
-        if (bytes == -1)
+        // Never read past this message; with pipelining the next one follows it.
+        if (co->options.sink)
         {
-            co->mm->mm_free(co->mm, buffer);
+            bytes = sink_recv(co->stats, child->client_fd_local, bytes_to_read - bytes_read, 0);
+        }
+        else
+        {
+            bytes = counted_recv(co->stats, child->client_fd_local, buffer + bytes_read, bytes_to_read - bytes_read,
+                                 0);
+        }
+        if (bytes == -1 || (bytes > 0 && handle_chunk(co, message, (buffer) ? buffer + bytes_read : NULL,
+                                                      (size_t) bytes, bytes_to_read, &response) == -1))
+        {
+            handle_end(co, &message);
+            if (buffer)
+            {
+                co->mm->mm_free(co->mm, buffer);
+            }
             return -1;
         }
         bytes_read += bytes;
     }
+    if ((header.flags & PROTOCOL_FLAG_CHECKSUM) && bytes_read == bytes_to_read &&
+        c_verify_checksum(co, child, buffer, bytes_read) == -1)
+    {
+        handle_end(co, &message);
+        if (buffer)
+        {
+            co->mm->mm_free(co->mm, buffer);
+        }
+        return -1;
+    }
     end_time_granular   = clock();
     end_time            = time(NULL);
+    child->record.stamps[STAMP_PAYLOAD_DONE] = now_ns();
+    SERVER_PROBE(recv_done, child->client_fd_local, bytes_read);
     
     if (c_inform_parent_recv_finished(co, so, child) == -1) // Write OG fd to pipe.
     {
+        handle_end(co, &message);
         return -1;
     }
     
@@ -678,44 +893,165 @@ static int c_recv_log_notify_parent_respond(struct core_object *co, struct state
     
     if (c_log(co, so, child, bytes_read, start_time, end_time, elapsed_time_granular, end_time_granular) == -1)
     {
+        handle_end(co, &message);
         return -1;
     }
     
-    co->mm->mm_free(co->mm, buffer);
+    if (buffer)
+    {
+        co->mm->mm_free(co->mm, buffer);
+    }
+    if (bytes_read < bytes_to_read)
+    {
+        response.length = bytes_read; // Closed part way; ack what arrived, as before.
+    }
+    else if (handle_chunk(co, message, NULL, 0, bytes_to_read, &response) == -1)
+    {
+        handle_end(co, &message);
+        return -1;
+    }
+    handle_end(co, &message); // Whether the message ended or the client went away part way.
     
-    bytes_read = htonl(bytes_read);
-    bytes      = send(child->client_fd_local, &bytes_read, sizeof(bytes_read), 0); //Send back the number of bytes read.
+    ack_size = protocol_encode_ack(&header, response.length, ack_buf); // Ack in the version of the request.
+    bytes    = counted_send(co->stats, child->client_fd_local, ack_buf, ack_size, 0); // Send count.
     if (bytes == -1)
     {
         return -1;
     }
+    SERVER_PROBE(ack, child->client_fd_local, bytes_read);
+    count_message(co->stats, bytes_read);
     
     return 0;
 }
 
-static int c_get_message_length(struct core_object *co, const struct child_struct *child,
-                                char **buffer, uint32_t *bytes_to_read)
+static int c_get_message_length(struct core_object *co, struct child_struct *child,
+                                char **buffer, struct protocol_header *header)
 {
     DC_TRACE(co->env);
     size_t  buffer_size;
+    size_t  header_size;
+    uint8_t header_buf[PROTOCOL_MAX_HEADER_SIZE];
     ssize_t bytes;
     
-    // Read the number of bytes that will be sent in the message.
-    bytes = recv(child->client_fd_local, bytes_to_read, sizeof((*bytes_to_read)), 0);
-    if (bytes == -1)
+    // Read the header, which holds the number of bytes that will be sent in the message.
+    bytes = counted_recv(co->stats, child->client_fd_local, header_buf, PROTOCOL_PREFIX_SIZE, MSG_WAITALL);
+    if (bytes == -1 && errno != ECONNRESET) // A reset between requests, such as with an echo unread, is a close.
     {
         return -1;
     }
+    child->record.stamps[STAMP_FIRST_BYTE] = now_ns();
+    header_size = (bytes > 0) ? protocol_header_size(header_buf) : 0;
+    if (header_size > PROTOCOL_PREFIX_SIZE) // v2; read the rest of the header.
+    {
+        bytes = counted_recv(co->stats, child->client_fd_local, header_buf + PROTOCOL_PREFIX_SIZE,
+                             header_size - PROTOCOL_PREFIX_SIZE, MSG_WAITALL);
+        if (bytes == -1 && errno != ECONNRESET)
+        {
+            return -1;
+        }
+    }
+    if (bytes <= 0)
+    {
+        return 1;
+    }
+    if (protocol_decode_header(header_buf, header) == -1)
+    {
+        (void) shutdown(child->client_fd_local, SHUT_RDWR); // A bad header; the parent will see the hangup.
+        return 1;
+    }
     
-    (*bytes_to_read) = ntohl((*bytes_to_read));
+    (*buffer) = NULL;
+    if (co->options.sink || (header->flags & PROTOCOL_FLAG_ECHO))
+    {
+        return 0; // The payload is only counted or goes straight back, so there is nothing to store it in.
+    }
     
     // Allocate the buffer based on bytes to read.
-    buffer_size = ((*bytes_to_read) + 1 * sizeof(char));
+    buffer_size = (header->length + 1 * sizeof(char));
     (*buffer) = (char *) Mmm_malloc(buffer_size, co->mm);
     if (!(*buffer))
+    {
+        (void) shutdown(child->client_fd_local, SHUT_RDWR); // Drop the one client rather than the child.
+        return 1;
+    }
+    
+    return 0;
+}
+
+static int c_echo_notify_parent(struct core_object *co, struct state_object *so, struct child_struct *child,
+                                const struct protocol_header *header)
+{
+    DC_TRACE(co->env);
+    uint8_t  ack_buf[PROTOCOL_MAX_HEADER_SIZE];
+    size_t   ack_size;
+    uint64_t echoed;
+    time_t   start_time;
+    time_t   end_time;
+    clock_t  start_time_granular;
+    clock_t  end_time_granular;
+    double   elapsed_time_granular;
+    
+    SERVER_PROBE(recv_start, child->client_fd_local, header->length);
+    start_time          = time(NULL);
+    start_time_granular = clock();
+    if (echo_pipe_open(&so->echo) == -1)
+    {
+        return -1;
+    }
+    
+    echoed   = 0;
+    ack_size = protocol_encode_ack(header, header->length, ack_buf); // The ack goes first; the payload follows it.
+    if (counted_send(co->stats, child->client_fd_local, ack_buf, ack_size, echo_ack_flags(header->length)) == -1 ||
+        echo_payload(co->stats, child->client_fd_local, &so->echo, header->length, &echoed) == -1)
+    {
+        echo_pipe_close(&so->echo); // Whatever is left in it belongs to this client.
+        if (errno != EPIPE && errno != ECONNRESET)
+        {
+            return -1;
+        }
+        (void) shutdown(child->client_fd_local, SHUT_RDWR); // The parent will see the hangup.
+    }
+    end_time_granular = clock();
+    end_time          = time(NULL);
+    child->record.stamps[STAMP_PAYLOAD_DONE] = now_ns();
+    SERVER_PROBE(recv_done, child->client_fd_local, echoed);
+    
+    if (c_inform_parent_recv_finished(co, so, child) == -1)
+    {
+        return -1;
+    }
+    
+    elapsed_time_granular = (double) (end_time_granular - start_time_granular) / CLOCKS_PER_SEC;
+    if (c_log(co, so, child, (ssize_t) echoed, start_time, end_time, elapsed_time_granular, end_time_granular) == -1)
+    {
+        return -1;
+    }
+    
+    if (echoed == header->length)
+    {
+        SERVER_PROBE(ack, child->client_fd_local, echoed);
+        count_message(co->stats, echoed);
+    }
+    
+    return 0;
+}
+
+static int c_verify_checksum(struct core_object *co, struct child_struct *child, const char *buffer,
+                             uint64_t length)
+{
+    DC_TRACE(co->env);
+    uint8_t trailer[PROTOCOL_CHECKSUM_SIZE];
+    ssize_t bytes;
+    
+    bytes = counted_recv(co->stats, child->client_fd_local, trailer, sizeof(trailer), MSG_WAITALL);
+    if (bytes == -1)
     {
         return -1;
     }
+    if (bytes == (ssize_t) sizeof(trailer) && buffer) // The whole payload is in hand, so one pass covers it.
+    {
+        count_checksum(co->stats, protocol_decode_checksum(trailer) == crc32c(0, buffer, (size_t) length));
+    }
     
     return 0;
 }
@@ -743,7 +1079,7 @@ static int c_log(struct core_object *co, struct state_object *so, struct child_s
     *(end_time_str + strlen(end_time_str) - 1) = '\0'; // Remove newline
     // NOLINTEND(concurrency-mt-unsafe)
     
-    if (sem_wait(so->log_sem) == -1)
+    if (sem_wait_restart(co->stats, so->log_sem) == -1)
     {
         return (errno == EINTR) ? 0 : -1;
     }
@@ -755,7 +1091,7 @@ static int c_log(struct core_object *co, struct state_object *so, struct child_s
                    (start_time_str) ? start_time_str : "NULL", (end_time_str) ? end_time_str : "NULL",
                    elapsed_time_granular, end_time_granular);
     
-    sem_post(so->log_sem);
+    counted_sem_post(co->stats, so->log_sem);
     
     return 0;
 }
@@ -765,12 +1101,13 @@ static int c_inform_parent_recv_finished(struct core_object *co, struct state_ob
     DC_TRACE(co->env);
     ssize_t bytes_written;
     
-    if (sem_wait(so->c_to_p_pipe_sem_write) == -1) // Wait for the pipe write semaphore.
+    if (sem_wait_restart(co->stats, so->c_to_p_pipe_sem_write) == -1) // Wait for the pipe write semaphore.
     {
         return (errno == EINTR) ? 0 : -1;
     }
     
-    bytes_written = write(so->c_to_p_pipe_fds[WRITE], &child->client_fd_parent, sizeof(int));
+    bytes_written = counted_write(co->stats, so->c_to_p_pipe_fds[WRITE], &child->record,
+                                  sizeof(struct dispatch_record));
     
     if (bytes_written == -1)
     {
@@ -786,6 +1123,7 @@ void destroy_process_state(struct core_object *co, struct state_object *so)
     
     if (so->parent)
     {
+        p_report_dispatch_stages(so->parent);
         p_destroy_parent_state(co, so, so->parent);
     } else if (so->child)
     {
@@ -294,6 +294,7 @@ void c_destroy_child_state(struct core_object *co, struct state_object *so, stru
     DC_TRACE(co->env);
     close_fd_report_undefined_error(so->c_to_p_pipe_fds[WRITE], "state of pipe write is undefined.");
     close_fd_report_undefined_error(so->domain_fds[READ], "state of child domain socket is undefined.");
+    echo_pipe_close(&so->echo);
     
     co->mm->mm_free(co->mm, child);
 }
@@ -7,22 +7,27 @@
 
 int main(int argc, char **argv)
 {
-    int                next_state;
-    int                run;
-    struct core_object co;
-    struct dc_env      *env;
-    struct dc_error    *err;
-    dc_env_tracer      tracer;
+    int                   next_state;
+    int                   run;
+    struct core_object    co;
+    struct engine_options options;
+    struct dc_env         *env;
+    struct dc_error       *err;
+    dc_env_tracer         tracer;
     
     tracer = NULL;
 //    tracer = trace_reporter;
     
+    memset(&options, 0, sizeof(struct engine_options));
+    options.stall_threshold_ms = DEFAULT_STALL_THRESHOLD_MS;
+    options.budget_kib         = DEFAULT_BUDGET_KIB;
+    
     err = dc_error_create(true);
     env = dc_env_create(err, false, tracer);
     
     char *end;
     
-    next_state = setup_core_object(&co, env, err, strtol(argv[2], &end, 10), argv[1]);
+    next_state = setup_core_object(&co, env, err, strtol(argv[2], &end, 10), argv[1], &options);
     if (next_state == -1)
     {
         return EXIT_FAILURE;
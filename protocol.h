@@ -0,0 +1,250 @@
+#ifndef SCALABLE_SERVER_PROTOCOL_H
+#define SCALABLE_SERVER_PROTOCOL_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Wire protocol between the client and the server engines. All fields are in network byte order.
+ *
+ * Version 1: a 4-byte payload length, then the payload. The server acks with the 4-byte number of bytes it
+ * received. One request is outstanding per connection.
+ *
+ * Version 2: a 24-byte header, then the payload. The server acks with a header of the same shape, with the ACK
+ * flag set, the number of bytes it received as the length, and the request ID of the request. Any number of
+ * requests may be in flight on a connection and acks may arrive in any order; the client matches them by ID.
+ * A request with the ECHO flag set is acked with the ECHO flag set too, and the ack is followed by the payload,
+ * sent back unchanged. A request with the CHECKSUM flag set is followed by a PROTOCOL_CHECKSUM_SIZE trailer, the
+ * CRC32C of the payload, which the server verifies; the length does not include the trailer. A request may not set
+ * both, since an echo is verified by the client.
+ *
+ *     offset  size  field
+ *     0       4     magic        PROTOCOL_MAGIC
+ *     4       1     version      PROTOCOL_VERSION_2
+ *     5       1     flags        PROTOCOL_FLAG_*
+ *     6       2     reserved     0
+ *     8       8     length       payload length in bytes
+ *     16      8     request_id   chosen by the client, echoed in the ack
+ *
+ * A server tells the versions apart by the first 4 bytes: the magic, or a v1 length. A v1 message of exactly
+ * PROTOCOL_MAGIC bytes (about 1.4 GB) cannot be sent.
+ *
+ * In either version the length is at most PROTOCOL_MAX_LENGTH. A server allocates a buffer of the length before
+ * it reads the payload, so a header with a larger length is rejected and its connection closed.
+ */
+
+#define PROTOCOL_MAGIC 0x53535632 // "SSV2"
+#define PROTOCOL_VERSION_1 1
+#define PROTOCOL_VERSION_2 2
+
+#define PROTOCOL_PREFIX_SIZE 4 // Bytes to read to tell the versions apart; the whole v1 header.
+#define PROTOCOL_V1_HEADER_SIZE 4
+#define PROTOCOL_V2_HEADER_SIZE 24
+#define PROTOCOL_MAX_HEADER_SIZE PROTOCOL_V2_HEADER_SIZE
+#define PROTOCOL_MAX_LENGTH (1ULL << 30) // The largest payload in bytes, 1 GiB; below PROTOCOL_MAGIC for v1.
+
+#define PROTOCOL_FLAG_ACK 0x01 // Set on acks from the server.
+#define PROTOCOL_FLAG_ECHO 0x02 // Set on requests whose payload should be sent back after the ack, and on their acks.
+#define PROTOCOL_FLAG_CHECKSUM 0x04 // Set on requests whose payload is followed by its CRC32C.
+#define PROTOCOL_FLAGS (PROTOCOL_FLAG_ACK | PROTOCOL_FLAG_ECHO | PROTOCOL_FLAG_CHECKSUM) // Every defined flag.
+
+#define PROTOCOL_CHECKSUM_SIZE 4
+
+/**
+ * protocol_header
+ * <p>
+ * A decoded request or ack header, of either version. Version 1 headers have only a length.
+ * </p>
+ */
+struct protocol_header {
+    uint8_t  version;
+    uint8_t  flags;
+    uint64_t length;
+    uint64_t request_id;
+};
+
+/**
+ * protocol_put_u64
+ * <p>
+ * Store a 64-bit value in network byte order.
+ * </p>
+ * @param buf where to store the value
+ * @param value the value
+ */
+static inline void protocol_put_u64(uint8_t *buf, uint64_t value)
+{
+    for (size_t i = 0; i < sizeof(uint64_t); ++i)
+    {
+        buf[i] = (uint8_t) (value >> (56 - 8 * i));
+    }
+}
+
+/**
+ * protocol_get_u64
+ * <p>
+ * Load a 64-bit value stored in network byte order.
+ * </p>
+ * @param buf where the value is stored
+ * @return the value
+ */
+static inline uint64_t protocol_get_u64(const uint8_t *buf)
+{
+    uint64_t value = 0;
+
+    for (size_t i = 0; i < sizeof(uint64_t); ++i)
+    {
+        value = (value << 8) | buf[i];
+    }
+
+    return value;
+}
+
+/**
+ * protocol_header_size
+ * <p>
+ * Get the size of a header from its first PROTOCOL_PREFIX_SIZE bytes.
+ * </p>
+ * @param prefix the first bytes of the header
+ * @return PROTOCOL_V2_HEADER_SIZE if the prefix is the v2 magic, PROTOCOL_V1_HEADER_SIZE otherwise
+ */
+static inline size_t protocol_header_size(const uint8_t *prefix)
+{
+    uint32_t magic;
+
+    memcpy(&magic, prefix, sizeof(magic));
+    return (ntohl(magic) == PROTOCOL_MAGIC) ? PROTOCOL_V2_HEADER_SIZE : PROTOCOL_V1_HEADER_SIZE;
+}
+
+/**
+ * protocol_decode_header
+ * <p>
+ * Decode a whole header of either version; protocol_header_size gives how many bytes that is.
+ * </p>
+ * @param buf the header
+ * @param header where to store the decoded header
+ * @return 0 on success, -1 and set errno to EPROTO if the length is above PROTOCOL_MAX_LENGTH, or if the header
+ * is v2 with an unsupported version, a flag that is not defined, or both ECHO and CHECKSUM
+ */
+static inline int protocol_decode_header(const uint8_t *buf, struct protocol_header *header)
+{
+    uint32_t length;
+
+    memset(header, 0, sizeof(struct protocol_header));
+    if (protocol_header_size(buf) == PROTOCOL_V1_HEADER_SIZE)
+    {
+        memcpy(&length, buf, sizeof(length));
+        header->version = PROTOCOL_VERSION_1;
+        header->length  = ntohl(length);
+        if (header->length > PROTOCOL_MAX_LENGTH)
+        {
+            errno = EPROTO;
+            return -1;
+        }
+        return 0;
+    }
+
+    header->version    = buf[4];
+    header->flags      = buf[5];
+    header->length     = protocol_get_u64(buf + 8);
+    header->request_id = protocol_get_u64(buf + 16);
+    if (header->version != PROTOCOL_VERSION_2 || header->length > PROTOCOL_MAX_LENGTH ||
+        (header->flags & ~PROTOCOL_FLAGS) ||
+        ((header->flags & PROTOCOL_FLAG_ECHO) && (header->flags & PROTOCOL_FLAG_CHECKSUM)))
+    {
+        errno = EPROTO;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * protocol_encode_header
+ * <p>
+ * Encode a header in the format of its version.
+ * </p>
+ * @param header the header
+ * @param buf where to store the header, at least PROTOCOL_MAX_HEADER_SIZE bytes
+ * @return the number of bytes stored
+ */
+static inline size_t protocol_encode_header(const struct protocol_header *header, uint8_t *buf)
+{
+    uint32_t word;
+
+    if (header->version == PROTOCOL_VERSION_1)
+    {
+        word = htonl((uint32_t) header->length);
+        memcpy(buf, &word, sizeof(word));
+        return PROTOCOL_V1_HEADER_SIZE;
+    }
+
+    word = htonl(PROTOCOL_MAGIC);
+    memcpy(buf, &word, sizeof(word));
+    buf[4] = PROTOCOL_VERSION_2;
+    buf[5] = header->flags;
+    buf[6] = 0;
+    buf[7] = 0;
+    protocol_put_u64(buf + 8, header->length);
+    protocol_put_u64(buf + 16, header->request_id);
+
+    return PROTOCOL_V2_HEADER_SIZE;
+}
+
+/**
+ * protocol_encode_ack
+ * <p>
+ * Encode the ack to a request, in the version of the request. The ack to an echo request is marked as an echo.
+ * </p>
+ * @param request the header of the request
+ * @param bytes the number of payload bytes received
+ * @param buf where to store the ack, at least PROTOCOL_MAX_HEADER_SIZE bytes
+ * @return the number of bytes stored
+ */
+static inline size_t protocol_encode_ack(const struct protocol_header *request, uint64_t bytes, uint8_t *buf)
+{
+    struct protocol_header ack;
+
+    ack.version    = request->version;
+    ack.flags      = PROTOCOL_FLAG_ACK | (request->flags & PROTOCOL_FLAG_ECHO);
+    ack.length     = bytes;
+    ack.request_id = request->request_id;
+
+    return protocol_encode_header(&ack, buf);
+}
+
+/**
+ * protocol_encode_checksum
+ * <p>
+ * Encode the checksum trailer of a request.
+ * </p>
+ * @param crc the CRC32C of the payload
+ * @param buf where to store the trailer, PROTOCOL_CHECKSUM_SIZE bytes
+ */
+static inline void protocol_encode_checksum(uint32_t crc, uint8_t *buf)
+{
+    uint32_t word;
+
+    word = htonl(crc);
+    memcpy(buf, &word, sizeof(word));
+}
+
+/**
+ * protocol_decode_checksum
+ * <p>
+ * Decode the checksum trailer of a request.
+ * </p>
+ * @param buf the trailer, PROTOCOL_CHECKSUM_SIZE bytes
+ * @return the CRC32C the client sent
+ */
+static inline uint32_t protocol_decode_checksum(const uint8_t *buf)
+{
+    uint32_t word;
+
+    memcpy(&word, buf, sizeof(word));
+    return ntohl(word);
+}
+
+#endif //SCALABLE_SERVER_PROTOCOL_H